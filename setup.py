@@ -7,10 +7,13 @@ if os.getenv("XXHASH_LINK_SO"):
     libraries = ["xxhash"]
     source = ["src/_xxhash.c"]
     include_dirs = []
+    define_macros = []
 else:
     libraries = []
-    source = ["src/_xxhash.c", "deps/xxhash/xxhash.c"]
+    # XXH3 picks its SIMD backend at import, see src/xxhash_dispatch.h.
+    source = ["src/_xxhash.c", "src/xxhash_dispatch.c", "deps/xxhash/xxhash.c"]
     include_dirs = ["deps/xxhash"]
+    define_macros = [("XXHASH_DISPATCH", "1")]
 
 ext_modules = [
     Extension(
@@ -18,6 +21,7 @@ ext_modules = [
         source,
         include_dirs=include_dirs,
         libraries=libraries,
+        define_macros=define_macros,
     )
 ]
 
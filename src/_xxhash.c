@@ -28,8 +28,36 @@
  non-cryptographic hash algorithm */
 
 #include <Python.h>
+#include <structmember.h>
 
+/* Hash objects embed their xxHash state, which needs its definition. */
+#define XXH_STATIC_LINKING_ONLY
 #include "xxhash.h"
+#ifdef XXHASH_DISPATCH
+#  include "xxhash_dispatch.h"
+#endif
+
+#include <fcntl.h>
+#include <time.h>
+#ifdef MS_WINDOWS
+#  include <io.h>
+#  include <windows.h>
+#endif
+#ifdef _MSC_VER
+#  include <intrin.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#  include <pthread.h>
+#  include <setjmp.h>
+#  include <signal.h>
+#  include <sys/mman.h>
+#endif
+#ifdef HAVE_FLOCK
+#  include <sys/file.h>
+#endif
+#ifndef MS_WINDOWS
+#  include <dirent.h>
+#endif
 
 /* ------------------------------------------------------------------ */
 /*  Lock type & helpers                                               */
@@ -145,20 +173,30 @@ _get_buffer_or_str(PyObject *obj, Py_buffer *buf)
  * Handles: positional 'data', positional 'seed', keyword 'data',
  * keyword 'seed', with proper error reporting for unknown keywords,
  * duplicate arguments, and too many positional args.
+ * If out (secret) is not NULL, a keyword-only 'out' ('secret') argument is
+ * also accepted and stored there (borrowed, NULL if not given).
  * Returns 0 on success, -1 on error with exception set. */
 static inline int
 _parse_fastcall_args(PyObject *const *args, Py_ssize_t nargs,
                      PyObject *kwnames, const char *funcname,
                      int data_required,
                      Py_buffer *buf,
-                     unsigned long long *seed)
+                     unsigned long long *seed,
+                     PyObject **out,
+                     PyObject **secret)
 {
     int data_found = 0;
     int seed_found = 0;
+    int out_found = 0;
+    int secret_found = 0;
 
     *seed = 0;
     buf->buf = NULL;
     buf->obj = NULL;
+    if (out)
+        *out = NULL;
+    if (secret)
+        *secret = NULL;
 
     /* positional args */
     if (nargs >= 1) {
@@ -207,6 +245,24 @@ _parse_fastcall_args(PyObject *const *args, Py_ssize_t nargs,
                 if (PyErr_Occurred())
                     goto error;
                 seed_found = 1;
+            } else if (out && PyUnicode_CompareWithASCIIString(key, "out") == 0) {
+                if (out_found) {
+                    PyErr_Format(PyExc_TypeError,
+                        "%s() got multiple values for argument 'out'",
+                        funcname);
+                    goto error;
+                }
+                *out = (val == Py_None) ? NULL : val;
+                out_found = 1;
+            } else if (secret && PyUnicode_CompareWithASCIIString(key, "secret") == 0) {
+                if (secret_found) {
+                    PyErr_Format(PyExc_TypeError,
+                        "%s() got multiple values for argument 'secret'",
+                        funcname);
+                    goto error;
+                }
+                *secret = (val == Py_None) ? NULL : val;
+                secret_found = 1;
             } else {
                 PyErr_Format(PyExc_TypeError,
                     "'%U' is an invalid keyword argument for '%s()'",
@@ -230,6 +286,205 @@ error:
     return -1;
 }
 
+/* Map fastcall arguments onto the NULL-terminated list of parameter *names*.
+ * The first *maxpos* parameters may be given positionally, the first
+ * *required* ones must be given. Borrowed references are stored in *slots*
+ * (one per name), parameters not given are left NULL.
+ * Returns 0 on success, -1 on error with exception set. */
+static int
+_parse_fastcall_kwargs(PyObject *const *args, Py_ssize_t nargs,
+                       PyObject *kwnames, const char *funcname,
+                       const char *const *names, Py_ssize_t maxpos,
+                       Py_ssize_t required, PyObject **slots)
+{
+    Py_ssize_t nnames = 0;
+    while (names[nnames] != NULL) {
+        slots[nnames] = NULL;
+        nnames++;
+    }
+
+    if (nargs > maxpos) {
+        PyErr_Format(PyExc_TypeError,
+            "%s() takes at most %zd positional argument%s (%zd given)",
+            funcname, maxpos, maxpos == 1 ? "" : "s", nargs);
+        return -1;
+    }
+    for (Py_ssize_t i = 0; i < nargs; i++) {
+        slots[i] = args[i];
+    }
+
+    if (kwnames) {
+        Py_ssize_t nkw = PyTuple_GET_SIZE(kwnames);
+        for (Py_ssize_t i = 0; i < nkw; i++) {
+            PyObject *key = PyTuple_GET_ITEM(kwnames, i);
+            Py_ssize_t j;
+            for (j = 0; j < nnames; j++) {
+                if (PyUnicode_CompareWithASCIIString(key, names[j]) == 0)
+                    break;
+            }
+            if (j == nnames) {
+                PyErr_Format(PyExc_TypeError,
+                    "'%U' is an invalid keyword argument for '%s()'",
+                    key, funcname);
+                return -1;
+            }
+            if (slots[j] != NULL) {
+                PyErr_Format(PyExc_TypeError,
+                    "%s() got multiple values for argument '%s'",
+                    funcname, names[j]);
+                return -1;
+            }
+            slots[j] = args[nargs + i];
+        }
+    }
+
+    for (Py_ssize_t i = 0; i < required; i++) {
+        if (slots[i] == NULL) {
+            PyErr_Format(PyExc_TypeError,
+                "%s() missing required argument '%s'", funcname, names[i]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Build a Python int from a 128-bit digest: (high64 << 64) + low64. */
+static PyObject *
+_xxh128_to_pylong(XXH128_hash_t intdigest)
+{
+    PyObject *sixtyfour = PyLong_FromLong(64);
+    PyObject *low = PyLong_FromUnsignedLongLong(intdigest.low64);
+    PyObject *high = PyLong_FromUnsignedLongLong(intdigest.high64);
+    PyObject *result = NULL;
+
+    if (sixtyfour && low && high) {
+        PyObject *shifted = PyNumber_Lshift(high, sixtyfour);
+        if (shifted) {
+            result = PyNumber_Add(shifted, low);
+            Py_DECREF(shifted);
+        }
+    }
+    Py_XDECREF(high);
+    Py_XDECREF(low);
+    Py_XDECREF(sixtyfour);
+    return result;
+}
+
+/* Acquire a writable, C-contiguous buffer of at least size bytes from the
+ * caller-provided out object.
+ * Returns 0 on success, -1 on error with exception set. */
+static int
+_get_out_buffer(PyObject *out, Py_ssize_t size, Py_buffer *view,
+                const char *funcname)
+{
+    if (PyObject_GetBuffer(out, view, PyBUF_WRITABLE) < 0)
+        return -1;
+    if (view->len < size) {
+        PyErr_Format(PyExc_ValueError,
+            "%s() out buffer is too small: %zd bytes required, got %zd",
+            funcname, size, view->len);
+        PyBuffer_Release(view);
+        return -1;
+    }
+    return 0;
+}
+
+/* Copy a single digest into the out buffer and return a new reference to
+ * out, or NULL on error. */
+static PyObject *
+_store_out(PyObject *out, const void *digest, Py_ssize_t size,
+           const char *funcname)
+{
+    Py_buffer view;
+    if (_get_out_buffer(out, size, &view, funcname) < 0)
+        return NULL;
+    memcpy(view.buf, digest, size);
+    PyBuffer_Release(&view);
+    Py_INCREF(out);
+    return out;
+}
+
+/* Acquire the buffer of an XXH3 secret argument. obj may be NULL, in which
+ * case secret->obj is left NULL and PyBuffer_Release(secret) is a no-op.
+ * A secret replaces the seed, so a nonzero seed alongside it is an error.
+ * Returns 0 on success, -1 on error with exception set. */
+static int
+_get_secret(PyObject *obj, unsigned long long seed, Py_buffer *secret,
+            const char *funcname)
+{
+    secret->buf = NULL;
+    secret->obj = NULL;
+    if (obj == NULL)
+        return 0;
+    if (seed != 0) {
+        PyErr_Format(PyExc_ValueError,
+            "%s() takes either a seed or a secret, not both", funcname);
+        return -1;
+    }
+    if (_get_buffer_or_str(obj, secret) < 0)
+        return -1;
+    if (secret->len < XXH3_SECRET_SIZE_MIN) {
+        PyErr_Format(PyExc_ValueError,
+            "%s() secret must be at least %d bytes, got %zd",
+            funcname, XXH3_SECRET_SIZE_MIN, secret->len);
+        PyBuffer_Release(secret);
+        secret->obj = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/* Like _get_secret(), but return the secret as a new reference to an
+ * immutable bytes object that a hash state can point into, or NULL with
+ * *error set to -1 on error (0 if obj was NULL). */
+static PyObject *
+_get_secret_bytes(PyObject *obj, unsigned long long seed,
+                  const char *funcname, int *error)
+{
+    Py_buffer secret;
+    PyObject *ret;
+
+    *error = 0;
+    if (_get_secret(obj, seed, &secret, funcname) < 0) {
+        *error = -1;
+        return NULL;
+    }
+    if (secret.obj == NULL)
+        return NULL;
+    if (PyBytes_CheckExact(obj)) {
+        ret = obj;
+        Py_INCREF(ret);
+    } else {
+        ret = PyBytes_FromStringAndSize(secret.buf, secret.len);
+        if (ret == NULL)
+            *error = -1;
+    }
+    PyBuffer_Release(&secret);
+    return ret;
+}
+
+/* One-shot XXH3 hashes of buf, with secret when secret->obj is set and
+ * with seed otherwise. */
+static inline XXH64_hash_t
+_xxh3_64_oneshot(const Py_buffer *buf, XXH64_hash_t seed,
+                 const Py_buffer *secret)
+{
+    if (secret->obj)
+        return XXH3_64bits_withSecret(buf->buf, buf->len,
+                                      secret->buf, secret->len);
+    return XXH3_64bits_withSeed(buf->buf, buf->len, seed);
+}
+
+static inline XXH128_hash_t
+_xxh3_128_oneshot(const Py_buffer *buf, XXH64_hash_t seed,
+                  const Py_buffer *secret)
+{
+    if (secret->obj)
+        return XXH3_128bits_withSecret(buf->buf, buf->len,
+                                       secret->buf, secret->len);
+    return XXH3_128bits_withSeed(buf->buf, buf->len, seed);
+}
+
 /*****************************************************************************
  * Module Functions ***********************************************************
  ****************************************************************************/
@@ -241,7 +496,8 @@ static PyObject *xxh32_digest(PyObject *self, PyObject *const *args,
     XXH32_hash_t seed = 0;
     Py_buffer buf;
     unsigned long long raw_seed;
-    if (_parse_fastcall_args(args, nargs, kwnames, "xxh32_digest", 1, &buf, &raw_seed) < 0)
+    PyObject *out;
+    if (_parse_fastcall_args(args, nargs, kwnames, "xxh32_digest", 1, &buf, &raw_seed, &out, NULL) < 0)
         return NULL;
     seed = (XXH32_hash_t)raw_seed;
 
@@ -255,6 +511,12 @@ static PyObject *xxh32_digest(PyObject *self, PyObject *const *args,
     }
     PyBuffer_Release(&buf);
 
+    if (out) {
+        XXH32_canonical_t canonical;
+        XXH32_canonicalFromHash(&canonical, intdigest);
+        return _store_out(out, &canonical, sizeof(canonical), "xxh32_digest");
+    }
+
     PyObject *ret = PyBytes_FromStringAndSize(NULL, XXH32_DIGESTSIZE);
     if (ret == NULL) return NULL;
     XXH32_canonicalFromHash((XXH32_canonical_t *)PyBytes_AS_STRING(ret), intdigest);
@@ -266,7 +528,8 @@ static PyObject *xxh32_intdigest(PyObject *self, PyObject *const *args,
     XXH32_hash_t seed = 0;
     Py_buffer buf;
     unsigned long long raw_seed;
-    if (_parse_fastcall_args(args, nargs, kwnames, "xxh32_intdigest", 1, &buf, &raw_seed) < 0)
+    PyObject *out;
+    if (_parse_fastcall_args(args, nargs, kwnames, "xxh32_intdigest", 1, &buf, &raw_seed, &out, NULL) < 0)
         return NULL;
     seed = (XXH32_hash_t)raw_seed;
 
@@ -280,6 +543,8 @@ static PyObject *xxh32_intdigest(PyObject *self, PyObject *const *args,
     }
     PyBuffer_Release(&buf);
 
+    if (out)
+        return _store_out(out, &intdigest, sizeof(intdigest), "xxh32_intdigest");
     return PyLong_FromUnsignedLong(intdigest);
 }
 static PyObject *xxh32_hexdigest(PyObject *self, PyObject *const *args,
@@ -288,7 +553,7 @@ static PyObject *xxh32_hexdigest(PyObject *self, PyObject *const *args,
     XXH32_hash_t seed = 0;
     Py_buffer buf;
     unsigned long long raw_seed;
-    if (_parse_fastcall_args(args, nargs, kwnames, "xxh32_hexdigest", 1, &buf, &raw_seed) < 0)
+    if (_parse_fastcall_args(args, nargs, kwnames, "xxh32_hexdigest", 1, &buf, &raw_seed, NULL, NULL) < 0)
         return NULL;
     seed = (XXH32_hash_t)raw_seed;
 
@@ -327,7 +592,8 @@ static PyObject *xxh64_digest(PyObject *self, PyObject *const *args,
     XXH64_hash_t seed = 0;
     Py_buffer buf;
     unsigned long long raw_seed;
-    if (_parse_fastcall_args(args, nargs, kwnames, "xxh64_digest", 1, &buf, &raw_seed) < 0)
+    PyObject *out;
+    if (_parse_fastcall_args(args, nargs, kwnames, "xxh64_digest", 1, &buf, &raw_seed, &out, NULL) < 0)
         return NULL;
     seed = (XXH64_hash_t)raw_seed;
 
@@ -341,6 +607,12 @@ static PyObject *xxh64_digest(PyObject *self, PyObject *const *args,
     }
     PyBuffer_Release(&buf);
 
+    if (out) {
+        XXH64_canonical_t canonical;
+        XXH64_canonicalFromHash(&canonical, intdigest);
+        return _store_out(out, &canonical, sizeof(canonical), "xxh64_digest");
+    }
+
     PyObject *ret = PyBytes_FromStringAndSize(NULL, XXH64_DIGESTSIZE);
     if (ret == NULL) return NULL;
     XXH64_canonicalFromHash((XXH64_canonical_t *)PyBytes_AS_STRING(ret), intdigest);
@@ -352,7 +624,8 @@ static PyObject *xxh64_intdigest(PyObject *self, PyObject *const *args,
     XXH64_hash_t seed = 0;
     Py_buffer buf;
     unsigned long long raw_seed;
-    if (_parse_fastcall_args(args, nargs, kwnames, "xxh64_intdigest", 1, &buf, &raw_seed) < 0)
+    PyObject *out;
+    if (_parse_fastcall_args(args, nargs, kwnames, "xxh64_intdigest", 1, &buf, &raw_seed, &out, NULL) < 0)
         return NULL;
     seed = (XXH64_hash_t)raw_seed;
 
@@ -366,6 +639,8 @@ static PyObject *xxh64_intdigest(PyObject *self, PyObject *const *args,
     }
     PyBuffer_Release(&buf);
 
+    if (out)
+        return _store_out(out, &intdigest, sizeof(intdigest), "xxh64_intdigest");
     return PyLong_FromUnsignedLongLong(intdigest);
 }
 static PyObject *xxh64_hexdigest(PyObject *self, PyObject *const *args,
@@ -374,7 +649,7 @@ static PyObject *xxh64_hexdigest(PyObject *self, PyObject *const *args,
     XXH64_hash_t seed = 0;
     Py_buffer buf;
     unsigned long long raw_seed;
-    if (_parse_fastcall_args(args, nargs, kwnames, "xxh64_hexdigest", 1, &buf, &raw_seed) < 0)
+    if (_parse_fastcall_args(args, nargs, kwnames, "xxh64_hexdigest", 1, &buf, &raw_seed, NULL, NULL) < 0)
         return NULL;
     seed = (XXH64_hash_t)raw_seed;
 
@@ -413,19 +688,32 @@ static PyObject *xxh3_64_digest(PyObject *self, PyObject *const *args,
     XXH64_hash_t seed = 0;
     Py_buffer buf;
     unsigned long long raw_seed;
-    if (_parse_fastcall_args(args, nargs, kwnames, "xxh3_64_digest", 1, &buf, &raw_seed) < 0)
+    PyObject *out, *secret_obj;
+    Py_buffer secret;
+    if (_parse_fastcall_args(args, nargs, kwnames, "xxh3_64_digest", 1, &buf, &raw_seed, &out, &secret_obj) < 0)
         return NULL;
     seed = (XXH64_hash_t)raw_seed;
+    if (_get_secret(secret_obj, raw_seed, &secret, "xxh3_64_digest") < 0) {
+        PyBuffer_Release(&buf);
+        return NULL;
+    }
 
     XXH64_hash_t intdigest;
     if (buf.len > XXHASH_GIL_MINSIZE) {
         Py_BEGIN_ALLOW_THREADS
-        intdigest = XXH3_64bits_withSeed(buf.buf, buf.len, seed);
+        intdigest = _xxh3_64_oneshot(&buf, seed, &secret);
         Py_END_ALLOW_THREADS
     } else {
-        intdigest = XXH3_64bits_withSeed(buf.buf, buf.len, seed);
+        intdigest = _xxh3_64_oneshot(&buf, seed, &secret);
     }
     PyBuffer_Release(&buf);
+    PyBuffer_Release(&secret);
+
+    if (out) {
+        XXH64_canonical_t canonical;
+        XXH64_canonicalFromHash(&canonical, intdigest);
+        return _store_out(out, &canonical, sizeof(canonical), "xxh3_64_digest");
+    }
 
     PyObject *ret = PyBytes_FromStringAndSize(NULL, XXH64_DIGESTSIZE);
     if (ret == NULL) return NULL;
@@ -438,20 +726,29 @@ static PyObject *xxh3_64_intdigest(PyObject *self, PyObject *const *args,
     XXH64_hash_t seed = 0;
     Py_buffer buf;
     unsigned long long raw_seed;
-    if (_parse_fastcall_args(args, nargs, kwnames, "xxh3_64_intdigest", 1, &buf, &raw_seed) < 0)
+    PyObject *out, *secret_obj;
+    Py_buffer secret;
+    if (_parse_fastcall_args(args, nargs, kwnames, "xxh3_64_intdigest", 1, &buf, &raw_seed, &out, &secret_obj) < 0)
         return NULL;
     seed = (XXH64_hash_t)raw_seed;
+    if (_get_secret(secret_obj, raw_seed, &secret, "xxh3_64_intdigest") < 0) {
+        PyBuffer_Release(&buf);
+        return NULL;
+    }
 
     XXH64_hash_t intdigest;
     if (buf.len > XXHASH_GIL_MINSIZE) {
         Py_BEGIN_ALLOW_THREADS
-        intdigest = XXH3_64bits_withSeed(buf.buf, buf.len, seed);
+        intdigest = _xxh3_64_oneshot(&buf, seed, &secret);
         Py_END_ALLOW_THREADS
     } else {
-        intdigest = XXH3_64bits_withSeed(buf.buf, buf.len, seed);
+        intdigest = _xxh3_64_oneshot(&buf, seed, &secret);
     }
     PyBuffer_Release(&buf);
+    PyBuffer_Release(&secret);
 
+    if (out)
+        return _store_out(out, &intdigest, sizeof(intdigest), "xxh3_64_intdigest");
     return PyLong_FromUnsignedLongLong(intdigest);
 }
 static PyObject *xxh3_64_hexdigest(PyObject *self, PyObject *const *args,
@@ -460,19 +757,26 @@ static PyObject *xxh3_64_hexdigest(PyObject *self, PyObject *const *args,
     XXH64_hash_t seed = 0;
     Py_buffer buf;
     unsigned long long raw_seed;
-    if (_parse_fastcall_args(args, nargs, kwnames, "xxh3_64_hexdigest", 1, &buf, &raw_seed) < 0)
+    PyObject *secret_obj;
+    Py_buffer secret;
+    if (_parse_fastcall_args(args, nargs, kwnames, "xxh3_64_hexdigest", 1, &buf, &raw_seed, NULL, &secret_obj) < 0)
         return NULL;
     seed = (XXH64_hash_t)raw_seed;
+    if (_get_secret(secret_obj, raw_seed, &secret, "xxh3_64_hexdigest") < 0) {
+        PyBuffer_Release(&buf);
+        return NULL;
+    }
 
     XXH64_hash_t intdigest;
     if (buf.len > XXHASH_GIL_MINSIZE) {
         Py_BEGIN_ALLOW_THREADS
-        intdigest = XXH3_64bits_withSeed(buf.buf, buf.len, seed);
+        intdigest = _xxh3_64_oneshot(&buf, seed, &secret);
         Py_END_ALLOW_THREADS
     } else {
-        intdigest = XXH3_64bits_withSeed(buf.buf, buf.len, seed);
+        intdigest = _xxh3_64_oneshot(&buf, seed, &secret);
     }
     PyBuffer_Release(&buf);
+    PyBuffer_Release(&secret);
 
     char digest[XXH64_DIGESTSIZE];
     XXH64_canonicalFromHash((XXH64_canonical_t *)digest, intdigest);
@@ -499,19 +803,32 @@ static PyObject *xxh3_128_digest(PyObject *self, PyObject *const *args,
     XXH64_hash_t seed = 0;
     Py_buffer buf;
     unsigned long long raw_seed;
-    if (_parse_fastcall_args(args, nargs, kwnames, "xxh3_128_digest", 1, &buf, &raw_seed) < 0)
+    PyObject *out, *secret_obj;
+    Py_buffer secret;
+    if (_parse_fastcall_args(args, nargs, kwnames, "xxh3_128_digest", 1, &buf, &raw_seed, &out, &secret_obj) < 0)
         return NULL;
     seed = (XXH64_hash_t)raw_seed;
+    if (_get_secret(secret_obj, raw_seed, &secret, "xxh3_128_digest") < 0) {
+        PyBuffer_Release(&buf);
+        return NULL;
+    }
 
     XXH128_hash_t intdigest;
     if (buf.len > XXHASH_GIL_MINSIZE) {
         Py_BEGIN_ALLOW_THREADS
-        intdigest = XXH3_128bits_withSeed(buf.buf, buf.len, seed);
+        intdigest = _xxh3_128_oneshot(&buf, seed, &secret);
         Py_END_ALLOW_THREADS
     } else {
-        intdigest = XXH3_128bits_withSeed(buf.buf, buf.len, seed);
+        intdigest = _xxh3_128_oneshot(&buf, seed, &secret);
     }
     PyBuffer_Release(&buf);
+    PyBuffer_Release(&secret);
+
+    if (out) {
+        XXH128_canonical_t canonical;
+        XXH128_canonicalFromHash(&canonical, intdigest);
+        return _store_out(out, &canonical, sizeof(canonical), "xxh3_128_digest");
+    }
 
     PyObject *ret = PyBytes_FromStringAndSize(NULL, XXH128_DIGESTSIZE);
     if (ret == NULL) return NULL;
@@ -524,36 +841,30 @@ static PyObject *xxh3_128_intdigest(PyObject *self, PyObject *const *args,
     XXH64_hash_t seed = 0;
     Py_buffer buf;
     unsigned long long raw_seed;
-    if (_parse_fastcall_args(args, nargs, kwnames, "xxh3_128_intdigest", 1, &buf, &raw_seed) < 0)
+    PyObject *out, *secret_obj;
+    Py_buffer secret;
+    if (_parse_fastcall_args(args, nargs, kwnames, "xxh3_128_intdigest", 1, &buf, &raw_seed, &out, &secret_obj) < 0)
         return NULL;
     seed = (XXH64_hash_t)raw_seed;
+    if (_get_secret(secret_obj, raw_seed, &secret, "xxh3_128_intdigest") < 0) {
+        PyBuffer_Release(&buf);
+        return NULL;
+    }
 
     XXH128_hash_t intdigest;
     if (buf.len > XXHASH_GIL_MINSIZE) {
         Py_BEGIN_ALLOW_THREADS
-        intdigest = XXH3_128bits_withSeed(buf.buf, buf.len, seed);
+        intdigest = _xxh3_128_oneshot(&buf, seed, &secret);
         Py_END_ALLOW_THREADS
     } else {
-        intdigest = XXH3_128bits_withSeed(buf.buf, buf.len, seed);
+        intdigest = _xxh3_128_oneshot(&buf, seed, &secret);
     }
     PyBuffer_Release(&buf);
+    PyBuffer_Release(&secret);
 
-    PyObject *sixtyfour = PyLong_FromLong(64);
-    PyObject *low = PyLong_FromUnsignedLongLong(intdigest.low64);
-    PyObject *high = PyLong_FromUnsignedLongLong(intdigest.high64);
-    PyObject *result = NULL;
-
-    if (sixtyfour && low && high) {
-        PyObject *shifted = PyNumber_Lshift(high, sixtyfour);
-        if (shifted) {
-            result = PyNumber_Add(shifted, low);
-            Py_DECREF(shifted);
-        }
-    }
-    Py_XDECREF(high);
-    Py_XDECREF(low);
-    Py_XDECREF(sixtyfour);
-    return result;
+    if (out)
+        return _store_out(out, &intdigest, sizeof(intdigest), "xxh3_128_intdigest");
+    return _xxh128_to_pylong(intdigest);
 }
 static PyObject *xxh3_128_hexdigest(PyObject *self, PyObject *const *args,
                                   Py_ssize_t nargs, PyObject *kwnames)
@@ -561,19 +872,26 @@ static PyObject *xxh3_128_hexdigest(PyObject *self, PyObject *const *args,
     XXH64_hash_t seed = 0;
     Py_buffer buf;
     unsigned long long raw_seed;
-    if (_parse_fastcall_args(args, nargs, kwnames, "xxh3_128_hexdigest", 1, &buf, &raw_seed) < 0)
+    PyObject *secret_obj;
+    Py_buffer secret;
+    if (_parse_fastcall_args(args, nargs, kwnames, "xxh3_128_hexdigest", 1, &buf, &raw_seed, NULL, &secret_obj) < 0)
         return NULL;
     seed = (XXH64_hash_t)raw_seed;
+    if (_get_secret(secret_obj, raw_seed, &secret, "xxh3_128_hexdigest") < 0) {
+        PyBuffer_Release(&buf);
+        return NULL;
+    }
 
     XXH128_hash_t intdigest;
     if (buf.len > XXHASH_GIL_MINSIZE) {
         Py_BEGIN_ALLOW_THREADS
-        intdigest = XXH3_128bits_withSeed(buf.buf, buf.len, seed);
+        intdigest = _xxh3_128_oneshot(&buf, seed, &secret);
         Py_END_ALLOW_THREADS
     } else {
-        intdigest = XXH3_128bits_withSeed(buf.buf, buf.len, seed);
+        intdigest = _xxh3_128_oneshot(&buf, seed, &secret);
     }
     PyBuffer_Release(&buf);
+    PyBuffer_Release(&secret);
 
     char digest[XXH128_DIGESTSIZE];
     XXH128_canonicalFromHash((XXH128_canonical_t *)digest, intdigest);
@@ -593,1588 +911,10795 @@ static PyObject *xxh3_128_hexdigest(PyObject *self, PyObject *const *args,
     return ret;
 }
 
-/*****************************************************************************
- * Module Types ***************************************************************
- ****************************************************************************/
-
-/* XXH32 */
-
-typedef struct {
-    PyObject_HEAD
-    XXH32_state_t *xxhash_state;
-    XXH32_hash_t seed;
-    XXHASH_LOCK_FIELD
-} PYXXH32Object;
-
-static void PYXXH32_dealloc(PYXXH32Object *self)
-{
-    if (self->xxhash_state)
-        XXH32_freeState(self->xxhash_state);
-    XXHASH_LOCK_FINI(self);
-    PyTypeObject *tp = Py_TYPE(self);
-    tp->tp_free((PyObject *)self);
-    Py_DECREF(tp);
-}
-
-/* Macro to generate _do_update for each hash type.
- * Matches CPython 3.9-3.12 md5 pattern: release GIL first (for large data),
- * then acquire lock, hash, release lock, re-acquire GIL.
- * For small data, acquire lock with GIL held (try-then-block if contested). */
-#define XXHASH_DO_UPDATE(type, update_fn)                                     \
-static inline void                                           \
-PY##type##_do_update(PY##type##Object *self, Py_buffer *buf)                  \
-{                                                                             \
-    XXHASH_LOCK_MAYBE_INIT(self, buf->len);                                   \
-    if (XXHASH_LOCK_IS_ACTIVE(self)) {                                        \
-        if (buf->len > XXHASH_GIL_MINSIZE) {                                  \
-            /* Release GIL first, then acquire lock. */                       \
-            Py_BEGIN_ALLOW_THREADS                                            \
-            XXHASH_LOCK_ACQUIRE_BLOCKING(self);                               \
-            update_fn(self->xxhash_state, buf->buf, buf->len);                \
-            XXHASH_LOCK_RELEASE(self);                                        \
-            Py_END_ALLOW_THREADS                                              \
-        } else {                                                              \
-            /* Acquire lock with GIL held. */                                 \
-            XXHASH_LOCK_ACQUIRE(self);                                        \
-            update_fn(self->xxhash_state, buf->buf, buf->len);                \
-            XXHASH_LOCK_RELEASE(self);                                        \
-        }                                                                     \
-    } else {                                                                  \
-        /* No lock: hash directly, no GIL release. */                         \
-        update_fn(self->xxhash_state, buf->buf, buf->len);                    \
-    }                                                                         \
-    PyBuffer_Release(buf);                                                    \
-}
-
-XXHASH_DO_UPDATE(XXH32, XXH32_update)
+/* XXH3 secrets */
+PyDoc_STRVAR(
+    xxh3_generate_secret_doc,
+    "xxh3_generate_secret(material=None, size=XXH3_SECRET_DEFAULT_SIZE) -> bytes\n"
+    "\n"
+    "Derive an XXH3 secret of size bytes from the bytes-like material, which\n"
+    "may be of any length and quality. If material is None, 32 bytes from\n"
+    "os.urandom() are used, giving a secret suitable for keying hash tables\n"
+    "against collision flooding. size must be at least XXH3_SECRET_SIZE_MIN.");
 
 static PyObject *
-PYXXH32_vectorcall(PyObject *type, PyObject *const *args,
-                   size_t nargsf, PyObject *kwnames)
+xxh3_generate_secret(PyObject *self, PyObject *const *args,
+                     Py_ssize_t nargs, PyObject *kwnames)
 {
-    Py_ssize_t nargs = PyVectorcall_NARGS(nargsf);
-    XXH32_hash_t seed = 0;
+    static const char *const names[] = {"material", "size", NULL};
+    PyObject *argv[2];
+    PyObject *material = NULL, *ret = NULL;
+    Py_ssize_t size = XXH3_SECRET_DEFAULT_SIZE;
     Py_buffer buf;
-    unsigned long long raw_seed;
 
-    if (_parse_fastcall_args(args, nargs, kwnames, "xxhash.xxh32", 0,
-                             &buf, &raw_seed) < 0)
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, "xxh3_generate_secret",
+                               names, 2, 0, argv) < 0)
         return NULL;
-    seed = (XXH32_hash_t)raw_seed;
-
-    PYXXH32Object *self = (PYXXH32Object *)
-        ((PyTypeObject *)type)->tp_alloc((PyTypeObject *)type, 0);
-    if (self == NULL) {
-        PyBuffer_Release(&buf);
+    if (argv[1]) {
+        size = PyLong_AsSsize_t(argv[1]);
+        if (size == -1 && PyErr_Occurred())
+            return NULL;
+    }
+    if (size < XXH3_SECRET_SIZE_MIN) {
+        PyErr_Format(PyExc_ValueError,
+            "xxh3_generate_secret() size must be at least %d, got %zd",
+            XXH3_SECRET_SIZE_MIN, size);
         return NULL;
     }
 
-    XXHASH_LOCK_INIT(self);
-
-    self->xxhash_state = XXH32_createState();
-    if (self->xxhash_state == NULL) {
-        Py_DECREF(self);
-        PyBuffer_Release(&buf);
-        return PyErr_NoMemory();
+    if (argv[0] == NULL || argv[0] == Py_None) {
+        PyObject *os = PyImport_ImportModule("os");
+        if (os == NULL)
+            return NULL;
+        material = PyObject_CallMethod(os, "urandom", "i", 32);
+        Py_DECREF(os);
+        if (material == NULL)
+            return NULL;
+    } else {
+        material = argv[0];
+        Py_INCREF(material);
     }
-    self->seed = seed;
-    XXH32_reset(self->xxhash_state, seed);
+    if (_get_buffer_or_str(material, &buf) < 0)
+        goto done;
 
-    if (buf.obj) {
-        /* Constructor: no concurrent access possible, skip locking. */
-        if (buf.len > XXHASH_GIL_MINSIZE) {
-            Py_BEGIN_ALLOW_THREADS
-            XXH32_update(self->xxhash_state, buf.buf, buf.len);
-            Py_END_ALLOW_THREADS
-        } else {
-            XXH32_update(self->xxhash_state, buf.buf, buf.len);
-        }
-        PyBuffer_Release(&buf);
-    }
-    return (PyObject *)self;
+    ret = PyBytes_FromStringAndSize(NULL, size);
+    if (ret)
+        XXH3_generateSecret(PyBytes_AS_STRING(ret), (size_t)size,
+                            buf.buf, (size_t)buf.len);
+    PyBuffer_Release(&buf);
+done:
+    Py_DECREF(material);
+    return ret;
 }
 
-/* XXH32 methods */
+typedef enum {
+    XXHASH_ALGO_XXH32,
+    XXHASH_ALGO_XXH64,
+    XXHASH_ALGO_XXH3_64,
+    XXHASH_ALGO_XXH3_128,
+} xxhash_algo;
 
-static PyObject *PYXXH32_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
-{
-    PYXXH32Object *self;
+#define XXHASH_NUM_ALGOS (XXHASH_ALGO_XXH3_128 + 1)
 
-    if ((self = (PYXXH32Object *)type->tp_alloc(type, 0)) == NULL) {
-        return NULL;
-    }
+static const Py_ssize_t xxhash_algo_digestsize[] = {
+    XXH32_DIGESTSIZE, XXH64_DIGESTSIZE, XXH64_DIGESTSIZE, XXH128_DIGESTSIZE,
+};
 
-    XXHASH_LOCK_INIT(self);
+/* XXH3 of str */
 
-    if ((self->xxhash_state = XXH32_createState()) == NULL) {
-        Py_DECREF(self);
-        PyErr_NoMemory();
-        return NULL;
-    }
+/* Bytes of UTF-8 encoded per pass over a non-ASCII str. Strings that fit
+ * are hashed in one shot, longer ones through a streaming state. */
+#define XXHASH_STR_CHUNK 1024
 
-    self->seed = 0;
-    XXH32_reset(self->xxhash_state, 0);
-
-    return (PyObject *)self;
+/* Encode code points of a str of the given kind from *pos on to UTF-8 into
+ * dst, as long as dstsize leaves room for a full character, and advance
+ * *pos. Returns the number of bytes written, or -1 at a lone surrogate,
+ * which the utf-8 codec refuses to encode. */
+static Py_ssize_t
+_str_utf8_chunk(int kind, const void *data, Py_ssize_t len, Py_ssize_t *pos,
+                unsigned char *dst, Py_ssize_t dstsize)
+{
+    Py_ssize_t i = *pos, n = 0;
+
+    for (; i < len && n <= dstsize - 4; i++) {
+        Py_UCS4 c = PyUnicode_READ(kind, data, i);
+        if (c < 0x80) {
+            dst[n++] = (unsigned char)c;
+        } else if (c < 0x800) {
+            dst[n++] = (unsigned char)(0xC0 | (c >> 6));
+            dst[n++] = (unsigned char)(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            if (c >= 0xD800 && c <= 0xDFFF) {
+                *pos = i;
+                return -1;
+            }
+            dst[n++] = (unsigned char)(0xE0 | (c >> 12));
+            dst[n++] = (unsigned char)(0x80 | ((c >> 6) & 0x3F));
+            dst[n++] = (unsigned char)(0x80 | (c & 0x3F));
+        } else {
+            dst[n++] = (unsigned char)(0xF0 | (c >> 18));
+            dst[n++] = (unsigned char)(0x80 | ((c >> 12) & 0x3F));
+            dst[n++] = (unsigned char)(0x80 | ((c >> 6) & 0x3F));
+            dst[n++] = (unsigned char)(0x80 | (c & 0x3F));
+        }
+    }
+    *pos = i;
+    return n;
 }
 
-/* Shared helper for parsing __init__ arguments.
- * Handles positional and keyword 'data' and 'seed', validates keywords,
- * and detects duplicate/multiple values.
- * Returns 0 on success, -1 on error.
- * On success *data_obj is set (or NULL) and *seed is populated. */
-static int
-_parse_init_args(PyObject *args, PyObject *kwargs,
-                 PyObject **data_obj, unsigned long long *seed,
-                 const char *funcname)
+/* Raise the UnicodeEncodeError of s.encode('utf-8') after
+ * _str_utf8_chunk() stopped at a surrogate, by letting the codec find it. */
+static void
+_str_utf8_error(PyObject *s, const char *funcname)
 {
-    Py_ssize_t nargs = PyTuple_GET_SIZE(args);
-
-    if (kwargs) {
-        Py_ssize_t pos = 0;
-        PyObject *key, *val;
-        while (PyDict_Next(kwargs, &pos, &key, &val)) {
-            if (PyUnicode_CompareWithASCIIString(key, "data") == 0 ||
-                PyUnicode_CompareWithASCIIString(key, "seed") == 0)
-                continue;
-            PyErr_Format(PyExc_TypeError,
-                "'%U' is an invalid keyword argument for '%s()'",
-                key, funcname);
-            return -1;
-        }
+    PyObject *encoded = PyUnicode_AsUTF8String(s);
+    if (encoded != NULL) {
+        Py_DECREF(encoded);
+        PyErr_Format(PyExc_SystemError,
+            "%s() failed to encode str to UTF-8", funcname);
     }
+}
 
-    *data_obj = NULL;
-    *seed = 0;
+/* XXH3_64 (low64 only) or XXH3_128 of p[:len]. */
+static inline XXH128_hash_t
+_xxh3_oneshot(xxhash_algo algo, const void *p, size_t len, XXH64_hash_t seed)
+{
+    if (algo == XXHASH_ALGO_XXH3_128)
+        return XXH3_128bits_withSeed(p, len, seed);
+    XXH128_hash_t h = { XXH3_64bits_withSeed(p, len, seed), 0 };
+    return h;
+}
 
-    if (nargs >= 1) {
-        *data_obj = PyTuple_GET_ITEM(args, 0);
-        if (kwargs && PyDict_GetItemString(kwargs, "data")) {
-            PyErr_Format(PyExc_TypeError,
-                "%s() got multiple values for argument 'data'", funcname);
-            return -1;
-        }
-    }
-    if (nargs >= 2) {
-        *seed = PyLong_AsUnsignedLongLongMask(PyTuple_GET_ITEM(args, 1));
-        if (PyErr_Occurred()) return -1;
-        if (kwargs && PyDict_GetItemString(kwargs, "seed")) {
-            PyErr_Format(PyExc_TypeError,
-                "%s() got multiple values for argument 'seed'", funcname);
-            return -1;
-        }
+/* Hash str s as its UTF-8 encoding without creating it: ASCII strings
+ * straight from their storage, others transcoded a chunk at a time.
+ * Returns 0, or -1 with UnicodeEncodeError set if s has lone surrogates,
+ * like s.encode('utf-8'). Can run without the GIL, s being immutable. */
+static int
+_xxh3_str_nogil(PyObject *s, xxhash_algo algo, XXH64_hash_t seed,
+                XXH128_hash_t *h)
+{
+    int kind = PyUnicode_KIND(s);
+    const void *data = PyUnicode_DATA(s);
+    Py_ssize_t len = PyUnicode_GET_LENGTH(s);
+    unsigned char chunk[XXHASH_STR_CHUNK];
+    Py_ssize_t pos = 0, n;
+    XXH3_state_t state;
+
+    if (PyUnicode_IS_ASCII(s)) {
+        *h = _xxh3_oneshot(algo, data, (size_t)len, seed);
+        return 0;
     }
-    if (nargs > 2) {
-        PyErr_Format(PyExc_TypeError,
-            "%s() takes at most 2 positional arguments (%zd given)",
-            funcname, nargs);
+    n = _str_utf8_chunk(kind, data, len, &pos, chunk, sizeof(chunk));
+    if (n < 0)
         return -1;
+    if (pos == len) {
+        *h = _xxh3_oneshot(algo, chunk, (size_t)n, seed);
+        return 0;
     }
-
-    if (kwargs) {
-        PyObject *val = PyDict_GetItemString(kwargs, "data");
-        if (val) {
-            if (*data_obj) {
-                PyErr_Format(PyExc_TypeError,
-                    "%s() got multiple values for argument 'data'", funcname);
-                return -1;
-            }
-            *data_obj = val;
-        }
-        val = PyDict_GetItemString(kwargs, "seed");
-        if (val) {
-            *seed = PyLong_AsUnsignedLongLongMask(val);
-            if (PyErr_Occurred()) return -1;
-        }
+    XXH3_INITSTATE(&state);
+    if (algo == XXHASH_ALGO_XXH3_128)
+        XXH3_128bits_reset_withSeed(&state, seed);
+    else
+        XXH3_64bits_reset_withSeed(&state, seed);
+    do {
+        /* XXH3_64bits_update() and XXH3_128bits_update() are the same. */
+        XXH3_64bits_update(&state, chunk, (size_t)n);
+        if (pos == len)
+            break;
+        n = _str_utf8_chunk(kind, data, len, &pos, chunk, sizeof(chunk));
+    } while (n >= 0);
+    if (n < 0)
+        return -1;
+    if (algo == XXHASH_ALGO_XXH3_128) {
+        *h = XXH3_128bits_digest(&state);
+    } else {
+        h->low64 = XXH3_64bits_digest(&state);
+        h->high64 = 0;
     }
     return 0;
 }
 
-/* Macro to generate __init__ for each hash type. */
-#define XXHASH_INIT(type, name, reset_fn, update_fn, seed_cast)               \
-static int PY##type##_init(PY##type##Object *self, PyObject *args,            \
-                           PyObject *kwargs)                                  \
-{                                                                             \
-    unsigned long long seed_val = 0;                                          \
-    PyObject *data_obj = NULL;                                                \
-    Py_buffer buf = {NULL, NULL};                                             \
-                                                                              \
-    if (_parse_init_args(args, kwargs, &data_obj, &seed_val,                  \
-                         name) < 0)                                           \
-        return -1;                                                            \
-                                                                              \
-    if (data_obj) {                                                           \
-        if (_get_buffer_or_str(data_obj, &buf) < 0)                           \
-            return -1;                                                        \
-    }                                                                         \
-                                                                              \
-    XXHASH_LOCK_ACQUIRE(self);                                                \
-    self->seed = (seed_cast)seed_val;                                         \
-    reset_fn(self->xxhash_state, self->seed);                                 \
-                                                                              \
-    if (buf.obj) {                                                            \
-        update_fn(self->xxhash_state, buf.buf, buf.len);                      \
-        PyBuffer_Release(&buf);                                               \
-    }                                                                         \
-    XXHASH_LOCK_RELEASE(self);                                                \
-    return 0;                                                                 \
-}
-
-XXHASH_INIT(XXH32, "xxhash.xxh32", XXH32_reset, XXH32_update, XXH32_hash_t)
-
-PyDoc_STRVAR(
-    PYXXH32_update_doc,
-    "update (data)\n\n"
-    "Update the xxh32 object with bytes-like data. Repeated calls are\n"
-    "equivalent to a single call with the concatenation of all the arguments.");
-
-static PyObject *PYXXH32_update(PYXXH32Object *self, PyObject *const *args,
-                                 Py_ssize_t nargs, PyObject *kwnames)
+/* Shared implementation of xxh3_*_intdigest_str(). */
+static PyObject *
+_xxh3_intdigest_str(PyObject *const *args, Py_ssize_t nargs,
+                    PyObject *kwnames, const char *funcname,
+                    xxhash_algo algo)
 {
-    PyObject *arg = NULL;
+    static const char *const names[] = {"data", "seed", NULL};
+    PyObject *argv[2];
+    XXH64_hash_t seed = 0;
+    XXH128_hash_t h;
+    int ret;
 
-    /* validate keywords first */
-    if (kwnames) {
-        Py_ssize_t nkw = PyTuple_GET_SIZE(kwnames);
-        for (Py_ssize_t i = 0; i < nkw; i++) {
-            PyObject *key = PyTuple_GET_ITEM(kwnames, i);
-            if (PyUnicode_CompareWithASCIIString(key, "data") == 0) {
-                if (nargs >= 1) {
-                    PyErr_SetString(PyExc_TypeError,
-                        "xxh32.update() got multiple values for argument 'data'");
-                    return NULL;
-                }
-                arg = args[nargs + i];
-            } else {
-                PyErr_Format(PyExc_TypeError,
-                    "'%U' is an invalid keyword argument for 'xxh32.update()'",
-                    key);
-                return NULL;
-            }
-        }
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, funcname, names,
+                               2, 1, argv) < 0)
+        return NULL;
+    if (!PyUnicode_Check(argv[0])) {
+        PyErr_Format(PyExc_TypeError,
+            "%s() argument 'data' must be str, not '%.200s'",
+            funcname, Py_TYPE(argv[0])->tp_name);
+        return NULL;
     }
-
-    if (nargs >= 1) {
-        if (nargs > 1) {
-            PyErr_Format(PyExc_TypeError,
-                "xxh32.update() takes at most 1 positional argument (%zd given)", nargs);
+    if (argv[1]) {
+        seed = (XXH64_hash_t)PyLong_AsUnsignedLongLongMask(argv[1]);
+        if (PyErr_Occurred())
             return NULL;
-        }
-        arg = args[0];
     }
-
-    if (!arg) {
-        PyErr_SetString(PyExc_TypeError, "xxh32.update() missing required argument 'data'");
+#if PY_VERSION_HEX < 0x030C0000
+    if (PyUnicode_READY(argv[0]) < 0)
         return NULL;
-    }
+#endif
 
-    Py_buffer buf;
-    if (_get_buffer_or_str(arg, &buf) < 0)
+    if (PyUnicode_GET_LENGTH(argv[0]) > XXHASH_GIL_MINSIZE) {
+        Py_BEGIN_ALLOW_THREADS
+        ret = _xxh3_str_nogil(argv[0], algo, seed, &h);
+        Py_END_ALLOW_THREADS
+    } else {
+        ret = _xxh3_str_nogil(argv[0], algo, seed, &h);
+    }
+    if (ret < 0) {
+        _str_utf8_error(argv[0], funcname);
         return NULL;
-    PYXXH32_do_update(self, &buf);
-    Py_RETURN_NONE;
+    }
+    if (algo == XXHASH_ALGO_XXH3_128)
+        return _xxh128_to_pylong(h);
+    return PyLong_FromUnsignedLongLong(h.low64);
 }
 
 PyDoc_STRVAR(
-    PYXXH32_digest_doc,
-    "digest() -> bytes\n\n"
-    "Return the digest of the data passed to the update() method so\n"
-    "far. This is a 4-byte value which may contain non-ASCII characters,\n"
-    "including null bytes.");
+    xxh3_64_intdigest_str_doc,
+    "xxh3_64_intdigest_str(data, seed=0) -> int\n\n"
+    "Return xxh3_64_intdigest(data.encode('utf-8'), seed) for the str data,\n"
+    "without creating the encoded bytes. ASCII strings are hashed straight\n"
+    "from their storage.");
 
-static PyObject *PYXXH32_digest(PYXXH32Object *self)
+static PyObject *
+xxh3_64_intdigest_str(PyObject *self, PyObject *const *args,
+                      Py_ssize_t nargs, PyObject *kwnames)
 {
-    XXH32_hash_t intdigest;
-
-    XXHASH_LOCK_ACQUIRE(self);
-    intdigest = XXH32_digest(self->xxhash_state);
-    XXHASH_LOCK_RELEASE(self);
-
-    PyObject *ret = PyBytes_FromStringAndSize(NULL, XXH32_DIGESTSIZE);
-    if (ret == NULL) return NULL;
-    XXH32_canonicalFromHash((XXH32_canonical_t *)PyBytes_AS_STRING(ret), intdigest);
-    return ret;
+    return _xxh3_intdigest_str(args, nargs, kwnames, "xxh3_64_intdigest_str",
+                               XXHASH_ALGO_XXH3_64);
 }
 
 PyDoc_STRVAR(
-    PYXXH32_hexdigest_doc,
-    "hexdigest() -> string\n\n"
-    "Like digest(), but returns the digest as a string of hexadecimal digits.");
+    xxh3_128_intdigest_str_doc,
+    "xxh3_128_intdigest_str(data, seed=0) -> int\n\n"
+    "Return xxh3_128_intdigest(data.encode('utf-8'), seed) for the str data,\n"
+    "without creating the encoded bytes. ASCII strings are hashed straight\n"
+    "from their storage.");
 
-static PyObject *PYXXH32_hexdigest(PYXXH32Object *self)
+static PyObject *
+xxh3_128_intdigest_str(PyObject *self, PyObject *const *args,
+                       Py_ssize_t nargs, PyObject *kwnames)
 {
-    XXH32_hash_t intdigest;
-    char digest[XXH32_DIGESTSIZE];
+    return _xxh3_intdigest_str(args, nargs, kwnames,
+                               "xxh3_128_intdigest_str", XXHASH_ALGO_XXH3_128);
+}
 
-    XXHASH_LOCK_ACQUIRE(self);
-    intdigest = XXH32_digest(self->xxhash_state);
-    XXHASH_LOCK_RELEASE(self);
-    XXH32_canonicalFromHash((XXH32_canonical_t *)digest, intdigest);
+/*****************************************************************************
+ * Worker Pool ****************************************************************
+ ****************************************************************************/
 
-    PyObject *ret = PyUnicode_New(XXH32_DIGESTSIZE * 2, 127);
-    if (ret == NULL) return NULL;
-    Py_UCS1 *b = PyUnicode_1BYTE_DATA(ret);
-    for (Py_ssize_t i = 0, j = 0; i < XXH32_DIGESTSIZE; i++) {
-        unsigned char c;
-        c = (digest[i] >> 4) & 0xf;
-        c = (c > 9) ? c + 'a' - 10 : c + '0';
-        b[j++] = c;
-        c = (digest[i] & 0xf);
-        c = (c > 9) ? c + 'a' - 10 : c + '0';
-        b[j++] = c;
-    }
-    return ret;
-}
+/* Batch jobs at least this large (in input bytes or elements) are split
+ * across the worker pool when more than one thread is requested. */
+#define XXHASH_PARALLEL_MINSIZE   (1 << 20)
+#define XXHASH_PARALLEL_MINITEMS  65536
+#define XXHASH_MAX_THREADS        256
 
-PyDoc_STRVAR(
-    PYXXH32_intdigest_doc,
-    "intdigest() -> int\n\n"
-    "Like digest(), but returns the digest as an integer, which is the integer\n"
-    "returned by the xxHash C API.");
+/* The nthreads= default is kept in module state and may be set while
+ * batches read it, so it is accessed atomically. */
+static inline int
+_atomic_load_int(const int *p)
+{
+#ifdef _MSC_VER
+    return (int)_InterlockedOr((volatile long *)p, 0);
+#else
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+#endif
+}
 
-static PyObject *PYXXH32_intdigest(PYXXH32Object *self)
+static inline void
+_atomic_store_int(int *p, int value)
 {
-    XXHASH_LOCK_ACQUIRE(self);
-    XXH32_hash_t digest = XXH32_digest(self->xxhash_state);
-    XXHASH_LOCK_RELEASE(self);
-    return PyLong_FromUnsignedLong(digest);
+#ifdef _MSC_VER
+    _InterlockedExchange((volatile long *)p, (long)value);
+#else
+    __atomic_store_n(p, value, __ATOMIC_RELAXED);
+#endif
 }
 
-PyDoc_STRVAR(
-    PYXXH32_copy_doc,
-    "copy() -> xxh32 object\n\n"
-    "Return a copy of the xxh32 object.");
+/* A task function hashes elements [start, end) of the job arg. It runs
+ * without the GIL, possibly on several threads at once. */
+typedef void (*xxhash_task_fn)(void *arg, Py_ssize_t start, Py_ssize_t end);
 
-static PyObject *PYXXH32_copy(PYXXH32Object *self)
+typedef struct xxhash_pool xxhash_pool;
+
+typedef struct {
+    xxhash_pool *pool;
+    PyThread_type_lock wake;    /* held while idle, released to start work */
+    PyThread_type_lock exited;  /* released by the thread when it exits */
+} xxhash_worker;
+
+/* Persistent native threads owned by the module. Only one parallel job
+ * runs at a time: a caller that finds the pool busy hashes on its own
+ * thread instead of waiting. Workers never touch Python objects. */
+struct xxhash_pool {
+    XXHASH_LOCK_FIELD                /* guards setup and growth */
+    PyThread_type_lock dispatch;     /* held while a parallel job runs */
+    PyThread_type_lock task_lock;    /* guards next and active */
+    PyThread_type_lock done;         /* released by the last worker done */
+    xxhash_worker **workers;
+    int nworkers;
+    int shutdown;
+#ifndef MS_WINDOWS
+    pid_t pid;                       /* workers do not survive fork() */
+#endif
+    /* The running job. */
+    xxhash_task_fn fn;
+    void *arg;
+    Py_ssize_t n;
+    Py_ssize_t chunk;
+    Py_ssize_t next;
+    int active;
+};
+
+/* Freed hash objects are recycled through a per-interpreter free list of
+ * this many per type. The list relies on the GIL, so the free-threaded
+ * build does without it. */
+#ifdef Py_GIL_DISABLED
+#  define XXHASH_FREELIST_SIZE  0
+#else
+#  define XXHASH_FREELIST_SIZE  64
+#endif
+
+typedef struct {
+    PyObject *types[XXHASH_NUM_ALGOS];  /* hash types, by xxhash_algo */
+    PyObject *cache_type;               /* DigestCache */
+    PyObject *bound_type;               /* BoundHasher */
+    PyObject *bloom_type;               /* BloomFilter */
+    PyObject *hll_type;                 /* HyperLogLog */
+    PyObject *cms_type;                 /* CountMinSketch */
+    PyObject *ring_type;                /* HashRing */
+    int default_nthreads;               /* nthreads= default, atomic */
+#if XXHASH_FREELIST_SIZE > 0
+    /* Freed hash objects kept for reuse, by xxhash_algo. */
+    PyObject *freelist[XXHASH_NUM_ALGOS][XXHASH_FREELIST_SIZE];
+    int nfree[XXHASH_NUM_ALGOS];
+#endif
+    xxhash_pool pool;
+} xxhash_state;
+
+static inline xxhash_state *
+_get_state(PyObject *module)
 {
-    PYXXH32Object *p;
+    return (xxhash_state *)PyModule_GetState(module);
+}
 
-    if ((p = (PYXXH32Object *)Py_TYPE(self)->tp_alloc(Py_TYPE(self), 0)) == NULL) {
-        return NULL;
+/* Take chunks of the running job until none are left. */
+static void
+_pool_work(xxhash_pool *pool)
+{
+    for (;;) {
+        PyThread_acquire_lock(pool->task_lock, WAIT_LOCK);
+        Py_ssize_t start = pool->next;
+        Py_ssize_t end = pool->n - start > pool->chunk ? start + pool->chunk
+                                                       : pool->n;
+        pool->next = end;
+        PyThread_release_lock(pool->task_lock);
+        if (start >= end)
+            return;
+        pool->fn(pool->arg, start, end);
     }
+}
 
-    XXHASH_LOCK_INIT(p);
-
-    if ((p->xxhash_state = XXH32_createState()) == NULL) {
-        Py_DECREF(p);
-        PyErr_NoMemory();
-        return NULL;
+static void
+_pool_worker_main(void *arg)
+{
+    xxhash_worker *w = arg;
+    xxhash_pool *pool = w->pool;
+
+    for (;;) {
+        PyThread_acquire_lock(w->wake, WAIT_LOCK);
+        if (pool->shutdown)
+            break;
+        _pool_work(pool);
+        PyThread_acquire_lock(pool->task_lock, WAIT_LOCK);
+        int last = --pool->active == 0;
+        PyThread_release_lock(pool->task_lock);
+        if (last)
+            PyThread_release_lock(pool->done);
     }
+    PyThread_release_lock(w->exited);
+}
 
-    XXHASH_LOCK_ACQUIRE(self);
-    p->seed = self->seed;
-    XXH32_copyState(p->xxhash_state, self->xxhash_state);
-    XXHASH_LOCK_RELEASE(self);
+/* Allocate a lock already held by the caller. */
+static PyThread_type_lock
+_allocate_held_lock(void)
+{
+    PyThread_type_lock lock = PyThread_allocate_lock();
+    if (lock)
+        PyThread_acquire_lock(lock, WAIT_LOCK);
+    return lock;
+}
 
-    return (PyObject *)p;
+static void
+_free_worker(xxhash_worker *w)
+{
+    if (w->wake)
+        PyThread_free_lock(w->wake);
+    if (w->exited)
+        PyThread_free_lock(w->exited);
+    PyMem_RawFree(w);
 }
 
-PyDoc_STRVAR(
-    PYXXH32_reset_doc,
-    "reset()\n\n"
-    "Reset state.");
-
-static PyObject *PYXXH32_reset(PYXXH32Object *self)
+/* Start one more worker thread. Returns 0 on success, -1 on failure
+ * (without exception set: the pool just stays smaller). */
+static int
+_pool_grow(xxhash_pool *pool)
 {
-    XXHASH_LOCK_ACQUIRE(self);
-    XXH32_reset(self->xxhash_state, self->seed);
-    XXHASH_LOCK_RELEASE(self);
-    Py_RETURN_NONE;
+    xxhash_worker **workers = PyMem_RawRealloc(
+        pool->workers, (pool->nworkers + 1) * sizeof(xxhash_worker *));
+    if (workers == NULL)
+        return -1;
+    pool->workers = workers;
+
+    xxhash_worker *w = PyMem_RawCalloc(1, sizeof(xxhash_worker));
+    if (w == NULL)
+        return -1;
+    w->pool = pool;
+    w->wake = _allocate_held_lock();
+    w->exited = _allocate_held_lock();
+    if (w->wake == NULL || w->exited == NULL
+        || PyThread_start_new_thread(_pool_worker_main, w)
+           == PYTHREAD_INVALID_THREAD_ID) {
+        _free_worker(w);
+        return -1;
+    }
+    pool->workers[pool->nworkers++] = w;
+    return 0;
 }
 
-static PyMethodDef PYXXH32_methods[] = {
-    {"update", (PyCFunction)PYXXH32_update, METH_FASTCALL | METH_KEYWORDS, PYXXH32_update_doc},
-    {"digest", (PyCFunction)PYXXH32_digest, METH_NOARGS, PYXXH32_digest_doc},
-    {"hexdigest", (PyCFunction)PYXXH32_hexdigest, METH_NOARGS, PYXXH32_hexdigest_doc},
-    {"intdigest", (PyCFunction)PYXXH32_intdigest, METH_NOARGS, PYXXH32_intdigest_doc},
-    {"copy", (PyCFunction)PYXXH32_copy, METH_NOARGS, PYXXH32_copy_doc},
-    {"reset", (PyCFunction)PYXXH32_reset, METH_NOARGS, PYXXH32_reset_doc},
-    {NULL, NULL, 0, NULL}
-};
+/* Forget all workers and locks, which are unusable in a forked child. */
+static void
+_pool_forget(xxhash_pool *pool)
+{
+    pool->dispatch = pool->task_lock = pool->done = NULL;
+    pool->workers = NULL;
+    pool->nworkers = 0;
+}
 
-static PyObject *PYXXH32_get_block_size(PYXXH32Object *self, void *closure)
+/* Stop the worker threads and free the pool. */
+static void
+_pool_fini(xxhash_pool *pool)
 {
-    return PyLong_FromLong(XXH32_BLOCKSIZE);
+#ifndef MS_WINDOWS
+    if (pool->dispatch && pool->pid != getpid()) {
+        _pool_forget(pool);
+        return;
+    }
+#endif
+    pool->shutdown = 1;
+    for (int i = 0; i < pool->nworkers; i++) {
+        xxhash_worker *w = pool->workers[i];
+        PyThread_release_lock(w->wake);
+        PyThread_acquire_lock(w->exited, WAIT_LOCK);
+        _free_worker(w);
+    }
+    PyMem_RawFree(pool->workers);
+    if (pool->dispatch)
+        PyThread_free_lock(pool->dispatch);
+    if (pool->task_lock)
+        PyThread_free_lock(pool->task_lock);
+    if (pool->done)
+        PyThread_free_lock(pool->done);
+    _pool_forget(pool);
+    XXHASH_LOCK_FINI(pool);
 }
 
-static PyObject *
-PYXXH32_get_digest_size(PYXXH32Object *self, void *closure)
+/* Reserve the pool for one job and make sure it has up to want workers.
+ * Called with the GIL held. Returns the number of workers to use, or -1
+ * if the pool is busy or cannot be set up (the caller then runs the job
+ * alone). */
+static int
+_pool_acquire(xxhash_pool *pool, int want)
 {
-    return PyLong_FromLong(XXH32_DIGESTSIZE);
+    int nworkers = -1;
+
+    XXHASH_LOCK_ACQUIRE(pool);
+#ifndef MS_WINDOWS
+    if (pool->dispatch && pool->pid != getpid())
+        _pool_forget(pool);
+#endif
+    if (pool->dispatch == NULL) {
+        PyThread_type_lock dispatch = PyThread_allocate_lock();
+        PyThread_type_lock task_lock = PyThread_allocate_lock();
+        PyThread_type_lock done = _allocate_held_lock();
+        if (dispatch == NULL || task_lock == NULL || done == NULL) {
+            if (dispatch) PyThread_free_lock(dispatch);
+            if (task_lock) PyThread_free_lock(task_lock);
+            if (done) PyThread_free_lock(done);
+            goto exit;
+        }
+        pool->dispatch = dispatch;
+        pool->task_lock = task_lock;
+        pool->done = done;
+#ifndef MS_WINDOWS
+        pool->pid = getpid();
+#endif
+    }
+    if (!PyThread_acquire_lock(pool->dispatch, NOWAIT_LOCK))
+        goto exit;
+    while (pool->nworkers < want && _pool_grow(pool) == 0)
+        ;
+    nworkers = pool->nworkers < want ? pool->nworkers : want;
+exit:
+    XXHASH_LOCK_RELEASE(pool);
+    return nworkers;
 }
 
-static PyObject *
-PYXXH32_get_name(PYXXH32Object *self, void *closure)
+/* Run fn over [0, n) on up to nthreads threads, the calling thread
+ * included, handing out chunks of about n / (8 * nthreads) elements so
+ * that uneven element sizes still balance. Called with the GIL held; the
+ * GIL is released while the job runs. */
+static void
+_parallel_for(PyObject *module, int nthreads, xxhash_task_fn fn, void *arg,
+              Py_ssize_t n)
 {
-    return PyUnicode_FromString("XXH32");
+    xxhash_pool *pool = &_get_state(module)->pool;
+    Py_ssize_t chunk = n / ((Py_ssize_t)nthreads * 8);
+    if (chunk < 1)
+        chunk = 1;
+    int want = nthreads - 1;
+    if ((n - 1) / chunk < want)
+        want = (int)((n - 1) / chunk);
+
+    int nworkers = want > 0 ? _pool_acquire(pool, want) : -1;
+
+    Py_BEGIN_ALLOW_THREADS
+    if (nworkers <= 0) {
+        fn(arg, 0, n);
+    } else {
+        pool->fn = fn;
+        pool->arg = arg;
+        pool->n = n;
+        pool->chunk = chunk;
+        pool->next = 0;
+        pool->active = nworkers;
+        for (int i = 0; i < nworkers; i++)
+            PyThread_release_lock(pool->workers[i]->wake);
+        _pool_work(pool);
+        PyThread_acquire_lock(pool->done, WAIT_LOCK);
+    }
+    Py_END_ALLOW_THREADS
+
+    if (nworkers >= 0)
+        PyThread_release_lock(pool->dispatch);
 }
 
-static PyObject *
-PYXXH32_get_seed(PYXXH32Object *self, void *closure)
+/* Convert obj to a thread count: a positive int, capped at
+ * XXHASH_MAX_THREADS. Returns 0 on success, -1 on error with exception
+ * set. */
+static int
+_as_nthreads(PyObject *obj, const char *funcname, int *nthreads)
 {
-    return PyLong_FromUnsignedLong(self->seed);
+    long value = PyLong_AsLong(obj);
+    if (value == -1 && PyErr_Occurred())
+        return -1;
+    if (value < 1) {
+        PyErr_Format(PyExc_ValueError,
+            "%s() argument 'nthreads' must be positive", funcname);
+        return -1;
+    }
+    *nthreads = value > XXHASH_MAX_THREADS ? XXHASH_MAX_THREADS : (int)value;
+    return 0;
 }
 
-static PyGetSetDef PYXXH32_getseters[] = {
-    {
-        "digest_size",
-        (getter)PYXXH32_get_digest_size, NULL,
-        "Digest size.",
-        NULL
-    },
-    {
-        "block_size",
-        (getter)PYXXH32_get_block_size, NULL,
-        "Block size.",
-        NULL
-    },
-    {
-        "name",
-        (getter)PYXXH32_get_name, NULL,
-        "Name. Always XXH32.",
-        NULL
-    },
-    {
-        "digestsize",
-        (getter)PYXXH32_get_digest_size, NULL,
-        "Digest size.",
-        NULL
-    },
-    {
-        "seed",
-        (getter)PYXXH32_get_seed, NULL,
-        "Seed.",
-        NULL
-    },
-    {NULL}  /* Sentinel */
-};
+/* Parse the nthreads= argument of a batch function of module: None (or
+ * absent) for the module's default. */
+static int
+_parse_nthreads(PyObject *module, PyObject *obj, const char *funcname,
+                int *nthreads)
+{
+    if (obj == NULL || obj == Py_None) {
+        *nthreads = _atomic_load_int(&_get_state(module)->default_nthreads);
+        return 0;
+    }
+    return _as_nthreads(obj, funcname, nthreads);
+}
 
 PyDoc_STRVAR(
-    PYXXH32Type_doc,
-    "An xxh32 represents the object used to calculate the XXH32 hash of a\n"
-    "bytes-like object.\n"
-    "\n"
-    "Methods:\n"
-    "\n"
-    "update(data) -- updates the current hash state with additional data\n"
-    "digest() -- return the current digest value\n"
-    "hexdigest() -- return the current digest as a string of hexadecimal digits\n"
-    "intdigest() -- return the current digest as an integer\n"
-    "copy() -- return a copy of the current xxh32 object");
-
-static PyType_Slot XXH32Type_slots[] = {
-    {Py_tp_dealloc, PYXXH32_dealloc},
-    {Py_tp_doc, (void *)PYXXH32Type_doc},
-    {Py_tp_methods, PYXXH32_methods},
-    {Py_tp_getset, PYXXH32_getseters},
-    {Py_tp_init, PYXXH32_init},
-    {Py_tp_new, PYXXH32_new},
-    {0, NULL},
-};
-
-static PyType_Spec XXH32Type_spec = {
-    .name = "xxhash.xxh32",
-    .basicsize = sizeof(PYXXH32Object),
-    .flags = Py_TPFLAGS_DEFAULT
-#if PY_VERSION_HEX >= 0x030c0000
-           | Py_TPFLAGS_IMMUTABLETYPE
-#endif
-    ,
-    .slots = XXH32Type_slots,
-};
-
-/* XXH64 */
+    set_default_nthreads_doc,
+    "set_default_nthreads(n)\n\n"
+    "Set the number of threads batch functions use when called without\n"
+    "nthreads=, for this interpreter. The default is 1: batches are hashed\n"
+    "on the calling thread only.");
 
-typedef struct {
-    PyObject_HEAD
-    XXH64_state_t *xxhash_state;
-    XXH64_hash_t seed;
-    XXHASH_LOCK_FIELD
-} PYXXH64Object;
-
-static void PYXXH64_dealloc(PYXXH64Object *self)
+static PyObject *
+set_default_nthreads(PyObject *self, PyObject *arg)
 {
-    if (self->xxhash_state)
-        XXH64_freeState(self->xxhash_state);
-    XXHASH_LOCK_FINI(self);
-    PyTypeObject *tp = Py_TYPE(self);
-    tp->tp_free((PyObject *)self);
-    Py_DECREF(tp);
+    int nthreads;
+    if (_as_nthreads(arg, "set_default_nthreads", &nthreads) < 0)
+        return NULL;
+    _atomic_store_int(&_get_state(self)->default_nthreads, nthreads);
+    Py_RETURN_NONE;
 }
 
-XXHASH_DO_UPDATE(XXH64, XXH64_update)
+PyDoc_STRVAR(
+    get_default_nthreads_doc,
+    "get_default_nthreads() -> int\n\n"
+    "Return the number of threads batch functions use by default.");
 
 static PyObject *
-PYXXH64_vectorcall(PyObject *type, PyObject *const *args,
-                   size_t nargsf, PyObject *kwnames)
+get_default_nthreads(PyObject *self, PyObject *Py_UNUSED(ignored))
 {
-    Py_ssize_t nargs = PyVectorcall_NARGS(nargsf);
-    XXH64_hash_t seed = 0;
-    Py_buffer buf;
-    unsigned long long raw_seed;
+    return PyLong_FromLong(
+        _atomic_load_int(&_get_state(self)->default_nthreads));
+}
 
-    if (_parse_fastcall_args(args, nargs, kwnames, "xxhash.xxh64", 0,
-                             &buf, &raw_seed) < 0)
-        return NULL;
-    seed = (XXH64_hash_t)raw_seed;
+/*****************************************************************************
+ * Batch Functions ************************************************************
+ ****************************************************************************/
 
-    PYXXH64Object *self = (PYXXH64Object *)
-        ((PyTypeObject *)type)->tp_alloc((PyTypeObject *)type, 0);
-    if (self == NULL) {
-        PyBuffer_Release(&buf);
-        return NULL;
+/* Where the inputs of a batch come from. */
+typedef enum {
+    XXHASH_SRC_BUFFERS,     /* bufs[i] */
+    XXHASH_SRC_STRIDED,     /* base + i * stride, length bytes each */
+    XXHASH_SRC_OFFSETS32,   /* base[offsets[i]:offsets[i + 1]], int32 offsets */
+    XXHASH_SRC_OFFSETS64,   /* same with int64 offsets */
+} xxhash_src;
+
+/* One batch hashing job: n inputs hashed with the same algorithm and seed.
+ * Digests are stored back to back in out, digestsize bytes each, either as
+ * native integers (XXH128_hash_t layout for XXH3_128) or, if canonical is
+ * set, in canonical (big-endian) form as returned by digest(). */
+typedef struct {
+    xxhash_algo algo;
+    XXH64_hash_t seed;
+    xxhash_src src;
+    const Py_buffer *bufs;
+    const unsigned char *base;
+    Py_ssize_t stride;
+    Py_ssize_t length;
+    const void *offsets;
+    unsigned char *out;
+    int canonical;
+} xxhash_batch;
+
+/* Return the address of the i-th input of a batch and store its size. */
+static inline const void *
+_batch_input(const xxhash_batch *job, Py_ssize_t i, size_t *len)
+{
+    switch (job->src) {
+    case XXHASH_SRC_STRIDED:
+        *len = (size_t)job->length;
+        return job->base + i * job->stride;
+    case XXHASH_SRC_OFFSETS32: {
+        const int32_t *offsets = job->offsets;
+        *len = (size_t)(offsets[i + 1] - offsets[i]);
+        return job->base + offsets[i];
+    }
+    case XXHASH_SRC_OFFSETS64: {
+        const int64_t *offsets = job->offsets;
+        *len = (size_t)(offsets[i + 1] - offsets[i]);
+        return job->base + offsets[i];
     }
+    case XXHASH_SRC_BUFFERS:
+    default:
+        *len = (size_t)job->bufs[i].len;
+        return job->bufs[i].buf;
+    }
+}
 
-    XXHASH_LOCK_INIT(self);
+/* Hash each element i in [start, end) with hash_fn(p, len, seed) and store
+ * the digest at its slot in job->out, canonical or native. */
+#define XXHASH_BATCH_LOOP(start, end, hash_t, canonical_t, canonical_fn,      \
+                          hash_fn, seed)                                      \
+    do {                                                                      \
+        const void *p;                                                        \
+        size_t len;                                                           \
+        if (job->canonical) {                                                 \
+            for (Py_ssize_t i = (start); i < (end); i++) {                    \
+                p = _batch_input(job, i, &len);                               \
+                hash_t h = hash_fn(p, len, seed);                             \
+                canonical_fn((canonical_t *)(job->out + i * sizeof(hash_t)), h); \
+            }                                                                 \
+        } else {                                                              \
+            for (Py_ssize_t i = (start); i < (end); i++) {                    \
+                p = _batch_input(job, i, &len);                               \
+                hash_t h = hash_fn(p, len, seed);                             \
+                memcpy(job->out + i * sizeof(hash_t), &h, sizeof(hash_t));    \
+            }                                                                 \
+        }                                                                     \
+    } while (0)
 
-    self->xxhash_state = XXH64_createState();
-    if (self->xxhash_state == NULL) {
-        Py_DECREF(self);
-        PyBuffer_Release(&buf);
-        return PyErr_NoMemory();
-    }
-    self->seed = seed;
-    XXH64_reset(self->xxhash_state, seed);
+#ifdef XXHASH_DISPATCH
+/* Inputs collected per call of a multi-lane kernel. */
+#define XXHASH_LANES_CHUNK 64
 
-    if (buf.obj) {
-        /* Constructor: no concurrent access possible, skip locking. */
-        if (buf.len > XXHASH_GIL_MINSIZE) {
-            Py_BEGIN_ALLOW_THREADS
-            XXH64_update(self->xxhash_state, buf.buf, buf.len);
-            Py_END_ALLOW_THREADS
+/* Store the digest h of element i of a batch of 32 or 64-bit digests. */
+static inline void
+_batch_store(const xxhash_batch *job, Py_ssize_t i, XXH64_hash_t h)
+{
+    if (job->algo == XXHASH_ALGO_XXH32) {
+        XXH32_hash_t h32 = (XXH32_hash_t)h;
+        unsigned char *p = job->out + i * sizeof(h32);
+        if (job->canonical) {
+            XXH32_canonicalFromHash((XXH32_canonical_t *)p, h32);
         } else {
-            XXH64_update(self->xxhash_state, buf.buf, buf.len);
+            memcpy(p, &h32, sizeof(h32));
+        }
+    } else {
+        unsigned char *p = job->out + i * sizeof(h);
+        if (job->canonical) {
+            XXH64_canonicalFromHash((XXH64_canonical_t *)p, h);
+        } else {
+            memcpy(p, &h, sizeof(h));
         }
-        PyBuffer_Release(&buf);
     }
-    return (PyObject *)self;
 }
-static PyObject *PYXXH64_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
-{
-    PYXXH64Object *self;
 
-    if ((self = (PYXXH64Object *)type->tp_alloc(type, 0)) == NULL) {
-        return NULL;
+/* Elements [start, end) of an XXH32, XXH64 or XXH3_64 batch through the
+ * multi-lane kernels of the SIMD backend, collected in chunks. XXH3_64
+ * inputs longer than XXHASH_SHORT_MAX bytes are hashed as they come. */
+static void
+_batch_hash_lanes(const xxhash_batch *job, Py_ssize_t start, Py_ssize_t end)
+{
+    const void *inputs[XXHASH_LANES_CHUNK];
+    size_t lens[XXHASH_LANES_CHUNK];
+    Py_ssize_t index[XXHASH_LANES_CHUNK];
+    XXH64_hash_t hashes[XXHASH_LANES_CHUNK];
+    XXH32_hash_t hashes32[XXHASH_LANES_CHUNK];
+    size_t maxlen = job->algo == XXHASH_ALGO_XXH3_64 ? XXHASH_SHORT_MAX
+                                                      : (size_t)-1;
+    Py_ssize_t i = start;
+
+    while (i < end) {
+        size_t n = 0;
+        for (; i < end && n < XXHASH_LANES_CHUNK; i++) {
+            size_t len;
+            const void *p = _batch_input(job, i, &len);
+            if (len > maxlen) {
+                _batch_store(job, i, XXH3_64bits_withSeed(p, len, job->seed));
+                continue;
+            }
+            inputs[n] = p;
+            lens[n] = len;
+            index[n] = i;
+            n++;
+        }
+        switch (job->algo) {
+        case XXHASH_ALGO_XXH32:
+            XXH32_many_dispatch(inputs, lens, n, (XXH32_hash_t)job->seed,
+                                hashes32);
+            for (size_t k = 0; k < n; k++) {
+                hashes[k] = hashes32[k];
+            }
+            break;
+        case XXHASH_ALGO_XXH64:
+            XXH64_many_dispatch(inputs, lens, n, job->seed, hashes);
+            break;
+        default:
+            XXH3_64bits_short_many_dispatch(inputs, lens, n, job->seed,
+                                            hashes);
+            break;
+        }
+        for (size_t k = 0; k < n; k++) {
+            _batch_store(job, index[k], hashes[k]);
+        }
     }
+}
 
-    XXHASH_LOCK_INIT(self);
-
-    if ((self->xxhash_state = XXH64_createState()) == NULL) {
-        Py_DECREF(self);
-        PyErr_NoMemory();
-        return NULL;
+/* Elements [start, end) of an XXH3_64 batch of inputs of 4, 8 or 16 bytes
+ * back to back, through the fixed-width kernels of the SIMD backend. They
+ * store to aligned native digests directly, anything else by chunks. */
+static void
+_batch_hash_fixed(const xxhash_batch *job, Py_ssize_t start, Py_ssize_t end)
+{
+    size_t width = (size_t)job->length;
+    XXH64_hash_t hashes[XXHASH_LANES_CHUNK];
+
+    if (!job->canonical
+        && (uintptr_t)job->out % sizeof(XXH64_hash_t) == 0) {
+        XXH3_64bits_fixed_many_dispatch(
+            job->base + start * job->length, width, (size_t)(end - start),
+            job->seed, (XXH64_hash_t *)(void *)(job->out
+                                                + start * sizeof(hashes[0])));
+        return;
+    }
+    while (start < end) {
+        size_t n = end - start < XXHASH_LANES_CHUNK ? (size_t)(end - start)
+                                                    : XXHASH_LANES_CHUNK;
+        XXH3_64bits_fixed_many_dispatch(job->base + start * job->length,
+                                        width, n, job->seed, hashes);
+        for (size_t k = 0; k < n; k++) {
+            _batch_store(job, start + (Py_ssize_t)k, hashes[k]);
+        }
+        start += (Py_ssize_t)n;
     }
+}
+#endif
 
-    self->seed = 0;
-    XXH64_reset(self->xxhash_state, 0);
+/* Hash elements [start, end) of a batch. Runs without the GIL. */
+static void
+_batch_hash_range(const xxhash_batch *job, Py_ssize_t start, Py_ssize_t end)
+{
+    switch (job->algo) {
+    case XXHASH_ALGO_XXH32:
+#ifdef XXHASH_DISPATCH
+        if (xxhash_dispatch_xxh32_lanes() > 1) {
+            _batch_hash_lanes(job, start, end);
+            break;
+        }
+#endif
+        XXHASH_BATCH_LOOP(start, end, XXH32_hash_t, XXH32_canonical_t,
+            XXH32_canonicalFromHash, XXH32, (XXH32_hash_t)job->seed);
+        break;
+    case XXHASH_ALGO_XXH64:
+#ifdef XXHASH_DISPATCH
+        if (xxhash_dispatch_xxh64_lanes() > 1) {
+            _batch_hash_lanes(job, start, end);
+            break;
+        }
+#endif
+        XXHASH_BATCH_LOOP(start, end, XXH64_hash_t, XXH64_canonical_t,
+            XXH64_canonicalFromHash, XXH64, job->seed);
+        break;
+    case XXHASH_ALGO_XXH3_64:
+#ifdef XXHASH_DISPATCH
+        /* Packed records of integer sizes have vector kernels for their
+         * width. Other inputs of one length are as fast one at a time, the
+         * branches on the length being predictable. */
+        if (job->src == XXHASH_SRC_STRIDED) {
+            if (job->stride == job->length
+                && (job->length == 4 || job->length == 8
+                    || job->length == 16)) {
+                _batch_hash_fixed(job, start, end);
+                break;
+            }
+        } else if (xxhash_dispatch_short_lanes() > 1) {
+            _batch_hash_lanes(job, start, end);
+            break;
+        }
+#endif
+        XXHASH_BATCH_LOOP(start, end, XXH64_hash_t, XXH64_canonical_t,
+            XXH64_canonicalFromHash, XXH3_64bits_withSeed, job->seed);
+        break;
+    case XXHASH_ALGO_XXH3_128:
+        XXHASH_BATCH_LOOP(start, end, XXH128_hash_t, XXH128_canonical_t,
+            XXH128_canonicalFromHash, XXH3_128bits_withSeed, job->seed);
+        break;
+    }
+}
 
-    return (PyObject *)self;
+static void
+_batch_task(void *arg, Py_ssize_t start, Py_ssize_t end)
+{
+    _batch_hash_range((const xxhash_batch *)arg, start, end);
 }
 
-XXHASH_INIT(XXH64, "xxhash.xxh64", XXH64_reset, XXH64_update, XXH64_hash_t)
+/* Run fn over elements [0, n) of arg, which cover total bytes of input: on
+ * the worker pool if nthreads > 1 and the job is large enough, else on this
+ * thread, releasing the GIL once if the total input size is large enough. */
+static void
+_run_task(PyObject *module, xxhash_task_fn fn, void *arg, Py_ssize_t n,
+          Py_ssize_t total, int nthreads)
+{
+    if (nthreads > 1 && n > 1 && (total >= XXHASH_PARALLEL_MINSIZE
+                                  || n >= XXHASH_PARALLEL_MINITEMS)) {
+        _parallel_for(module, nthreads, fn, arg, n);
+    } else if (total > XXHASH_GIL_MINSIZE) {
+        Py_BEGIN_ALLOW_THREADS
+        fn(arg, 0, n);
+        Py_END_ALLOW_THREADS
+    } else {
+        fn(arg, 0, n);
+    }
+}
 
-PyDoc_STRVAR(
-    PYXXH64_update_doc,
-    "update (data)\n\n"
-    "Update the xxh64 object with bytes-like data. Repeated calls are\n"
-    "equivalent to a single call with the concatenation of all the arguments.");
+/* Run elements [0, n) of a batch. */
+static void
+_batch_run(PyObject *module, const xxhash_batch *job, Py_ssize_t n,
+           Py_ssize_t total, int nthreads)
+{
+    _run_task(module, _batch_task, (void *)job, n, total, nthreads);
+}
 
-static PyObject *PYXXH64_update(PYXXH64Object *self, PyObject *const *args,
-                                 Py_ssize_t nargs, PyObject *kwnames)
+/* Convert the i-th native digest of a finished batch to a Python object:
+ * an int if as_int, canonical (big-endian) bytes otherwise. */
+static PyObject *
+_batch_result_item(xxhash_algo algo, const unsigned char *out, Py_ssize_t i,
+                   int as_int)
 {
-    PyObject *arg = NULL;
+    Py_ssize_t digestsize = xxhash_algo_digestsize[algo];
+    const unsigned char *p = out + i * digestsize;
+    PyObject *ret = NULL;
 
-    /* validate keywords first */
-    if (kwnames) {
-        Py_ssize_t nkw = PyTuple_GET_SIZE(kwnames);
-        for (Py_ssize_t i = 0; i < nkw; i++) {
-            PyObject *key = PyTuple_GET_ITEM(kwnames, i);
-            if (PyUnicode_CompareWithASCIIString(key, "data") == 0) {
-                if (nargs >= 1) {
-                    PyErr_SetString(PyExc_TypeError,
-                        "xxh64.update() got multiple values for argument 'data'");
-                    return NULL;
-                }
-                arg = args[nargs + i];
-            } else {
-                PyErr_Format(PyExc_TypeError,
-                    "'%U' is an invalid keyword argument for 'xxh64.update()'",
-                    key);
-                return NULL;
-            }
-        }
+    if (!as_int) {
+        ret = PyBytes_FromStringAndSize(NULL, digestsize);
+        if (ret == NULL) return NULL;
     }
 
-    if (nargs >= 1) {
-        if (nargs > 1) {
-            PyErr_Format(PyExc_TypeError,
-                "xxh64.update() takes at most 1 positional argument (%zd given)", nargs);
+    switch (algo) {
+    case XXHASH_ALGO_XXH32: {
+        XXH32_hash_t h;
+        memcpy(&h, p, sizeof(h));
+        if (as_int) return PyLong_FromUnsignedLong(h);
+        XXH32_canonicalFromHash((XXH32_canonical_t *)PyBytes_AS_STRING(ret), h);
+        return ret;
+    }
+    case XXHASH_ALGO_XXH64:
+    case XXHASH_ALGO_XXH3_64: {
+        XXH64_hash_t h;
+        memcpy(&h, p, sizeof(h));
+        if (as_int) return PyLong_FromUnsignedLongLong(h);
+        XXH64_canonicalFromHash((XXH64_canonical_t *)PyBytes_AS_STRING(ret), h);
+        return ret;
+    }
+    case XXHASH_ALGO_XXH3_128:
+    default: {
+        XXH128_hash_t h;
+        memcpy(&h, p, sizeof(h));
+        if (as_int) return _xxh128_to_pylong(h);
+        XXH128_canonicalFromHash((XXH128_canonical_t *)PyBytes_AS_STRING(ret), h);
+        return ret;
+    }
+    }
+}
+
+/* Build the list of the n digests of a finished batch. */
+static PyObject *
+_batch_result_list(xxhash_algo algo, const unsigned char *out, Py_ssize_t n,
+                   int as_int)
+{
+    PyObject *result = PyList_New(n);
+    if (result == NULL)
+        return NULL;
+    for (Py_ssize_t i = 0; i < n; i++) {
+        PyObject *item = _batch_result_item(algo, out, i, as_int);
+        if (item == NULL) {
+            Py_DECREF(result);
             return NULL;
         }
-        arg = args[0];
+        PyList_SET_ITEM(result, i, item);
     }
+    return result;
+}
 
-    if (!arg) {
-        PyErr_SetString(PyExc_TypeError, "xxh64.update() missing required argument 'data'");
-        return NULL;
+/* Point *out at the storage for size bytes of digests: the caller's out
+ * buffer if outobj is given (view is then filled), a temporary array
+ * otherwise. Returns 0 on success, -1 on error with exception set. */
+static int
+_batch_out_init(PyObject *outobj, Py_ssize_t size, Py_buffer *view,
+                unsigned char **out, const char *funcname)
+{
+    view->obj = NULL;
+    if (outobj) {
+        if (_get_out_buffer(outobj, size, view, funcname) < 0)
+            return -1;
+        *out = view->buf;
+        return 0;
+    }
+    if ((*out = PyMem_Malloc(size)) == NULL) {
+        PyErr_NoMemory();
+        return -1;
     }
+    return 0;
+}
 
-    Py_buffer buf;
-    if (_get_buffer_or_str(arg, &buf) < 0)
-        return NULL;
-    PYXXH64_do_update(self, &buf);
-    Py_RETURN_NONE;
+static void
+_batch_out_release(Py_buffer *view, unsigned char *out)
+{
+    if (view->obj)
+        PyBuffer_Release(view);
+    else
+        PyMem_Free(out);
 }
 
-PyDoc_STRVAR(
-    PYXXH64_digest_doc,
-    "digest() -> bytes\n\n"
-    "Return the digest of the data passed to the update() method so\n"
-    "far. This is an 8-byte value which may contain non-ASCII characters,\n"
-    "including null bytes.");
+/* Return out (new reference) if given, else the list of digests. */
+static PyObject *
+_batch_result(PyObject *outobj, xxhash_algo algo, const unsigned char *out,
+              Py_ssize_t n, int as_int)
+{
+    if (outobj) {
+        Py_INCREF(outobj);
+        return outobj;
+    }
+    return _batch_result_list(algo, out, n, as_int);
+}
 
-static PyObject *PYXXH64_digest(PYXXH64Object *self)
+/* Convert obj to a Py_ssize_t >= 0 for argument name of funcname.
+ * Returns 0 on success, -1 on error with exception set. */
+static int
+_as_nonneg_ssize(PyObject *obj, const char *funcname, const char *name,
+                 Py_ssize_t *value)
 {
-    XXH64_hash_t intdigest;
+    *value = PyLong_AsSsize_t(obj);
+    if (*value == -1 && PyErr_Occurred())
+        return -1;
+    if (*value < 0) {
+        PyErr_Format(PyExc_ValueError,
+            "%s() argument '%s' must be non-negative", funcname, name);
+        return -1;
+    }
+    return 0;
+}
 
-    XXHASH_LOCK_ACQUIRE(self);
-    intdigest = XXH64_digest(self->xxhash_state);
-    XXHASH_LOCK_RELEASE(self);
+/* Shared implementation of xxh*_digest_many() and xxh*_intdigest_many().
+ * All buffers are acquired up front, then the whole batch is hashed with a
+ * single GIL release when the total input is large enough. */
+static PyObject *
+_xxhash_many(PyObject *module, PyObject *const *args, Py_ssize_t nargs,
+             PyObject *kwnames, const char *funcname, xxhash_algo algo,
+             int as_int)
+{
+    static const char *const names[] = {
+        "data", "seed", "out", "nthreads", NULL,
+    };
+    PyObject *argv[4];
+    XXH64_hash_t seed = 0;
+    int nthreads;
 
-    PyObject *ret = PyBytes_FromStringAndSize(NULL, XXH64_DIGESTSIZE);
-    if (ret == NULL) return NULL;
-    XXH64_canonicalFromHash((XXH64_canonical_t *)PyBytes_AS_STRING(ret), intdigest);
-    return ret;
-}
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, funcname, names,
+                               2, 1, argv) < 0)
+        return NULL;
+    if (_parse_nthreads(module, argv[3], funcname, &nthreads) < 0)
+        return NULL;
+    if (argv[1]) {
+        seed = (XXH64_hash_t)PyLong_AsUnsignedLongLongMask(argv[1]);
+        if (PyErr_Occurred())
+            return NULL;
+    }
+    if (argv[2] == Py_None)
+        argv[2] = NULL;
+    if (PyObject_CheckBuffer(argv[0])) {
+        PyErr_Format(PyExc_TypeError,
+            "%s() expects a sequence of bytes-like objects, not a single "
+            "'%.200s'", funcname, Py_TYPE(argv[0])->tp_name);
+        return NULL;
+    }
 
-PyDoc_STRVAR(
-    PYXXH64_hexdigest_doc,
-    "hexdigest() -> string\n\n"
-    "Like digest(), but returns the digest as a string of hexadecimal digits.");
+    PyObject *seq = PySequence_Fast(argv[0],
+        "data must be a sequence of bytes-like objects");
+    if (seq == NULL)
+        return NULL;
 
-static PyObject *PYXXH64_hexdigest(PYXXH64Object *self)
-{
-    XXH64_hash_t intdigest;
-    char digest[XXH64_DIGESTSIZE];
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    Py_buffer *bufs = PyMem_New(Py_buffer, n);
+    Py_buffer outview;
+    unsigned char *out = NULL;
+    PyObject *result = NULL;
+    Py_ssize_t nbufs = 0;
+    Py_ssize_t total = 0;
 
-    XXHASH_LOCK_ACQUIRE(self);
-    intdigest = XXH64_digest(self->xxhash_state);
-    XXHASH_LOCK_RELEASE(self);
-    XXH64_canonicalFromHash((XXH64_canonical_t *)digest, intdigest);
+    if (bufs == NULL) {
+        PyErr_NoMemory();
+        Py_DECREF(seq);
+        return NULL;
+    }
+    if (_batch_out_init(argv[2], n * xxhash_algo_digestsize[algo], &outview,
+                        &out, funcname) < 0) {
+        PyMem_Free(bufs);
+        Py_DECREF(seq);
+        return NULL;
+    }
 
-    PyObject *ret = PyUnicode_New(XXH64_DIGESTSIZE * 2, 127);
-    if (ret == NULL) return NULL;
-    Py_UCS1 *b = PyUnicode_1BYTE_DATA(ret);
-    for (Py_ssize_t i = 0, j = 0; i < XXH64_DIGESTSIZE; i++) {
-        unsigned char c;
-        c = (digest[i] >> 4) & 0xf;
-        c = (c > 9) ? c + 'a' - 10 : c + '0';
-        b[j++] = c;
-        c = (digest[i] & 0xf);
-        c = (c > 9) ? c + 'a' - 10 : c + '0';
-        b[j++] = c;
+    PyObject **items = PySequence_Fast_ITEMS(seq);
+    for (; nbufs < n; nbufs++) {
+        if (_get_buffer_or_str(items[nbufs], &bufs[nbufs]) < 0)
+            goto done;
+        total += bufs[nbufs].len;
     }
-    return ret;
-}
 
-PyDoc_STRVAR(
-    PYXXH64_intdigest_doc,
-    "intdigest() -> int\n\n"
-    "Like digest(), but returns the digest as an integer, which is the integer\n"
-    "returned by the xxHash C API.");
+    xxhash_batch job = {
+        .algo = algo, .seed = seed,
+        .src = XXHASH_SRC_BUFFERS, .bufs = bufs,
+        .out = out, .canonical = argv[2] && !as_int,
+    };
+    _batch_run(module, &job, n, total, nthreads);
+    result = _batch_result(argv[2], algo, out, n, as_int);
+
+done:
+    for (Py_ssize_t i = 0; i < nbufs; i++) {
+        PyBuffer_Release(&bufs[i]);
+    }
+    PyMem_Free(bufs);
+    _batch_out_release(&outview, out);
+    Py_DECREF(seq);
+    return result;
+}
 
-static PyObject *PYXXH64_intdigest(PYXXH64Object *self)
-{
-    XXHASH_LOCK_ACQUIRE(self);
-    XXH64_hash_t digest = XXH64_digest(self->xxhash_state);
-    XXHASH_LOCK_RELEASE(self);
-    return PyLong_FromUnsignedLongLong(digest);
+#define XXHASH_MANY(name, algo, as_int, rtype, outdoc)                        \
+PyDoc_STRVAR(                                                                 \
+    name##_doc,                                                               \
+    #name "(data, seed=0, *, out=None, nthreads=None) -> list of " rtype "\n\n"\
+    "Hash every bytes-like object in the sequence data with the same seed\n" \
+    "and return the digests in order, as " rtype " objects.\n\n"             \
+    "If out is given, the digests are written into that writable buffer\n"   \
+    outdoc " instead, and out is returned.\n\n"                              \
+    XXHASH_NTHREADS_DOC);                                                     \
+static PyObject *name(PyObject *self, PyObject *const *args,                  \
+                      Py_ssize_t nargs, PyObject *kwnames)                    \
+{                                                                             \
+    return _xxhash_many(self, args, nargs, kwnames, #name, algo, as_int);     \
 }
 
-PyDoc_STRVAR(
-    PYXXH64_copy_doc,
-    "copy() -> xxh64 object\n\n"
-    "Return a copy of the xxh64 object.");
+#define XXHASH_NTHREADS_DOC                                                   \
+    "nthreads is the number of threads to hash a large batch on, the\n"      \
+    "calling thread included (default: get_default_nthreads())."
 
-static PyObject *PYXXH64_copy(PYXXH64Object *self)
+#define XXHASH_OUT_CANONICAL "as canonical (big-endian) digest bytes"
+#define XXHASH_OUT_NATIVE "as native-endian unsigned integers"
+#define XXHASH_OUT_NATIVE128 "as pairs of native-endian uint64 (low, high)"
+
+XXHASH_MANY(xxh32_digest_many, XXHASH_ALGO_XXH32, 0, "bytes", XXHASH_OUT_CANONICAL)
+XXHASH_MANY(xxh32_intdigest_many, XXHASH_ALGO_XXH32, 1, "int", XXHASH_OUT_NATIVE)
+XXHASH_MANY(xxh64_digest_many, XXHASH_ALGO_XXH64, 0, "bytes", XXHASH_OUT_CANONICAL)
+XXHASH_MANY(xxh64_intdigest_many, XXHASH_ALGO_XXH64, 1, "int", XXHASH_OUT_NATIVE)
+XXHASH_MANY(xxh3_64_digest_many, XXHASH_ALGO_XXH3_64, 0, "bytes", XXHASH_OUT_CANONICAL)
+XXHASH_MANY(xxh3_64_intdigest_many, XXHASH_ALGO_XXH3_64, 1, "int", XXHASH_OUT_NATIVE)
+XXHASH_MANY(xxh3_128_digest_many, XXHASH_ALGO_XXH3_128, 0, "bytes", XXHASH_OUT_CANONICAL)
+XXHASH_MANY(xxh3_128_intdigest_many, XXHASH_ALGO_XXH3_128, 1, "int", XXHASH_OUT_NATIVE128)
+
+/* Shared implementation of xxh3_*_hash_strided(). */
+static PyObject *
+_xxhash_strided(PyObject *module, PyObject *const *args, Py_ssize_t nargs,
+                PyObject *kwnames, const char *funcname, xxhash_algo algo)
 {
-    PYXXH64Object *p;
+    static const char *const names[] = {
+        "data", "record_size", "stride", "offset", "length", "seed", "out",
+        "nthreads", NULL,
+    };
+    PyObject *argv[8];
+    Py_ssize_t record_size, stride, offset = 0, length;
+    XXH64_hash_t seed = 0;
+    int nthreads;
 
-    if ((p = (PYXXH64Object *)Py_TYPE(self)->tp_alloc(Py_TYPE(self), 0)) == NULL) {
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, funcname, names,
+                               3, 2, argv) < 0)
+        return NULL;
+    if (_parse_nthreads(module, argv[7], funcname, &nthreads) < 0)
+        return NULL;
+    if (_as_nonneg_ssize(argv[1], funcname, "record_size", &record_size) < 0)
+        return NULL;
+    if (record_size == 0) {
+        PyErr_Format(PyExc_ValueError,
+            "%s() argument 'record_size' must be positive", funcname);
+        return NULL;
+    }
+    stride = record_size;
+    if (argv[2] && argv[2] != Py_None) {
+        if (_as_nonneg_ssize(argv[2], funcname, "stride", &stride) < 0)
+            return NULL;
+        if (stride == 0) {
+            PyErr_Format(PyExc_ValueError,
+                "%s() argument 'stride' must be positive", funcname);
+            return NULL;
+        }
+    }
+    if (argv[3] && _as_nonneg_ssize(argv[3], funcname, "offset", &offset) < 0)
         return NULL;
+    if (offset > record_size) {
+        PyErr_Format(PyExc_ValueError,
+            "%s() offset %zd is larger than record_size %zd",
+            funcname, offset, record_size);
+        return NULL;
+    }
+    length = record_size - offset;
+    if (argv[4] && argv[4] != Py_None) {
+        if (_as_nonneg_ssize(argv[4], funcname, "length", &length) < 0)
+            return NULL;
+        if (length > record_size - offset) {
+            PyErr_Format(PyExc_ValueError,
+                "%s() field [%zd:%zd] does not fit in record_size %zd",
+                funcname, offset, offset + length, record_size);
+            return NULL;
+        }
+    }
+    if (argv[5]) {
+        seed = (XXH64_hash_t)PyLong_AsUnsignedLongLongMask(argv[5]);
+        if (PyErr_Occurred())
+            return NULL;
     }
+    if (argv[6] == Py_None)
+        argv[6] = NULL;
 
-    XXHASH_LOCK_INIT(p);
+    Py_buffer buf;
+    if (_get_buffer_or_str(argv[0], &buf) < 0)
+        return NULL;
 
-    if ((p->xxhash_state = XXH64_createState()) == NULL) {
-        Py_DECREF(p);
-        PyErr_NoMemory();
+    /* The last record only needs record_size bytes, not a full stride. */
+    Py_ssize_t n = 0;
+    if (buf.len >= record_size)
+        n = (buf.len - record_size) / stride + 1;
+
+    Py_buffer outview;
+    unsigned char *out;
+    PyObject *result = NULL;
+    if (_batch_out_init(argv[6], n * xxhash_algo_digestsize[algo], &outview,
+                        &out, funcname) < 0) {
+        PyBuffer_Release(&buf);
         return NULL;
     }
 
-    XXHASH_LOCK_ACQUIRE(self);
-    p->seed = self->seed;
-    XXH64_copyState(p->xxhash_state, self->xxhash_state);
-    XXHASH_LOCK_RELEASE(self);
+    xxhash_batch job = {
+        .algo = algo, .seed = seed,
+        .src = XXHASH_SRC_STRIDED, .base = (unsigned char *)buf.buf + offset,
+        .stride = stride, .length = length,
+        .out = out, .canonical = 0,
+    };
+    Py_ssize_t total = PY_SSIZE_T_MAX;
+    if (length == 0 || n <= PY_SSIZE_T_MAX / length)
+        total = n * length;
+    _batch_run(module, &job, n, total, nthreads);
+    result = _batch_result(argv[6], algo, out, n, 1);
+
+    _batch_out_release(&outview, out);
+    PyBuffer_Release(&buf);
+    return result;
+}
 
-    return (PyObject *)p;
+#define XXHASH_STRIDED(name, algo, outdoc)                                    \
+PyDoc_STRVAR(                                                                 \
+    name##_doc,                                                               \
+    #name "(data, record_size, stride=None, *, offset=0, length=None,\n"      \
+    "    seed=0, out=None, nthreads=None) -> list of int\n\n"                 \
+    "Treat the contiguous buffer data as fixed-size records and return the\n"\
+    "integer digest of each one. Record i starts at byte i * stride (stride\n"\
+    "defaults to record_size); only the field [offset:offset + length] of\n" \
+    "each record is hashed (the whole record by default). A trailing partial\n"\
+    "record is ignored.\n\n"                                                  \
+    "If out is given, the digests are written into that writable buffer\n"   \
+    outdoc " instead, and out is returned.\n\n"                              \
+    XXHASH_NTHREADS_DOC);                                                     \
+static PyObject *name(PyObject *self, PyObject *const *args,                  \
+                      Py_ssize_t nargs, PyObject *kwnames)                    \
+{                                                                             \
+    return _xxhash_strided(self, args, nargs, kwnames, #name, algo);          \
 }
 
-PyDoc_STRVAR(
-    PYXXH64_reset_doc,
-    "reset()\n\n"
-    "Reset state.");
+XXHASH_STRIDED(xxh3_64_hash_strided, XXHASH_ALGO_XXH3_64, XXHASH_OUT_NATIVE)
+XXHASH_STRIDED(xxh3_128_hash_strided, XXHASH_ALGO_XXH3_128, XXHASH_OUT_NATIVE128)
 
-static PyObject *PYXXH64_reset(PYXXH64Object *self)
+/* Shared implementation of hash_uint*_array(): a strided batch of
+ * XXH3_64 over records of width bytes with no gaps. */
+static PyObject *
+_xxhash_uint_array(PyObject *module, PyObject *const *args, Py_ssize_t nargs,
+                   PyObject *kwnames, const char *funcname, Py_ssize_t width)
 {
-    XXHASH_LOCK_ACQUIRE(self);
-    XXH64_reset(self->xxhash_state, self->seed);
-    XXHASH_LOCK_RELEASE(self);
-    Py_RETURN_NONE;
-}
+    static const char *const names[] = {
+        "data", "seed", "out", "nthreads", NULL,
+    };
+    PyObject *argv[4];
+    XXH64_hash_t seed = 0;
+    int nthreads;
 
-static PyMethodDef PYXXH64_methods[] = {
-    {"update", (PyCFunction)PYXXH64_update, METH_FASTCALL | METH_KEYWORDS, PYXXH64_update_doc},
-    {"digest", (PyCFunction)PYXXH64_digest, METH_NOARGS, PYXXH64_digest_doc},
-    {"hexdigest", (PyCFunction)PYXXH64_hexdigest, METH_NOARGS, PYXXH64_hexdigest_doc},
-    {"intdigest", (PyCFunction)PYXXH64_intdigest, METH_NOARGS, PYXXH64_intdigest_doc},
-    {"copy", (PyCFunction)PYXXH64_copy, METH_NOARGS, PYXXH64_copy_doc},
-    {"reset", (PyCFunction)PYXXH64_reset, METH_NOARGS, PYXXH64_reset_doc},
-    {NULL, NULL, 0, NULL}
-};
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, funcname, names,
+                               2, 1, argv) < 0)
+        return NULL;
+    if (_parse_nthreads(module, argv[3], funcname, &nthreads) < 0)
+        return NULL;
+    if (argv[1]) {
+        seed = (XXH64_hash_t)PyLong_AsUnsignedLongLongMask(argv[1]);
+        if (PyErr_Occurred())
+            return NULL;
+    }
+    if (argv[2] == Py_None)
+        argv[2] = NULL;
 
-static PyObject *PYXXH64_get_block_size(PYXXH64Object *self, void *closure)
-{
-    return PyLong_FromLong(XXH64_BLOCKSIZE);
+    Py_buffer buf;
+    if (PyObject_GetBuffer(argv[0], &buf, PyBUF_C_CONTIGUOUS) < 0)
+        return NULL;
+    /* Raw bytes, or elements of the width, whatever their type. */
+    if (buf.itemsize != 1 && buf.itemsize != width) {
+        PyErr_Format(PyExc_TypeError,
+            "%s() expects items of %zd bytes, not %zd",
+            funcname, width, buf.itemsize);
+        PyBuffer_Release(&buf);
+        return NULL;
+    }
+    if (buf.len % width != 0) {
+        PyErr_Format(PyExc_ValueError,
+            "%s() buffer size %zd is not a multiple of %zd",
+            funcname, buf.len, width);
+        PyBuffer_Release(&buf);
+        return NULL;
+    }
+
+    Py_ssize_t n = buf.len / width;
+    Py_buffer outview;
+    unsigned char *out;
+    PyObject *result = NULL;
+    if (_batch_out_init(argv[2], n * sizeof(XXH64_hash_t), &outview, &out,
+                        funcname) < 0) {
+        PyBuffer_Release(&buf);
+        return NULL;
+    }
+
+    xxhash_batch job = {
+        .algo = XXHASH_ALGO_XXH3_64, .seed = seed,
+        .src = XXHASH_SRC_STRIDED, .base = buf.buf,
+        .stride = width, .length = width,
+        .out = out, .canonical = 0,
+    };
+    _batch_run(module, &job, n, buf.len, nthreads);
+    result = _batch_result(argv[2], XXHASH_ALGO_XXH3_64, out, n, 1);
+
+    _batch_out_release(&outview, out);
+    PyBuffer_Release(&buf);
+    return result;
 }
 
-static PyObject *
-PYXXH64_get_digest_size(PYXXH64Object *self, void *closure)
+#define XXHASH_UINT_ARRAY(name, width, ctype)                                 \
+PyDoc_STRVAR(                                                                 \
+    name##_doc,                                                               \
+    #name "(data, seed=0, *, out=None, nthreads=None) -> list of int\n\n"   \
+    "Hash every " #width "-byte element of the contiguous buffer data, such\n"\
+    "as an array of " ctype ", as its own key, and return the XXH3_64\n"     \
+    "integer digests in order: the same as xxh3_64_intdigest() of the bytes\n"\
+    "of each element as stored, that is in native byte order.\n\n"           \
+    "If out is given, the digests are written into that writable buffer\n"   \
+    XXHASH_OUT_NATIVE " instead, and out is returned.\n\n"                  \
+    XXHASH_NTHREADS_DOC);                                                     \
+static PyObject *name(PyObject *self, PyObject *const *args,                  \
+                      Py_ssize_t nargs, PyObject *kwnames)                    \
+{                                                                             \
+    return _xxhash_uint_array(self, args, nargs, kwnames, #name, width);      \
+}
+
+XXHASH_UINT_ARRAY(hash_uint32_array, 4, "32-bit integers")
+XXHASH_UINT_ARRAY(hash_uint64_array, 8, "64-bit integers or doubles")
+XXHASH_UINT_ARRAY(hash_uint128_array, 16, "128-bit integers")
+
+/* Copy offsets, a C-contiguous buffer of int32 or int64 integers (Arrow
+ * style), into a new array *copy of *len bytes. Workers read the copy
+ * without the GIL, so it cannot change after it has been checked. Returns
+ * the item size (4 or 8), or -1 on error with exception set. */
+static int
+_get_offsets(PyObject *obj, void **copy, Py_ssize_t *len,
+             const char *funcname)
 {
-    return PyLong_FromLong(XXH64_DIGESTSIZE);
+    Py_buffer view;
+
+    if (PyObject_GetBuffer(obj, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0)
+        return -1;
+
+    const char *format = view.format ? view.format : "B";
+    if (*format == '@' || *format == '=')
+        format++;
+#if PY_LITTLE_ENDIAN
+    else if (*format == '<')
+        format++;
+#else
+    else if (*format == '>' || *format == '!')
+        format++;
+#endif
+    if (!(view.ndim <= 1 && format[0] != '\0' && format[1] == '\0'
+          && strchr("iIlLqQnN", format[0]) != NULL
+          && (view.itemsize == 4 || view.itemsize == 8))) {
+        PyErr_Format(PyExc_TypeError,
+            "%s() offsets must be a one-dimensional buffer of native int32 "
+            "or int64, not format '%s' with itemsize %zd",
+            funcname, view.format ? view.format : "B", view.itemsize);
+        PyBuffer_Release(&view);
+        return -1;
+    }
+    if ((*copy = PyMem_Malloc(view.len ? view.len : 1)) == NULL) {
+        PyBuffer_Release(&view);
+        PyErr_NoMemory();
+        return -1;
+    }
+    memcpy(*copy, view.buf, view.len);
+    *len = view.len;
+    int itemsize = (int)view.itemsize;
+    PyBuffer_Release(&view);
+    return itemsize;
 }
 
-static PyObject *
-PYXXH64_get_name(PYXXH64Object *self, void *closure)
+/* Check that offsets are non-decreasing and within [0, datalen].
+ * Returns the number of bytes they cover, or -1 on error with exception
+ * set. */
+#define XXHASH_CHECK_OFFSETS(type)                                            \
+    do {                                                                      \
+        const type *o = offsets;                                              \
+        if (o[0] < 0) {                                                       \
+            bad = 0;                                                          \
+            break;                                                            \
+        }                                                                     \
+        for (Py_ssize_t i = 0; i < n; i++) {                                  \
+            if (o[i + 1] < o[i]) {                                            \
+                bad = i + 1;                                                  \
+                break;                                                        \
+            }                                                                 \
+        }                                                                     \
+        if (bad < 0 && (unsigned long long)o[n] > (unsigned long long)datalen) \
+            bad = n;                                                          \
+        if (bad < 0)                                                          \
+            total = (Py_ssize_t)(o[n] - o[0]);                                \
+    } while (0)
+
+static Py_ssize_t
+_check_offsets(const void *offsets, int itemsize, Py_ssize_t n,
+               Py_ssize_t datalen, const char *funcname)
 {
-    return PyUnicode_FromString("XXH64");
+    Py_ssize_t bad = -1;
+    Py_ssize_t total = 0;
+
+    if (itemsize == 4)
+        XXHASH_CHECK_OFFSETS(int32_t);
+    else
+        XXHASH_CHECK_OFFSETS(int64_t);
+
+    if (bad >= 0) {
+        PyErr_Format(PyExc_ValueError,
+            "%s() offsets[%zd] is out of range: offsets must be "
+            "non-decreasing and within the data buffer (%zd bytes)",
+            funcname, bad, datalen);
+        return -1;
+    }
+    return total;
 }
 
+/* Shared implementation of xxh3_*_hash_offsets(). */
 static PyObject *
-PYXXH64_get_seed(PYXXH64Object *self, void *closure)
+_xxhash_offsets(PyObject *module, PyObject *const *args, Py_ssize_t nargs,
+                PyObject *kwnames, const char *funcname, xxhash_algo algo)
 {
-    return PyLong_FromUnsignedLongLong(self->seed);
-}
+    static const char *const names[] = {
+        "data", "offsets", "seed", "out", "nthreads", NULL,
+    };
+    PyObject *argv[5];
+    XXH64_hash_t seed = 0;
+    int nthreads;
 
-static PyGetSetDef PYXXH64_getseters[] = {
-    {
-        "digest_size",
-        (getter)PYXXH64_get_digest_size, NULL,
-        "Digest size.",
-        NULL
-    },
-    {
-        "block_size",
-        (getter)PYXXH64_get_block_size, NULL,
-        "Block size.",
-        NULL
-    },
-    {
-        "name",
-        (getter)PYXXH64_get_name, NULL,
-        "Name. Always XXH64.",
-        NULL
-    },
-    {
-        "digestsize",
-        (getter)PYXXH64_get_digest_size, NULL,
-        "Digest size.",
-        NULL
-    },
-    {
-        "seed",
-        (getter)PYXXH64_get_seed, NULL,
-        "Seed.",
-        NULL
-    },
-    {NULL}  /* Sentinel */
-};
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, funcname, names,
+                               2, 2, argv) < 0)
+        return NULL;
+    if (_parse_nthreads(module, argv[4], funcname, &nthreads) < 0)
+        return NULL;
+    if (argv[2]) {
+        seed = (XXH64_hash_t)PyLong_AsUnsignedLongLongMask(argv[2]);
+        if (PyErr_Occurred())
+            return NULL;
+    }
+    if (argv[3] == Py_None)
+        argv[3] = NULL;
 
-PyDoc_STRVAR(
-    PYXXH64Type_doc,
-    "An xxh64 represents the object used to calculate the XXH64 hash of a\n"
-    "bytes-like object.\n"
-    "\n"
-    "Methods:\n"
-    "\n"
-    "update(data) -- updates the current hash state with additional data\n"
-    "digest() -- return the current digest value\n"
-    "hexdigest() -- return the current digest as a string of hexadecimal digits\n"
-    "intdigest() -- return the current digest as an integer\n"
-    "copy() -- return a copy of the current xxh64 object");
+    Py_buffer buf, outview;
+    unsigned char *out;
+    void *offsets;
+    Py_ssize_t offlen;
+    PyObject *result = NULL;
+    int itemsize;
 
-static PyType_Slot XXH64Type_slots[] = {
-    {Py_tp_dealloc, PYXXH64_dealloc},
-    {Py_tp_doc, (void *)PYXXH64Type_doc},
-    {Py_tp_methods, PYXXH64_methods},
-    {Py_tp_getset, PYXXH64_getseters},
-    {Py_tp_init, PYXXH64_init},
-    {Py_tp_new, PYXXH64_new},
-    {0, NULL},
-};
+    if (_get_buffer_or_str(argv[0], &buf) < 0)
+        return NULL;
+    if ((itemsize = _get_offsets(argv[1], &offsets, &offlen, funcname)) < 0) {
+        PyBuffer_Release(&buf);
+        return NULL;
+    }
 
-static PyType_Spec XXH64Type_spec = {
-    .name = "xxhash.xxh64",
-    .basicsize = sizeof(PYXXH64Object),
-    .flags = Py_TPFLAGS_DEFAULT
-#if PY_VERSION_HEX >= 0x030c0000
-           | Py_TPFLAGS_IMMUTABLETYPE
-#endif
-    ,
-    .slots = XXH64Type_slots,
-};
+    Py_ssize_t n = offlen / itemsize - 1;
+    Py_ssize_t total = 0;
+    if (n < 0)
+        n = 0;
+    else if ((total = _check_offsets(offsets, itemsize, n, buf.len,
+                                     funcname)) < 0)
+        goto error;
 
-/* XXH3_64 */
+    if (_batch_out_init(argv[3], n * xxhash_algo_digestsize[algo], &outview,
+                        &out, funcname) < 0)
+        goto error;
 
-typedef struct {
-    PyObject_HEAD
-    XXH3_state_t *xxhash_state;
-    XXH64_hash_t seed;
-    XXHASH_LOCK_FIELD
-} PYXXH3_64Object;
+    xxhash_batch job = {
+        .algo = algo, .seed = seed,
+        .src = itemsize == 4 ? XXHASH_SRC_OFFSETS32 : XXHASH_SRC_OFFSETS64,
+        .base = buf.buf, .offsets = offsets,
+        .out = out, .canonical = 0,
+    };
+    _batch_run(module, &job, n, total, nthreads);
+    result = _batch_result(argv[3], algo, out, n, 1);
+    _batch_out_release(&outview, out);
 
-static void PYXXH3_64_dealloc(PYXXH3_64Object *self)
-{
-    if (self->xxhash_state)
-        XXH3_freeState(self->xxhash_state);
-    XXHASH_LOCK_FINI(self);
-    PyTypeObject *tp = Py_TYPE(self);
-    tp->tp_free((PyObject *)self);
-    Py_DECREF(tp);
+error:
+    PyMem_Free(offsets);
+    PyBuffer_Release(&buf);
+    return result;
 }
 
-XXHASH_DO_UPDATE(XXH3_64, XXH3_64bits_update)
+#define XXHASH_OFFSETS(name, algo, outdoc)                                    \
+PyDoc_STRVAR(                                                                 \
+    name##_doc,                                                               \
+    #name "(data, offsets, *, seed=0, out=None, nthreads=None)\n"            \
+    "    -> list of int\n\n"                                                  \
+    "Hash the variable-length values stored back to back in the buffer data,\n"\
+    "Arrow style: value i is data[offsets[i]:offsets[i + 1]], where offsets\n"\
+    "is a buffer of n + 1 int32 or int64 integers. Return the n integer\n"   \
+    "digests.\n\n"                                                            \
+    "If out is given, the digests are written into that writable buffer\n"   \
+    outdoc " instead, and out is returned.\n\n"                              \
+    XXHASH_NTHREADS_DOC);                                                     \
+static PyObject *name(PyObject *self, PyObject *const *args,                  \
+                      Py_ssize_t nargs, PyObject *kwnames)                    \
+{                                                                             \
+    return _xxhash_offsets(self, args, nargs, kwnames, #name, algo);          \
+}
 
-static PyObject *
-PYXXH3_64_vectorcall(PyObject *type, PyObject *const *args,
-                     size_t nargsf, PyObject *kwnames)
+XXHASH_OFFSETS(xxh3_64_hash_offsets, XXHASH_ALGO_XXH3_64, XXHASH_OUT_NATIVE)
+XXHASH_OFFSETS(xxh3_128_hash_offsets, XXHASH_ALGO_XXH3_128, XXHASH_OUT_NATIVE128)
+
+/* Hash elements [start, start + n) of a batch into out, which stands for
+ * the batch's own output. */
+static void
+_batch_hash_at(const xxhash_batch *job, Py_ssize_t start, Py_ssize_t n,
+               void *out)
 {
-    Py_ssize_t nargs = PyVectorcall_NARGS(nargsf);
-    XXH64_hash_t seed = 0;
-    Py_buffer buf;
-    unsigned long long raw_seed;
+    xxhash_batch part = *job;
+    part.out = out;
+    switch (part.src) {
+    case XXHASH_SRC_BUFFERS:
+        part.bufs += start;
+        break;
+    case XXHASH_SRC_STRIDED:
+        part.base += start * part.stride;
+        break;
+    case XXHASH_SRC_OFFSETS32:
+        part.offsets = (const int32_t *)part.offsets + start;
+        break;
+    case XXHASH_SRC_OFFSETS64:
+        part.offsets = (const int64_t *)part.offsets + start;
+        break;
+    }
+    _batch_hash_range(&part, 0, n);
+}
 
-    if (_parse_fastcall_args(args, nargs, kwnames, "xxhash.xxh3_64", 0,
-                             &buf, &raw_seed) < 0)
-        return NULL;
-    seed = (XXH64_hash_t)raw_seed;
+/* Most columns xxh3_*_hash_columns() combine. */
+#define XXHASH_COLUMNS_MAX  256
+/* Bytes of cell digests hashed per chunk of rows, column by column, before
+ * the rows of the chunk are combined. */
+#define XXHASH_COLUMNS_CELLS  16384
 
-    PYXXH3_64Object *self = (PYXXH3_64Object *)
-        ((PyTypeObject *)type)->tp_alloc((PyTypeObject *)type, 0);
-    if (self == NULL) {
-        PyBuffer_Release(&buf);
-        return NULL;
-    }
+/* A row-wise hash over several columns: each column is a batch job of its
+ * own, minus the output. */
+typedef struct {
+    xxhash_algo algo;
+    XXH64_hash_t seed;
+    Py_ssize_t ncols;
+    const xxhash_batch *cols;
+    unsigned char *out;
+} xxhash_columns;
+
+/* Hash rows [start, end) of a column job. Cells are hashed a chunk of rows
+ * at a time with the batch kernels, one column after the other; then the
+ * little-endian cell digests of each row are concatenated and hashed. */
+static void
+_columns_hash_range(const xxhash_columns *job, Py_ssize_t start,
+                    Py_ssize_t end)
+{
+    XXH64_hash_t cells[XXHASH_COLUMNS_CELLS / sizeof(XXH64_hash_t)];
+    unsigned char row[XXHASH_COLUMNS_MAX * XXH128_DIGESTSIZE];
+    Py_ssize_t digestsize = xxhash_algo_digestsize[job->algo];
+    Py_ssize_t chunk = sizeof(cells) / (job->ncols * digestsize);
 
-    XXHASH_LOCK_INIT(self);
+    while (start < end) {
+        Py_ssize_t n = end - start < chunk ? end - start : chunk;
 
-    self->xxhash_state = XXH3_createState();
-    if (self->xxhash_state == NULL) {
-        Py_DECREF(self);
-        PyBuffer_Release(&buf);
-        return PyErr_NoMemory();
-    }
-    self->seed = seed;
-    XXH3_64bits_reset_withSeed(self->xxhash_state, seed);
+        for (Py_ssize_t c = 0; c < job->ncols; c++) {
+            _batch_hash_at(&job->cols[c], start, n,
+                           (unsigned char *)cells + c * n * digestsize);
+        }
 
-    if (buf.obj) {
-        /* Constructor: no concurrent access possible, skip locking. */
-        if (buf.len > XXHASH_GIL_MINSIZE) {
-            Py_BEGIN_ALLOW_THREADS
-            XXH3_64bits_update(self->xxhash_state, buf.buf, buf.len);
-            Py_END_ALLOW_THREADS
-        } else {
-            XXH3_64bits_update(self->xxhash_state, buf.buf, buf.len);
+        for (Py_ssize_t r = 0; r < n; r++) {
+            unsigned char *p = row;
+            for (Py_ssize_t c = 0; c < job->ncols; c++) {
+                const unsigned char *cell =
+                    (const unsigned char *)cells + (c * n + r) * digestsize;
+                XXH128_hash_t h = {0, 0};
+                if (job->algo == XXHASH_ALGO_XXH3_64)
+                    memcpy(&h.low64, cell, sizeof(XXH64_hash_t));
+                else
+                    memcpy(&h, cell, sizeof(XXH128_hash_t));
+                for (int i = 0; i < 8; i++) {
+                    p[i] = (unsigned char)(h.low64 >> (8 * i));
+                    p[8 + i] = (unsigned char)(h.high64 >> (8 * i));
+                }
+                p += digestsize;
+            }
+
+            unsigned char *dst = job->out + (start + r) * digestsize;
+            if (job->algo == XXHASH_ALGO_XXH3_64) {
+                XXH64_hash_t h = XXH3_64bits_withSeed(row, p - row, job->seed);
+                memcpy(dst, &h, sizeof(h));
+            } else {
+                XXH128_hash_t h = XXH3_128bits_withSeed(row, p - row,
+                                                        job->seed);
+                memcpy(dst, &h, sizeof(h));
+            }
         }
-        PyBuffer_Release(&buf);
+        start += n;
     }
-    return (PyObject *)self;
 }
-static PyObject *PYXXH3_64_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+
+static void
+_columns_task(void *arg, Py_ssize_t start, Py_ssize_t end)
 {
-    PYXXH3_64Object *self;
+    _columns_hash_range((const xxhash_columns *)arg, start, end);
+}
 
-    if ((self = (PYXXH3_64Object *)type->tp_alloc(type, 0)) == NULL) {
-        return NULL;
-    }
+/* A column of xxh3_*_hash_columns() and the buffers it holds. */
+typedef struct {
+    Py_buffer data;
+    void *offsets;      /* private copy of the offsets, or NULL */
+} xxhash_column_view;
+
+/* Acquire the (data, offsets) pair of variable-length values as taken by
+ * xxh3_*_hash_offsets() and set up its batch job. Returns the number of
+ * values, or -1 on error with exception set and nothing held. */
+static Py_ssize_t
+_get_offsets_column(PyObject *data, PyObject *offsets,
+                    xxhash_column_view *view, xxhash_batch *job,
+                    Py_ssize_t *total, const char *funcname)
+{
+    Py_ssize_t n, offlen, covered = 0;
+    int itemsize;
 
-    XXHASH_LOCK_INIT(self);
+    view->offsets = NULL;
+    if (_get_buffer_or_str(data, &view->data) < 0)
+        return -1;
+    itemsize = _get_offsets(offsets, &view->offsets, &offlen, funcname);
+    if (itemsize < 0) {
+        PyBuffer_Release(&view->data);
+        return -1;
+    }
 
-    if ((self->xxhash_state = XXH3_createState()) == NULL) {
-        Py_DECREF(self);
-        PyErr_NoMemory();
-        return NULL;
+    if ((n = offlen / itemsize - 1) < 0)
+        n = 0;
+    else if ((covered = _check_offsets(view->offsets, itemsize, n,
+                                       view->data.len, funcname)) < 0) {
+        PyMem_Free(view->offsets);
+        PyBuffer_Release(&view->data);
+        return -1;
     }
+    job->src = itemsize == 4 ? XXHASH_SRC_OFFSETS32 : XXHASH_SRC_OFFSETS64;
+    job->base = view->data.buf;
+    job->offsets = view->offsets;
+    *total += covered;
+    return n;
+}
 
-    self->seed = 0;
-    XXH3_64bits_reset_withSeed(self->xxhash_state, 0);
+/* Acquire obj as a C-contiguous buffer whose first dimension are the rows,
+ * each row a value, and set up its batch job. Returns the number of rows,
+ * or -1 on error with exception set and nothing held. */
+static Py_ssize_t
+_get_rows_column(PyObject *obj, xxhash_column_view *view, xxhash_batch *job,
+                 Py_ssize_t *total, const char *funcname)
+{
+    Py_ssize_t n;
 
-    return (PyObject *)self;
+    view->offsets = NULL;
+    if (PyObject_GetBuffer(obj, &view->data, PyBUF_C_CONTIGUOUS) < 0)
+        return -1;
+    if (view->data.ndim < 1) {
+        PyErr_Format(PyExc_TypeError,
+            "%s() buffers of values must have at least one dimension",
+            funcname);
+        PyBuffer_Release(&view->data);
+        return -1;
+    }
+    n = view->data.shape[0];
+    job->src = XXHASH_SRC_STRIDED;
+    job->base = view->data.buf;
+    job->stride = job->length = n ? view->data.len / n : 0;
+    *total += view->data.len;
+    return n;
 }
 
-XXHASH_INIT(XXH3_64, "xxhash.xxh3_64", XXH3_64bits_reset_withSeed, XXH3_64bits_update, XXH64_hash_t)
-
-PyDoc_STRVAR(
-    PYXXH3_64_update_doc,
-    "update (data)\n\n"
-    "Update the xxh3_64 object with bytes-like data. Repeated calls are\n"
-    "equivalent to a single call with the concatenation of all the arguments.");
+/* Acquire a column of xxh3_*_hash_columns(): a buffer of rows or a
+ * (data, offsets) pair. */
+static Py_ssize_t
+_get_column(PyObject *column, xxhash_column_view *view, xxhash_batch *job,
+            Py_ssize_t *total, const char *funcname)
+{
+    if (PyTuple_Check(column) && PyTuple_GET_SIZE(column) == 2) {
+        return _get_offsets_column(PyTuple_GET_ITEM(column, 0),
+                                   PyTuple_GET_ITEM(column, 1), view, job,
+                                   total, funcname);
+    }
+    return _get_rows_column(column, view, job, total, funcname);
+}
 
-static PyObject *PYXXH3_64_update(PYXXH3_64Object *self, PyObject *const *args,
-                                 Py_ssize_t nargs, PyObject *kwnames)
+static void
+_column_view_release(xxhash_column_view *view)
 {
-    PyObject *arg = NULL;
+    PyBuffer_Release(&view->data);
+    PyMem_Free(view->offsets);
+}
 
-    /* validate keywords first */
-    if (kwnames) {
-        Py_ssize_t nkw = PyTuple_GET_SIZE(kwnames);
-        for (Py_ssize_t i = 0; i < nkw; i++) {
-            PyObject *key = PyTuple_GET_ITEM(kwnames, i);
-            if (PyUnicode_CompareWithASCIIString(key, "data") == 0) {
-                if (nargs >= 1) {
-                    PyErr_SetString(PyExc_TypeError,
-                        "xxh3_64.update() got multiple values for argument 'data'");
-                    return NULL;
-                }
-                arg = args[nargs + i];
-            } else {
-                PyErr_Format(PyExc_TypeError,
-                    "'%U' is an invalid keyword argument for 'xxh3_64.update()'",
-                    key);
-                return NULL;
-            }
+/* The keys of a sketch's batch method: a sequence of bytes-like objects, a
+ * buffer of rows such as an integer array, each row a key, or with offsets
+ * given, the variable-length keys in data as taken by
+ * xxh3_*_hash_offsets(). */
+typedef struct {
+    xxhash_batch job;   /* algo, seed and out are left to the caller */
+    Py_ssize_t n;
+    Py_ssize_t total;
+    PyObject *seq;      /* the sequence, if keys are separate objects */
+    Py_buffer *bufs;
+    xxhash_column_view view;
+} xxhash_keys;
+
+static void
+_keys_release(xxhash_keys *keys)
+{
+    if (keys->seq) {
+        for (Py_ssize_t i = 0; i < keys->n; i++) {
+            PyBuffer_Release(&keys->bufs[i]);
         }
+        PyMem_Free(keys->bufs);
+        Py_DECREF(keys->seq);
+    } else {
+        _column_view_release(&keys->view);
     }
+}
 
-    if (nargs >= 1) {
-        if (nargs > 1) {
-            PyErr_Format(PyExc_TypeError,
-                "xxh3_64.update() takes at most 1 positional argument (%zd given)", nargs);
-            return NULL;
+/* Acquire the keys of a batch method from obj and offsets (NULL or None
+ * if not given). Returns 0, or -1 on error with exception set and nothing
+ * held. */
+static int
+_get_keys(PyObject *obj, PyObject *offsets, xxhash_keys *keys,
+          const char *funcname)
+{
+    memset(keys, 0, sizeof(*keys));
+    if (offsets && offsets != Py_None) {
+        keys->n = _get_offsets_column(obj, offsets, &keys->view, &keys->job,
+                                      &keys->total, funcname);
+        return keys->n < 0 ? -1 : 0;
+    }
+    if (PyBytes_Check(obj) || PyByteArray_Check(obj) || PyUnicode_Check(obj)) {
+        PyErr_Format(PyExc_TypeError,
+            "%s() expects a sequence of keys, not a single '%.200s'",
+            funcname, Py_TYPE(obj)->tp_name);
+        return -1;
+    }
+    if (PyObject_CheckBuffer(obj)) {
+        keys->n = _get_rows_column(obj, &keys->view, &keys->job,
+                                   &keys->total, funcname);
+        return keys->n < 0 ? -1 : 0;
+    }
+
+    PyObject *seq = PySequence_Fast(obj,
+        "keys must be a sequence of bytes-like objects or a buffer");
+    if (seq == NULL)
+        return -1;
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    Py_buffer *bufs = PyMem_New(Py_buffer, n);
+    if (bufs == NULL) {
+        PyErr_NoMemory();
+        Py_DECREF(seq);
+        return -1;
+    }
+    PyObject **items = PySequence_Fast_ITEMS(seq);
+    keys->seq = seq;
+    keys->bufs = bufs;
+    for (; keys->n < n; keys->n++) {
+        if (_get_buffer_or_str(items[keys->n], &bufs[keys->n]) < 0) {
+            _keys_release(keys);
+            return -1;
         }
-        arg = args[0];
+        keys->total += bufs[keys->n].len;
     }
+    keys->job.src = XXHASH_SRC_BUFFERS;
+    keys->job.bufs = bufs;
+    return 0;
+}
 
-    if (!arg) {
-        PyErr_SetString(PyExc_TypeError, "xxh3_64.update() missing required argument 'data'");
+/* Shared implementation of xxh3_*_hash_columns(). */
+static PyObject *
+_xxhash_columns(PyObject *module, PyObject *const *args, Py_ssize_t nargs,
+                PyObject *kwnames, const char *funcname, xxhash_algo algo)
+{
+    static const char *const names[] = {
+        "columns", "seed", "out", "nthreads", NULL,
+    };
+    PyObject *argv[4];
+    XXH64_hash_t seed = 0;
+    int nthreads;
+
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, funcname, names,
+                               2, 1, argv) < 0)
         return NULL;
+    if (_parse_nthreads(module, argv[3], funcname, &nthreads) < 0)
+        return NULL;
+    if (argv[1]) {
+        seed = (XXH64_hash_t)PyLong_AsUnsignedLongLongMask(argv[1]);
+        if (PyErr_Occurred())
+            return NULL;
     }
+    if (argv[2] == Py_None)
+        argv[2] = NULL;
 
-    Py_buffer buf;
-    if (_get_buffer_or_str(arg, &buf) < 0)
+    PyObject *seq = PySequence_Fast(argv[0],
+        "columns must be a sequence of buffers or (data, offsets) pairs");
+    if (seq == NULL)
         return NULL;
-    PYXXH3_64_do_update(self, &buf);
-    Py_RETURN_NONE;
-}
 
-PyDoc_STRVAR(
-    PYXXH3_64_digest_doc,
-    "digest() -> bytes\n\n"
-    "Return the digest of the data passed to the update() method so\n"
-    "far. This is an 8-byte value which may contain non-ASCII characters,\n"
-    "including null bytes.");
+    Py_ssize_t ncols = PySequence_Fast_GET_SIZE(seq);
+    if (ncols < 1 || ncols > XXHASH_COLUMNS_MAX) {
+        PyErr_Format(PyExc_ValueError,
+            "%s() takes 1 to %d columns, got %zd", funcname,
+            XXHASH_COLUMNS_MAX, ncols);
+        Py_DECREF(seq);
+        return NULL;
+    }
 
-static PyObject *PYXXH3_64_digest(PYXXH3_64Object *self)
-{
-    XXH64_hash_t intdigest;
+    xxhash_column_view *views = PyMem_New(xxhash_column_view, ncols);
+    xxhash_batch *cols = PyMem_New(xxhash_batch, ncols);
+    PyObject *result = NULL;
+    Py_ssize_t nviews = 0, n = 0, total = 0;
+    Py_buffer outview;
+    unsigned char *out;
 
-    XXHASH_LOCK_ACQUIRE(self);
-    intdigest = XXH3_64bits_digest(self->xxhash_state);
-    XXHASH_LOCK_RELEASE(self);
+    if (views == NULL || cols == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    for (; nviews < ncols; nviews++) {
+        PyObject *column = PySequence_Fast_GET_ITEM(seq, nviews);
+        xxhash_batch *col = &cols[nviews];
+        col->algo = algo;
+        col->seed = seed;
+        col->canonical = 0;
+        Py_ssize_t rows = _get_column(column, &views[nviews], col, &total,
+                                      funcname);
+        if (rows < 0)
+            goto error;
+        if (nviews == 0) {
+            n = rows;
+        } else if (rows != n) {
+            PyErr_Format(PyExc_ValueError,
+                "%s() column %zd has %zd rows, expected %zd",
+                funcname, nviews, rows, n);
+            nviews++;
+            goto error;
+        }
+    }
 
-    PyObject *ret = PyBytes_FromStringAndSize(NULL, XXH64_DIGESTSIZE);
-    if (ret == NULL) return NULL;
-    XXH64_canonicalFromHash((XXH64_canonical_t *)PyBytes_AS_STRING(ret), intdigest);
-    return ret;
-}
+    if (_batch_out_init(argv[2], n * xxhash_algo_digestsize[algo], &outview,
+                        &out, funcname) < 0)
+        goto error;
 
-PyDoc_STRVAR(
-    PYXXH3_64_hexdigest_doc,
-    "hexdigest() -> string\n\n"
-    "Like digest(), but returns the digest as a string of hexadecimal digits.");
+    xxhash_columns job = {
+        .algo = algo, .seed = seed, .ncols = ncols, .cols = cols, .out = out,
+    };
+    _run_task(module, _columns_task, &job, n, total, nthreads);
+    result = _batch_result(argv[2], algo, out, n, 1);
+    _batch_out_release(&outview, out);
 
-static PyObject *PYXXH3_64_hexdigest(PYXXH3_64Object *self)
-{
+error:
+    for (Py_ssize_t i = 0; i < nviews; i++) {
+        _column_view_release(&views[i]);
+    }
+    PyMem_Free(views);
+    PyMem_Free(cols);
+    Py_DECREF(seq);
+    return result;
+}
+
+#define XXHASH_COLUMNS(name, algo, cellfn, width, outdoc)                     \
+PyDoc_STRVAR(                                                                 \
+    name##_doc,                                                               \
+    #name "(columns, seed=0, *, out=None, nthreads=None) -> list of int\n\n" \
+    "Hash the rows of a table given as a sequence of columns of n rows each,\n"\
+    "and return the n integer digests. A column is either a C-contiguous\n"  \
+    "buffer, such as a NumPy array, whose first dimension are the rows, or a\n"\
+    "(data, offsets) pair of variable-length values as taken by\n"          \
+    "xxh3_*_hash_offsets().\n\n"                                             \
+    "Row i hashes to\n\n"                                                     \
+    "    " cellfn "(b''.join(\n"                                              \
+    "        " cellfn "(cell, seed).to_bytes(" width ", 'little')\n"          \
+    "        for cell in row_i), seed)\n\n"                                   \
+    "so the digest depends on the order of the columns, and a cell never\n"  \
+    "runs into its neighbour.\n\n"                                            \
+    "If out is given, the digests are written into that writable buffer\n"   \
+    outdoc " instead, and out is returned.\n\n"                              \
+    XXHASH_NTHREADS_DOC);                                                     \
+static PyObject *name(PyObject *self, PyObject *const *args,                  \
+                      Py_ssize_t nargs, PyObject *kwnames)                    \
+{                                                                             \
+    return _xxhash_columns(self, args, nargs, kwnames, #name, algo);          \
+}
+
+XXHASH_COLUMNS(xxh3_64_hash_columns, XXHASH_ALGO_XXH3_64,
+               "xxh3_64_intdigest", "8", XXHASH_OUT_NATIVE)
+XXHASH_COLUMNS(xxh3_128_hash_columns, XXHASH_ALGO_XXH3_128,
+               "xxh3_128_intdigest", "16", XXHASH_OUT_NATIVE128)
+
+/*****************************************************************************
+ * Module Types ***************************************************************
+ ****************************************************************************/
+
+/* Hash objects keep their xxHash state inline, so creating or copying one
+ * is a single allocation. XXH3 states must be 64-byte aligned, which
+ * object memory is not, so they get XXHASH_STATE_ALIGN - 1 bytes of slack
+ * and xxhash_state points at the aligned start. */
+#define XXHASH_STATE_ALIGN  64
+#define XXHASH_STATE_STORAGE(type) \
+    unsigned char state_storage[sizeof(type) + XXHASH_STATE_ALIGN - 1];
+#define XXHASH_STATE_PTR(o, type) \
+    ((type *)(((uintptr_t)(o)->state_storage + XXHASH_STATE_ALIGN - 1) \
+              & ~(uintptr_t)(XXHASH_STATE_ALIGN - 1)))
+
+/* Allocate an object of the hash type for algo, reusing a freed one when
+ * the free list has one. Fields are left for the caller to set. */
+static PyObject *
+_hasher_alloc(PyTypeObject *type, xxhash_algo algo)
+{
+#if XXHASH_FREELIST_SIZE > 0
+    xxhash_state *state = PyType_GetModuleState(type);
+    if (state && (PyObject *)type == state->types[algo]
+        && state->nfree[algo] > 0)
+        return PyObject_Init(state->freelist[algo][--state->nfree[algo]],
+                             type);
+#endif
+    return type->tp_alloc(type, 0);
+}
+
+/* Free a hash object, keeping it on the free list if there is room. */
+static void
+_hasher_free(PyObject *self, xxhash_algo algo)
+{
+    PyTypeObject *tp = Py_TYPE(self);
+#if XXHASH_FREELIST_SIZE > 0
+    xxhash_state *state = PyType_GetModuleState(tp);
+    if (state && (PyObject *)tp == state->types[algo]
+        && state->nfree[algo] < XXHASH_FREELIST_SIZE) {
+        state->freelist[algo][state->nfree[algo]++] = self;
+        Py_DECREF(tp);
+        return;
+    }
+#endif
+    tp->tp_free(self);
+    Py_DECREF(tp);
+}
+
+/* XXH32 */
+
+typedef struct {
+    PyObject_HEAD
+    XXH32_state_t *xxhash_state;    /* points into the object */
+    XXH32_hash_t seed;
+    XXHASH_LOCK_FIELD
+    XXH32_state_t state;
+} PYXXH32Object;
+
+static void PYXXH32_dealloc(PYXXH32Object *self)
+{
+    XXHASH_LOCK_FINI(self);
+    _hasher_free((PyObject *)self, XXHASH_ALGO_XXH32);
+}
+
+/* Macro to generate _do_update for each hash type.
+ * Matches CPython 3.9-3.12 md5 pattern: release GIL first (for large data),
+ * then acquire lock, hash, release lock, re-acquire GIL.
+ * For small data, acquire lock with GIL held (try-then-block if contested). */
+#define XXHASH_DO_UPDATE(type, update_fn)                                     \
+static inline void                                           \
+PY##type##_do_update(PY##type##Object *self, Py_buffer *buf)                  \
+{                                                                             \
+    XXHASH_LOCK_MAYBE_INIT(self, buf->len);                                   \
+    if (XXHASH_LOCK_IS_ACTIVE(self)) {                                        \
+        if (buf->len > XXHASH_GIL_MINSIZE) {                                  \
+            /* Release GIL first, then acquire lock. */                       \
+            Py_BEGIN_ALLOW_THREADS                                            \
+            XXHASH_LOCK_ACQUIRE_BLOCKING(self);                               \
+            update_fn(self->xxhash_state, buf->buf, buf->len);                \
+            XXHASH_LOCK_RELEASE(self);                                        \
+            Py_END_ALLOW_THREADS                                              \
+        } else {                                                              \
+            /* Acquire lock with GIL held. */                                 \
+            XXHASH_LOCK_ACQUIRE(self);                                        \
+            update_fn(self->xxhash_state, buf->buf, buf->len);                \
+            XXHASH_LOCK_RELEASE(self);                                        \
+        }                                                                     \
+    } else {                                                                  \
+        /* No lock: hash directly, no GIL release. */                         \
+        update_fn(self->xxhash_state, buf->buf, buf->len);                    \
+    }                                                                         \
+    PyBuffer_Release(buf);                                                    \
+}
+
+XXHASH_DO_UPDATE(XXH32, XXH32_update)
+
+static PyObject *
+PYXXH32_vectorcall(PyObject *type, PyObject *const *args,
+                   size_t nargsf, PyObject *kwnames)
+{
+    Py_ssize_t nargs = PyVectorcall_NARGS(nargsf);
+    XXH32_hash_t seed = 0;
+    Py_buffer buf;
+    unsigned long long raw_seed;
+
+    if (_parse_fastcall_args(args, nargs, kwnames, "xxhash.xxh32", 0,
+                             &buf, &raw_seed, NULL, NULL) < 0)
+        return NULL;
+    seed = (XXH32_hash_t)raw_seed;
+
+    PYXXH32Object *self = (PYXXH32Object *)
+        _hasher_alloc((PyTypeObject *)type, XXHASH_ALGO_XXH32);
+    if (self == NULL) {
+        PyBuffer_Release(&buf);
+        return NULL;
+    }
+
+    XXHASH_LOCK_INIT(self);
+
+    self->xxhash_state = &self->state;
+    self->seed = seed;
+    XXH32_reset(self->xxhash_state, seed);
+
+    if (buf.obj) {
+        /* Constructor: no concurrent access possible, skip locking. */
+        if (buf.len > XXHASH_GIL_MINSIZE) {
+            Py_BEGIN_ALLOW_THREADS
+            XXH32_update(self->xxhash_state, buf.buf, buf.len);
+            Py_END_ALLOW_THREADS
+        } else {
+            XXH32_update(self->xxhash_state, buf.buf, buf.len);
+        }
+        PyBuffer_Release(&buf);
+    }
+    return (PyObject *)self;
+}
+
+/* XXH32 methods */
+
+static PyObject *PYXXH32_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    PYXXH32Object *self;
+
+    if ((self = (PYXXH32Object *)_hasher_alloc(type, XXHASH_ALGO_XXH32)) == NULL) {
+        return NULL;
+    }
+
+    XXHASH_LOCK_INIT(self);
+
+    self->xxhash_state = &self->state;
+
+    self->seed = 0;
+    XXH32_reset(self->xxhash_state, 0);
+
+    return (PyObject *)self;
+}
+
+/* Shared helper for parsing __init__ arguments.
+ * Handles positional and keyword 'data' and 'seed', validates keywords,
+ * and detects duplicate/multiple values. If secret is not NULL, a keyword
+ * 'secret' is also accepted and stored there (borrowed, NULL if not given).
+ * Returns 0 on success, -1 on error.
+ * On success *data_obj is set (or NULL) and *seed is populated. */
+static int
+_parse_init_args(PyObject *args, PyObject *kwargs,
+                 PyObject **data_obj, unsigned long long *seed,
+                 PyObject **secret, const char *funcname)
+{
+    Py_ssize_t nargs = PyTuple_GET_SIZE(args);
+
+    if (kwargs) {
+        Py_ssize_t pos = 0;
+        PyObject *key, *val;
+        while (PyDict_Next(kwargs, &pos, &key, &val)) {
+            if (PyUnicode_CompareWithASCIIString(key, "data") == 0 ||
+                PyUnicode_CompareWithASCIIString(key, "seed") == 0 ||
+                (secret &&
+                 PyUnicode_CompareWithASCIIString(key, "secret") == 0))
+                continue;
+            PyErr_Format(PyExc_TypeError,
+                "'%U' is an invalid keyword argument for '%s()'",
+                key, funcname);
+            return -1;
+        }
+    }
+
+    *data_obj = NULL;
+    *seed = 0;
+    if (secret)
+        *secret = NULL;
+
+    if (nargs >= 1) {
+        *data_obj = PyTuple_GET_ITEM(args, 0);
+        if (kwargs && PyDict_GetItemString(kwargs, "data")) {
+            PyErr_Format(PyExc_TypeError,
+                "%s() got multiple values for argument 'data'", funcname);
+            return -1;
+        }
+    }
+    if (nargs >= 2) {
+        *seed = PyLong_AsUnsignedLongLongMask(PyTuple_GET_ITEM(args, 1));
+        if (PyErr_Occurred()) return -1;
+        if (kwargs && PyDict_GetItemString(kwargs, "seed")) {
+            PyErr_Format(PyExc_TypeError,
+                "%s() got multiple values for argument 'seed'", funcname);
+            return -1;
+        }
+    }
+    if (nargs > 2) {
+        PyErr_Format(PyExc_TypeError,
+            "%s() takes at most 2 positional arguments (%zd given)",
+            funcname, nargs);
+        return -1;
+    }
+
+    if (kwargs) {
+        PyObject *val = PyDict_GetItemString(kwargs, "data");
+        if (val) {
+            if (*data_obj) {
+                PyErr_Format(PyExc_TypeError,
+                    "%s() got multiple values for argument 'data'", funcname);
+                return -1;
+            }
+            *data_obj = val;
+        }
+        val = PyDict_GetItemString(kwargs, "seed");
+        if (val) {
+            *seed = PyLong_AsUnsignedLongLongMask(val);
+            if (PyErr_Occurred()) return -1;
+        }
+        if (secret) {
+            val = PyDict_GetItemString(kwargs, "secret");
+            if (val && val != Py_None)
+                *secret = val;
+        }
+    }
+    return 0;
+}
+
+/* Macro to generate __init__ for each hash type. */
+#define XXHASH_INIT(type, name, reset_fn, update_fn, seed_cast)               \
+static int PY##type##_init(PY##type##Object *self, PyObject *args,            \
+                           PyObject *kwargs)                                  \
+{                                                                             \
+    unsigned long long seed_val = 0;                                          \
+    PyObject *data_obj = NULL;                                                \
+    Py_buffer buf = {NULL, NULL};                                             \
+                                                                              \
+    if (_parse_init_args(args, kwargs, &data_obj, &seed_val, NULL,            \
+                         name) < 0)                                           \
+        return -1;                                                            \
+                                                                              \
+    if (data_obj) {                                                           \
+        if (_get_buffer_or_str(data_obj, &buf) < 0)                           \
+            return -1;                                                        \
+    }                                                                         \
+                                                                              \
+    XXHASH_LOCK_ACQUIRE(self);                                                \
+    self->seed = (seed_cast)seed_val;                                         \
+    reset_fn(self->xxhash_state, self->seed);                                 \
+                                                                              \
+    if (buf.obj) {                                                            \
+        update_fn(self->xxhash_state, buf.buf, buf.len);                      \
+        PyBuffer_Release(&buf);                                               \
+    }                                                                         \
+    XXHASH_LOCK_RELEASE(self);                                                \
+    return 0;                                                                 \
+}
+
+XXHASH_INIT(XXH32, "xxhash.xxh32", XXH32_reset, XXH32_update, XXH32_hash_t)
+
+/* Macro to generate _reset_state for the XXH3 types, which reset from
+ * their secret if they have one and from their seed otherwise. */
+#define XXHASH3_RESET_STATE(type, reset_seed_fn, reset_secret_fn)             \
+static inline void                                                            \
+PY##type##_reset_state(PY##type##Object *self)                                \
+{                                                                             \
+    if (self->secret)                                                         \
+        reset_secret_fn(self->xxhash_state,                                   \
+                        PyBytes_AS_STRING(self->secret),                      \
+                        (size_t)PyBytes_GET_SIZE(self->secret));              \
+    else                                                                      \
+        reset_seed_fn(self->xxhash_state, self->seed);                        \
+}
+
+/* Macro to generate __init__ for the XXH3 types, which also take a
+ * secret. The replaced secret is released after the lock, once the state
+ * no longer points into it. */
+#define XXHASH3_INIT(type, name, update_fn)                                   \
+static int PY##type##_init(PY##type##Object *self, PyObject *args,            \
+                           PyObject *kwargs)                                  \
+{                                                                             \
+    unsigned long long seed_val = 0;                                          \
+    PyObject *data_obj = NULL, *secret_obj, *secret, *old_secret;             \
+    Py_buffer buf = {NULL, NULL};                                             \
+    int error;                                                                \
+                                                                              \
+    if (_parse_init_args(args, kwargs, &data_obj, &seed_val, &secret_obj,     \
+                         name) < 0)                                           \
+        return -1;                                                            \
+    secret = _get_secret_bytes(secret_obj, seed_val, name, &error);           \
+    if (error < 0)                                                            \
+        return -1;                                                            \
+                                                                              \
+    if (data_obj) {                                                           \
+        if (_get_buffer_or_str(data_obj, &buf) < 0) {                         \
+            Py_XDECREF(secret);                                               \
+            return -1;                                                        \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    XXHASH_LOCK_ACQUIRE(self);                                                \
+    old_secret = self->secret;                                                \
+    self->seed = (XXH64_hash_t)seed_val;                                      \
+    self->secret = secret;                                                    \
+    PY##type##_reset_state(self);                                             \
+                                                                              \
+    if (buf.obj) {                                                            \
+        update_fn(self->xxhash_state, buf.buf, buf.len);                      \
+        PyBuffer_Release(&buf);                                               \
+    }                                                                         \
+    XXHASH_LOCK_RELEASE(self);                                                \
+    Py_XDECREF(old_secret);                                                   \
+    return 0;                                                                 \
+}
+
+PyDoc_STRVAR(
+    PYXXH32_update_doc,
+    "update (data)\n\n"
+    "Update the xxh32 object with bytes-like data. Repeated calls are\n"
+    "equivalent to a single call with the concatenation of all the arguments.");
+
+static PyObject *PYXXH32_update(PYXXH32Object *self, PyObject *const *args,
+                                 Py_ssize_t nargs, PyObject *kwnames)
+{
+    PyObject *arg = NULL;
+
+    /* validate keywords first */
+    if (kwnames) {
+        Py_ssize_t nkw = PyTuple_GET_SIZE(kwnames);
+        for (Py_ssize_t i = 0; i < nkw; i++) {
+            PyObject *key = PyTuple_GET_ITEM(kwnames, i);
+            if (PyUnicode_CompareWithASCIIString(key, "data") == 0) {
+                if (nargs >= 1) {
+                    PyErr_SetString(PyExc_TypeError,
+                        "xxh32.update() got multiple values for argument 'data'");
+                    return NULL;
+                }
+                arg = args[nargs + i];
+            } else {
+                PyErr_Format(PyExc_TypeError,
+                    "'%U' is an invalid keyword argument for 'xxh32.update()'",
+                    key);
+                return NULL;
+            }
+        }
+    }
+
+    if (nargs >= 1) {
+        if (nargs > 1) {
+            PyErr_Format(PyExc_TypeError,
+                "xxh32.update() takes at most 1 positional argument (%zd given)", nargs);
+            return NULL;
+        }
+        arg = args[0];
+    }
+
+    if (!arg) {
+        PyErr_SetString(PyExc_TypeError, "xxh32.update() missing required argument 'data'");
+        return NULL;
+    }
+
+    Py_buffer buf;
+    if (_get_buffer_or_str(arg, &buf) < 0)
+        return NULL;
+    PYXXH32_do_update(self, &buf);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+    PYXXH32_digest_doc,
+    "digest() -> bytes\n\n"
+    "Return the digest of the data passed to the update() method so\n"
+    "far. This is a 4-byte value which may contain non-ASCII characters,\n"
+    "including null bytes.");
+
+static PyObject *PYXXH32_digest(PYXXH32Object *self)
+{
+    XXH32_hash_t intdigest;
+
+    XXHASH_LOCK_ACQUIRE(self);
+    intdigest = XXH32_digest(self->xxhash_state);
+    XXHASH_LOCK_RELEASE(self);
+
+    PyObject *ret = PyBytes_FromStringAndSize(NULL, XXH32_DIGESTSIZE);
+    if (ret == NULL) return NULL;
+    XXH32_canonicalFromHash((XXH32_canonical_t *)PyBytes_AS_STRING(ret), intdigest);
+    return ret;
+}
+
+PyDoc_STRVAR(
+    PYXXH32_hexdigest_doc,
+    "hexdigest() -> string\n\n"
+    "Like digest(), but returns the digest as a string of hexadecimal digits.");
+
+static PyObject *PYXXH32_hexdigest(PYXXH32Object *self)
+{
+    XXH32_hash_t intdigest;
+    char digest[XXH32_DIGESTSIZE];
+
+    XXHASH_LOCK_ACQUIRE(self);
+    intdigest = XXH32_digest(self->xxhash_state);
+    XXHASH_LOCK_RELEASE(self);
+    XXH32_canonicalFromHash((XXH32_canonical_t *)digest, intdigest);
+
+    PyObject *ret = PyUnicode_New(XXH32_DIGESTSIZE * 2, 127);
+    if (ret == NULL) return NULL;
+    Py_UCS1 *b = PyUnicode_1BYTE_DATA(ret);
+    for (Py_ssize_t i = 0, j = 0; i < XXH32_DIGESTSIZE; i++) {
+        unsigned char c;
+        c = (digest[i] >> 4) & 0xf;
+        c = (c > 9) ? c + 'a' - 10 : c + '0';
+        b[j++] = c;
+        c = (digest[i] & 0xf);
+        c = (c > 9) ? c + 'a' - 10 : c + '0';
+        b[j++] = c;
+    }
+    return ret;
+}
+
+PyDoc_STRVAR(
+    PYXXH32_intdigest_doc,
+    "intdigest() -> int\n\n"
+    "Like digest(), but returns the digest as an integer, which is the integer\n"
+    "returned by the xxHash C API.");
+
+static PyObject *PYXXH32_intdigest(PYXXH32Object *self)
+{
+    XXHASH_LOCK_ACQUIRE(self);
+    XXH32_hash_t digest = XXH32_digest(self->xxhash_state);
+    XXHASH_LOCK_RELEASE(self);
+    return PyLong_FromUnsignedLong(digest);
+}
+
+PyDoc_STRVAR(
+    PYXXH32_copy_doc,
+    "copy() -> xxh32 object\n\n"
+    "Return a copy of the xxh32 object.");
+
+static PyObject *PYXXH32_copy(PYXXH32Object *self)
+{
+    PYXXH32Object *p;
+
+    if ((p = (PYXXH32Object *)_hasher_alloc(Py_TYPE(self), XXHASH_ALGO_XXH32)) == NULL) {
+        return NULL;
+    }
+
+    XXHASH_LOCK_INIT(p);
+
+    p->xxhash_state = &p->state;
+
+    XXHASH_LOCK_ACQUIRE(self);
+    p->seed = self->seed;
+    XXH32_copyState(p->xxhash_state, self->xxhash_state);
+    XXHASH_LOCK_RELEASE(self);
+
+    return (PyObject *)p;
+}
+
+PyDoc_STRVAR(
+    PYXXH32_reset_doc,
+    "reset()\n\n"
+    "Reset state.");
+
+static PyObject *PYXXH32_reset(PYXXH32Object *self)
+{
+    XXHASH_LOCK_ACQUIRE(self);
+    XXH32_reset(self->xxhash_state, self->seed);
+    XXHASH_LOCK_RELEASE(self);
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef PYXXH32_methods[] = {
+    {"update", (PyCFunction)PYXXH32_update, METH_FASTCALL | METH_KEYWORDS, PYXXH32_update_doc},
+    {"digest", (PyCFunction)PYXXH32_digest, METH_NOARGS, PYXXH32_digest_doc},
+    {"hexdigest", (PyCFunction)PYXXH32_hexdigest, METH_NOARGS, PYXXH32_hexdigest_doc},
+    {"intdigest", (PyCFunction)PYXXH32_intdigest, METH_NOARGS, PYXXH32_intdigest_doc},
+    {"copy", (PyCFunction)PYXXH32_copy, METH_NOARGS, PYXXH32_copy_doc},
+    {"reset", (PyCFunction)PYXXH32_reset, METH_NOARGS, PYXXH32_reset_doc},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyObject *PYXXH32_get_block_size(PYXXH32Object *self, void *closure)
+{
+    return PyLong_FromLong(XXH32_BLOCKSIZE);
+}
+
+static PyObject *
+PYXXH32_get_digest_size(PYXXH32Object *self, void *closure)
+{
+    return PyLong_FromLong(XXH32_DIGESTSIZE);
+}
+
+static PyObject *
+PYXXH32_get_name(PYXXH32Object *self, void *closure)
+{
+    return PyUnicode_FromString("XXH32");
+}
+
+static PyObject *
+PYXXH32_get_seed(PYXXH32Object *self, void *closure)
+{
+    return PyLong_FromUnsignedLong(self->seed);
+}
+
+static PyGetSetDef PYXXH32_getseters[] = {
+    {
+        "digest_size",
+        (getter)PYXXH32_get_digest_size, NULL,
+        "Digest size.",
+        NULL
+    },
+    {
+        "block_size",
+        (getter)PYXXH32_get_block_size, NULL,
+        "Block size.",
+        NULL
+    },
+    {
+        "name",
+        (getter)PYXXH32_get_name, NULL,
+        "Name. Always XXH32.",
+        NULL
+    },
+    {
+        "digestsize",
+        (getter)PYXXH32_get_digest_size, NULL,
+        "Digest size.",
+        NULL
+    },
+    {
+        "seed",
+        (getter)PYXXH32_get_seed, NULL,
+        "Seed.",
+        NULL
+    },
+    {NULL}  /* Sentinel */
+};
+
+PyDoc_STRVAR(
+    PYXXH32Type_doc,
+    "An xxh32 represents the object used to calculate the XXH32 hash of a\n"
+    "bytes-like object.\n"
+    "\n"
+    "Methods:\n"
+    "\n"
+    "update(data) -- updates the current hash state with additional data\n"
+    "digest() -- return the current digest value\n"
+    "hexdigest() -- return the current digest as a string of hexadecimal digits\n"
+    "intdigest() -- return the current digest as an integer\n"
+    "copy() -- return a copy of the current xxh32 object");
+
+static PyType_Slot XXH32Type_slots[] = {
+    {Py_tp_dealloc, PYXXH32_dealloc},
+    {Py_tp_doc, (void *)PYXXH32Type_doc},
+    {Py_tp_methods, PYXXH32_methods},
+    {Py_tp_getset, PYXXH32_getseters},
+    {Py_tp_init, PYXXH32_init},
+    {Py_tp_new, PYXXH32_new},
+    {0, NULL},
+};
+
+static PyType_Spec XXH32Type_spec = {
+    .name = "xxhash.xxh32",
+    .basicsize = sizeof(PYXXH32Object),
+    .flags = Py_TPFLAGS_DEFAULT
+#if PY_VERSION_HEX >= 0x030c0000
+           | Py_TPFLAGS_IMMUTABLETYPE
+#endif
+    ,
+    .slots = XXH32Type_slots,
+};
+
+/* XXH64 */
+
+typedef struct {
+    PyObject_HEAD
+    XXH64_state_t *xxhash_state;    /* points into the object */
+    XXH64_hash_t seed;
+    XXHASH_LOCK_FIELD
+    XXH64_state_t state;
+} PYXXH64Object;
+
+static void PYXXH64_dealloc(PYXXH64Object *self)
+{
+    XXHASH_LOCK_FINI(self);
+    _hasher_free((PyObject *)self, XXHASH_ALGO_XXH64);
+}
+
+XXHASH_DO_UPDATE(XXH64, XXH64_update)
+
+static PyObject *
+PYXXH64_vectorcall(PyObject *type, PyObject *const *args,
+                   size_t nargsf, PyObject *kwnames)
+{
+    Py_ssize_t nargs = PyVectorcall_NARGS(nargsf);
+    XXH64_hash_t seed = 0;
+    Py_buffer buf;
+    unsigned long long raw_seed;
+
+    if (_parse_fastcall_args(args, nargs, kwnames, "xxhash.xxh64", 0,
+                             &buf, &raw_seed, NULL, NULL) < 0)
+        return NULL;
+    seed = (XXH64_hash_t)raw_seed;
+
+    PYXXH64Object *self = (PYXXH64Object *)
+        _hasher_alloc((PyTypeObject *)type, XXHASH_ALGO_XXH64);
+    if (self == NULL) {
+        PyBuffer_Release(&buf);
+        return NULL;
+    }
+
+    XXHASH_LOCK_INIT(self);
+
+    self->xxhash_state = &self->state;
+    self->seed = seed;
+    XXH64_reset(self->xxhash_state, seed);
+
+    if (buf.obj) {
+        /* Constructor: no concurrent access possible, skip locking. */
+        if (buf.len > XXHASH_GIL_MINSIZE) {
+            Py_BEGIN_ALLOW_THREADS
+            XXH64_update(self->xxhash_state, buf.buf, buf.len);
+            Py_END_ALLOW_THREADS
+        } else {
+            XXH64_update(self->xxhash_state, buf.buf, buf.len);
+        }
+        PyBuffer_Release(&buf);
+    }
+    return (PyObject *)self;
+}
+static PyObject *PYXXH64_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    PYXXH64Object *self;
+
+    if ((self = (PYXXH64Object *)_hasher_alloc(type, XXHASH_ALGO_XXH64)) == NULL) {
+        return NULL;
+    }
+
+    XXHASH_LOCK_INIT(self);
+
+    self->xxhash_state = &self->state;
+
+    self->seed = 0;
+    XXH64_reset(self->xxhash_state, 0);
+
+    return (PyObject *)self;
+}
+
+XXHASH_INIT(XXH64, "xxhash.xxh64", XXH64_reset, XXH64_update, XXH64_hash_t)
+
+PyDoc_STRVAR(
+    PYXXH64_update_doc,
+    "update (data)\n\n"
+    "Update the xxh64 object with bytes-like data. Repeated calls are\n"
+    "equivalent to a single call with the concatenation of all the arguments.");
+
+static PyObject *PYXXH64_update(PYXXH64Object *self, PyObject *const *args,
+                                 Py_ssize_t nargs, PyObject *kwnames)
+{
+    PyObject *arg = NULL;
+
+    /* validate keywords first */
+    if (kwnames) {
+        Py_ssize_t nkw = PyTuple_GET_SIZE(kwnames);
+        for (Py_ssize_t i = 0; i < nkw; i++) {
+            PyObject *key = PyTuple_GET_ITEM(kwnames, i);
+            if (PyUnicode_CompareWithASCIIString(key, "data") == 0) {
+                if (nargs >= 1) {
+                    PyErr_SetString(PyExc_TypeError,
+                        "xxh64.update() got multiple values for argument 'data'");
+                    return NULL;
+                }
+                arg = args[nargs + i];
+            } else {
+                PyErr_Format(PyExc_TypeError,
+                    "'%U' is an invalid keyword argument for 'xxh64.update()'",
+                    key);
+                return NULL;
+            }
+        }
+    }
+
+    if (nargs >= 1) {
+        if (nargs > 1) {
+            PyErr_Format(PyExc_TypeError,
+                "xxh64.update() takes at most 1 positional argument (%zd given)", nargs);
+            return NULL;
+        }
+        arg = args[0];
+    }
+
+    if (!arg) {
+        PyErr_SetString(PyExc_TypeError, "xxh64.update() missing required argument 'data'");
+        return NULL;
+    }
+
+    Py_buffer buf;
+    if (_get_buffer_or_str(arg, &buf) < 0)
+        return NULL;
+    PYXXH64_do_update(self, &buf);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+    PYXXH64_digest_doc,
+    "digest() -> bytes\n\n"
+    "Return the digest of the data passed to the update() method so\n"
+    "far. This is an 8-byte value which may contain non-ASCII characters,\n"
+    "including null bytes.");
+
+static PyObject *PYXXH64_digest(PYXXH64Object *self)
+{
+    XXH64_hash_t intdigest;
+
+    XXHASH_LOCK_ACQUIRE(self);
+    intdigest = XXH64_digest(self->xxhash_state);
+    XXHASH_LOCK_RELEASE(self);
+
+    PyObject *ret = PyBytes_FromStringAndSize(NULL, XXH64_DIGESTSIZE);
+    if (ret == NULL) return NULL;
+    XXH64_canonicalFromHash((XXH64_canonical_t *)PyBytes_AS_STRING(ret), intdigest);
+    return ret;
+}
+
+PyDoc_STRVAR(
+    PYXXH64_hexdigest_doc,
+    "hexdigest() -> string\n\n"
+    "Like digest(), but returns the digest as a string of hexadecimal digits.");
+
+static PyObject *PYXXH64_hexdigest(PYXXH64Object *self)
+{
+    XXH64_hash_t intdigest;
+    char digest[XXH64_DIGESTSIZE];
+
+    XXHASH_LOCK_ACQUIRE(self);
+    intdigest = XXH64_digest(self->xxhash_state);
+    XXHASH_LOCK_RELEASE(self);
+    XXH64_canonicalFromHash((XXH64_canonical_t *)digest, intdigest);
+
+    PyObject *ret = PyUnicode_New(XXH64_DIGESTSIZE * 2, 127);
+    if (ret == NULL) return NULL;
+    Py_UCS1 *b = PyUnicode_1BYTE_DATA(ret);
+    for (Py_ssize_t i = 0, j = 0; i < XXH64_DIGESTSIZE; i++) {
+        unsigned char c;
+        c = (digest[i] >> 4) & 0xf;
+        c = (c > 9) ? c + 'a' - 10 : c + '0';
+        b[j++] = c;
+        c = (digest[i] & 0xf);
+        c = (c > 9) ? c + 'a' - 10 : c + '0';
+        b[j++] = c;
+    }
+    return ret;
+}
+
+PyDoc_STRVAR(
+    PYXXH64_intdigest_doc,
+    "intdigest() -> int\n\n"
+    "Like digest(), but returns the digest as an integer, which is the integer\n"
+    "returned by the xxHash C API.");
+
+static PyObject *PYXXH64_intdigest(PYXXH64Object *self)
+{
+    XXHASH_LOCK_ACQUIRE(self);
+    XXH64_hash_t digest = XXH64_digest(self->xxhash_state);
+    XXHASH_LOCK_RELEASE(self);
+    return PyLong_FromUnsignedLongLong(digest);
+}
+
+PyDoc_STRVAR(
+    PYXXH64_copy_doc,
+    "copy() -> xxh64 object\n\n"
+    "Return a copy of the xxh64 object.");
+
+static PyObject *PYXXH64_copy(PYXXH64Object *self)
+{
+    PYXXH64Object *p;
+
+    if ((p = (PYXXH64Object *)_hasher_alloc(Py_TYPE(self), XXHASH_ALGO_XXH64)) == NULL) {
+        return NULL;
+    }
+
+    XXHASH_LOCK_INIT(p);
+
+    p->xxhash_state = &p->state;
+
+    XXHASH_LOCK_ACQUIRE(self);
+    p->seed = self->seed;
+    XXH64_copyState(p->xxhash_state, self->xxhash_state);
+    XXHASH_LOCK_RELEASE(self);
+
+    return (PyObject *)p;
+}
+
+PyDoc_STRVAR(
+    PYXXH64_reset_doc,
+    "reset()\n\n"
+    "Reset state.");
+
+static PyObject *PYXXH64_reset(PYXXH64Object *self)
+{
+    XXHASH_LOCK_ACQUIRE(self);
+    XXH64_reset(self->xxhash_state, self->seed);
+    XXHASH_LOCK_RELEASE(self);
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef PYXXH64_methods[] = {
+    {"update", (PyCFunction)PYXXH64_update, METH_FASTCALL | METH_KEYWORDS, PYXXH64_update_doc},
+    {"digest", (PyCFunction)PYXXH64_digest, METH_NOARGS, PYXXH64_digest_doc},
+    {"hexdigest", (PyCFunction)PYXXH64_hexdigest, METH_NOARGS, PYXXH64_hexdigest_doc},
+    {"intdigest", (PyCFunction)PYXXH64_intdigest, METH_NOARGS, PYXXH64_intdigest_doc},
+    {"copy", (PyCFunction)PYXXH64_copy, METH_NOARGS, PYXXH64_copy_doc},
+    {"reset", (PyCFunction)PYXXH64_reset, METH_NOARGS, PYXXH64_reset_doc},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyObject *PYXXH64_get_block_size(PYXXH64Object *self, void *closure)
+{
+    return PyLong_FromLong(XXH64_BLOCKSIZE);
+}
+
+static PyObject *
+PYXXH64_get_digest_size(PYXXH64Object *self, void *closure)
+{
+    return PyLong_FromLong(XXH64_DIGESTSIZE);
+}
+
+static PyObject *
+PYXXH64_get_name(PYXXH64Object *self, void *closure)
+{
+    return PyUnicode_FromString("XXH64");
+}
+
+static PyObject *
+PYXXH64_get_seed(PYXXH64Object *self, void *closure)
+{
+    return PyLong_FromUnsignedLongLong(self->seed);
+}
+
+static PyGetSetDef PYXXH64_getseters[] = {
+    {
+        "digest_size",
+        (getter)PYXXH64_get_digest_size, NULL,
+        "Digest size.",
+        NULL
+    },
+    {
+        "block_size",
+        (getter)PYXXH64_get_block_size, NULL,
+        "Block size.",
+        NULL
+    },
+    {
+        "name",
+        (getter)PYXXH64_get_name, NULL,
+        "Name. Always XXH64.",
+        NULL
+    },
+    {
+        "digestsize",
+        (getter)PYXXH64_get_digest_size, NULL,
+        "Digest size.",
+        NULL
+    },
+    {
+        "seed",
+        (getter)PYXXH64_get_seed, NULL,
+        "Seed.",
+        NULL
+    },
+    {NULL}  /* Sentinel */
+};
+
+PyDoc_STRVAR(
+    PYXXH64Type_doc,
+    "An xxh64 represents the object used to calculate the XXH64 hash of a\n"
+    "bytes-like object.\n"
+    "\n"
+    "Methods:\n"
+    "\n"
+    "update(data) -- updates the current hash state with additional data\n"
+    "digest() -- return the current digest value\n"
+    "hexdigest() -- return the current digest as a string of hexadecimal digits\n"
+    "intdigest() -- return the current digest as an integer\n"
+    "copy() -- return a copy of the current xxh64 object");
+
+static PyType_Slot XXH64Type_slots[] = {
+    {Py_tp_dealloc, PYXXH64_dealloc},
+    {Py_tp_doc, (void *)PYXXH64Type_doc},
+    {Py_tp_methods, PYXXH64_methods},
+    {Py_tp_getset, PYXXH64_getseters},
+    {Py_tp_init, PYXXH64_init},
+    {Py_tp_new, PYXXH64_new},
+    {0, NULL},
+};
+
+static PyType_Spec XXH64Type_spec = {
+    .name = "xxhash.xxh64",
+    .basicsize = sizeof(PYXXH64Object),
+    .flags = Py_TPFLAGS_DEFAULT
+#if PY_VERSION_HEX >= 0x030c0000
+           | Py_TPFLAGS_IMMUTABLETYPE
+#endif
+    ,
+    .slots = XXH64Type_slots,
+};
+
+/* XXH3_64 */
+
+typedef struct {
+    PyObject_HEAD
+    XXH3_state_t *xxhash_state;    /* points into the object */
+    XXH64_hash_t seed;
+    PyObject *secret;              /* bytes, or NULL if seeded */
+    XXHASH_LOCK_FIELD
+    XXHASH_STATE_STORAGE(XXH3_state_t)
+} PYXXH3_64Object;
+
+static void PYXXH3_64_dealloc(PYXXH3_64Object *self)
+{
+    XXHASH_LOCK_FINI(self);
+    Py_CLEAR(self->secret);
+    _hasher_free((PyObject *)self, XXHASH_ALGO_XXH3_64);
+}
+
+XXHASH_DO_UPDATE(XXH3_64, XXH3_64bits_update)
+XXHASH3_RESET_STATE(XXH3_64, XXH3_64bits_reset_withSeed, XXH3_64bits_reset_withSecret)
+
+static PyObject *
+PYXXH3_64_vectorcall(PyObject *type, PyObject *const *args,
+                     size_t nargsf, PyObject *kwnames)
+{
+    Py_ssize_t nargs = PyVectorcall_NARGS(nargsf);
+    XXH64_hash_t seed = 0;
+    Py_buffer buf;
+    unsigned long long raw_seed;
+    PyObject *secret_obj, *secret;
+    int error;
+
+    if (_parse_fastcall_args(args, nargs, kwnames, "xxhash.xxh3_64", 0,
+                             &buf, &raw_seed, NULL, &secret_obj) < 0)
+        return NULL;
+    seed = (XXH64_hash_t)raw_seed;
+    secret = _get_secret_bytes(secret_obj, raw_seed, "xxhash.xxh3_64", &error);
+    if (error < 0) {
+        PyBuffer_Release(&buf);
+        return NULL;
+    }
+
+    PYXXH3_64Object *self = (PYXXH3_64Object *)
+        _hasher_alloc((PyTypeObject *)type, XXHASH_ALGO_XXH3_64);
+    if (self == NULL) {
+        PyBuffer_Release(&buf);
+        Py_XDECREF(secret);
+        return NULL;
+    }
+
+    XXHASH_LOCK_INIT(self);
+
+    self->xxhash_state = XXHASH_STATE_PTR(self, XXH3_state_t);
+    XXH3_INITSTATE(self->xxhash_state);
+    self->seed = seed;
+    self->secret = secret;
+    PYXXH3_64_reset_state(self);
+
+    if (buf.obj) {
+        /* Constructor: no concurrent access possible, skip locking. */
+        if (buf.len > XXHASH_GIL_MINSIZE) {
+            Py_BEGIN_ALLOW_THREADS
+            XXH3_64bits_update(self->xxhash_state, buf.buf, buf.len);
+            Py_END_ALLOW_THREADS
+        } else {
+            XXH3_64bits_update(self->xxhash_state, buf.buf, buf.len);
+        }
+        PyBuffer_Release(&buf);
+    }
+    return (PyObject *)self;
+}
+static PyObject *PYXXH3_64_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    PYXXH3_64Object *self;
+
+    if ((self = (PYXXH3_64Object *)_hasher_alloc(type, XXHASH_ALGO_XXH3_64)) == NULL) {
+        return NULL;
+    }
+
+    XXHASH_LOCK_INIT(self);
+
+    self->xxhash_state = XXHASH_STATE_PTR(self, XXH3_state_t);
+    XXH3_INITSTATE(self->xxhash_state);
+
+    self->seed = 0;
+    self->secret = NULL;
+    XXH3_64bits_reset_withSeed(self->xxhash_state, 0);
+
+    return (PyObject *)self;
+}
+
+XXHASH3_INIT(XXH3_64, "xxhash.xxh3_64", XXH3_64bits_update)
+
+PyDoc_STRVAR(
+    PYXXH3_64_update_doc,
+    "update (data)\n\n"
+    "Update the xxh3_64 object with bytes-like data. Repeated calls are\n"
+    "equivalent to a single call with the concatenation of all the arguments.");
+
+static PyObject *PYXXH3_64_update(PYXXH3_64Object *self, PyObject *const *args,
+                                 Py_ssize_t nargs, PyObject *kwnames)
+{
+    PyObject *arg = NULL;
+
+    /* validate keywords first */
+    if (kwnames) {
+        Py_ssize_t nkw = PyTuple_GET_SIZE(kwnames);
+        for (Py_ssize_t i = 0; i < nkw; i++) {
+            PyObject *key = PyTuple_GET_ITEM(kwnames, i);
+            if (PyUnicode_CompareWithASCIIString(key, "data") == 0) {
+                if (nargs >= 1) {
+                    PyErr_SetString(PyExc_TypeError,
+                        "xxh3_64.update() got multiple values for argument 'data'");
+                    return NULL;
+                }
+                arg = args[nargs + i];
+            } else {
+                PyErr_Format(PyExc_TypeError,
+                    "'%U' is an invalid keyword argument for 'xxh3_64.update()'",
+                    key);
+                return NULL;
+            }
+        }
+    }
+
+    if (nargs >= 1) {
+        if (nargs > 1) {
+            PyErr_Format(PyExc_TypeError,
+                "xxh3_64.update() takes at most 1 positional argument (%zd given)", nargs);
+            return NULL;
+        }
+        arg = args[0];
+    }
+
+    if (!arg) {
+        PyErr_SetString(PyExc_TypeError, "xxh3_64.update() missing required argument 'data'");
+        return NULL;
+    }
+
+    Py_buffer buf;
+    if (_get_buffer_or_str(arg, &buf) < 0)
+        return NULL;
+    PYXXH3_64_do_update(self, &buf);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+    PYXXH3_64_digest_doc,
+    "digest() -> bytes\n\n"
+    "Return the digest of the data passed to the update() method so\n"
+    "far. This is an 8-byte value which may contain non-ASCII characters,\n"
+    "including null bytes.");
+
+static PyObject *PYXXH3_64_digest(PYXXH3_64Object *self)
+{
+    XXH64_hash_t intdigest;
+
+    XXHASH_LOCK_ACQUIRE(self);
+    intdigest = XXH3_64bits_digest(self->xxhash_state);
+    XXHASH_LOCK_RELEASE(self);
+
+    PyObject *ret = PyBytes_FromStringAndSize(NULL, XXH64_DIGESTSIZE);
+    if (ret == NULL) return NULL;
+    XXH64_canonicalFromHash((XXH64_canonical_t *)PyBytes_AS_STRING(ret), intdigest);
+    return ret;
+}
+
+PyDoc_STRVAR(
+    PYXXH3_64_hexdigest_doc,
+    "hexdigest() -> string\n\n"
+    "Like digest(), but returns the digest as a string of hexadecimal digits.");
+
+static PyObject *PYXXH3_64_hexdigest(PYXXH3_64Object *self)
+{
     XXH64_hash_t intdigest;
     char digest[XXH64_DIGESTSIZE];
 
-    XXHASH_LOCK_ACQUIRE(self);
-    intdigest = XXH3_64bits_digest(self->xxhash_state);
-    XXHASH_LOCK_RELEASE(self);
-    XXH64_canonicalFromHash((XXH64_canonical_t *)digest, intdigest);
+    XXHASH_LOCK_ACQUIRE(self);
+    intdigest = XXH3_64bits_digest(self->xxhash_state);
+    XXHASH_LOCK_RELEASE(self);
+    XXH64_canonicalFromHash((XXH64_canonical_t *)digest, intdigest);
+
+    PyObject *ret = PyUnicode_New(XXH64_DIGESTSIZE * 2, 127);
+    if (ret == NULL) return NULL;
+    Py_UCS1 *b = PyUnicode_1BYTE_DATA(ret);
+    for (Py_ssize_t i = 0, j = 0; i < XXH64_DIGESTSIZE; i++) {
+        unsigned char c;
+        c = (digest[i] >> 4) & 0xf;
+        c = (c > 9) ? c + 'a' - 10 : c + '0';
+        b[j++] = c;
+        c = (digest[i] & 0xf);
+        c = (c > 9) ? c + 'a' - 10 : c + '0';
+        b[j++] = c;
+    }
+    return ret;
+}
+
+PyDoc_STRVAR(
+    PYXXH3_64_intdigest_doc,
+    "intdigest() -> int\n\n"
+    "Like digest(), but returns the digest as an integer, which is the integer\n"
+    "returned by the xxHash C API.");
+
+static PyObject *PYXXH3_64_intdigest(PYXXH3_64Object *self)
+{
+    XXHASH_LOCK_ACQUIRE(self);
+    XXH64_hash_t intdigest = XXH3_64bits_digest(self->xxhash_state);
+    XXHASH_LOCK_RELEASE(self);
+    return PyLong_FromUnsignedLongLong(intdigest);
+}
+
+PyDoc_STRVAR(
+    PYXXH3_64_copy_doc,
+    "copy() -> xxh3_64 object\n\n"
+    "Return a copy of the xxh3_64 object.");
+
+static PyObject *PYXXH3_64_copy(PYXXH3_64Object *self)
+{
+    PYXXH3_64Object *p;
+
+    if ((p = (PYXXH3_64Object *)_hasher_alloc(Py_TYPE(self), XXHASH_ALGO_XXH3_64)) == NULL) {
+        return NULL;
+    }
+
+    XXHASH_LOCK_INIT(p);
+
+    p->xxhash_state = XXHASH_STATE_PTR(p, XXH3_state_t);
+    XXH3_INITSTATE(p->xxhash_state);
+
+    XXHASH_LOCK_ACQUIRE(self);
+    p->seed = self->seed;
+    p->secret = self->secret;
+    Py_XINCREF(p->secret);
+    XXH3_copyState(p->xxhash_state, self->xxhash_state);
+#if XXH_VERSION_NUMBER < 704
+    // v0.7.3 and earlier have a bug where states reset with a seed
+    // will have a wild pointer to the original state when copied,
+    // causing a use-after-free if the original is freed.
+    if (p->xxhash_state->secret == &self->xxhash_state->customSecret[0])
+        p->xxhash_state->secret = &p->xxhash_state->customSecret[0];
+#endif
+    XXHASH_LOCK_RELEASE(self);
+
+    return (PyObject *)p;
+}
+
+PyDoc_STRVAR(
+    PYXXH3_64_reset_doc,
+    "reset()\n\n"
+    "Reset state.");
+
+static PyObject *PYXXH3_64_reset(PYXXH3_64Object *self)
+{
+    XXHASH_LOCK_ACQUIRE(self);
+    PYXXH3_64_reset_state(self);
+    XXHASH_LOCK_RELEASE(self);
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef PYXXH3_64_methods[] = {
+    {"update", (PyCFunction)PYXXH3_64_update, METH_FASTCALL | METH_KEYWORDS, PYXXH3_64_update_doc},
+    {"digest", (PyCFunction)PYXXH3_64_digest, METH_NOARGS, PYXXH3_64_digest_doc},
+    {"hexdigest", (PyCFunction)PYXXH3_64_hexdigest, METH_NOARGS, PYXXH3_64_hexdigest_doc},
+    {"intdigest", (PyCFunction)PYXXH3_64_intdigest, METH_NOARGS, PYXXH3_64_intdigest_doc},
+    {"copy", (PyCFunction)PYXXH3_64_copy, METH_NOARGS, PYXXH3_64_copy_doc},
+    {"reset", (PyCFunction)PYXXH3_64_reset, METH_NOARGS, PYXXH3_64_reset_doc},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyObject *PYXXH3_64_get_block_size(PYXXH3_64Object *self, void *closure)
+{
+    return PyLong_FromLong(XXH64_BLOCKSIZE);
+}
+
+static PyObject *
+PYXXH3_64_get_digest_size(PYXXH3_64Object *self, void *closure)
+{
+    return PyLong_FromLong(XXH64_DIGESTSIZE);
+}
+
+static PyObject *
+PYXXH3_64_get_name(PYXXH3_64Object *self, void *closure)
+{
+    return PyUnicode_FromString("XXH3_64");
+}
+
+static PyObject *
+PYXXH3_64_get_seed(PYXXH3_64Object *self, void *closure)
+{
+    return PyLong_FromUnsignedLongLong(self->seed);
+}
+
+static PyGetSetDef PYXXH3_64_getseters[] = {
+    {
+        "digest_size",
+        (getter)PYXXH3_64_get_digest_size, NULL,
+        "Digest size.",
+        NULL
+    },
+    {
+        "block_size",
+        (getter)PYXXH3_64_get_block_size, NULL,
+        "Block size.",
+        NULL
+    },
+    {
+        "name",
+        (getter)PYXXH3_64_get_name, NULL,
+        "Name. Always XXH3_64.",
+        NULL
+    },
+    {
+        "digestsize",
+        (getter)PYXXH3_64_get_digest_size, NULL,
+        "Digest size.",
+        NULL
+    },
+    {
+        "seed",
+        (getter)PYXXH3_64_get_seed, NULL,
+        "Seed.",
+        NULL
+    },
+    {NULL}  /* Sentinel */
+};
+
+PyDoc_STRVAR(
+    PYXXH3_64Type_doc,
+    "An xxh3_64 represents the object used to calculate the XXH3_64 hash of a\n"
+    "bytes-like object.\n"
+    "\n"
+    "Methods:\n"
+    "\n"
+    "update(data) -- updates the current hash state with additional data\n"
+    "digest() -- return the current digest value\n"
+    "hexdigest() -- return the current digest as a string of hexadecimal digits\n"
+    "intdigest() -- return the current digest as an integer\n"
+    "copy() -- return a copy of the current xxh3_64 object");
+
+static PyType_Slot XXH3_64Type_slots[] = {
+    {Py_tp_dealloc, PYXXH3_64_dealloc},
+    {Py_tp_doc, (void *)PYXXH3_64Type_doc},
+    {Py_tp_methods, PYXXH3_64_methods},
+    {Py_tp_getset, PYXXH3_64_getseters},
+    {Py_tp_init, PYXXH3_64_init},
+    {Py_tp_new, PYXXH3_64_new},
+    {0, NULL},
+};
+
+static PyType_Spec XXH3_64Type_spec = {
+    .name = "xxhash.xxh3_64",
+    .basicsize = sizeof(PYXXH3_64Object),
+    .flags = Py_TPFLAGS_DEFAULT
+#if PY_VERSION_HEX >= 0x030c0000
+           | Py_TPFLAGS_IMMUTABLETYPE
+#endif
+    ,
+    .slots = XXH3_64Type_slots,
+};
+
+/* XXH3_128 */
+
+typedef struct {
+    PyObject_HEAD
+    XXH3_state_t *xxhash_state;    /* points into the object */
+    XXH64_hash_t seed;
+    PyObject *secret;              /* bytes, or NULL if seeded */
+    XXHASH_LOCK_FIELD
+    XXHASH_STATE_STORAGE(XXH3_state_t)
+} PYXXH3_128Object;
+
+static void PYXXH3_128_dealloc(PYXXH3_128Object *self)
+{
+    XXHASH_LOCK_FINI(self);
+    Py_CLEAR(self->secret);
+    _hasher_free((PyObject *)self, XXHASH_ALGO_XXH3_128);
+}
+
+XXHASH_DO_UPDATE(XXH3_128, XXH3_128bits_update)
+XXHASH3_RESET_STATE(XXH3_128, XXH3_128bits_reset_withSeed, XXH3_128bits_reset_withSecret)
+
+static PyObject *
+PYXXH3_128_vectorcall(PyObject *type, PyObject *const *args,
+                      size_t nargsf, PyObject *kwnames)
+{
+    Py_ssize_t nargs = PyVectorcall_NARGS(nargsf);
+    XXH64_hash_t seed = 0;
+    Py_buffer buf;
+    unsigned long long raw_seed;
+    PyObject *secret_obj, *secret;
+    int error;
+
+    if (_parse_fastcall_args(args, nargs, kwnames, "xxhash.xxh3_128", 0,
+                             &buf, &raw_seed, NULL, &secret_obj) < 0)
+        return NULL;
+    seed = (XXH64_hash_t)raw_seed;
+    secret = _get_secret_bytes(secret_obj, raw_seed, "xxhash.xxh3_128", &error);
+    if (error < 0) {
+        PyBuffer_Release(&buf);
+        return NULL;
+    }
+
+    PYXXH3_128Object *self = (PYXXH3_128Object *)
+        _hasher_alloc((PyTypeObject *)type, XXHASH_ALGO_XXH3_128);
+    if (self == NULL) {
+        PyBuffer_Release(&buf);
+        Py_XDECREF(secret);
+        return NULL;
+    }
+
+    XXHASH_LOCK_INIT(self);
+
+    self->xxhash_state = XXHASH_STATE_PTR(self, XXH3_state_t);
+    XXH3_INITSTATE(self->xxhash_state);
+    self->seed = seed;
+    self->secret = secret;
+    PYXXH3_128_reset_state(self);
+
+    if (buf.obj) {
+        /* Constructor: no concurrent access possible, skip locking. */
+        if (buf.len > XXHASH_GIL_MINSIZE) {
+            Py_BEGIN_ALLOW_THREADS
+            XXH3_128bits_update(self->xxhash_state, buf.buf, buf.len);
+            Py_END_ALLOW_THREADS
+        } else {
+            XXH3_128bits_update(self->xxhash_state, buf.buf, buf.len);
+        }
+        PyBuffer_Release(&buf);
+    }
+    return (PyObject *)self;
+}
+static PyObject *PYXXH3_128_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    PYXXH3_128Object *self;
+
+    if ((self = (PYXXH3_128Object *)_hasher_alloc(type, XXHASH_ALGO_XXH3_128)) == NULL) {
+        return NULL;
+    }
+
+    XXHASH_LOCK_INIT(self);
+
+    self->xxhash_state = XXHASH_STATE_PTR(self, XXH3_state_t);
+    XXH3_INITSTATE(self->xxhash_state);
+
+    self->seed = 0;
+    self->secret = NULL;
+    XXH3_128bits_reset_withSeed(self->xxhash_state, 0);
+
+    return (PyObject *)self;
+}
+
+XXHASH3_INIT(XXH3_128, "xxhash.xxh3_128", XXH3_128bits_update)
+
+PyDoc_STRVAR(
+    PYXXH3_128_update_doc,
+    "update (data)\n\n"
+    "Update the xxh3_128 object with bytes-like data. Repeated calls are\n"
+    "equivalent to a single call with the concatenation of all the arguments.");
+
+static PyObject *PYXXH3_128_update(PYXXH3_128Object *self, PyObject *const *args,
+                                 Py_ssize_t nargs, PyObject *kwnames)
+{
+    PyObject *arg = NULL;
+
+    /* validate keywords first */
+    if (kwnames) {
+        Py_ssize_t nkw = PyTuple_GET_SIZE(kwnames);
+        for (Py_ssize_t i = 0; i < nkw; i++) {
+            PyObject *key = PyTuple_GET_ITEM(kwnames, i);
+            if (PyUnicode_CompareWithASCIIString(key, "data") == 0) {
+                if (nargs >= 1) {
+                    PyErr_SetString(PyExc_TypeError,
+                        "xxh3_128.update() got multiple values for argument 'data'");
+                    return NULL;
+                }
+                arg = args[nargs + i];
+            } else {
+                PyErr_Format(PyExc_TypeError,
+                    "'%U' is an invalid keyword argument for 'xxh3_128.update()'",
+                    key);
+                return NULL;
+            }
+        }
+    }
+
+    if (nargs >= 1) {
+        if (nargs > 1) {
+            PyErr_Format(PyExc_TypeError,
+                "xxh3_128.update() takes at most 1 positional argument (%zd given)", nargs);
+            return NULL;
+        }
+        arg = args[0];
+    }
+
+    if (!arg) {
+        PyErr_SetString(PyExc_TypeError, "xxh3_128.update() missing required argument 'data'");
+        return NULL;
+    }
+
+    Py_buffer buf;
+    if (_get_buffer_or_str(arg, &buf) < 0)
+        return NULL;
+    PYXXH3_128_do_update(self, &buf);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+    PYXXH3_128_digest_doc,
+    "digest() -> bytes\n\n"
+    "Return the digest of the data passed to the update() method so\n"
+    "far. This is a 16-byte value which may contain non-ASCII characters,\n"
+    "including null bytes.");
+
+static PyObject *PYXXH3_128_digest(PYXXH3_128Object *self)
+{
+    XXH128_hash_t intdigest;
+
+    XXHASH_LOCK_ACQUIRE(self);
+    intdigest = XXH3_128bits_digest(self->xxhash_state);
+    XXHASH_LOCK_RELEASE(self);
+
+    PyObject *ret = PyBytes_FromStringAndSize(NULL, XXH128_DIGESTSIZE);
+    if (ret == NULL) return NULL;
+    XXH128_canonicalFromHash((XXH128_canonical_t *)PyBytes_AS_STRING(ret), intdigest);
+    return ret;
+}
+
+PyDoc_STRVAR(
+    PYXXH3_128_hexdigest_doc,
+    "hexdigest() -> string\n\n"
+    "Like digest(), but returns the digest as a string of hexadecimal digits.");
+
+static PyObject *PYXXH3_128_hexdigest(PYXXH3_128Object *self)
+{
+    XXH128_hash_t intdigest;
+    char digest[XXH128_DIGESTSIZE];
+
+    XXHASH_LOCK_ACQUIRE(self);
+    intdigest = XXH3_128bits_digest(self->xxhash_state);
+    XXHASH_LOCK_RELEASE(self);
+    XXH128_canonicalFromHash((XXH128_canonical_t *)digest, intdigest);
+
+    PyObject *ret = PyUnicode_New(XXH128_DIGESTSIZE * 2, 127);
+    if (ret == NULL) return NULL;
+    Py_UCS1 *b = PyUnicode_1BYTE_DATA(ret);
+    for (Py_ssize_t i = 0, j = 0; i < XXH128_DIGESTSIZE; i++) {
+        unsigned char c;
+        c = (digest[i] >> 4) & 0xf;
+        c = (c > 9) ? c + 'a' - 10 : c + '0';
+        b[j++] = c;
+        c = (digest[i] & 0xf);
+        c = (c > 9) ? c + 'a' - 10 : c + '0';
+        b[j++] = c;
+    }
+    return ret;
+}
+
+PyDoc_STRVAR(
+    PYXXH3_128_intdigest_doc,
+    "intdigest() -> int\n\n"
+    "Like digest(), but returns the digest as an integer, which is the integer\n"
+    "returned by the xxHash C API.");
+
+static PyObject *PYXXH3_128_intdigest(PYXXH3_128Object *self)
+{
+    XXH128_hash_t intdigest;
+
+    XXHASH_LOCK_ACQUIRE(self);
+    intdigest = XXH3_128bits_digest(self->xxhash_state);
+    XXHASH_LOCK_RELEASE(self);
+
+    return _xxh128_to_pylong(intdigest);
+}
+
+PyDoc_STRVAR(
+    PYXXH3_128_copy_doc,
+    "copy() -> xxh3_128 object\n\n"
+    "Return a copy of the xxh3_128 object.");
+
+static PyObject *PYXXH3_128_copy(PYXXH3_128Object *self)
+{
+    PYXXH3_128Object *p;
+
+    if ((p = (PYXXH3_128Object *)_hasher_alloc(Py_TYPE(self), XXHASH_ALGO_XXH3_128)) == NULL) {
+        return NULL;
+    }
+
+    XXHASH_LOCK_INIT(p);
+
+    p->xxhash_state = XXHASH_STATE_PTR(p, XXH3_state_t);
+    XXH3_INITSTATE(p->xxhash_state);
+
+    XXHASH_LOCK_ACQUIRE(self);
+    p->seed = self->seed;
+    p->secret = self->secret;
+    Py_XINCREF(p->secret);
+    XXH3_copyState(p->xxhash_state, self->xxhash_state);
+#if XXH_VERSION_NUMBER < 704
+    // v0.7.3 and earlier have a bug where states reset with a seed
+    // will have a wild pointer to the original state when copied,
+    // causing a use-after-free if the original is freed.
+    if (p->xxhash_state->secret == &self->xxhash_state->customSecret[0])
+        p->xxhash_state->secret = &p->xxhash_state->customSecret[0];
+#endif
+    XXHASH_LOCK_RELEASE(self);
+
+    return (PyObject *)p;
+}
+
+PyDoc_STRVAR(
+    PYXXH3_128_reset_doc,
+    "reset()\n\n"
+    "Reset state.");
+
+static PyObject *PYXXH3_128_reset(PYXXH3_128Object *self)
+{
+    XXHASH_LOCK_ACQUIRE(self);
+    PYXXH3_128_reset_state(self);
+    XXHASH_LOCK_RELEASE(self);
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef PYXXH3_128_methods[] = {
+    {"update", (PyCFunction)PYXXH3_128_update, METH_FASTCALL | METH_KEYWORDS, PYXXH3_128_update_doc},
+    {"digest", (PyCFunction)PYXXH3_128_digest, METH_NOARGS, PYXXH3_128_digest_doc},
+    {"hexdigest", (PyCFunction)PYXXH3_128_hexdigest, METH_NOARGS, PYXXH3_128_hexdigest_doc},
+    {"intdigest", (PyCFunction)PYXXH3_128_intdigest, METH_NOARGS, PYXXH3_128_intdigest_doc},
+    {"copy", (PyCFunction)PYXXH3_128_copy, METH_NOARGS, PYXXH3_128_copy_doc},
+    {"reset", (PyCFunction)PYXXH3_128_reset, METH_NOARGS, PYXXH3_128_reset_doc},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyObject *PYXXH3_128_get_block_size(PYXXH3_128Object *self, void *closure)
+{
+    return PyLong_FromLong(XXH128_BLOCKSIZE);
+}
+
+static PyObject *
+PYXXH3_128_get_digest_size(PYXXH3_128Object *self, void *closure)
+{
+    return PyLong_FromLong(XXH128_DIGESTSIZE);
+}
+
+static PyObject *
+PYXXH3_128_get_name(PYXXH3_128Object *self, void *closure)
+{
+    return PyUnicode_FromString("XXH3_128");
+}
+
+static PyObject *
+PYXXH3_128_get_seed(PYXXH3_128Object *self, void *closure)
+{
+    return PyLong_FromUnsignedLongLong(self->seed);
+}
+
+static PyGetSetDef PYXXH3_128_getseters[] = {
+    {
+        "digest_size",
+        (getter)PYXXH3_128_get_digest_size, NULL,
+        "Digest size.",
+        NULL
+    },
+    {
+        "block_size",
+        (getter)PYXXH3_128_get_block_size, NULL,
+        "Block size.",
+        NULL
+    },
+    {
+        "name",
+        (getter)PYXXH3_128_get_name, NULL,
+        "Name. Always XXH3_128.",
+        NULL
+    },
+    {
+        "digestsize",
+        (getter)PYXXH3_128_get_digest_size, NULL,
+        "Digest size.",
+        NULL
+    },
+    {
+        "seed",
+        (getter)PYXXH3_128_get_seed, NULL,
+        "Seed.",
+        NULL
+    },
+    {NULL}  /* Sentinel */
+};
+
+PyDoc_STRVAR(
+    PYXXH3_128Type_doc,
+    "An xxh3_128 represents the object used to calculate the XXH3_128 hash of a\n"
+    "bytes-like object.\n"
+    "\n"
+    "Methods:\n"
+    "\n"
+    "update(data) -- updates the current hash state with additional data\n"
+    "digest() -- return the current digest value\n"
+    "hexdigest() -- return the current digest as a string of hexadecimal digits\n"
+    "intdigest() -- return the current digest as an integer\n"
+    "copy() -- return a copy of the current xxh3_128 object");
+
+static PyType_Slot XXH3_128Type_slots[] = {
+    {Py_tp_dealloc, PYXXH3_128_dealloc},
+    {Py_tp_doc, (void *)PYXXH3_128Type_doc},
+    {Py_tp_methods, PYXXH3_128_methods},
+    {Py_tp_getset, PYXXH3_128_getseters},
+    {Py_tp_init, PYXXH3_128_init},
+    {Py_tp_new, PYXXH3_128_new},
+    {0, NULL},
+};
+
+static PyType_Spec XXH3_128Type_spec = {
+    .name = "xxhash.xxh3_128",
+    .basicsize = sizeof(PYXXH3_128Object),
+    .flags = Py_TPFLAGS_DEFAULT
+#if PY_VERSION_HEX >= 0x030c0000
+           | Py_TPFLAGS_IMMUTABLETYPE
+#endif
+    ,
+    .slots = XXH3_128Type_slots,
+};
+
+/*****************************************************************************
+ * File Functions *************************************************************
+ ****************************************************************************/
+
+/* Default read size for streaming a file, and the size of each mmap()
+ * window when mmap mode is on. */
+#define XXHASH_FILE_BUFSIZE  (1 << 20)
+#define XXHASH_FILE_MAXBUFSIZE  (1 << 30)
+#define XXHASH_MMAP_WINDOW   ((size_t)1 << 26)
+
+/* Resolve algorithm, either one of the names in algorithms_available or
+ * one of the hash types. Returns 0 on success, -1 on error with exception
+ * set. */
+static int
+_parse_algorithm(PyObject *module, PyObject *obj, const char *funcname,
+                 xxhash_algo *algo)
+{
+    static const struct {
+        const char *name;
+        xxhash_algo algo;
+    } names[] = {
+        {"xxh32", XXHASH_ALGO_XXH32},
+        {"xxh64", XXHASH_ALGO_XXH64},
+        {"xxh3_64", XXHASH_ALGO_XXH3_64},
+        {"xxh3_128", XXHASH_ALGO_XXH3_128},
+        {"xxh128", XXHASH_ALGO_XXH3_128},
+    };
+    xxhash_state *state = _get_state(module);
+
+    if (PyUnicode_Check(obj)) {
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+            if (PyUnicode_CompareWithASCIIString(obj, names[i].name) == 0) {
+                *algo = names[i].algo;
+                return 0;
+            }
+        }
+        PyErr_Format(PyExc_ValueError,
+            "%s() unsupported algorithm %R", funcname, obj);
+        return -1;
+    }
+    for (int i = 0; i < XXHASH_NUM_ALGOS; i++) {
+        if (obj == state->types[i]) {
+            *algo = (xxhash_algo)i;
+            return 0;
+        }
+    }
+    PyErr_Format(PyExc_TypeError,
+        "%s() algorithm must be a name such as 'xxh3_64' or an xxhash type, "
+        "not '%.200s'", funcname, Py_TYPE(obj)->tp_name);
+    return -1;
+}
+
+/* Return the XXH*_state_t of a hash object of algorithm algo. */
+static void *
+_object_state(xxhash_algo algo, PyObject *obj)
+{
+    switch (algo) {
+    case XXHASH_ALGO_XXH32:
+        return ((PYXXH32Object *)obj)->xxhash_state;
+    case XXHASH_ALGO_XXH64:
+        return ((PYXXH64Object *)obj)->xxhash_state;
+    case XXHASH_ALGO_XXH3_64:
+        return ((PYXXH3_64Object *)obj)->xxhash_state;
+    case XXHASH_ALGO_XXH3_128:
+    default:
+        return ((PYXXH3_128Object *)obj)->xxhash_state;
+    }
+}
+
+/* Feed len bytes to state, an XXH*_state_t of algorithm algo. */
+static inline void
+_state_update(xxhash_algo algo, void *state, const void *p, size_t len)
+{
+    switch (algo) {
+    case XXHASH_ALGO_XXH32:
+        XXH32_update(state, p, len);
+        break;
+    case XXHASH_ALGO_XXH64:
+        XXH64_update(state, p, len);
+        break;
+    case XXHASH_ALGO_XXH3_64:
+        XXH3_64bits_update(state, p, len);
+        break;
+    case XXHASH_ALGO_XXH3_128:
+        XXH3_128bits_update(state, p, len);
+        break;
+    }
+}
+
+/* Create a standalone XXH*_state_t of algorithm algo, for native code
+ * that hashes without a hash object. Returns NULL if out of memory. */
+static void *
+_state_create(xxhash_algo algo)
+{
+    switch (algo) {
+    case XXHASH_ALGO_XXH32:
+        return XXH32_createState();
+    case XXHASH_ALGO_XXH64:
+        return XXH64_createState();
+    case XXHASH_ALGO_XXH3_64:
+    case XXHASH_ALGO_XXH3_128:
+    default:
+        return XXH3_createState();
+    }
+}
+
+static void
+_state_free(xxhash_algo algo, void *state)
+{
+    switch (algo) {
+    case XXHASH_ALGO_XXH32:
+        XXH32_freeState(state);
+        break;
+    case XXHASH_ALGO_XXH64:
+        XXH64_freeState(state);
+        break;
+    case XXHASH_ALGO_XXH3_64:
+    case XXHASH_ALGO_XXH3_128:
+        XXH3_freeState(state);
+        break;
+    }
+}
+
+static void
+_state_reset(xxhash_algo algo, void *state, XXH64_hash_t seed)
+{
+    switch (algo) {
+    case XXHASH_ALGO_XXH32:
+        XXH32_reset(state, (XXH32_hash_t)seed);
+        break;
+    case XXHASH_ALGO_XXH64:
+        XXH64_reset(state, seed);
+        break;
+    case XXHASH_ALGO_XXH3_64:
+        XXH3_64bits_reset_withSeed(state, seed);
+        break;
+    case XXHASH_ALGO_XXH3_128:
+        XXH3_128bits_reset_withSeed(state, seed);
+        break;
+    }
+}
+
+/* Store the native digest of state at out, in the layout the batch
+ * functions use. */
+static void
+_state_digest(xxhash_algo algo, void *state, unsigned char *out)
+{
+    switch (algo) {
+    case XXHASH_ALGO_XXH32: {
+        XXH32_hash_t h = XXH32_digest(state);
+        memcpy(out, &h, sizeof(h));
+        break;
+    }
+    case XXHASH_ALGO_XXH64: {
+        XXH64_hash_t h = XXH64_digest(state);
+        memcpy(out, &h, sizeof(h));
+        break;
+    }
+    case XXHASH_ALGO_XXH3_64: {
+        XXH64_hash_t h = XXH3_64bits_digest(state);
+        memcpy(out, &h, sizeof(h));
+        break;
+    }
+    case XXHASH_ALGO_XXH3_128: {
+        XXH128_hash_t h = XXH3_128bits_digest(state);
+        memcpy(out, &h, sizeof(h));
+        break;
+    }
+    }
+}
+
+#ifdef MS_WINDOWS
+#  define XXHASH_READ(fd, buf, len)  _read((fd), (buf), (unsigned int)(len))
+#else
+#  define XXHASH_READ(fd, buf, len)  read((fd), (buf), (len))
+#endif
+
+/* Store the size of the regular file fd. Returns 0 on success, an errno
+ * value if fstat() fails, or -1 if fd is not a regular file. */
+static int
+_file_size(int fd, int64_t *size)
+{
+#ifdef MS_WINDOWS
+    struct _stat64 st;
+    if (_fstat64(fd, &st) < 0)
+        return errno;
+#else
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+        return errno;
+#endif
+    if (!S_ISREG(st.st_mode))
+        return -1;
+    *size = (int64_t)st.st_size;
+    return 0;
+}
+
+#ifdef HAVE_SYS_MMAN_H
+/* Reading a mapped page beyond the end of a file that shrank after it was
+ * mapped raises SIGBUS. Mapped data is hashed with a recovery point set
+ * for the thread, which a SIGBUS handler jumps back to; the handler is
+ * installed on first use and passes other SIGBUS signals on to the
+ * handler it replaced. */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L \
+    && !defined(__STDC_NO_THREADS__)
+static _Thread_local sigjmp_buf *xxhash_sigbus_jmp;
+#else
+static __thread sigjmp_buf *xxhash_sigbus_jmp;
+#endif
+static struct sigaction xxhash_sigbus_prev;
+static pthread_once_t xxhash_sigbus_once = PTHREAD_ONCE_INIT;
+
+static void
+_sigbus_handler(int sig, siginfo_t *info, void *context)
+{
+    sigjmp_buf *jmp = xxhash_sigbus_jmp;
+    if (jmp != NULL)
+        siglongjmp(*jmp, 1);
+    if (xxhash_sigbus_prev.sa_flags & SA_SIGINFO) {
+        xxhash_sigbus_prev.sa_sigaction(sig, info, context);
+    } else if (xxhash_sigbus_prev.sa_handler != SIG_DFL
+               && xxhash_sigbus_prev.sa_handler != SIG_IGN) {
+        xxhash_sigbus_prev.sa_handler(sig);
+    } else {
+        /* The faulting access runs again and gets the default action. */
+        sigaction(SIGBUS, &xxhash_sigbus_prev, NULL);
+    }
+}
+
+static void
+_sigbus_install(void)
+{
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = _sigbus_handler;
+    sa.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGBUS, &sa, &xxhash_sigbus_prev);
+}
+
+/* Bytes hashed between saves of the state while hashing mapped data. */
+#define XXHASH_MMAP_CHUNK  ((size_t)1 << 20)
+
+/* Hash the len mapped bytes at p into state, saving the state into saved
+ * (room for any algorithm's state) before each chunk. If a page of the
+ * file is gone, the state is restored to before the chunk that faulted.
+ * Returns the number of bytes hashed. */
+static size_t
+_mmap_hash(xxhash_algo algo, void *state, unsigned char *saved,
+           const unsigned char *p, size_t len)
+{
+    size_t statesize = algo == XXHASH_ALGO_XXH32 ? sizeof(XXH32_state_t)
+                     : algo == XXHASH_ALGO_XXH64 ? sizeof(XXH64_state_t)
+                     : sizeof(XXH3_state_t);
+    volatile size_t done = 0;
+    sigjmp_buf jmp;
+
+    pthread_once(&xxhash_sigbus_once, _sigbus_install);
+    if (sigsetjmp(jmp, 1)) {
+        xxhash_sigbus_jmp = NULL;
+        memcpy(state, saved, statesize);
+        return done;
+    }
+    xxhash_sigbus_jmp = &jmp;
+    while (done < len) {
+        size_t n = len - done < XXHASH_MMAP_CHUNK ? len - done
+                                                  : XXHASH_MMAP_CHUNK;
+        memcpy(saved, state, statesize);
+        _state_update(algo, state, p + done, n);
+        done += n;
+    }
+    xxhash_sigbus_jmp = NULL;
+    return done;
+}
+
+/* Hash [off, off + len) of fd through read-only mmap() windows advised
+ * MADV_SEQUENTIAL. Returns the number of bytes hashed, which is short if
+ * mmap() fails or the file shrinks; the caller reads the rest. */
+static int64_t
+_mmap_update(int fd, xxhash_algo algo, void *state, int64_t off, int64_t len)
+{
+    int64_t pagesize = (int64_t)sysconf(_SC_PAGESIZE);
+    int64_t pos = off, end = off + len;
+    XXH3_state_t saved;
+
+    while (pos < end) {
+        int64_t start = pos - pos % pagesize;
+        size_t maplen = end - start > (int64_t)XXHASH_MMAP_WINDOW
+                        ? XXHASH_MMAP_WINDOW : (size_t)(end - start);
+        unsigned char *p = mmap(NULL, maplen, PROT_READ, MAP_SHARED, fd,
+                                (off_t)start);
+        if (p == MAP_FAILED)
+            break;
+#ifdef MADV_SEQUENTIAL
+        madvise(p, maplen, MADV_SEQUENTIAL);
+#endif
+        size_t want = maplen - (size_t)(pos - start);
+        size_t done = _mmap_hash(algo, state, (unsigned char *)&saved,
+                                 p + (pos - start), want);
+        munmap(p, maplen);
+        pos += (int64_t)done;
+        if (done < want)
+            break;
+    }
+    return pos - off;
+}
+
+/* Hash the rest of the regular file fd through mmap() and leave the file
+ * offset at the end of what was hashed. Does nothing for other kinds of
+ * files: the read loop takes over from the current offset. */
+static void
+_fd_update_mmap(int fd, xxhash_algo algo, void *state)
+{
+    int64_t size = 0;
+    off_t pos;
+
+    if (_file_size(fd, &size) != 0)
+        return;
+    if ((pos = lseek(fd, 0, SEEK_CUR)) < 0 || pos >= size)
+        return;
+    pos += (off_t)_mmap_update(fd, algo, state, pos, size - pos);
+    lseek(fd, pos, SEEK_SET);
+}
+#endif
+
+/* Stream fd from its current offset to end of file into state, through
+ * buf, and through mmap() first if use_mmap is set. Runs without the GIL.
+ * Returns 0 at end of file, else an errno value; after EINTR the caller
+ * may check for signals and call again to resume. */
+static int
+_fd_update(int fd, xxhash_algo algo, void *state, unsigned char *buf,
+           size_t bufsize, int use_mmap)
+{
+#ifdef HAVE_SYS_MMAN_H
+    if (use_mmap)
+        _fd_update_mmap(fd, algo, state);
+#endif
+    for (;;) {
+        Py_ssize_t n = XXHASH_READ(fd, buf, bufsize);
+        if (n == 0)
+            return 0;
+        if (n < 0)
+            return errno;
+        _state_update(algo, state, buf, (size_t)n);
+    }
+}
+
+/* Open path (str, bytes or os.PathLike) read-only. Returns the file
+ * descriptor, or -1 on error with exception set. */
+static int
+_open_path(PyObject *path)
+{
+    int fd;
+#ifdef MS_WINDOWS
+    PyObject *decoded;
+    if (!PyUnicode_FSDecoder(path, &decoded))
+        return -1;
+    wchar_t *wpath = PyUnicode_AsWideCharString(decoded, NULL);
+    if (wpath == NULL) {
+        Py_DECREF(decoded);
+        return -1;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    fd = _wopen(wpath, _O_RDONLY | _O_BINARY | _O_NOINHERIT);
+    Py_END_ALLOW_THREADS
+    PyMem_Free(wpath);
+    if (fd < 0)
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, decoded);
+    Py_DECREF(decoded);
+#else
+    PyObject *encoded;
+    int async_err = 0;
+    if (!PyUnicode_FSConverter(path, &encoded))
+        return -1;
+    do {
+        Py_BEGIN_ALLOW_THREADS
+        fd = open(PyBytes_AS_STRING(encoded), O_RDONLY | O_CLOEXEC);
+        Py_END_ALLOW_THREADS
+    } while (fd < 0 && errno == EINTR && !(async_err = PyErr_CheckSignals()));
+    if (fd < 0 && !async_err)
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+    Py_DECREF(encoded);
+#endif
+    return fd;
+}
+
+/* Take a file argument: an open file descriptor (not closed afterwards) or
+ * a path (opened here, *owned set). Returns the file descriptor, or -1 on
+ * error with exception set. */
+static int
+_get_fd(PyObject *file, int *owned)
+{
+    *owned = 0;
+    if (PyBool_Check(file)) {
+        PyErr_SetString(PyExc_TypeError,
+            "file must be a path or a file descriptor, not 'bool'");
+        return -1;
+    }
+    if (PyLong_Check(file))
+        return PyObject_AsFileDescriptor(file);
+    if (!PyUnicode_Check(file) && !PyBytes_Check(file)
+        && !PyObject_HasAttrString(file, "__fspath__")) {
+        PyErr_Format(PyExc_TypeError,
+            "file must be a path or a file descriptor, not '%.200s'",
+            Py_TYPE(file)->tp_name);
+        return -1;
+    }
+    int fd = _open_path(file);
+    *owned = fd >= 0;
+    return fd;
+}
+
+static void
+_close_fd(int fd)
+{
+    Py_BEGIN_ALLOW_THREADS
+#ifdef MS_WINDOWS
+    _close(fd);
+#else
+    close(fd);
+#endif
+    Py_END_ALLOW_THREADS
+}
+
+/* Stream fd into state with the GIL released, checking for signals when
+ * interrupted. Returns 0 on success, -1 on error with exception set. */
+static int
+_fd_hash(int fd, xxhash_algo algo, void *state, size_t bufsize, int use_mmap,
+         PyObject *filename)
+{
+    unsigned char *buf = PyMem_Malloc(bufsize);
+    int err;
+
+    if (buf == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (;;) {
+        Py_BEGIN_ALLOW_THREADS
+        err = _fd_update(fd, algo, state, buf, bufsize, use_mmap);
+        Py_END_ALLOW_THREADS
+        if (err != EINTR)
+            break;
+        if (PyErr_CheckSignals() < 0) {
+            PyMem_Free(buf);
+            return -1;
+        }
+    }
+    PyMem_Free(buf);
+    if (err) {
+        errno = err;
+        if (filename && !PyLong_Check(filename))
+            PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, filename);
+        else
+            PyErr_SetFromErrno(PyExc_OSError);
+        return -1;
+    }
+    return 0;
+}
+
+PyDoc_STRVAR(
+    file_digest_doc,
+    "file_digest(file, algorithm, *, seed=0, mmap=False, buffer_size=1048576)\n"
+    "\n"
+    "Return a hash object of the given algorithm ('xxh32', 'xxh64',\n"
+    "'xxh3_64', 'xxh3_128' or one of the hash types) fed with the contents\n"
+    "of file, a path or an open file descriptor. A file descriptor is read\n"
+    "from its current offset to end of file and is not closed.\n"
+    "\n"
+    "The file is read into one reusable buffer of buffer_size bytes with the\n"
+    "GIL released. If mmap is true, regular files are instead mapped in\n"
+    "large windows advised for sequential access; a file that shrinks\n"
+    "meanwhile is read to its new end.");
+
+static PyObject *
+file_digest(PyObject *self, PyObject *const *args, Py_ssize_t nargs,
+            PyObject *kwnames)
+{
+    static const char *const names[] = {
+        "file", "algorithm", "seed", "mmap", "buffer_size", NULL,
+    };
+    PyObject *argv[5];
+    xxhash_algo algo;
+    Py_ssize_t bufsize = XXHASH_FILE_BUFSIZE;
+    int use_mmap = 0;
+
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, "file_digest", names,
+                               2, 2, argv) < 0)
+        return NULL;
+    if (_parse_algorithm(self, argv[1], "file_digest", &algo) < 0)
+        return NULL;
+    if (argv[3] && (use_mmap = PyObject_IsTrue(argv[3])) < 0)
+        return NULL;
+    if (argv[4]) {
+        if (_as_nonneg_ssize(argv[4], "file_digest", "buffer_size", &bufsize) < 0)
+            return NULL;
+        if (bufsize == 0) {
+            PyErr_SetString(PyExc_ValueError,
+                "file_digest() argument 'buffer_size' must be positive");
+            return NULL;
+        }
+        if (bufsize > XXHASH_FILE_MAXBUFSIZE)
+            bufsize = XXHASH_FILE_MAXBUFSIZE;
+    }
+
+    /* Let the type's constructor validate and store the seed. */
+    PyObject *type = _get_state(self)->types[algo];
+    PyObject *hasher;
+    if (argv[2]) {
+        PyObject *kwargs = Py_BuildValue("{sO}", "seed", argv[2]);
+        if (kwargs == NULL)
+            return NULL;
+        hasher = PyObject_VectorcallDict(type, NULL, 0, kwargs);
+        Py_DECREF(kwargs);
+    } else {
+        hasher = PyObject_CallNoArgs(type);
+    }
+    if (hasher == NULL)
+        return NULL;
+
+    int owned;
+    int fd = _get_fd(argv[0], &owned);
+    if (fd < 0) {
+        Py_DECREF(hasher);
+        return NULL;
+    }
+    /* hasher is not shared yet, so its state needs no locking. */
+    int rc = _fd_hash(fd, algo, _object_state(algo, hasher), (size_t)bufsize,
+                      use_mmap, argv[0]);
+    if (owned)
+        _close_fd(fd);
+    if (rc < 0) {
+        Py_DECREF(hasher);
+        return NULL;
+    }
+    return hasher;
+}
+
+#ifdef MS_WINDOWS
+#  define XXHASH_WRITE(fd, buf, len)  _write((fd), (buf), (unsigned int)(len))
+#else
+#  define XXHASH_WRITE(fd, buf, len)  write((fd), (buf), (len))
+#endif
+
+/* One copy_and_hash() transfer. Bytes are read from src into buf, hashed,
+ * then written to dst; pending and written track a buffer that was not
+ * fully written when a call was interrupted, so the copy can resume. */
+typedef struct {
+    int src;
+    int dst;
+    xxhash_algo algo;
+    void *state;
+    unsigned char *buf;
+    size_t bufsize;
+    size_t pending;
+    size_t written;
+    int64_t left;       /* bytes still to read, or -1 to read to end of file */
+    int64_t copied;
+} xxhash_copy;
+
+/* Run c until done. Returns 0, -1 if src ends before c->left bytes were
+ * read, or an errno value (EINTR can be resumed, EIO if dst accepts no
+ * bytes). Runs without the GIL. */
+static int
+_copy_run(xxhash_copy *c)
+{
+    for (;;) {
+        while (c->written < c->pending) {
+            size_t want = c->pending - c->written;
+#ifdef MS_WINDOWS
+            if (want > 0x40000000)
+                want = 0x40000000;
+#endif
+            Py_ssize_t n = XXHASH_WRITE(c->dst, c->buf + c->written, want);
+            if (n < 0)
+                return errno;
+            /* dst taking no bytes would make this loop forever. */
+            if (n == 0)
+                return EIO;
+            c->written += (size_t)n;
+            c->copied += n;
+        }
+        c->pending = c->written = 0;
+        if (c->left == 0)
+            return 0;
+        size_t want = c->bufsize;
+        if (c->left > 0 && c->left < (int64_t)want)
+            want = (size_t)c->left;
+        Py_ssize_t n = XXHASH_READ(c->src, c->buf, want);
+        if (n < 0)
+            return errno;
+        if (n == 0)
+            return c->left > 0 ? -1 : 0;
+        _state_update(c->algo, c->state, c->buf, (size_t)n);
+        c->pending = (size_t)n;
+        if (c->left > 0)
+            c->left -= n;
+    }
+}
+
+PyDoc_STRVAR(
+    copy_and_hash_doc,
+    "copy_and_hash(src, dst, algorithm, length=None, *, seed=0,\n"
+    "    buffer_size=1048576)\n"
+    "\n"
+    "Copy data from the file descriptor src to dst (integers or objects\n"
+    "with a fileno() method: regular files, pipes or sockets) and return a\n"
+    "hash object of the given algorithm fed with the copied bytes. Copy\n"
+    "length bytes, or until src reaches end of file if length is None;\n"
+    "raise EOFError if src ends early.\n"
+    "\n"
+    "Each chunk is read once into a reusable buffer of buffer_size bytes,\n"
+    "hashed and written out with the GIL released. Both descriptors are\n"
+    "used from their current offsets and are not closed.");
+
+static PyObject *
+copy_and_hash(PyObject *self, PyObject *const *args, Py_ssize_t nargs,
+              PyObject *kwnames)
+{
+    static const char *const names[] = {
+        "src", "dst", "algorithm", "length", "seed", "buffer_size", NULL,
+    };
+    PyObject *argv[6];
+    xxhash_copy c = {.left = -1};
+    Py_ssize_t bufsize = XXHASH_FILE_BUFSIZE;
+
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, "copy_and_hash", names,
+                               4, 3, argv) < 0)
+        return NULL;
+    if ((c.src = PyObject_AsFileDescriptor(argv[0])) < 0)
+        return NULL;
+    if ((c.dst = PyObject_AsFileDescriptor(argv[1])) < 0)
+        return NULL;
+    if (_parse_algorithm(self, argv[2], "copy_and_hash", &c.algo) < 0)
+        return NULL;
+    if (argv[3] && argv[3] != Py_None) {
+        Py_ssize_t length;
+        if (_as_nonneg_ssize(argv[3], "copy_and_hash", "length", &length) < 0)
+            return NULL;
+        c.left = (int64_t)length;
+    }
+    if (argv[5]) {
+        if (_as_nonneg_ssize(argv[5], "copy_and_hash", "buffer_size", &bufsize) < 0)
+            return NULL;
+        if (bufsize == 0) {
+            PyErr_SetString(PyExc_ValueError,
+                "copy_and_hash() argument 'buffer_size' must be positive");
+            return NULL;
+        }
+        if (bufsize > XXHASH_FILE_MAXBUFSIZE)
+            bufsize = XXHASH_FILE_MAXBUFSIZE;
+    }
+    if (c.left >= 0 && c.left < (int64_t)bufsize)
+        bufsize = c.left ? (Py_ssize_t)c.left : 1;
+
+    PyObject *type = _get_state(self)->types[c.algo];
+    PyObject *hasher;
+    if (argv[4]) {
+        PyObject *kwargs = Py_BuildValue("{sO}", "seed", argv[4]);
+        if (kwargs == NULL)
+            return NULL;
+        hasher = PyObject_VectorcallDict(type, NULL, 0, kwargs);
+        Py_DECREF(kwargs);
+    } else {
+        hasher = PyObject_CallNoArgs(type);
+    }
+    if (hasher == NULL)
+        return NULL;
+
+    /* hasher is not shared yet, so its state needs no locking. */
+    c.state = _object_state(c.algo, hasher);
+    c.bufsize = (size_t)bufsize;
+    if ((c.buf = PyMem_Malloc(c.bufsize)) == NULL) {
+        Py_DECREF(hasher);
+        return PyErr_NoMemory();
+    }
+    int err;
+    for (;;) {
+        Py_BEGIN_ALLOW_THREADS
+        err = _copy_run(&c);
+        Py_END_ALLOW_THREADS
+        if (err != EINTR)
+            break;
+        if (PyErr_CheckSignals() < 0)
+            goto error;
+    }
+    if (err == -1) {
+        PyErr_Format(PyExc_EOFError,
+            "copy_and_hash() src ended after %lld of %lld bytes",
+            (long long)c.copied, (long long)(c.copied + c.left));
+        goto error;
+    }
+    if (err) {
+        errno = err;
+        PyErr_SetFromErrno(PyExc_OSError);
+        goto error;
+    }
+    PyMem_Free(c.buf);
+    return hasher;
+
+error:
+    PyMem_Free(c.buf);
+    Py_DECREF(hasher);
+    return NULL;
+}
+
+/* pread() that retries on EINTR. Returns the number of bytes read, 0 at
+ * end of file, or -1 with errno set. */
+static Py_ssize_t
+_pread(int fd, void *buf, size_t len, int64_t off)
+{
+#ifdef MS_WINDOWS
+    HANDLE h = (HANDLE)_get_osfhandle(fd);
+    OVERLAPPED ov = {0};
+    DWORD n;
+    ov.Offset = (DWORD)off;
+    ov.OffsetHigh = (DWORD)(off >> 32);
+    if (len > 0x40000000)
+        len = 0x40000000;
+    if (!ReadFile(h, buf, (DWORD)len, &n, &ov)) {
+        if (GetLastError() == ERROR_HANDLE_EOF)
+            return 0;
+        errno = EIO;
+        return -1;
+    }
+    return (Py_ssize_t)n;
+#else
+    Py_ssize_t n;
+    do {
+        n = pread(fd, buf, len, (off_t)off);
+    } while (n < 0 && errno == EINTR);
+    return n;
+#endif
+}
+
+/* Hash [off, off + len) of fd with pread() through buf. Returns 0, an
+ * errno value, or -1 if the file ends first. */
+static int
+_pread_update(int fd, xxhash_algo algo, void *state, unsigned char *buf,
+              size_t bufsize, int64_t off, int64_t len)
+{
+    while (len > 0) {
+        size_t want = len < (int64_t)bufsize ? (size_t)len : bufsize;
+        Py_ssize_t n = _pread(fd, buf, want, off);
+        if (n < 0)
+            return errno;
+        if (n == 0)
+            return -1;
+        _state_update(algo, state, buf, (size_t)n);
+        off += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* One file_block_digests() job: block i is [offsets[i], offsets[i] +
+ * lengths[i]) if offsets is set, else [i * block_size, (i + 1) *
+ * block_size) clipped to file_size. */
+typedef struct {
+    int fd;
+    xxhash_algo algo;
+    XXH64_hash_t seed;
+    int use_mmap;
+    const int64_t *offsets;
+    const int64_t *lengths;
+    int64_t block_size;
+    int64_t file_size;
+    unsigned char *out;
+    PyThread_type_lock err_lock;
+    int err;                    /* first failure: errno value, -1 on EOF */
+} xxhash_blocks;
+
+static int
+_blocks_failed(xxhash_blocks *job)
+{
+    PyThread_acquire_lock(job->err_lock, WAIT_LOCK);
+    int err = job->err;
+    PyThread_release_lock(job->err_lock);
+    return err;
+}
+
+static void
+_blocks_fail(xxhash_blocks *job, int err)
+{
+    PyThread_acquire_lock(job->err_lock, WAIT_LOCK);
+    if (job->err == 0)
+        job->err = err;
+    PyThread_release_lock(job->err_lock);
+}
+
+/* Task function: hash blocks [start, end), each with a fresh state. */
+static void
+_blocks_task(void *arg, Py_ssize_t start, Py_ssize_t end)
+{
+    xxhash_blocks *job = arg;
+    size_t bufsize = XXHASH_FILE_BUFSIZE;
+    void *state = _state_create(job->algo);
+    unsigned char *buf = PyMem_RawMalloc(bufsize);
+
+    if (state == NULL || buf == NULL) {
+        _blocks_fail(job, ENOMEM);
+        goto done;
+    }
+    for (Py_ssize_t i = start; i < end && !_blocks_failed(job); i++) {
+        int64_t off, len;
+        if (job->offsets) {
+            off = job->offsets[i];
+            len = job->lengths[i];
+        } else {
+            off = i * job->block_size;
+            len = job->file_size - off < job->block_size
+                  ? job->file_size - off : job->block_size;
+        }
+        _state_reset(job->algo, state, job->seed);
+#ifdef HAVE_SYS_MMAN_H
+        if (job->use_mmap) {
+            int64_t done = _mmap_update(job->fd, job->algo, state, off, len);
+            off += done;
+            len -= done;
+        }
+#endif
+        int err = _pread_update(job->fd, job->algo, state, buf, bufsize,
+                                off, len);
+        if (err) {
+            _blocks_fail(job, err);
+            break;
+        }
+        _state_digest(job->algo, state,
+                      job->out + i * xxhash_algo_digestsize[job->algo]);
+    }
+done:
+    if (state)
+        _state_free(job->algo, state);
+    PyMem_RawFree(buf);
+}
+
+/* Parse ranges, a sequence of (offset, length) pairs within file_size, into
+ * two new arrays. Returns the number of ranges, or -1 on error with
+ * exception set. */
+static Py_ssize_t
+_parse_ranges(PyObject *ranges, int64_t file_size, int64_t **offsets,
+              int64_t **lengths)
+{
+    PyObject *seq = PySequence_Fast(ranges,
+        "ranges must be a sequence of (offset, length) pairs");
+    if (seq == NULL)
+        return -1;
+
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    *offsets = PyMem_New(int64_t, n);
+    *lengths = PyMem_New(int64_t, n);
+    if (*offsets == NULL || *lengths == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    for (Py_ssize_t i = 0; i < n; i++) {
+        PyObject *item = PySequence_Fast_GET_ITEM(seq, i);
+        long long off, len;
+        if (!PyTuple_Check(item) || PyTuple_GET_SIZE(item) != 2) {
+            PyErr_Format(PyExc_TypeError,
+                "ranges[%zd] must be an (offset, length) tuple", i);
+            goto error;
+        }
+        off = PyLong_AsLongLong(PyTuple_GET_ITEM(item, 0));
+        if (off == -1 && PyErr_Occurred())
+            goto error;
+        len = PyLong_AsLongLong(PyTuple_GET_ITEM(item, 1));
+        if (len == -1 && PyErr_Occurred())
+            goto error;
+        if (off < 0 || len < 0 || off > file_size || len > file_size - off) {
+            PyErr_Format(PyExc_ValueError,
+                "ranges[%zd] (%lld, %lld) is out of range for a file of "
+                "%lld bytes", i, off, len, (long long)file_size);
+            goto error;
+        }
+        (*offsets)[i] = off;
+        (*lengths)[i] = len;
+    }
+    Py_DECREF(seq);
+    return n;
+
+error:
+    PyMem_Free(*offsets);
+    PyMem_Free(*lengths);
+    *offsets = *lengths = NULL;
+    Py_DECREF(seq);
+    return -1;
+}
+
+PyDoc_STRVAR(
+    file_block_digests_doc,
+    "file_block_digests(file, algorithm, block_size=None, *, ranges=None,\n"
+    "    seed=0, mmap=False, out=None, nthreads=None) -> list of int\n"
+    "\n"
+    "Return the integer digest of each block of a regular file, given by\n"
+    "path or file descriptor. Blocks are either consecutive block_size\n"
+    "bytes (the last one may be shorter) or the given ranges, a sequence\n"
+    "of (offset, length) pairs. Blocks are read with pread(), or through\n"
+    "mmap() if mmap is true, and hashed on up to nthreads threads (default:\n"
+    "get_default_nthreads()) with the GIL released.\n"
+    "\n"
+    "If out is given, the digests are written into that writable buffer\n"
+    "as native-endian unsigned integers (pairs of uint64 (low, high) for\n"
+    "XXH3_128) instead, and out is returned.");
+
+static PyObject *
+file_block_digests(PyObject *self, PyObject *const *args, Py_ssize_t nargs,
+                   PyObject *kwnames)
+{
+    static const char *const funcname = "file_block_digests";
+    static const char *const names[] = {
+        "file", "algorithm", "block_size", "ranges", "seed", "mmap", "out",
+        "nthreads", NULL,
+    };
+    PyObject *argv[8];
+    xxhash_algo algo;
+    Py_ssize_t block_size = 0;
+    XXH64_hash_t seed = 0;
+    int use_mmap = 0, nthreads;
+
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, funcname, names,
+                               3, 2, argv) < 0)
+        return NULL;
+    if (_parse_algorithm(self, argv[1], funcname, &algo) < 0)
+        return NULL;
+    if (argv[2] == Py_None)
+        argv[2] = NULL;
+    if (argv[3] == Py_None)
+        argv[3] = NULL;
+    if ((argv[2] == NULL) == (argv[3] == NULL)) {
+        PyErr_SetString(PyExc_TypeError,
+            "file_block_digests() requires exactly one of block_size and "
+            "ranges");
+        return NULL;
+    }
+    if (argv[2]) {
+        if (_as_nonneg_ssize(argv[2], funcname, "block_size", &block_size) < 0)
+            return NULL;
+        if (block_size == 0) {
+            PyErr_SetString(PyExc_ValueError,
+                "file_block_digests() argument 'block_size' must be positive");
+            return NULL;
+        }
+    }
+    if (argv[4]) {
+        seed = (XXH64_hash_t)PyLong_AsUnsignedLongLongMask(argv[4]);
+        if (PyErr_Occurred())
+            return NULL;
+    }
+    if (argv[5] && (use_mmap = PyObject_IsTrue(argv[5])) < 0)
+        return NULL;
+    if (argv[6] == Py_None)
+        argv[6] = NULL;
+    if (_parse_nthreads(self, argv[7], funcname, &nthreads) < 0)
+        return NULL;
+
+    int owned;
+    int fd = _get_fd(argv[0], &owned);
+    if (fd < 0)
+        return NULL;
+
+    xxhash_blocks job = {
+        .fd = fd, .algo = algo, .seed = seed, .use_mmap = use_mmap,
+        .block_size = block_size,
+    };
+    int64_t *offsets = NULL, *lengths = NULL;
+    Py_buffer outview = {0};
+    unsigned char *out = NULL;
+    PyObject *result = NULL;
+    Py_ssize_t n;
+
+    int err = _file_size(fd, &job.file_size);
+    if (err) {
+        if (err < 0)
+            PyErr_SetString(PyExc_ValueError,
+                "file_block_digests() requires a regular file");
+        else {
+            errno = err;
+            if (!PyLong_Check(argv[0]))
+                PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, argv[0]);
+            else
+                PyErr_SetFromErrno(PyExc_OSError);
+        }
+        goto done;
+    }
+    if (argv[3]) {
+        if ((n = _parse_ranges(argv[3], job.file_size, &offsets, &lengths)) < 0)
+            goto done;
+        job.offsets = offsets;
+        job.lengths = lengths;
+    } else {
+        n = (Py_ssize_t)((job.file_size + block_size - 1) / block_size);
+    }
+    if (_batch_out_init(argv[6], n * xxhash_algo_digestsize[algo], &outview,
+                        &out, funcname) < 0) {
+        out = NULL;
+        goto done;
+    }
+    job.out = out;
+    if ((job.err_lock = PyThread_allocate_lock()) == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+
+    _parallel_for(self, nthreads, _blocks_task, &job, n);
+
+    if (job.err == ENOMEM)
+        PyErr_NoMemory();
+    else if (job.err < 0)
+        PyErr_SetString(PyExc_OSError,
+            "file_block_digests() file ended before the last block");
+    else if (job.err) {
+        errno = job.err;
+        if (!PyLong_Check(argv[0]))
+            PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, argv[0]);
+        else
+            PyErr_SetFromErrno(PyExc_OSError);
+    }
+    else
+        result = _batch_result(argv[6], algo, out, n, 1);
+
+done:
+    if (job.err_lock)
+        PyThread_free_lock(job.err_lock);
+    if (out)
+        _batch_out_release(&outview, out);
+    PyMem_Free(offsets);
+    PyMem_Free(lengths);
+    if (owned)
+        _close_fd(fd);
+    return result;
+}
+
+/* Native paths: wide characters on Windows, bytes elsewhere. */
+#ifdef MS_WINDOWS
+typedef wchar_t xxhash_pchar;
+#  define XXHASH_SEP      L'\\'
+#  define XXHASH_PSTRLEN  wcslen
+#  define XXHASH_PSTRCMP  wcscmp
+#else
+typedef char xxhash_pchar;
+#  define XXHASH_SEP      '/'
+#  define XXHASH_PSTRLEN  strlen
+#  define XXHASH_PSTRCMP  strcmp
+#endif
+
+/* Return a PyMem-allocated native copy of the path obj (str, bytes or
+ * os.PathLike), or NULL with exception set. */
+static xxhash_pchar *
+_native_path(PyObject *obj, size_t *len)
+{
+#ifdef MS_WINDOWS
+    PyObject *decoded;
+    if (!PyUnicode_FSDecoder(obj, &decoded))
+        return NULL;
+    Py_ssize_t size;
+    wchar_t *path = PyUnicode_AsWideCharString(decoded, &size);
+    Py_DECREF(decoded);
+    if (path)
+        *len = (size_t)size;
+    return path;
+#else
+    PyObject *encoded;
+    if (!PyUnicode_FSConverter(obj, &encoded))
+        return NULL;
+    size_t size = (size_t)PyBytes_GET_SIZE(encoded);
+    char *path = PyMem_Malloc(size + 1);
+    if (path == NULL)
+        PyErr_NoMemory();
+    else {
+        memcpy(path, PyBytes_AS_STRING(encoded), size + 1);
+        *len = size;
+    }
+    Py_DECREF(encoded);
+    return path;
+#endif
+}
+
+static PyObject *
+_path_to_object(const xxhash_pchar *path)
+{
+#ifdef MS_WINDOWS
+    return PyUnicode_FromWideChar(path, -1);
+#else
+    return PyUnicode_DecodeFSDefault(path);
+#endif
+}
+
+/* Like _path_to_object(), but return the file system encoding of path as
+ * bytes, as os functions do for bytes arguments. */
+static PyObject *
+_path_to_bytes(const xxhash_pchar *path)
+{
+#ifdef MS_WINDOWS
+    PyObject *decoded = PyUnicode_FromWideChar(path, -1);
+    if (decoded == NULL)
+        return NULL;
+    PyObject *encoded = PyUnicode_EncodeFSDefault(decoded);
+    Py_DECREF(decoded);
+    return encoded;
+#else
+    return PyBytes_FromString(path);
+#endif
+}
+
+/* A growable list of NUL-terminated native paths kept in one arena, each
+ * with a small tag: an xxhash_algo for files to hash, an entry kind while
+ * walking a directory. */
+typedef struct {
+    xxhash_pchar *arena;
+    size_t arena_len;
+    size_t arena_cap;
+    size_t *offsets;
+    unsigned char *tags;
+    Py_ssize_t n;
+    Py_ssize_t cap;
+} xxhash_paths;
+
+/* Append path (len characters) and tag. Returns 0, or ENOMEM. */
+static int
+_paths_add(xxhash_paths *p, const xxhash_pchar *path, size_t len,
+           unsigned char tag)
+{
+    if (p->arena_len + len + 1 > p->arena_cap) {
+        size_t cap = p->arena_cap ? p->arena_cap : 4096;
+        while (cap < p->arena_len + len + 1)
+            cap *= 2;
+        xxhash_pchar *arena = PyMem_RawRealloc(p->arena,
+                                               cap * sizeof(xxhash_pchar));
+        if (arena == NULL)
+            return ENOMEM;
+        p->arena = arena;
+        p->arena_cap = cap;
+    }
+    if (p->n == p->cap) {
+        Py_ssize_t cap = p->cap ? p->cap * 2 : 64;
+        size_t *offsets = PyMem_RawRealloc(p->offsets, cap * sizeof(size_t));
+        if (offsets == NULL)
+            return ENOMEM;
+        p->offsets = offsets;
+        unsigned char *tags = PyMem_RawRealloc(p->tags, cap);
+        if (tags == NULL)
+            return ENOMEM;
+        p->tags = tags;
+        p->cap = cap;
+    }
+    memcpy(p->arena + p->arena_len, path, len * sizeof(xxhash_pchar));
+    p->arena[p->arena_len + len] = 0;
+    p->offsets[p->n] = p->arena_len;
+    p->tags[p->n++] = tag;
+    p->arena_len += len + 1;
+    return 0;
+}
+
+static inline const xxhash_pchar *
+_paths_get(const xxhash_paths *p, Py_ssize_t i)
+{
+    return p->arena + p->offsets[i];
+}
+
+static void
+_paths_free(xxhash_paths *p)
+{
+    PyMem_RawFree(p->arena);
+    PyMem_RawFree(p->offsets);
+    PyMem_RawFree(p->tags);
+    memset(p, 0, sizeof(*p));
+}
+
+/* Directory entry kinds seen while walking. */
+enum {
+    XXHASH_KIND_UNKNOWN,
+    XXHASH_KIND_FILE,
+    XXHASH_KIND_DIR,
+    XXHASH_KIND_LINK,
+    XXHASH_KIND_OTHER,
+};
+
+/* The identity of a directory being walked, linked to its parent's. */
+typedef struct xxhash_walk_dir {
+    uint64_t dev;
+    uint64_t ino;
+    const struct xxhash_walk_dir *parent;
+} xxhash_walk_dir;
+
+/* State of a native directory walk, which runs without the GIL. path holds
+ * the current path; regular files are added to files tagged with algo. When
+ * following symbolic links, dirs is the chain of directories from the one
+ * being walked up to the root, used to skip links that form a cycle. */
+typedef struct {
+    xxhash_pchar *path;
+    size_t cap;
+    int follow_symlinks;
+    const xxhash_walk_dir *dirs;
+    unsigned char algo;
+    xxhash_paths *files;
+    int err;                    /* errno of the first failure */
+    xxhash_pchar *err_path;     /* path of the first failure */
+} xxhash_walk;
+
+typedef struct {
+    const xxhash_pchar *name;
+    unsigned char kind;
+} xxhash_dirent;
+
+static int
+_dirent_cmp(const void *a, const void *b)
+{
+    return XXHASH_PSTRCMP(((const xxhash_dirent *)a)->name,
+                          ((const xxhash_dirent *)b)->name);
+}
+
+/* Record a failure at the current path. Returns -1. */
+static int
+_walk_fail(xxhash_walk *w, int err)
+{
+    w->err = err;
+    size_t len = XXHASH_PSTRLEN(w->path);
+    w->err_path = PyMem_RawMalloc((len + 1) * sizeof(xxhash_pchar));
+    if (w->err_path)
+        memcpy(w->err_path, w->path, (len + 1) * sizeof(xxhash_pchar));
+    return -1;
+}
+
+/* Make room for len characters plus a NUL in w->path. Returns 0 or -1. */
+static int
+_walk_reserve(xxhash_walk *w, size_t len)
+{
+    if (len + 1 <= w->cap)
+        return 0;
+    size_t cap = w->cap * 2 > len + 1 ? w->cap * 2 : len + 1;
+    xxhash_pchar *path = PyMem_RawRealloc(w->path, cap * sizeof(xxhash_pchar));
+    if (path == NULL)
+        return _walk_fail(w, ENOMEM);
+    w->path = path;
+    w->cap = cap;
+    return 0;
+}
+
+/* Read the entries of the directory w->path (len characters) into
+ * entries, tagged with their kind. Returns 0, or an errno value. */
+static int
+_walk_list(xxhash_walk *w, size_t len, xxhash_paths *entries)
+{
+#ifdef MS_WINDOWS
+    WIN32_FIND_DATAW data;
+    HANDLE h;
+    int err = 0;
+
+    if (_walk_reserve(w, len + 2) < 0)
+        return ENOMEM;
+    w->path[len] = L'\\';
+    w->path[len + 1] = L'*';
+    w->path[len + 2] = 0;
+    h = FindFirstFileW(w->path, &data);
+    w->path[len] = 0;
+    if (h == INVALID_HANDLE_VALUE) {
+        DWORD code = GetLastError();
+        if (code == ERROR_FILE_NOT_FOUND)
+            return 0;
+        return code == ERROR_ACCESS_DENIED ? EACCES
+             : code == ERROR_PATH_NOT_FOUND ? ENOENT
+             : code == ERROR_DIRECTORY ? ENOTDIR : EIO;
+    }
+    do {
+        const wchar_t *name = data.cFileName;
+        unsigned char kind;
+        if (wcscmp(name, L".") == 0 || wcscmp(name, L"..") == 0)
+            continue;
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)
+            kind = XXHASH_KIND_LINK;
+        else if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            kind = XXHASH_KIND_DIR;
+        else
+            kind = XXHASH_KIND_FILE;
+        if ((err = _paths_add(entries, name, wcslen(name), kind)) != 0)
+            break;
+    } while (FindNextFileW(h, &data));
+    FindClose(h);
+    return err;
+#else
+    DIR *dir = opendir(w->path);
+    struct dirent *e;
+    int err = 0;
+
+    if (dir == NULL)
+        return errno;
+    for (;;) {
+        errno = 0;
+        if ((e = readdir(dir)) == NULL) {
+            err = errno;
+            break;
+        }
+        const char *name = e->d_name;
+        unsigned char kind = XXHASH_KIND_UNKNOWN;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+            continue;
+#ifdef DT_UNKNOWN
+        switch (e->d_type) {
+        case DT_REG: kind = XXHASH_KIND_FILE; break;
+        case DT_DIR: kind = XXHASH_KIND_DIR; break;
+        case DT_LNK: kind = XXHASH_KIND_LINK; break;
+        case DT_UNKNOWN: break;
+        default: kind = XXHASH_KIND_OTHER; break;
+        }
+#endif
+        if ((err = _paths_add(entries, name, strlen(name), kind)) != 0)
+            break;
+    }
+    closedir(dir);
+    return err;
+#endif
+}
+
+/* Resolve the kind of the entry at w->path: follow symbolic links if
+ * asked to, and stat() entries the directory listing did not classify. */
+static unsigned char
+_walk_kind(xxhash_walk *w, unsigned char kind)
+{
+#ifdef MS_WINDOWS
+    if (kind == XXHASH_KIND_LINK && w->follow_symlinks) {
+        DWORD attrs = GetFileAttributesW(w->path);
+        if (attrs == INVALID_FILE_ATTRIBUTES)
+            return XXHASH_KIND_OTHER;
+        return attrs & FILE_ATTRIBUTE_DIRECTORY ? XXHASH_KIND_DIR
+                                                : XXHASH_KIND_FILE;
+    }
+    return kind;
+#else
+    struct stat st;
+    int rc;
+    if (kind == XXHASH_KIND_UNKNOWN)
+        rc = w->follow_symlinks ? stat(w->path, &st) : lstat(w->path, &st);
+    else if (kind == XXHASH_KIND_LINK && w->follow_symlinks)
+        rc = stat(w->path, &st);
+    else
+        return kind;
+    if (rc < 0)
+        return XXHASH_KIND_OTHER;   /* dangling link or vanished entry */
+    return S_ISREG(st.st_mode) ? XXHASH_KIND_FILE
+         : S_ISDIR(st.st_mode) ? XXHASH_KIND_DIR
+         : S_ISLNK(st.st_mode) ? XXHASH_KIND_LINK : XXHASH_KIND_OTHER;
+#endif
+}
+
+/* Store the identity of the directory w->path in dir. Returns 0, or an
+ * errno value. */
+static int
+_walk_identity(xxhash_walk *w, xxhash_walk_dir *dir)
+{
+#ifdef MS_WINDOWS
+    BY_HANDLE_FILE_INFORMATION info;
+    HANDLE h = CreateFileW(w->path, 0,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+    if (h == INVALID_HANDLE_VALUE)
+        return GetLastError() == ERROR_ACCESS_DENIED ? EACCES : ENOENT;
+    BOOL ok = GetFileInformationByHandle(h, &info);
+    CloseHandle(h);
+    if (!ok)
+        return EIO;
+    dir->dev = info.dwVolumeSerialNumber;
+    dir->ino = ((uint64_t)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+#else
+    struct stat st;
+    if (stat(w->path, &st) < 0)
+        return errno;
+    dir->dev = (uint64_t)st.st_dev;
+    dir->ino = (uint64_t)st.st_ino;
+#endif
+    return 0;
+}
+
+/* Walk the directory w->path (len characters) in name order, adding its
+ * regular files to w->files and descending into subdirectories. A
+ * directory reached again below itself through a symbolic link is skipped.
+ * Returns 0, or -1 with w->err set. */
+static int
+_walk_dir(xxhash_walk *w, size_t len)
+{
+    xxhash_paths entries = {0};
+    xxhash_dirent *sorted = NULL;
+    xxhash_walk_dir dir;
+    int err, rc = -1;
+
+    if (w->follow_symlinks) {
+        if ((err = _walk_identity(w, &dir)) != 0)
+            return _walk_fail(w, err);
+        for (const xxhash_walk_dir *d = w->dirs; d != NULL; d = d->parent) {
+            if (d->dev == dir.dev && d->ino == dir.ino)
+                return 0;
+        }
+        dir.parent = w->dirs;
+        w->dirs = &dir;
+    }
+    if ((err = _walk_list(w, len, &entries)) != 0) {
+        w->path[len] = 0;
+        _walk_fail(w, err);
+        goto done;
+    }
+    if (entries.n > 0) {
+        sorted = PyMem_RawMalloc(entries.n * sizeof(xxhash_dirent));
+        if (sorted == NULL) {
+            _walk_fail(w, ENOMEM);
+            goto done;
+        }
+    }
+    for (Py_ssize_t i = 0; i < entries.n; i++) {
+        sorted[i].name = _paths_get(&entries, i);
+        sorted[i].kind = entries.tags[i];
+    }
+    qsort(sorted, entries.n, sizeof(xxhash_dirent), _dirent_cmp);
+
+    size_t base = len;
+    if (len == 0 || w->path[len - 1] != XXHASH_SEP
+#ifdef MS_WINDOWS
+        && w->path[len - 1] != L'/'
+#endif
+        )
+        base++;
+    for (Py_ssize_t i = 0; i < entries.n; i++) {
+        size_t namelen = XXHASH_PSTRLEN(sorted[i].name);
+        if (_walk_reserve(w, base + namelen) < 0)
+            goto done;
+        w->path[len] = XXHASH_SEP;
+        memcpy(w->path + base, sorted[i].name, namelen * sizeof(xxhash_pchar));
+        w->path[base + namelen] = 0;
+
+        switch (_walk_kind(w, sorted[i].kind)) {
+        case XXHASH_KIND_FILE:
+            if ((err = _paths_add(w->files, w->path, base + namelen,
+                                  w->algo)) != 0) {
+                _walk_fail(w, err);
+                goto done;
+            }
+            break;
+        case XXHASH_KIND_DIR:
+            if (_walk_dir(w, base + namelen) < 0)
+                goto done;
+            break;
+        default:
+            break;
+        }
+    }
+    rc = 0;
+done:
+    if (w->follow_symlinks)
+        w->dirs = dir.parent;
+    w->path[len] = 0;
+    PyMem_RawFree(sorted);
+    _paths_free(&entries);
+    return rc;
+}
+
+static int
+_open_native(const xxhash_pchar *path)
+{
+#ifdef MS_WINDOWS
+    return _wopen(path, _O_RDONLY | _O_BINARY | _O_NOINHERIT);
+#else
+    int fd;
+    do {
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+    } while (fd < 0 && errno == EINTR);
+    return fd;
+#endif
+}
+
+/* Store the canonical (big-endian) digest of state at out. */
+static void
+_state_canonical(xxhash_algo algo, void *state, unsigned char *out)
+{
+    switch (algo) {
+    case XXHASH_ALGO_XXH32:
+        XXH32_canonicalFromHash((XXH32_canonical_t *)out, XXH32_digest(state));
+        break;
+    case XXHASH_ALGO_XXH64:
+        XXH64_canonicalFromHash((XXH64_canonical_t *)out, XXH64_digest(state));
+        break;
+    case XXHASH_ALGO_XXH3_64:
+        XXH64_canonicalFromHash((XXH64_canonical_t *)out,
+                                XXH3_64bits_digest(state));
+        break;
+    case XXHASH_ALGO_XXH3_128:
+        XXH128_canonicalFromHash((XXH128_canonical_t *)out,
+                                 XXH3_128bits_digest(state));
+        break;
+    }
+}
+
+/* A persistent digest cache. The table file holds a header followed by a
+ * power-of-two number of entries, placed by a hash of (dev, ino, algo,
+ * seed) with linear probing over a short window; when the window is full
+ * the first slot is evicted. An entry is a hit only if the file's size and
+ * mtime_ns also match, and a file's stale entry is replaced when it is
+ * rehashed. Each entry carries a checksum of its other fields, so a torn or
+ * corrupted entry reads as empty rather than as a wrong digest.
+ *
+ * The file is mapped shared where mmap() is available; elsewhere it is read
+ * into memory and written back by flush() and close(). Its layout is native
+ * endian and not portable between architectures. */
+#define XXHASH_CACHE_MAGIC  "XXHCACHE"
+#define XXHASH_CACHE_VERSION  1
+#define XXHASH_CACHE_PROBES  16
+#define XXHASH_CACHE_CAPACITY  (1 << 20)
+#define XXHASH_CACHE_MINCAPACITY  16
+#define XXHASH_CACHE_MAXCAPACITY  ((uint64_t)1 << 32)
+/* Files modified less than this many seconds before a hash started are not
+ * stored: a second change within the same mtime tick would go unnoticed. */
+#define XXHASH_CACHE_RACY_SECONDS  2
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t capacity;
+    uint64_t count;
+    unsigned char reserved[32];
+} xxhash_cache_header;
+
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+    int64_t size;
+    int64_t mtime_ns;
+    uint64_t seed;
+    uint32_t algo;
+    uint32_t check;     /* 0 for an empty slot */
+    unsigned char digest[XXH128_DIGESTSIZE];    /* canonical */
+} xxhash_cache_entry;
+
+/* What identifies a file's contents to the cache. */
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+    int64_t size;
+    int64_t mtime_ns;
+} xxhash_file_key;
+
+typedef struct {
+    PyObject_HEAD
+    PyThread_type_lock lock;    /* guards the table and the counters */
+    xxhash_cache_header *header;    /* NULL once closed */
+    xxhash_cache_entry *entries;
+    size_t mapsize;
+    int fd;
+    int mapped;         /* header is an mmap() of fd, else PyMem_Raw memory */
+    Py_ssize_t users;   /* calls hashing through the cache right now */
+    unsigned long long hits, misses, stores;
+    PyObject *path;
+} DigestCacheObject;
+
+/* Store the identity of the open file fd in key. Returns 0 or an errno
+ * value. */
+static int
+_file_key(int fd, xxhash_file_key *key)
+{
+#ifdef MS_WINDOWS
+    BY_HANDLE_FILE_INFORMATION info;
+    HANDLE h = (HANDLE)_get_osfhandle(fd);
+    if (h == INVALID_HANDLE_VALUE || !GetFileInformationByHandle(h, &info))
+        return EBADF;
+    uint64_t ticks = ((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32)
+                     | info.ftLastWriteTime.dwLowDateTime;
+    key->dev = info.dwVolumeSerialNumber;
+    key->ino = ((uint64_t)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+    key->size = (int64_t)(((uint64_t)info.nFileSizeHigh << 32)
+                          | info.nFileSizeLow);
+    /* FILETIME counts 100 ns ticks since 1601-01-01. */
+    key->mtime_ns = ((int64_t)ticks - 116444736000000000LL) * 100;
+#else
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+        return errno;
+    key->dev = (uint64_t)st.st_dev;
+    key->ino = (uint64_t)st.st_ino;
+    key->size = (int64_t)st.st_size;
+    key->mtime_ns = (int64_t)st.st_mtime * 1000000000;
+#  if defined(HAVE_STAT_TV_NSEC)
+    key->mtime_ns += st.st_mtim.tv_nsec;
+#  elif defined(HAVE_STAT_TV_NSEC2)
+    key->mtime_ns += st.st_mtimespec.tv_nsec;
+#  endif
+#endif
+    return 0;
+}
+
+static uint32_t
+_cache_check(const xxhash_cache_entry *e)
+{
+    xxhash_cache_entry copy = *e;
+    copy.check = 0;
+    uint32_t check = (uint32_t)XXH3_64bits(&copy, sizeof(copy));
+    return check ? check : 1;
+}
+
+/* Return the slot for (key, algo, seed): its entry if present, else the
+ * first empty slot in the probe window, else the slot to evict. Called
+ * with c->lock held. */
+static xxhash_cache_entry *
+_cache_slot(DigestCacheObject *c, const xxhash_file_key *key,
+            xxhash_algo algo, uint64_t seed)
+{
+    uint64_t id[4] = {key->dev, key->ino, seed, (uint64_t)algo};
+    uint64_t mask = c->header->capacity - 1;
+    uint64_t home = XXH3_64bits(id, sizeof(id)) & mask;
+
+    for (uint64_t i = 0; i < XXHASH_CACHE_PROBES; i++) {
+        xxhash_cache_entry *e = &c->entries[(home + i) & mask];
+        if (e->check == 0
+            || (e->dev == key->dev && e->ino == key->ino && e->seed == seed
+                && e->algo == (uint32_t)algo))
+            return e;
+    }
+    return &c->entries[home];
+}
+
+/* Copy the cached canonical digest for key to out. Returns 1 on a hit,
+ * 0 on a miss. Safe to call without the GIL. */
+static int
+_cache_lookup(DigestCacheObject *c, const xxhash_file_key *key,
+              xxhash_algo algo, uint64_t seed, unsigned char *out)
+{
+    PyThread_acquire_lock(c->lock, WAIT_LOCK);
+    xxhash_cache_entry *e = _cache_slot(c, key, algo, seed);
+    int hit = e->check != 0 && e->check == _cache_check(e)
+              && e->dev == key->dev && e->ino == key->ino
+              && e->seed == seed && e->algo == (uint32_t)algo
+              && e->size == key->size && e->mtime_ns == key->mtime_ns;
+    if (hit) {
+        memcpy(out, e->digest, XXH128_DIGESTSIZE);
+        c->hits++;
+    } else {
+        c->misses++;
+    }
+    PyThread_release_lock(c->lock);
+    return hit;
+}
+
+/* Take (lock) or drop an advisory lock on the table file fd, which other
+ * processes writing to the same mapped table take too. A no-op where
+ * flock() is unavailable. */
+static void
+_cache_flock(int fd, int lock)
+{
+#ifdef HAVE_FLOCK
+    while (flock(fd, lock ? LOCK_EX : LOCK_UN) < 0 && errno == EINTR)
+        ;
+#endif
+}
+
+/* Record the canonical digest of the file with key. Safe to call without
+ * the GIL. */
+static void
+_cache_store(DigestCacheObject *c, const xxhash_file_key *key,
+             xxhash_algo algo, uint64_t seed, const unsigned char *digest)
+{
+    PyThread_acquire_lock(c->lock, WAIT_LOCK);
+    if (c->mapped)
+        _cache_flock(c->fd, 1);
+    xxhash_cache_entry *e = _cache_slot(c, key, algo, seed);
+    if (e->check == 0)
+        c->header->count++;
+    e->dev = key->dev;
+    e->ino = key->ino;
+    e->size = key->size;
+    e->mtime_ns = key->mtime_ns;
+    e->seed = seed;
+    e->algo = (uint32_t)algo;
+    memcpy(e->digest, digest, XXH128_DIGESTSIZE);
+    e->check = _cache_check(e);
+    if (c->mapped)
+        _cache_flock(c->fd, 0);
+    c->stores++;
+    PyThread_release_lock(c->lock);
+}
+
+/* Write the size bytes at buf to fd at offset 0. Returns 0 or an errno
+ * value. */
+static int
+_write_file(int fd, const void *buf, size_t size)
+{
+    const char *p = buf;
+#ifdef MS_WINDOWS
+    if (_lseeki64(fd, 0, SEEK_SET) < 0)
+        return errno;
+#else
+    if (lseek(fd, 0, SEEK_SET) < 0)
+        return errno;
+#endif
+    while (size > 0) {
+        size_t chunk = size > 0x40000000 ? 0x40000000 : size;
+#ifdef MS_WINDOWS
+        int n = _write(fd, p, (unsigned int)chunk);
+#else
+        Py_ssize_t n = write(fd, p, chunk);
+#endif
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return errno;
+        }
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Write the in-memory table back to the file. Returns 0 or an errno
+ * value. Called with c->lock held. */
+static int
+_cache_sync(DigestCacheObject *c)
+{
+#ifdef HAVE_SYS_MMAN_H
+    if (c->mapped)
+        return msync(c->header, c->mapsize, MS_SYNC) < 0 ? errno : 0;
+#endif
+    return _write_file(c->fd, c->header, c->mapsize);
+}
+
+/* Release the table and the file. Returns 0 or the errno value of a
+ * failed write-back. Called with c->lock held. */
+static int
+_cache_unmap(DigestCacheObject *c)
+{
+    int err = 0;
+
+    if (c->header == NULL)
+        return 0;
+#ifdef HAVE_SYS_MMAN_H
+    if (c->mapped)
+        munmap(c->header, c->mapsize);
+    else
+#endif
+    {
+        err = _cache_sync(c);
+        PyMem_RawFree(c->header);
+    }
+    c->header = NULL;
+    c->entries = NULL;
+#ifdef MS_WINDOWS
+    _close(c->fd);
+#else
+    close(c->fd);
+#endif
+    c->fd = -1;
+    return err;
+}
+
+/* Read the size bytes of fd at offset 0 into buf. Returns 0 or an errno
+ * value; a short file is EINVAL. */
+static int
+_read_file(int fd, void *buf, size_t size)
+{
+    unsigned char *p = buf;
+    int64_t off = 0;
+
+    while (size > 0) {
+        Py_ssize_t n = _pread(fd, p, size, off);
+        if (n < 0)
+            return errno;
+        if (n == 0)
+            return EINVAL;
+        p += n;
+        off += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Open or create the table file at path, with capacity entries if it is
+ * created. Returns 0, or -1 with exception set. */
+static int
+_cache_open(DigestCacheObject *c, const xxhash_pchar *path, uint64_t capacity)
+{
+    xxhash_cache_header header;
+    int64_t filesize = 0;
+    int err, fd, init;
+
+    Py_BEGIN_ALLOW_THREADS
+#ifdef MS_WINDOWS
+    fd = _wopen(path, _O_RDWR | _O_CREAT | _O_BINARY | _O_NOINHERIT,
+                _S_IREAD | _S_IWRITE);
+#else
+    do {
+        fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    } while (fd < 0 && errno == EINTR);
+#endif
+    err = fd < 0 ? errno : 0;
+    if (!err) {
+        /* Held until the header is written, so that processes creating
+         * the file at once do not both initialize it. */
+        _cache_flock(fd, 1);
+        err = _file_size(fd, &filesize);
+    }
+    init = !err && filesize == 0;
+    if (init) {
+        filesize = (int64_t)(sizeof(header)
+                             + capacity * sizeof(xxhash_cache_entry));
+#ifdef MS_WINDOWS
+        err = _chsize_s(fd, filesize);
+#else
+        err = ftruncate(fd, (off_t)filesize) < 0 ? errno : 0;
+#endif
+    } else if (!err) {
+        err = _read_file(fd, &header, sizeof(header));
+        if (!err
+            && (memcmp(header.magic, XXHASH_CACHE_MAGIC, 8) != 0
+                || header.version != XXHASH_CACHE_VERSION
+                || header.entry_size != sizeof(xxhash_cache_entry)
+                || header.capacity < XXHASH_CACHE_MINCAPACITY
+                || header.capacity > XXHASH_CACHE_MAXCAPACITY
+                || (header.capacity & (header.capacity - 1)) != 0
+                || (uint64_t)filesize != sizeof(header)
+                       + header.capacity * sizeof(xxhash_cache_entry)))
+            err = EINVAL;
+    }
+    Py_END_ALLOW_THREADS
+
+    if (err) {
+        if (fd >= 0) {
+#ifdef MS_WINDOWS
+            _close(fd);
+#else
+            close(fd);
+#endif
+        }
+        PyObject *filename = _path_to_object(path);
+        if (filename == NULL)
+            return -1;
+        if (err == EINVAL || err == -1)
+            PyErr_Format(PyExc_ValueError,
+                "%R is not a digest cache file", filename);
+        else {
+            errno = err;
+            PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, filename);
+        }
+        Py_DECREF(filename);
+        return -1;
+    }
+
+    c->fd = fd;
+    c->mapsize = (size_t)filesize;
+#ifdef HAVE_SYS_MMAN_H
+    void *map = mmap(NULL, c->mapsize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     fd, 0);
+    if (map != MAP_FAILED) {
+        c->header = map;
+        c->mapped = 1;
+    }
+#endif
+    if (c->header == NULL) {
+        void *table = init ? PyMem_RawCalloc(1, c->mapsize)
+                           : PyMem_RawMalloc(c->mapsize);
+        err = table ? 0 : ENOMEM;
+        if (table && !init)
+            err = _read_file(fd, table, c->mapsize);
+        if (err) {
+            PyMem_RawFree(table);
+#ifdef MS_WINDOWS
+            _close(fd);
+#else
+            close(fd);
+#endif
+            c->fd = -1;
+            errno = err;
+            PyErr_SetFromErrno(PyExc_OSError);
+            return -1;
+        }
+        c->header = table;
+    }
+    c->entries = (xxhash_cache_entry *)(c->header + 1);
+    if (init) {
+        memcpy(c->header->magic, XXHASH_CACHE_MAGIC, 8);
+        c->header->version = XXHASH_CACHE_VERSION;
+        c->header->entry_size = sizeof(xxhash_cache_entry);
+        c->header->capacity = capacity;
+        c->header->count = 0;
+    }
+    _cache_flock(fd, 0);
+    return 0;
+}
+
+static PyObject *
+DigestCache_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"path", "capacity", NULL};
+    PyObject *path;
+    Py_ssize_t capacity = XXHASH_CACHE_CAPACITY;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|n:DigestCache", keywords,
+                                     &path, &capacity))
+        return NULL;
+    if (capacity < 1 || (uint64_t)capacity > XXHASH_CACHE_MAXCAPACITY) {
+        PyErr_Format(PyExc_ValueError,
+            "DigestCache() capacity must be between 1 and %llu",
+            (unsigned long long)XXHASH_CACHE_MAXCAPACITY);
+        return NULL;
+    }
+    uint64_t cap = XXHASH_CACHE_MINCAPACITY;
+    while (cap < (uint64_t)capacity)
+        cap <<= 1;
+
+    size_t len;
+    xxhash_pchar *native = _native_path(path, &len);
+    if (native == NULL)
+        return NULL;
+
+    DigestCacheObject *self = (DigestCacheObject *)type->tp_alloc(type, 0);
+    if (self == NULL) {
+        PyMem_Free(native);
+        return NULL;
+    }
+    self->fd = -1;
+    if ((self->lock = PyThread_allocate_lock()) == NULL) {
+        PyMem_Free(native);
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+    Py_INCREF(path);
+    self->path = path;
+    int rc = _cache_open(self, native, cap);
+    PyMem_Free(native);
+    if (rc < 0) {
+        Py_DECREF(self);
+        return NULL;
+    }
+    return (PyObject *)self;
+}
+
+/* path may be any path-like object, which can refer back to the cache. */
+static int
+DigestCache_tp_traverse(DigestCacheObject *self, visitproc visit, void *arg)
+{
+    Py_VISIT(Py_TYPE(self));
+    Py_VISIT(self->path);
+    return 0;
+}
+
+static int
+DigestCache_tp_clear(DigestCacheObject *self)
+{
+    Py_CLEAR(self->path);
+    return 0;
+}
+
+static void
+DigestCache_dealloc(DigestCacheObject *self)
+{
+    PyObject_GC_UnTrack(self);
+    if (self->lock) {
+        _cache_unmap(self);
+        PyThread_free_lock(self->lock);
+    }
+    Py_XDECREF(self->path);
+    PyTypeObject *tp = Py_TYPE(self);
+    tp->tp_free((PyObject *)self);
+    Py_DECREF(tp);
+}
+
+/* Take c->lock, raising ValueError if the cache is closed. Returns 0, or
+ * -1 with exception set and the lock released. */
+static int
+_cache_acquire(DigestCacheObject *c)
+{
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(c->lock, WAIT_LOCK);
+    Py_END_ALLOW_THREADS
+    if (c->header == NULL) {
+        PyThread_release_lock(c->lock);
+        PyErr_SetString(PyExc_ValueError, "DigestCache is closed");
+        return -1;
+    }
+    return 0;
+}
+
+/* Mark c as in use by a hashing call, which keeps close() from unmapping
+ * it underneath the workers. Returns 0, or -1 with exception set. */
+static int
+_cache_enter(DigestCacheObject *c)
+{
+    if (_cache_acquire(c) < 0)
+        return -1;
+    c->users++;
+    PyThread_release_lock(c->lock);
+    return 0;
+}
+
+static void
+_cache_leave(DigestCacheObject *c)
+{
+    PyThread_acquire_lock(c->lock, WAIT_LOCK);
+    c->users--;
+    PyThread_release_lock(c->lock);
+}
+
+PyDoc_STRVAR(
+    DigestCache_stats_doc,
+    "stats() -> dict\n\n"
+    "Return the lookups that hit and missed and the digests stored since\n"
+    "the cache was opened, the hit rate, and the number of entries and\n"
+    "capacity of the table.");
+
+static PyObject *
+DigestCache_stats(DigestCacheObject *self, PyObject *unused)
+{
+    if (_cache_acquire(self) < 0)
+        return NULL;
+    unsigned long long hits = self->hits, misses = self->misses;
+    unsigned long long stores = self->stores;
+    unsigned long long entries = self->header->count;
+    unsigned long long capacity = self->header->capacity;
+    PyThread_release_lock(self->lock);
+
+    double rate = hits + misses ? (double)hits / (double)(hits + misses) : 0.0;
+    return Py_BuildValue("{sKsKsKsdsKsK}", "hits", hits, "misses", misses,
+                         "stores", stores, "hit_rate", rate,
+                         "entries", entries, "capacity", capacity);
+}
+
+PyDoc_STRVAR(
+    DigestCache_clear_doc,
+    "clear()\n\n"
+    "Drop every entry, e.g. after files were rewritten by a tool that\n"
+    "restores their size and mtime.");
+
+static PyObject *
+DigestCache_clear(DigestCacheObject *self, PyObject *unused)
+{
+    if (_cache_acquire(self) < 0)
+        return NULL;
+    if (self->mapped)
+        _cache_flock(self->fd, 1);
+    memset(self->entries, 0,
+           self->header->capacity * sizeof(xxhash_cache_entry));
+    self->header->count = 0;
+    if (self->mapped)
+        _cache_flock(self->fd, 0);
+    PyThread_release_lock(self->lock);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+    DigestCache_flush_doc,
+    "flush()\n\n"
+    "Write the table to disk.");
+
+static PyObject *
+DigestCache_flush(DigestCacheObject *self, PyObject *unused)
+{
+    int err;
+
+    if (_cache_acquire(self) < 0)
+        return NULL;
+    Py_BEGIN_ALLOW_THREADS
+    err = _cache_sync(self);
+    Py_END_ALLOW_THREADS
+    PyThread_release_lock(self->lock);
+    if (err) {
+        errno = err;
+        return PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, self->path);
+    }
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+    DigestCache_close_doc,
+    "close()\n\n"
+    "Write the table to disk and close it. Calling close() again has no\n"
+    "effect.");
+
+static PyObject *
+DigestCache_close(DigestCacheObject *self, PyObject *unused)
+{
+    int err;
+
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(self->lock, WAIT_LOCK);
+    Py_END_ALLOW_THREADS
+    if (self->users > 0) {
+        PyThread_release_lock(self->lock);
+        PyErr_SetString(PyExc_RuntimeError,
+                        "cannot close a DigestCache that is in use");
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    err = _cache_unmap(self);
+    Py_END_ALLOW_THREADS
+    PyThread_release_lock(self->lock);
+    if (err) {
+        errno = err;
+        return PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, self->path);
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+DigestCache_enter(DigestCacheObject *self, PyObject *unused)
+{
+    if (_cache_acquire(self) < 0)
+        return NULL;
+    PyThread_release_lock(self->lock);
+    Py_INCREF(self);
+    return (PyObject *)self;
+}
+
+static PyObject *
+DigestCache_exit(DigestCacheObject *self, PyObject *args)
+{
+    return DigestCache_close(self, NULL);
+}
+
+static PyMethodDef DigestCache_methods[] = {
+    {"stats", (PyCFunction)DigestCache_stats, METH_NOARGS, DigestCache_stats_doc},
+    {"clear", (PyCFunction)DigestCache_clear, METH_NOARGS, DigestCache_clear_doc},
+    {"flush", (PyCFunction)DigestCache_flush, METH_NOARGS, DigestCache_flush_doc},
+    {"close", (PyCFunction)DigestCache_close, METH_NOARGS, DigestCache_close_doc},
+    {"__enter__", (PyCFunction)DigestCache_enter, METH_NOARGS, NULL},
+    {"__exit__", (PyCFunction)DigestCache_exit, METH_VARARGS, NULL},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyObject *
+DigestCache_get_path(DigestCacheObject *self, void *closure)
+{
+    PyObject *path = self->path ? self->path : Py_None;
+    Py_INCREF(path);
+    return path;
+}
+
+static PyObject *
+DigestCache_get_capacity(DigestCacheObject *self, void *closure)
+{
+    if (_cache_acquire(self) < 0)
+        return NULL;
+    unsigned long long capacity = self->header->capacity;
+    PyThread_release_lock(self->lock);
+    return PyLong_FromUnsignedLongLong(capacity);
+}
+
+static PyObject *
+DigestCache_get_closed(DigestCacheObject *self, void *closure)
+{
+    return PyBool_FromLong(self->header == NULL);
+}
+
+static PyGetSetDef DigestCache_getseters[] = {
+    {
+        "path",
+        (getter)DigestCache_get_path, NULL,
+        "Path of the table file, as given.",
+        NULL
+    },
+    {
+        "capacity",
+        (getter)DigestCache_get_capacity, NULL,
+        "Number of entries the table holds.",
+        NULL
+    },
+    {
+        "closed",
+        (getter)DigestCache_get_closed, NULL,
+        "True once the cache has been closed.",
+        NULL
+    },
+    {NULL}  /* Sentinel */
+};
+
+PyDoc_STRVAR(
+    DigestCacheType_doc,
+    "DigestCache(path, capacity=1048576)\n"
+    "\n"
+    "A persistent cache of file digests, kept in a table file at path that\n"
+    "is created with room for capacity entries (rounded up to a power of\n"
+    "two) if it does not exist. Pass it as cache= to hash_tree() and\n"
+    "verify_manifest() to skip rereading files that have not changed.\n"
+    "\n"
+    "Entries are keyed by device, inode, algorithm and seed, and are used\n"
+    "only while the file's size and modification time (in nanoseconds)\n"
+    "still match. Files modified within two seconds before a hash starts\n"
+    "are not stored.\n"
+    "\n"
+    "Processes sharing a mapped table file serialize their writes with an\n"
+    "advisory flock(); where the table cannot be mapped, the last process\n"
+    "to write it back wins.");
+
+static PyType_Slot DigestCacheType_slots[] = {
+    {Py_tp_dealloc, DigestCache_dealloc},
+    {Py_tp_traverse, DigestCache_tp_traverse},
+    {Py_tp_clear, DigestCache_tp_clear},
+    {Py_tp_doc, (void *)DigestCacheType_doc},
+    {Py_tp_methods, DigestCache_methods},
+    {Py_tp_getset, DigestCache_getseters},
+    {Py_tp_new, DigestCache_new},
+    {0, NULL},
+};
+
+static PyType_Spec DigestCacheType_spec = {
+    .name = "xxhash.DigestCache",
+    .basicsize = sizeof(DigestCacheObject),
+    .flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC
+#if PY_VERSION_HEX >= 0x030c0000
+           | Py_TPFLAGS_IMMUTABLETYPE
+#endif
+    ,
+    .slots = DigestCacheType_slots,
+};
+
+/* Parse the cache argument: None or a DigestCache, which is marked in use
+ * until _cache_leave(). Returns 0, or -1 with exception set. */
+static int
+_parse_cache(PyObject *module, PyObject *obj, const char *funcname,
+             DigestCacheObject **cache)
+{
+    *cache = NULL;
+    if (obj == NULL || obj == Py_None)
+        return 0;
+    if (!PyObject_TypeCheck(obj,
+                            (PyTypeObject *)_get_state(module)->cache_type)) {
+        PyErr_Format(PyExc_TypeError,
+            "%s() cache must be a DigestCache or None, not '%.200s'",
+            funcname, Py_TYPE(obj)->tp_name);
+        return -1;
+    }
+    if (_cache_enter((DigestCacheObject *)obj) < 0)
+        return -1;
+    *cache = (DigestCacheObject *)obj;
+    return 0;
+}
+
+/* Hash a list of files, each with the algorithm in its tag and seed 0, as
+ * xxhsum does. Canonical digests are stored XXH128_DIGESTSIZE bytes apart;
+ * files that cannot be read get their errno in errors. With a cache, files
+ * it knows are not reread, and new digests are stored unless the file
+ * changed while it was read or was modified at or after racy_ns. */
+typedef struct {
+    const xxhash_paths *files;
+    unsigned char *digests;
+    int *errors;
+    DigestCacheObject *cache;
+    int64_t racy_ns;
+} xxhash_files;
+
+static void
+_files_task(void *arg, Py_ssize_t start, Py_ssize_t end)
+{
+    xxhash_files *job = arg;
+    void *states[XXHASH_NUM_ALGOS] = {NULL};
+    unsigned char *buf = PyMem_RawMalloc(XXHASH_FILE_BUFSIZE);
+
+    for (Py_ssize_t i = start; i < end; i++) {
+        xxhash_algo algo = (xxhash_algo)job->files->tags[i];
+        unsigned char *digest = job->digests + i * XXH128_DIGESTSIZE;
+        xxhash_file_key key, after;
+        int err = buf ? 0 : ENOMEM;
+        int fd = -1, cached = 0, keyed = 0;
+
+        if (!err && states[algo] == NULL
+            && (states[algo] = _state_create(algo)) == NULL)
+            err = ENOMEM;
+        if (!err && (fd = _open_native(_paths_get(job->files, i))) < 0)
+            err = errno;
+        if (!err && job->cache && _file_key(fd, &key) == 0) {
+            keyed = 1;
+            cached = _cache_lookup(job->cache, &key, algo, 0, digest);
+        }
+        if (!err && !cached) {
+            _state_reset(algo, states[algo], 0);
+            do {
+                err = _fd_update(fd, algo, states[algo], buf,
+                                 XXHASH_FILE_BUFSIZE, 0);
+            } while (err == EINTR);
+            if (!err)
+                _state_canonical(algo, states[algo], digest);
+            if (!err && keyed && key.mtime_ns < job->racy_ns
+                && _file_key(fd, &after) == 0
+                && memcmp(&key, &after, sizeof(key)) == 0)
+                _cache_store(job->cache, &key, algo, 0, digest);
+        }
+        if (fd >= 0) {
+#ifdef MS_WINDOWS
+            _close(fd);
+#else
+            close(fd);
+#endif
+        }
+        job->errors[i] = err;
+    }
+    for (int a = 0; a < XXHASH_NUM_ALGOS; a++) {
+        if (states[a])
+            _state_free((xxhash_algo)a, states[a]);
+    }
+    PyMem_RawFree(buf);
+}
+
+/* Hash files on up to nthreads threads. Returns 0, or -1 with exception
+ * set; job->digests and job->errors are allocated here and owned by the
+ * caller on success. */
+static int
+_files_run(PyObject *module, int nthreads, xxhash_files *job)
+{
+    Py_ssize_t n = job->files->n;
+    job->digests = PyMem_Malloc(n ? n * XXH128_DIGESTSIZE : 1);
+    job->errors = PyMem_New(int, n ? n : 1);
+    if (job->digests == NULL || job->errors == NULL) {
+        PyMem_Free(job->digests);
+        PyMem_Free(job->errors);
+        PyErr_NoMemory();
+        return -1;
+    }
+    job->racy_ns = ((int64_t)time(NULL) - XXHASH_CACHE_RACY_SECONDS)
+                   * 1000000000;
+    if (n > 0)
+        _parallel_for(module, nthreads, _files_task, job, n);
+    return 0;
+}
+
+static void
+_hex_encode(const unsigned char *digest, Py_ssize_t size, char *out)
+{
+    static const char hexdigits[] = "0123456789abcdef";
+    for (Py_ssize_t i = 0; i < size; i++) {
+        out[2 * i] = hexdigits[digest[i] >> 4];
+        out[2 * i + 1] = hexdigits[digest[i] & 0xf];
+    }
+}
+
+static int
+_hex_decode(const char *hex, Py_ssize_t size, unsigned char *out)
+{
+    for (Py_ssize_t i = 0; i < 2 * size; i++) {
+        int c = hex[i], v;
+        if (c >= '0' && c <= '9') v = c - '0';
+        else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') v = c - 'A' + 10;
+        else return -1;
+        if (i % 2 == 0)
+            out[i / 2] = (unsigned char)(v << 4);
+        else
+            out[i / 2] |= (unsigned char)v;
+    }
+    return 0;
+}
+
+/* Tags xxhsum uses in BSD-style (--tag) manifest lines, by xxhash_algo. */
+static const char *const xxhash_bsd_tags[] = {"XXH32", "XXH64", "XXH3", "XXH128"};
+
+/* Call dest.write(data) if dest has a write() method, else write data to
+ * the file at path dest. Returns 0, or -1 with exception set. */
+static int
+_write_manifest(PyObject *dest, PyObject *data)
+{
+    PyObject *file, *ret;
+    int owned = !PyObject_HasAttrString(dest, "write");
+
+    if (owned) {
+        PyObject *io = PyImport_ImportModule("io");
+        if (io == NULL)
+            return -1;
+        file = PyObject_CallMethod(io, "open", "Os", dest, "wb");
+        Py_DECREF(io);
+        if (file == NULL)
+            return -1;
+    } else {
+        file = dest;
+        Py_INCREF(file);
+    }
+    ret = PyObject_CallMethod(file, "write", "O", data);
+    Py_XDECREF(ret);
+    if (owned) {
+        PyObject *closed = PyObject_CallMethod(file, "close", NULL);
+        if (closed == NULL && ret != NULL)
+            ret = NULL;
+        Py_XDECREF(closed);
+    }
+    Py_DECREF(file);
+    return ret ? 0 : -1;
+}
+
+/* Return the contents of src as bytes: src.read() if src has a read()
+ * method (text is encoded with the filesystem encoding), else the file at
+ * path src. */
+static PyObject *
+_read_manifest(PyObject *src)
+{
+    PyObject *data;
+
+    if (PyObject_HasAttrString(src, "read")) {
+        data = PyObject_CallMethod(src, "read", NULL);
+    } else {
+        PyObject *io = PyImport_ImportModule("io");
+        if (io == NULL)
+            return NULL;
+        PyObject *file = PyObject_CallMethod(io, "open", "Os", src, "rb");
+        Py_DECREF(io);
+        if (file == NULL)
+            return NULL;
+        data = PyObject_CallMethod(file, "read", NULL);
+        PyObject *closed = PyObject_CallMethod(file, "close", NULL);
+        Py_DECREF(file);
+        if (closed == NULL)
+            Py_CLEAR(data);
+        Py_XDECREF(closed);
+    }
+    if (data && PyUnicode_Check(data))
+        Py_SETREF(data, PyUnicode_EncodeFSDefault(data));
+    if (data && !PyBytes_Check(data)) {
+        PyErr_Format(PyExc_TypeError,
+            "manifest read() returned '%.200s', not bytes",
+            Py_TYPE(data)->tp_name);
+        Py_CLEAR(data);
+    }
+    return data;
+}
+
+/* Format one xxhsum manifest line for path (bytes) and a canonical
+ * digest, GNU style ("<hex>  <path>", hex prefixed with "XXH3_" for
+ * XXH3_64) or BSD style ("<TAG> (<path>) = <hex>"). Paths containing a
+ * backslash, newline or carriage return are escaped and the line starts
+ * with a backslash, as coreutils and xxhsum do. Returns a new bytes
+ * object, or NULL with exception set. */
+static PyObject *
+_manifest_line(xxhash_algo algo, const unsigned char *digest, PyObject *path,
+               int bsd)
+{
+    const char *p = PyBytes_AS_STRING(path);
+    Py_ssize_t len = PyBytes_GET_SIZE(path);
+    Py_ssize_t hexlen = 2 * xxhash_algo_digestsize[algo];
+    Py_ssize_t extra = 0;
+
+    for (Py_ssize_t i = 0; i < len; i++) {
+        if (p[i] == '\\' || p[i] == '\n' || p[i] == '\r')
+            extra++;
+    }
+    /* Longest prefix and separators: "\\XXH128 (" + ") = " + "\n". */
+    PyObject *line = PyBytes_FromStringAndSize(NULL, 1 + 8 + len + extra
+                                                     + 4 + hexlen + 1);
+    if (line == NULL)
+        return NULL;
+    char *out = PyBytes_AS_STRING(line), *q = out;
+
+    if (extra)
+        *q++ = '\\';
+    if (bsd) {
+        q += sprintf(q, "%s (", xxhash_bsd_tags[algo]);
+    } else {
+        if (algo == XXHASH_ALGO_XXH3_64) {
+            memcpy(q, "XXH3_", 5);
+            q += 5;
+        }
+        _hex_encode(digest, hexlen / 2, q);
+        q += hexlen;
+        *q++ = ' ';
+        *q++ = ' ';
+    }
+    for (Py_ssize_t i = 0; i < len; i++) {
+        if (p[i] == '\\') { *q++ = '\\'; *q++ = '\\'; }
+        else if (p[i] == '\n') { *q++ = '\\'; *q++ = 'n'; }
+        else if (p[i] == '\r') { *q++ = '\\'; *q++ = 'r'; }
+        else *q++ = p[i];
+    }
+    if (bsd) {
+        memcpy(q, ") = ", 4);
+        q += 4;
+        _hex_encode(digest, hexlen / 2, q);
+        q += hexlen;
+    }
+    *q++ = '\n';
+    if (_PyBytes_Resize(&line, q - out) < 0)
+        return NULL;
+    return line;
+}
+
+/* Parse the format argument: "gnu" (default) or "bsd". Returns 1 for BSD,
+ * 0 for GNU, -1 on error with exception set. */
+static int
+_parse_manifest_format(PyObject *obj, const char *funcname)
+{
+    if (obj == NULL || obj == Py_None)
+        return 0;
+    if (PyUnicode_Check(obj)) {
+        if (PyUnicode_CompareWithASCIIString(obj, "gnu") == 0)
+            return 0;
+        if (PyUnicode_CompareWithASCIIString(obj, "bsd") == 0)
+            return 1;
+    }
+    PyErr_Format(PyExc_ValueError,
+        "%s() format must be 'gnu' or 'bsd', not %R", funcname, obj);
+    return -1;
+}
+
+PyDoc_STRVAR(
+    hash_tree_doc,
+    "hash_tree(root, algorithm='xxh3_128', *, nthreads=None, manifest=None,\n"
+    "    format='gnu', follow_symlinks=False, cache=None) -> dict\n"
+    "\n"
+    "Walk the directory root and hash every regular file below it on up to\n"
+    "nthreads threads (default: get_default_nthreads()), with the GIL\n"
+    "released. Return a dict mapping each file path (root joined with the\n"
+    "relative path, in name order; bytes if root is bytes) to its\n"
+    "hexadecimal digest.\n"
+    "\n"
+    "If manifest is given (a path or a binary file object), also write the\n"
+    "digests to it as xxhsum lines, in GNU ('gnu') or BSD ('bsd', as with\n"
+    "xxhsum --tag) format. Symbolic links are skipped unless\n"
+    "follow_symlinks is true; a link back to a directory being walked is\n"
+    "then skipped too. If cache is a DigestCache, unchanged files are\n"
+    "looked up in it instead of being read.");
+
+static PyObject *
+hash_tree(PyObject *self, PyObject *const *args, Py_ssize_t nargs,
+          PyObject *kwnames)
+{
+    static const char *const names[] = {
+        "root", "algorithm", "nthreads", "manifest", "format",
+        "follow_symlinks", "cache", NULL,
+    };
+    PyObject *argv[7];
+    DigestCacheObject *cache;
+    xxhash_algo algo = XXHASH_ALGO_XXH3_128;
+    int nthreads, bsd, follow = 0, as_bytes;
+
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, "hash_tree", names,
+                               2, 1, argv) < 0)
+        return NULL;
+    PyObject *fspath = PyOS_FSPath(argv[0]);
+    if (fspath == NULL)
+        return NULL;
+    as_bytes = PyBytes_Check(fspath);
+    Py_DECREF(fspath);
+    if (argv[1] && _parse_algorithm(self, argv[1], "hash_tree", &algo) < 0)
+        return NULL;
+    if (_parse_nthreads(self, argv[2], "hash_tree", &nthreads) < 0)
+        return NULL;
+    if (argv[3] == Py_None)
+        argv[3] = NULL;
+    if ((bsd = _parse_manifest_format(argv[4], "hash_tree")) < 0)
+        return NULL;
+    if (argv[5] && (follow = PyObject_IsTrue(argv[5])) < 0)
+        return NULL;
+
+    size_t rootlen;
+    xxhash_pchar *root = _native_path(argv[0], &rootlen);
+    if (root == NULL)
+        return NULL;
+    if (_parse_cache(self, argv[6], "hash_tree", &cache) < 0) {
+        PyMem_Free(root);
+        return NULL;
+    }
+
+    xxhash_paths files = {0};
+    xxhash_walk walk = {
+        .cap = rootlen + 1, .follow_symlinks = follow,
+        .algo = (unsigned char)algo, .files = &files,
+    };
+    xxhash_files job = {.files = &files, .cache = cache};
+    PyObject *result = NULL, *manifest = NULL;
+    int rc;
+
+    /* root is PyMem-allocated; the walk may grow it with PyMem_Raw. */
+    walk.path = PyMem_RawMalloc((rootlen + 1) * sizeof(xxhash_pchar));
+    if (walk.path == NULL) {
+        PyMem_Free(root);
+        if (cache)
+            _cache_leave(cache);
+        return PyErr_NoMemory();
+    }
+    memcpy(walk.path, root, (rootlen + 1) * sizeof(xxhash_pchar));
+    PyMem_Free(root);
+
+    Py_BEGIN_ALLOW_THREADS
+    rc = _walk_dir(&walk, rootlen);
+    Py_END_ALLOW_THREADS
+    if (rc < 0) {
+        if (walk.err == ENOMEM || walk.err_path == NULL) {
+            PyErr_NoMemory();
+        } else {
+            PyObject *filename = as_bytes ? _path_to_bytes(walk.err_path)
+                                          : _path_to_object(walk.err_path);
+            if (filename) {
+                errno = walk.err;
+                PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, filename);
+                Py_DECREF(filename);
+            }
+        }
+        goto done;
+    }
+    if (_files_run(self, nthreads, &job) < 0)
+        goto done;
+
+    if ((result = PyDict_New()) == NULL)
+        goto done;
+    if (argv[3] && (manifest = PyList_New(0)) == NULL)
+        goto error;
+    for (Py_ssize_t i = 0; i < files.n; i++) {
+        const xxhash_pchar *native = _paths_get(&files, i);
+        PyObject *path = as_bytes ? _path_to_bytes(native)
+                                  : _path_to_object(native);
+        if (path == NULL)
+            goto error;
+        if (job.errors[i]) {
+            errno = job.errors[i];
+            PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+            Py_DECREF(path);
+            goto error;
+        }
+        const unsigned char *digest = job.digests + i * XXH128_DIGESTSIZE;
+        char hex[2 * XXH128_DIGESTSIZE];
+        Py_ssize_t hexlen = 2 * xxhash_algo_digestsize[algo];
+        _hex_encode(digest, hexlen / 2, hex);
+        PyObject *value = PyUnicode_FromStringAndSize(hex, hexlen);
+        if (value == NULL || PyDict_SetItem(result, path, value) < 0) {
+            Py_XDECREF(value);
+            Py_DECREF(path);
+            goto error;
+        }
+        Py_DECREF(value);
+        if (manifest) {
+            PyObject *encoded = path;
+            if (as_bytes)
+                Py_INCREF(encoded);
+            else
+                encoded = PyUnicode_EncodeFSDefault(path);
+            PyObject *line = encoded ? _manifest_line(algo, digest, encoded, bsd)
+                                     : NULL;
+            Py_XDECREF(encoded);
+            if (line == NULL || PyList_Append(manifest, line) < 0) {
+                Py_XDECREF(line);
+                Py_DECREF(path);
+                goto error;
+            }
+            Py_DECREF(line);
+        }
+        Py_DECREF(path);
+    }
+    if (manifest) {
+        PyObject *empty = PyBytes_FromStringAndSize(NULL, 0);
+        PyObject *data = empty ? PyObject_CallMethod(empty, "join", "O",
+                                                     manifest) : NULL;
+        Py_XDECREF(empty);
+        if (data == NULL || _write_manifest(argv[3], data) < 0) {
+            Py_XDECREF(data);
+            goto error;
+        }
+        Py_DECREF(data);
+    }
+    goto done;
+
+error:
+    Py_CLEAR(result);
+done:
+    Py_XDECREF(manifest);
+    PyMem_Free(job.digests);
+    PyMem_Free(job.errors);
+    PyMem_RawFree(walk.path);
+    PyMem_RawFree(walk.err_path);
+    _paths_free(&files);
+    if (cache)
+        _cache_leave(cache);
+    return result;
+}
+
+/* Parse one xxhsum manifest line (without its line terminator), GNU or
+ * BSD style. Stores the algorithm, the canonical digest, and the unescaped
+ * path into path (at least len bytes). Returns the path length, or -1 if
+ * the line is malformed. */
+static Py_ssize_t
+_parse_manifest_line(const char *line, Py_ssize_t len, xxhash_algo *algo,
+                     unsigned char *digest, char *path)
+{
+    const char *end = line + len, *hex, *name, *name_end;
+    Py_ssize_t hexlen;
+    int escaped = len > 0 && line[0] == '\\';
+
+    if (escaped)
+        line++;
+    const char *paren = NULL;
+    for (int a = 0; a < XXHASH_NUM_ALGOS && paren == NULL; a++) {
+        size_t taglen = strlen(xxhash_bsd_tags[a]);
+        if ((size_t)(end - line) > taglen + 2
+            && memcmp(line, xxhash_bsd_tags[a], taglen) == 0
+            && memcmp(line + taglen, " (", 2) == 0) {
+            *algo = (xxhash_algo)a;
+            paren = line + taglen + 1;
+        }
+    }
+    if (paren) {
+        /* BSD: TAG (path) = hex */
+        hexlen = 2 * xxhash_algo_digestsize[*algo];
+        if (end - (paren + 1) < 4 + hexlen
+            || memcmp(end - hexlen - 4, ") = ", 4) != 0)
+            return -1;
+        hex = end - hexlen;
+        name = paren + 1;
+        name_end = end - hexlen - 4;
+    } else {
+        /* GNU: [XXH3_]hex  path, or hex *path */
+        int xxh3 = end - line > 5 && memcmp(line, "XXH3_", 5) == 0;
+        hex = line + (xxh3 ? 5 : 0);
+        const char *sp = memchr(hex, ' ', end - hex);
+        if (sp == NULL || end - sp < 2 || (sp[1] != ' ' && sp[1] != '*'))
+            return -1;
+        hexlen = sp - hex;
+        if (xxh3 && hexlen == 16)
+            *algo = XXHASH_ALGO_XXH3_64;
+        else if (!xxh3 && hexlen == 8)
+            *algo = XXHASH_ALGO_XXH32;
+        else if (!xxh3 && hexlen == 16)
+            *algo = XXHASH_ALGO_XXH64;
+        else if (!xxh3 && hexlen == 32)
+            *algo = XXHASH_ALGO_XXH3_128;
+        else
+            return -1;
+        name = sp + 2;
+        name_end = end;
+    }
+    if (name == name_end || _hex_decode(hex, hexlen / 2, digest) < 0)
+        return -1;
+
+    Py_ssize_t n = 0;
+    for (const char *p = name; p < name_end; p++) {
+        if (escaped && *p == '\\') {
+            if (++p == name_end)
+                return -1;
+            if (*p == '\\') path[n++] = '\\';
+            else if (*p == 'n') path[n++] = '\n';
+            else if (*p == 'r') path[n++] = '\r';
+            else return -1;
+        } else {
+            path[n++] = *p;
+        }
+    }
+    return n;
+}
+
+static int
+_is_absolute(const xxhash_pchar *path)
+{
+#ifdef MS_WINDOWS
+    return path[0] == L'\\' || path[0] == L'/'
+           || (path[0] && path[1] == L':');
+#else
+    return path[0] == '/';
+#endif
+}
+
+PyDoc_STRVAR(
+    verify_manifest_doc,
+    "verify_manifest(manifest, *, root=None, nthreads=None, cache=None)\n"
+    "    -> dict\n"
+    "\n"
+    "Check the files listed in an xxhsum manifest (a path or a binary file\n"
+    "object; GNU and BSD lines may be mixed), hashing them on up to\n"
+    "nthreads threads with the GIL released. Relative paths are resolved\n"
+    "against root if given, else against the current directory.\n"
+    "\n"
+    "Return a dict mapping each path as written in the manifest to 'OK',\n"
+    "'FAILED' (the digest differs) or 'ERROR' (the file could not be\n"
+    "read). A path listed more than once is 'OK' only if every line for\n"
+    "it is. Raise ValueError if a line is not a valid manifest line. If\n"
+    "cache is a DigestCache, unchanged files are looked up in it instead of\n"
+    "being read.");
+
+static PyObject *
+verify_manifest(PyObject *self, PyObject *const *args, Py_ssize_t nargs,
+                PyObject *kwnames)
+{
+    static const char *const names[] = {
+        "manifest", "root", "nthreads", "cache", NULL,
+    };
+    PyObject *argv[4];
+    DigestCacheObject *cache;
+    int nthreads;
+
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, "verify_manifest", names,
+                               1, 1, argv) < 0)
+        return NULL;
+    if (argv[1] == Py_None)
+        argv[1] = NULL;
+    if (_parse_nthreads(self, argv[2], "verify_manifest", &nthreads) < 0)
+        return NULL;
+    if (_parse_cache(self, argv[3], "verify_manifest", &cache) < 0)
+        return NULL;
+
+    PyObject *data = _read_manifest(argv[0]);
+    if (data == NULL) {
+        if (cache)
+            _cache_leave(cache);
+        return NULL;
+    }
+
+    xxhash_pchar *root = NULL;
+    size_t rootlen = 0;
+    xxhash_paths files = {0};
+    xxhash_files job = {.files = &files, .cache = cache};
+    unsigned char *expected = NULL;
+    PyObject *keys = NULL, *result = NULL;
+    const char *text = PyBytes_AS_STRING(data);
+    Py_ssize_t size = PyBytes_GET_SIZE(data);
+    char *path = PyMem_Malloc(size + 1);
+
+    if (path == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    if (argv[1] && (root = _native_path(argv[1], &rootlen)) == NULL)
+        goto done;
+    if ((keys = PyList_New(0)) == NULL)
+        goto done;
+
+    Py_ssize_t lineno = 0;
+    for (const char *line = text, *end; line < text + size; line = end + 1) {
+        end = memchr(line, '\n', text + size - line);
+        if (end == NULL)
+            end = text + size;
+        lineno++;
+        Py_ssize_t len = end - line;
+        if (len > 0 && line[len - 1] == '\r')
+            len--;
+        if (len == 0)
+            continue;
+
+        xxhash_algo algo;
+        unsigned char digest[XXH128_DIGESTSIZE];
+        Py_ssize_t pathlen = _parse_manifest_line(line, len, &algo, digest,
+                                                  path);
+        if (pathlen < 0) {
+            PyErr_Format(PyExc_ValueError,
+                "verify_manifest() line %zd is not a valid xxhsum line",
+                lineno);
+            goto done;
+        }
+        unsigned char *grown = PyMem_Realloc(expected,
+            (files.n + 1) * XXH128_DIGESTSIZE);
+        if (grown == NULL) {
+            PyErr_NoMemory();
+            goto done;
+        }
+        expected = grown;
+        memcpy(expected + files.n * XXH128_DIGESTSIZE, digest,
+               XXH128_DIGESTSIZE);
+
+        PyObject *key = PyUnicode_DecodeFSDefaultAndSize(path, pathlen);
+        if (key == NULL || PyList_Append(keys, key) < 0) {
+            Py_XDECREF(key);
+            goto done;
+        }
+        size_t namelen;
+        xxhash_pchar *name = _native_path(key, &namelen);
+        Py_DECREF(key);
+        if (name == NULL)
+            goto done;
+        int err;
+        if (root && !_is_absolute(name)) {
+            xxhash_pchar *joined = PyMem_Malloc(
+                (rootlen + 1 + namelen + 1) * sizeof(xxhash_pchar));
+            if (joined == NULL) {
+                PyMem_Free(name);
+                PyErr_NoMemory();
+                goto done;
+            }
+            memcpy(joined, root, rootlen * sizeof(xxhash_pchar));
+            joined[rootlen] = XXHASH_SEP;
+            memcpy(joined + rootlen + 1, name, (namelen + 1) * sizeof(xxhash_pchar));
+            err = _paths_add(&files, joined, rootlen + 1 + namelen,
+                             (unsigned char)algo);
+            PyMem_Free(joined);
+        } else {
+            err = _paths_add(&files, name, namelen, (unsigned char)algo);
+        }
+        PyMem_Free(name);
+        if (err) {
+            PyErr_NoMemory();
+            goto done;
+        }
+    }
+
+    if (_files_run(self, nthreads, &job) < 0)
+        goto done;
+    if ((result = PyDict_New()) == NULL)
+        goto done;
+    for (Py_ssize_t i = 0; i < files.n; i++) {
+        const char *status = "ERROR";
+        if (job.errors[i] == 0) {
+            Py_ssize_t digestsize = xxhash_algo_digestsize[files.tags[i]];
+            status = memcmp(job.digests + i * XXH128_DIGESTSIZE,
+                            expected + i * XXH128_DIGESTSIZE, digestsize) == 0
+                     ? "OK" : "FAILED";
+        }
+        /* A path listed more than once is only OK if every line for it
+         * is, so a conflicting duplicate cannot hide behind a good one. */
+        PyObject *key = PyList_GET_ITEM(keys, i);
+        PyObject *prev = PyDict_GetItemWithError(result, key);
+        if (prev == NULL && PyErr_Occurred()) {
+            Py_CLEAR(result);
+            goto done;
+        }
+        if (prev && PyUnicode_CompareWithASCIIString(prev, "OK") != 0)
+            continue;
+        PyObject *value = PyUnicode_InternFromString(status);
+        if (value == NULL || PyDict_SetItem(result, key, value) < 0) {
+            Py_XDECREF(value);
+            Py_CLEAR(result);
+            goto done;
+        }
+        Py_DECREF(value);
+    }
+
+done:
+    PyMem_Free(job.digests);
+    PyMem_Free(job.errors);
+    PyMem_Free(expected);
+    PyMem_Free(path);
+    PyMem_Free(root);
+    Py_XDECREF(keys);
+    _paths_free(&files);
+    Py_DECREF(data);
+    if (cache)
+        _cache_leave(cache);
+    return result;
+}
+
+/*****************************************************************************
+ * Object Hashing *************************************************************
+ ****************************************************************************/
+
+/* hash_object() feeds a type-tagged, length-prefixed encoding of an object
+ * tree to one streaming state, without building it. The encoding is part
+ * of the API: digests must be the same across processes, platforms and
+ * versions. Numbers and lengths are 8 bytes, little-endian.
+ *
+ *   None, False, True   'N', 'F', 'T'
+ *   int                 'i' value, if it fits in int64
+ *                       'I' length, hex(value) in ASCII, otherwise
+ *   float               'd' IEEE 754 bits, NaNs as 0x7FF8000000000000
+ *   str                 's' number of code points, UTF-8
+ *   bytes-like          'b' length, bytes
+ *   tuple, list         't', 'l' length, items
+ *   dict                'm' length, keys and values in iteration order
+ *                       'M' length, sorted digests of the items if
+ *                       unordered_dicts is set
+ *   set, frozenset      'e' length, sorted digests of the items
+ *
+ * The digests of unordered containers are canonical XXH3_128 of the
+ * encoding of each item (or key and value), with the same seed, whatever
+ * the algorithm of the whole. Subclasses are encoded as their base type. */
+
+/* Bytes collected before each update of the state. Encodings are mostly a
+ * few bytes long, which streaming updates are slow at, and small objects
+ * fit whole and are hashed in one shot. */
+#define XXHASH_OBJ_BUFSIZE 512
+
+typedef struct {
+    xxhash_algo algo;
+    XXH64_hash_t seed;
+    int unordered_dicts;
+    int started;            /* state reset and fed */
+    size_t used;
+    unsigned char buf[XXHASH_OBJ_BUFSIZE];
+    union {
+        XXH32_state_t xxh32;
+        XXH64_state_t xxh64;
+        XXH3_state_t xxh3;
+    } state;
+} xxhash_obj_writer;
+
+static void
+_obj_init(xxhash_obj_writer *w, xxhash_algo algo, XXH64_hash_t seed,
+          int unordered_dicts)
+{
+    w->algo = algo;
+    w->seed = seed;
+    w->unordered_dicts = unordered_dicts;
+    w->started = 0;
+    w->used = 0;
+}
+
+static void
+_obj_flush(xxhash_obj_writer *w)
+{
+    if (!w->started) {
+        if (w->algo == XXHASH_ALGO_XXH3_64 || w->algo == XXHASH_ALGO_XXH3_128)
+            XXH3_INITSTATE(&w->state.xxh3);
+        _state_reset(w->algo, &w->state, w->seed);
+        w->started = 1;
+    }
+    if (w->used) {
+        _state_update(w->algo, &w->state, w->buf, w->used);
+        w->used = 0;
+    }
+}
+
+/* Digest of everything written, in the low bits for 32 and 64-bit
+ * algorithms. */
+static XXH128_hash_t
+_obj_digest(xxhash_obj_writer *w)
+{
+    XXH128_hash_t h = {0, 0};
+
+    if (!w->started) {
+        switch (w->algo) {
+        case XXHASH_ALGO_XXH32:
+            h.low64 = XXH32(w->buf, w->used, (XXH32_hash_t)w->seed);
+            break;
+        case XXHASH_ALGO_XXH64:
+            h.low64 = XXH64(w->buf, w->used, w->seed);
+            break;
+        case XXHASH_ALGO_XXH3_64:
+            h.low64 = XXH3_64bits_withSeed(w->buf, w->used, w->seed);
+            break;
+        case XXHASH_ALGO_XXH3_128:
+            h = XXH3_128bits_withSeed(w->buf, w->used, w->seed);
+            break;
+        }
+        return h;
+    }
+    _obj_flush(w);
+    switch (w->algo) {
+    case XXHASH_ALGO_XXH32:
+        h.low64 = XXH32_digest(&w->state.xxh32);
+        break;
+    case XXHASH_ALGO_XXH64:
+        h.low64 = XXH64_digest(&w->state.xxh64);
+        break;
+    case XXHASH_ALGO_XXH3_64:
+        h.low64 = XXH3_64bits_digest(&w->state.xxh3);
+        break;
+    case XXHASH_ALGO_XXH3_128:
+        h = XXH3_128bits_digest(&w->state.xxh3);
+        break;
+    }
+    return h;
+}
+
+static void
+_obj_write(xxhash_obj_writer *w, const void *p, size_t len)
+{
+    if (len > XXHASH_OBJ_BUFSIZE - w->used) {
+        _obj_flush(w);
+        if (len >= XXHASH_OBJ_BUFSIZE) {
+            _state_update(w->algo, &w->state, p, len);
+            return;
+        }
+    }
+    memcpy(w->buf + w->used, p, len);
+    w->used += len;
+}
+
+/* Write a tag followed by the 8-byte little-endian value. */
+static void
+_obj_write_tag(xxhash_obj_writer *w, char tag, uint64_t value)
+{
+    unsigned char b[9];
+    b[0] = (unsigned char)tag;
+    for (int i = 0; i < 8; i++) {
+        b[1 + i] = (unsigned char)(value >> (8 * i));
+    }
+    _obj_write(w, b, sizeof(b));
+}
+
+static int _obj_encode(xxhash_obj_writer *w, PyObject *obj);
+
+static int
+_obj_digest_cmp(const void *a, const void *b)
+{
+    return memcmp(a, b, sizeof(XXH128_canonical_t));
+}
+
+/* Encode a dict (its items) or a set as tag, length and the sorted
+ * digests of its items. */
+static int
+_obj_encode_unordered(xxhash_obj_writer *w, char tag, PyObject *obj)
+{
+    int is_dict = PyDict_Check(obj);
+    Py_ssize_t n = is_dict ? PyDict_GET_SIZE(obj) : PySet_GET_SIZE(obj);
+    XXH128_canonical_t *digests = PyMem_New(XXH128_canonical_t, n ? n : 1);
+    /* On the heap, as these nest with the containers, with slack to align
+     * the XXH3 state in it as hash objects do. */
+    void *sub_alloc = PyMem_Malloc(sizeof(xxhash_obj_writer)
+                                   + XXHASH_STATE_ALIGN - 1);
+    xxhash_obj_writer *sub = (xxhash_obj_writer *)
+        (((uintptr_t)sub_alloc + XXHASH_STATE_ALIGN - 1)
+         & ~(uintptr_t)(XXHASH_STATE_ALIGN - 1));
+    PyObject *it = NULL, *key, *value;
+    Py_ssize_t i = 0, pos = 0;
+    int ret = -1;
+
+    if (digests == NULL || sub_alloc == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    if (!is_dict && (it = PyObject_GetIter(obj)) == NULL)
+        goto done;
+
+    for (;;) {
+        if (is_dict) {
+            if (!PyDict_Next(obj, &pos, &key, &value))
+                break;
+            Py_INCREF(key);
+            Py_INCREF(value);
+        } else {
+            if ((key = PyIter_Next(it)) == NULL) {
+                if (PyErr_Occurred())
+                    goto done;
+                break;
+            }
+            value = NULL;
+        }
+        if (i == n) {
+            PyErr_Format(PyExc_RuntimeError,
+                "%s changed size during hashing", Py_TYPE(obj)->tp_name);
+            Py_DECREF(key);
+            Py_XDECREF(value);
+            goto done;
+        }
+        _obj_init(sub, XXHASH_ALGO_XXH3_128, w->seed, w->unordered_dicts);
+        int err = _obj_encode(sub, key) < 0
+                  || (value != NULL && _obj_encode(sub, value) < 0);
+        Py_DECREF(key);
+        Py_XDECREF(value);
+        if (err)
+            goto done;
+        XXH128_canonicalFromHash(&digests[i++], _obj_digest(sub));
+    }
+    if (i != n) {
+        PyErr_Format(PyExc_RuntimeError,
+            "%s changed size during hashing", Py_TYPE(obj)->tp_name);
+        goto done;
+    }
+
+    qsort(digests, (size_t)n, sizeof(digests[0]), _obj_digest_cmp);
+    _obj_write_tag(w, tag, (uint64_t)n);
+    _obj_write(w, digests, (size_t)n * sizeof(digests[0]));
+    ret = 0;
+
+done:
+    Py_XDECREF(it);
+    PyMem_Free(sub_alloc);
+    PyMem_Free(digests);
+    return ret;
+}
+
+static int
+_obj_encode_str(xxhash_obj_writer *w, PyObject *obj)
+{
+#if PY_VERSION_HEX < 0x030C0000
+    if (PyUnicode_READY(obj) < 0)
+        return -1;
+#endif
+    int kind = PyUnicode_KIND(obj);
+    const void *data = PyUnicode_DATA(obj);
+    Py_ssize_t len = PyUnicode_GET_LENGTH(obj), pos = 0;
+
+    _obj_write_tag(w, 's', (uint64_t)len);
+    if (PyUnicode_IS_ASCII(obj)) {
+        _obj_write(w, data, (size_t)len);
+        return 0;
+    }
+    /* Transcode into the buffer; the code point count already delimits
+     * the UTF-8. */
+    while (pos < len) {
+        if (XXHASH_OBJ_BUFSIZE - w->used < 4)
+            _obj_flush(w);
+        Py_ssize_t n = _str_utf8_chunk(kind, data, len, &pos,
+                                       w->buf + w->used,
+                                       XXHASH_OBJ_BUFSIZE - w->used);
+        if (n < 0) {
+            _str_utf8_error(obj, "hash_object");
+            return -1;
+        }
+        w->used += (size_t)n;
+    }
+    return 0;
+}
+
+static int
+_obj_encode_int(xxhash_obj_writer *w, PyObject *obj)
+{
+    int overflow;
+    long long value = PyLong_AsLongLongAndOverflow(obj, &overflow);
+
+    if (value == -1 && PyErr_Occurred())
+        return -1;
+    if (!overflow) {
+        _obj_write_tag(w, 'i', (uint64_t)value);
+        return 0;
+    }
+    PyObject *hex = PyNumber_ToBase(obj, 16);
+    if (hex == NULL)
+        return -1;
+    Py_ssize_t len;
+    const char *p = PyUnicode_AsUTF8AndSize(hex, &len);
+    if (p == NULL) {
+        Py_DECREF(hex);
+        return -1;
+    }
+    _obj_write_tag(w, 'I', (uint64_t)len);
+    _obj_write(w, p, (size_t)len);
+    Py_DECREF(hex);
+    return 0;
+}
+
+/* Encode the items of a tuple or list. */
+static int
+_obj_encode_seq(xxhash_obj_writer *w, char tag, PyObject *obj)
+{
+    int is_tuple = PyTuple_Check(obj);
+    Py_ssize_t n = Py_SIZE(obj);
+
+    _obj_write_tag(w, tag, (uint64_t)n);
+    for (Py_ssize_t i = 0; i < n; i++) {
+        if (Py_SIZE(obj) != n) {
+            PyErr_SetString(PyExc_RuntimeError,
+                            "list changed size during hashing");
+            return -1;
+        }
+        PyObject *item = is_tuple ? PyTuple_GET_ITEM(obj, i)
+                                  : PyList_GET_ITEM(obj, i);
+        Py_INCREF(item);
+        int ret = _obj_encode(w, item);
+        Py_DECREF(item);
+        if (ret < 0)
+            return -1;
+    }
+    return 0;
+}
+
+static int
+_obj_encode_dict(xxhash_obj_writer *w, PyObject *obj)
+{
+    Py_ssize_t n = PyDict_GET_SIZE(obj), pos = 0, i = 0;
+    PyObject *key, *value;
+
+    _obj_write_tag(w, 'm', (uint64_t)n);
+    while (PyDict_Next(obj, &pos, &key, &value)) {
+        if (i++ == n)
+            break;
+        Py_INCREF(key);
+        Py_INCREF(value);
+        int ret = _obj_encode(w, key) < 0 ? -1 : _obj_encode(w, value);
+        Py_DECREF(key);
+        Py_DECREF(value);
+        if (ret < 0)
+            return -1;
+    }
+    if (i != n || PyDict_GET_SIZE(obj) != n) {
+        PyErr_SetString(PyExc_RuntimeError,
+                        "dict changed size during hashing");
+        return -1;
+    }
+    return 0;
+}
+
+static int
+_obj_encode(xxhash_obj_writer *w, PyObject *obj)
+{
+    int ret;
+
+    if (obj == Py_None) {
+        _obj_write(w, "N", 1);
+        return 0;
+    }
+    if (PyBool_Check(obj)) {
+        _obj_write(w, obj == Py_True ? "T" : "F", 1);
+        return 0;
+    }
+    if (PyLong_Check(obj))
+        return _obj_encode_int(w, obj);
+    if (PyFloat_Check(obj)) {
+        double d = PyFloat_AS_DOUBLE(obj);
+        uint64_t bits = 0x7FF8000000000000ULL;
+        if (!Py_IS_NAN(d))
+            memcpy(&bits, &d, sizeof(bits));
+        _obj_write_tag(w, 'd', bits);
+        return 0;
+    }
+    if (PyUnicode_Check(obj))
+        return _obj_encode_str(w, obj);
+    if (PyBytes_Check(obj)) {
+        _obj_write_tag(w, 'b', (uint64_t)PyBytes_GET_SIZE(obj));
+        _obj_write(w, PyBytes_AS_STRING(obj), (size_t)PyBytes_GET_SIZE(obj));
+        return 0;
+    }
+
+    if (Py_EnterRecursiveCall(" while hashing an object"))
+        return -1;
+    if (PyTuple_Check(obj)) {
+        ret = _obj_encode_seq(w, 't', obj);
+    } else if (PyList_Check(obj)) {
+        ret = _obj_encode_seq(w, 'l', obj);
+    } else if (PyDict_Check(obj)) {
+        ret = w->unordered_dicts ? _obj_encode_unordered(w, 'M', obj)
+                                 : _obj_encode_dict(w, obj);
+    } else if (PyAnySet_Check(obj)) {
+        ret = _obj_encode_unordered(w, 'e', obj);
+    } else if (PyObject_CheckBuffer(obj)) {
+        Py_buffer buf;
+        ret = PyObject_GetBuffer(obj, &buf, PyBUF_SIMPLE);
+        if (ret == 0) {
+            _obj_write_tag(w, 'b', (uint64_t)buf.len);
+            _obj_write(w, buf.buf, (size_t)buf.len);
+            PyBuffer_Release(&buf);
+        }
+    } else {
+        PyErr_Format(PyExc_TypeError,
+            "hash_object() cannot hash object of type '%.200s'",
+            Py_TYPE(obj)->tp_name);
+        ret = -1;
+    }
+    Py_LeaveRecursiveCall();
+    return ret;
+}
+
+PyDoc_STRVAR(
+    hash_object_doc,
+    "hash_object(obj, algorithm='xxh3_128', seed=0, *, unordered_dicts=False)\n"
+    "    -> int\n\n"
+    "Return the integer digest of a canonical encoding of obj, made of None,\n"
+    "bools, ints, floats, str, bytes-like objects, and tuples, lists, dicts,\n"
+    "sets and frozensets of them, nested to any depth. Values are tagged\n"
+    "with their type and containers with their length, so that different\n"
+    "structures do not share an encoding, and digests are the same across\n"
+    "processes, platforms and versions. Nothing is serialized in between.\n\n"
+    "Dicts are hashed in iteration order, or regardless of order if\n"
+    "unordered_dicts is true; sets always regardless of order. Other types\n"
+    "raise TypeError.");
+
+static PyObject *
+hash_object(PyObject *self, PyObject *const *args, Py_ssize_t nargs,
+            PyObject *kwnames)
+{
+    static const char *const names[] = {
+        "obj", "algorithm", "seed", "unordered_dicts", NULL,
+    };
+    PyObject *argv[4];
+    xxhash_algo algo = XXHASH_ALGO_XXH3_128;
+    XXH64_hash_t seed = 0;
+    int unordered_dicts = 0;
+    xxhash_obj_writer w;
+    XXH128_hash_t h;
+
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, "hash_object", names,
+                               3, 1, argv) < 0)
+        return NULL;
+    if (argv[1] && _parse_algorithm(self, argv[1], "hash_object", &algo) < 0)
+        return NULL;
+    if (argv[2]) {
+        seed = (XXH64_hash_t)PyLong_AsUnsignedLongLongMask(argv[2]);
+        if (PyErr_Occurred())
+            return NULL;
+    }
+    if (argv[3] && (unordered_dicts = PyObject_IsTrue(argv[3])) < 0)
+        return NULL;
+
+    _obj_init(&w, algo, seed, unordered_dicts);
+    if (_obj_encode(&w, argv[0]) < 0)
+        return NULL;
+    h = _obj_digest(&w);
+    if (algo == XXHASH_ALGO_XXH3_128)
+        return _xxh128_to_pylong(h);
+    return PyLong_FromUnsignedLongLong(h.low64);
+}
+
+/*****************************************************************************
+ * Bound Hashers **************************************************************
+ ****************************************************************************/
+
+/* A one-shot hash function with its algorithm and seed bound in, returned
+ * by xxh*_hasher(). Calls take the data as their only argument, so there
+ * is no keyword parsing, and seeded XXH3 hashers keep the secret derived
+ * from the seed instead of deriving it again for every long input. */
+typedef struct {
+    PyObject_VAR_HEAD
+    vectorcallfunc vectorcall;
+    xxhash_algo algo;
+    XXH64_hash_t seed;
+    /* XXH3 with a caller-supplied secret: bytes, otherwise NULL. */
+    PyObject *custom_secret;
+    /* XXH3 with a nonzero seed: XXH3_generateSecret_fromSeed(seed), in
+     * XXH3_SECRET_DEFAULT_SIZE trailing bytes. Other hashers are allocated
+     * without them, so ob_size is 0. */
+    unsigned char secret[];
+} BoundHasherObject;
+
+/* Algorithm names, as the hash types' name attributes give them. */
+static const char *const xxhash_algo_names[] = {
+    "XXH32", "XXH64", "XXH3_64", "XXH3_128",
+};
+
+static XXH128_hash_t
+_bound_hash(const BoundHasherObject *self, const void *p, size_t len)
+{
+    XXH128_hash_t h = {0, 0};
+
+    switch (self->algo) {
+    case XXHASH_ALGO_XXH32:
+        h.low64 = XXH32(p, len, (XXH32_hash_t)self->seed);
+        break;
+    case XXHASH_ALGO_XXH64:
+        h.low64 = XXH64(p, len, self->seed);
+        break;
+    case XXHASH_ALGO_XXH3_64:
+        if (self->custom_secret) {
+            h.low64 = XXH3_64bits_withSecret(p, len,
+                PyBytes_AS_STRING(self->custom_secret),
+                (size_t)PyBytes_GET_SIZE(self->custom_secret));
+            break;
+        }
+        h.low64 = self->seed
+            ? XXH3_64bits_withSecretandSeed(p, len, self->secret,
+                                            XXH3_SECRET_DEFAULT_SIZE,
+                                            self->seed)
+            : XXH3_64bits(p, len);
+        break;
+    case XXHASH_ALGO_XXH3_128:
+        if (self->custom_secret) {
+            h = XXH3_128bits_withSecret(p, len,
+                PyBytes_AS_STRING(self->custom_secret),
+                (size_t)PyBytes_GET_SIZE(self->custom_secret));
+            break;
+        }
+        h = self->seed
+            ? XXH3_128bits_withSecretandSeed(p, len, self->secret,
+                                             XXH3_SECRET_DEFAULT_SIZE,
+                                             self->seed)
+            : XXH3_128bits(p, len);
+        break;
+    }
+    return h;
+}
+
+/* Hash data, releasing the GIL for large inputs. Returns 0, or -1 with
+ * exception set. */
+static int
+_bound_call(const BoundHasherObject *self, PyObject *data, XXH128_hash_t *h)
+{
+    Py_buffer buf;
+
+    if (_get_buffer_or_str(data, &buf) < 0)
+        return -1;
+    if (buf.len > XXHASH_GIL_MINSIZE) {
+        Py_BEGIN_ALLOW_THREADS
+        *h = _bound_hash(self, buf.buf, (size_t)buf.len);
+        Py_END_ALLOW_THREADS
+    } else {
+        *h = _bound_hash(self, buf.buf, (size_t)buf.len);
+    }
+    PyBuffer_Release(&buf);
+    return 0;
+}
+
+static PyObject *
+_bound_intdigest(const BoundHasherObject *self, XXH128_hash_t h)
+{
+    switch (self->algo) {
+    case XXHASH_ALGO_XXH32:
+        return PyLong_FromUnsignedLong((unsigned long)h.low64);
+    case XXHASH_ALGO_XXH3_128:
+        return _xxh128_to_pylong(h);
+    default:
+        return PyLong_FromUnsignedLongLong(h.low64);
+    }
+}
+
+static void
+_bound_canonical(const BoundHasherObject *self, XXH128_hash_t h,
+                 unsigned char *out)
+{
+    switch (self->algo) {
+    case XXHASH_ALGO_XXH32:
+        XXH32_canonicalFromHash((XXH32_canonical_t *)out, (XXH32_hash_t)h.low64);
+        break;
+    case XXHASH_ALGO_XXH3_128:
+        XXH128_canonicalFromHash((XXH128_canonical_t *)out, h);
+        break;
+    default:
+        XXH64_canonicalFromHash((XXH64_canonical_t *)out, h.low64);
+        break;
+    }
+}
+
+static PyObject *
+BoundHasher_vectorcall(PyObject *op, PyObject *const *args, size_t nargsf,
+                       PyObject *kwnames)
+{
+    BoundHasherObject *self = (BoundHasherObject *)op;
+    Py_ssize_t nargs = PyVectorcall_NARGS(nargsf);
+    XXH128_hash_t h;
+
+    if (nargs != 1 || (kwnames && PyTuple_GET_SIZE(kwnames))) {
+        PyErr_Format(PyExc_TypeError,
+            "%s hasher takes exactly one positional argument",
+            xxhash_algo_names[self->algo]);
+        return NULL;
+    }
+    if (_bound_call(self, args[0], &h) < 0)
+        return NULL;
+    return _bound_intdigest(self, h);
+}
+
+PyDoc_STRVAR(
+    BoundHasher_intdigest_doc,
+    "intdigest(data) -> int\n\n"
+    "Return the digest of data as an integer; the same as calling the\n"
+    "hasher.");
+
+static PyObject *
+BoundHasher_intdigest(BoundHasherObject *self, PyObject *data)
+{
+    XXH128_hash_t h;
+    if (_bound_call(self, data, &h) < 0)
+        return NULL;
+    return _bound_intdigest(self, h);
+}
+
+PyDoc_STRVAR(
+    BoundHasher_digest_doc,
+    "digest(data) -> bytes\n\n"
+    "Return the digest of data as big-endian bytes.");
+
+static PyObject *
+BoundHasher_digest(BoundHasherObject *self, PyObject *data)
+{
+    XXH128_hash_t h;
+    if (_bound_call(self, data, &h) < 0)
+        return NULL;
+    PyObject *ret = PyBytes_FromStringAndSize(NULL,
+                                              xxhash_algo_digestsize[self->algo]);
+    if (ret == NULL)
+        return NULL;
+    _bound_canonical(self, h, (unsigned char *)PyBytes_AS_STRING(ret));
+    return ret;
+}
+
+PyDoc_STRVAR(
+    BoundHasher_hexdigest_doc,
+    "hexdigest(data) -> str\n\n"
+    "Return the digest of data as a string of hexadecimal digits.");
+
+static PyObject *
+BoundHasher_hexdigest(BoundHasherObject *self, PyObject *data)
+{
+    XXH128_hash_t h;
+    unsigned char digest[XXH128_DIGESTSIZE];
+    Py_ssize_t size = xxhash_algo_digestsize[self->algo];
+
+    if (_bound_call(self, data, &h) < 0)
+        return NULL;
+    _bound_canonical(self, h, digest);
+    PyObject *ret = PyUnicode_New(2 * size, 127);
+    if (ret == NULL)
+        return NULL;
+    _hex_encode(digest, size, (char *)PyUnicode_1BYTE_DATA(ret));
+    return ret;
+}
+
+static PyMethodDef BoundHasher_methods[] = {
+    {"digest", (PyCFunction)BoundHasher_digest, METH_O, BoundHasher_digest_doc},
+    {"hexdigest", (PyCFunction)BoundHasher_hexdigest, METH_O, BoundHasher_hexdigest_doc},
+    {"intdigest", (PyCFunction)BoundHasher_intdigest, METH_O, BoundHasher_intdigest_doc},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyObject *
+BoundHasher_get_name(BoundHasherObject *self, void *closure)
+{
+    return PyUnicode_FromString(xxhash_algo_names[self->algo]);
+}
+
+static PyObject *
+BoundHasher_get_seed(BoundHasherObject *self, void *closure)
+{
+    return PyLong_FromUnsignedLongLong(self->seed);
+}
+
+static PyObject *
+BoundHasher_get_digest_size(BoundHasherObject *self, void *closure)
+{
+    return PyLong_FromLong(xxhash_algo_digestsize[self->algo]);
+}
+
+static PyGetSetDef BoundHasher_getseters[] = {
+    {
+        "name",
+        (getter)BoundHasher_get_name, NULL,
+        "Name of the algorithm, as for the hash types.",
+        NULL
+    },
+    {
+        "seed",
+        (getter)BoundHasher_get_seed, NULL,
+        "Seed.",
+        NULL
+    },
+    {
+        "digest_size",
+        (getter)BoundHasher_get_digest_size, NULL,
+        "Digest size.",
+        NULL
+    },
+    {NULL}  /* Sentinel */
+};
+
+static PyMemberDef BoundHasher_members[] = {
+    {"__vectorcalloffset__", T_PYSSIZET,
+     offsetof(BoundHasherObject, vectorcall), READONLY, NULL},
+    {NULL}  /* Sentinel */
+};
+
+static void
+BoundHasher_dealloc(BoundHasherObject *self)
+{
+    PyTypeObject *tp = Py_TYPE(self);
+    Py_CLEAR(self->custom_secret);
+    tp->tp_free((PyObject *)self);
+    Py_DECREF(tp);
+}
+
+PyDoc_STRVAR(
+    BoundHasherType_doc,
+    "A hash function with its algorithm and seed bound, as returned by\n"
+    "xxh32_hasher(), xxh64_hasher(), xxh3_64_hasher() and\n"
+    "xxh3_128_hasher(). Calling it with a bytes-like object returns the\n"
+    "integer digest.");
+
+static PyType_Slot BoundHasherType_slots[] = {
+    {Py_tp_dealloc, BoundHasher_dealloc},
+    {Py_tp_doc, (void *)BoundHasherType_doc},
+    {Py_tp_call, PyVectorcall_Call},
+    {Py_tp_methods, BoundHasher_methods},
+    {Py_tp_getset, BoundHasher_getseters},
+    {Py_tp_members, BoundHasher_members},
+    {0, NULL},
+};
+
+static PyType_Spec BoundHasherType_spec = {
+    .name = "xxhash.BoundHasher",
+    .basicsize = offsetof(BoundHasherObject, secret),
+    .itemsize = 1,
+    .flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_VECTORCALL
+#if PY_VERSION_HEX >= 0x030a0000
+           | Py_TPFLAGS_DISALLOW_INSTANTIATION
+#endif
+#if PY_VERSION_HEX >= 0x030c0000
+           | Py_TPFLAGS_IMMUTABLETYPE
+#endif
+    ,
+    .slots = BoundHasherType_slots,
+};
+
+/* Shared implementation of xxh*_hasher(seed=0), and of
+ * xxh3_*_hasher(seed=0, *, secret=None) for the XXH3 algorithms. */
+static PyObject *
+_xxhash_hasher(PyObject *module, PyObject *const *args, Py_ssize_t nargs,
+               PyObject *kwnames, const char *funcname, xxhash_algo algo)
+{
+    static const char *const names[] = {"seed", "secret", NULL};
+    static const char *const names_nosecret[] = {"seed", NULL};
+    int xxh3 = (algo == XXHASH_ALGO_XXH3_64 || algo == XXHASH_ALGO_XXH3_128);
+    PyObject *argv[2] = {NULL, NULL};
+    PyObject *secret = NULL;
+    unsigned long long seed = 0;
+    int error;
+
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, funcname,
+                               xxh3 ? names : names_nosecret, 1, 0, argv) < 0)
+        return NULL;
+    if (argv[0]) {
+        seed = PyLong_AsUnsignedLongLongMask(argv[0]);
+        if (seed == (unsigned long long)-1 && PyErr_Occurred())
+            return NULL;
+    }
+    if (algo == XXHASH_ALGO_XXH32)
+        seed = (XXH32_hash_t)seed;
+    if (argv[1] && argv[1] != Py_None) {
+        secret = _get_secret_bytes(argv[1], seed, funcname, &error);
+        if (error < 0)
+            return NULL;
+    }
+
+    PyTypeObject *type = (PyTypeObject *)_get_state(module)->bound_type;
+    int derive = seed && xxh3 && secret == NULL;
+    BoundHasherObject *self = PyObject_NewVar(BoundHasherObject, type,
+        derive ? XXH3_SECRET_DEFAULT_SIZE : 0);
+    if (self == NULL) {
+        Py_XDECREF(secret);
+        return NULL;
+    }
+    self->vectorcall = BoundHasher_vectorcall;
+    self->algo = algo;
+    self->seed = (XXH64_hash_t)seed;
+    self->custom_secret = secret;
+    if (derive)
+        XXH3_generateSecret_fromSeed(self->secret, self->seed);
+    return (PyObject *)self;
+}
+
+#define XXHASH_HASHER(name, algo, sig)                                        \
+PyDoc_STRVAR(                                                                 \
+    name##_doc,                                                               \
+    #name sig " -> BoundHasher\n"                                             \
+    "\n"                                                                      \
+    "Return a callable that hashes its one bytes-like argument with this\n"   \
+    "algorithm and seed, returning the integer digest. Its digest(),\n"       \
+    "hexdigest() and intdigest() methods return the other forms.");          \
+                                                                              \
+static PyObject *                                                             \
+name(PyObject *self, PyObject *const *args, Py_ssize_t nargs,                 \
+     PyObject *kwnames)                                                       \
+{                                                                             \
+    return _xxhash_hasher(self, args, nargs, kwnames, #name, algo);           \
+}
+
+XXHASH_HASHER(xxh32_hasher, XXHASH_ALGO_XXH32, "(seed=0)")
+XXHASH_HASHER(xxh64_hasher, XXHASH_ALGO_XXH64, "(seed=0)")
+XXHASH_HASHER(xxh3_64_hasher, XXHASH_ALGO_XXH3_64, "(seed=0, *, secret=None)")
+XXHASH_HASHER(xxh3_128_hasher, XXHASH_ALGO_XXH3_128, "(seed=0, *, secret=None)")
+
+/*****************************************************************************
+ * Sketches *******************************************************************
+ ****************************************************************************/
+
+/* Keys a sketch's batch methods hash at a time, to keep the digests in
+ * cache and to prefetch the cells they address. */
+#define XXHASH_SKETCH_CHUNK  256
+
+/* Sketches touch about a cache line per key, so batches release the GIL
+ * by that measure too. */
+#define XXHASH_SKETCH_COST(keys)  ((keys)->total + (keys)->n * 64)
+
+#if defined(__GNUC__) || defined(__clang__)
+#  define XXHASH_PREFETCH(p)  __builtin_prefetch(p)
+#else
+#  define XXHASH_PREFETCH(p)  ((void)(p))
+#endif
+
+/* Next value of the splitmix64 sequence at *state. */
+static inline uint64_t
+_splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/* A Bloom filter is split into blocks of one cache line. A key's
+ * XXH3_128 digest (low64, high64) picks the block with the low 32 bits of
+ * high64, and its k probes are all bits of that block, so a lookup costs
+ * a single cache miss. Probes are independent 9-bit slices of the digest:
+ * double hashing low64 + i * high64 within 512 bits gave up to five times
+ * the false positives of random probes.
+ *
+ * The filter is a 64-byte header followed by the blocks, each stored as
+ * eight native-endian uint64; a file holds the same bytes. */
+#define XXHASH_BLOOM_MAGIC  "XXHBLOOM"
+#define XXHASH_BLOOM_VERSION  1
+#define XXHASH_BLOOM_BLOCKBITS  512
+#define XXHASH_BLOOM_BLOCKWORDS  (XXHASH_BLOOM_BLOCKBITS / 64)
+#define XXHASH_BLOOM_BLOCKSIZE  (XXHASH_BLOOM_BLOCKBITS / 8)
+#define XXHASH_BLOOM_MAXHASHES  32
+#define XXHASH_BLOOM_MAXBLOCKS                                                \
+    ((uint64_t)PY_SSIZE_T_MAX / XXHASH_BLOOM_BLOCKSIZE - 1 < ((uint64_t)1 << 32) \
+     ? (uint64_t)PY_SSIZE_T_MAX / XXHASH_BLOOM_BLOCKSIZE - 1                  \
+     : ((uint64_t)1 << 32))
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_hashes;
+    uint64_t num_blocks;
+    uint64_t seed;
+    uint64_t capacity;
+    double fp_rate;
+    uint64_t count;     /* adds that set at least one bit */
+    unsigned char reserved[8];
+} xxhash_bloom_header;
+
+/* What probing needs of a filter, for use without the GIL. */
+typedef struct {
+    uint64_t *bits;
+    uint64_t nblocks;
+    uint32_t k;
+} xxhash_bloom;
+
+typedef struct {
+    PyObject_HEAD
+    PyThread_type_lock lock;    /* guards the header and the bits */
+    xxhash_bloom_header *header;    /* NULL once closed */
+    xxhash_bloom filter;
+    uint64_t seed;      /* header->seed, read without the lock */
+    void *alloc;        /* memory the filter lives in, unless mapped */
+    size_t size;        /* bytes from the header to the end of the bits */
+    int fd;             /* file written back by flush(), or -1 */
+    int mapped;         /* header is an mmap() of the file */
+    int readonly;
+    Py_ssize_t exports;
+    PyObject *path;     /* None for a filter made in memory */
+} BloomFilterObject;
+
+static inline uint64_t *
+_bloom_block(const xxhash_bloom *f, XXH128_hash_t h)
+{
+    return f->bits + ((h.high64 & 0xFFFFFFFF) * f->nblocks >> 32)
+                     * XXHASH_BLOOM_BLOCKWORDS;
+}
+
+/* The probes of a key with digest h: 9-bit slices of h.low64, then of a
+ * splitmix64 sequence seeded with h.high64 once those run out. */
+typedef struct {
+    uint64_t bits;
+    uint64_t state;
+    int left;
+} xxhash_bloom_probes;
+
+static inline unsigned
+_bloom_probe(xxhash_bloom_probes *p)
+{
+    if (p->left == 0) {
+        p->bits = _splitmix64(&p->state);
+        p->left = 7;
+    }
+    unsigned pos = (unsigned)(p->bits & (XXHASH_BLOOM_BLOCKBITS - 1));
+    p->bits >>= 9;
+    p->left--;
+    return pos;
+}
+
+/* Set the bits of the key with digest h. Returns 1 if any was clear. */
+static inline int
+_bloom_set(const xxhash_bloom *f, XXH128_hash_t h)
+{
+    uint64_t *block = _bloom_block(f, h);
+    xxhash_bloom_probes p = {h.low64, h.high64, 7};
+    uint64_t clear = 0;
+
+    for (uint32_t i = 0; i < f->k; i++) {
+        unsigned pos = _bloom_probe(&p);
+        uint64_t mask = (uint64_t)1 << (pos & 63);
+        clear |= ~block[pos >> 6] & mask;
+        block[pos >> 6] |= mask;
+    }
+    return clear != 0;
+}
+
+/* Return 1 if every bit of the key with digest h is set. */
+static inline int
+_bloom_test(const xxhash_bloom *f, XXH128_hash_t h)
+{
+    const uint64_t *block = _bloom_block(f, h);
+    xxhash_bloom_probes p = {h.low64, h.high64, 7};
+
+    for (uint32_t i = 0; i < f->k; i++) {
+        unsigned pos = _bloom_probe(&p);
+        if (!(block[pos >> 6] & ((uint64_t)1 << (pos & 63))))
+            return 0;
+    }
+    return 1;
+}
+
+/* A batch of keys to add to or look up in a filter. */
+typedef struct {
+    xxhash_bloom filter;
+    const xxhash_batch *keys;
+    unsigned char *found;   /* lookups: 1 or 0 per key */
+    uint64_t added;         /* adds: keys that set a bit */
+} xxhash_bloom_job;
+
+static void
+_bloom_add_task(void *arg, Py_ssize_t start, Py_ssize_t end)
+{
+    xxhash_bloom_job *job = arg;
+    XXH128_hash_t h[XXHASH_SKETCH_CHUNK];
+
+    while (start < end) {
+        Py_ssize_t n = end - start < XXHASH_SKETCH_CHUNK
+                       ? end - start : XXHASH_SKETCH_CHUNK;
+        _batch_hash_at(job->keys, start, n, h);
+        for (Py_ssize_t i = 0; i < n; i++) {
+            XXHASH_PREFETCH(_bloom_block(&job->filter, h[i]));
+        }
+        for (Py_ssize_t i = 0; i < n; i++) {
+            job->added += _bloom_set(&job->filter, h[i]);
+        }
+        start += n;
+    }
+}
+
+static void
+_bloom_contains_task(void *arg, Py_ssize_t start, Py_ssize_t end)
+{
+    const xxhash_bloom_job *job = arg;
+    XXH128_hash_t h[XXHASH_SKETCH_CHUNK];
+
+    while (start < end) {
+        Py_ssize_t n = end - start < XXHASH_SKETCH_CHUNK
+                       ? end - start : XXHASH_SKETCH_CHUNK;
+        _batch_hash_at(job->keys, start, n, h);
+        for (Py_ssize_t i = 0; i < n; i++) {
+            XXHASH_PREFETCH(_bloom_block(&job->filter, h[i]));
+        }
+        for (Py_ssize_t i = 0; i < n; i++) {
+            job->found[start + i] = (unsigned char)_bloom_test(&job->filter,
+                                                               h[i]);
+        }
+        start += n;
+    }
+}
+
+/* Return 0 if header describes a filter of size bytes, else -1. */
+static int
+_bloom_check_header(const xxhash_bloom_header *header, uint64_t size)
+{
+    if (memcmp(header->magic, XXHASH_BLOOM_MAGIC, 8) != 0
+        || header->version != XXHASH_BLOOM_VERSION
+        || header->num_hashes < 1
+        || header->num_hashes > XXHASH_BLOOM_MAXHASHES
+        || header->num_blocks < 1
+        || header->num_blocks > XXHASH_BLOOM_MAXBLOCKS
+        || size != sizeof(xxhash_bloom_header)
+                   + header->num_blocks * XXHASH_BLOOM_BLOCKSIZE)
+        return -1;
+    return 0;
+}
+
+/* Point self at the filter whose header is at header. */
+static void
+_bloom_attach(BloomFilterObject *self, void *header)
+{
+    self->header = header;
+    self->filter.bits = (uint64_t *)(self->header + 1);
+    self->filter.nblocks = self->header->num_blocks;
+    self->filter.k = self->header->num_hashes;
+    self->seed = self->header->seed;
+}
+
+/* Allocate a filter object for size bytes of filter, with zeroed memory
+ * for it unless it is going to be mapped. Returns NULL with exception set
+ * on error. */
+static BloomFilterObject *
+_bloom_alloc(PyTypeObject *type, size_t size, int map)
+{
+    BloomFilterObject *self = (BloomFilterObject *)type->tp_alloc(type, 0);
+    if (self == NULL)
+        return NULL;
+    self->fd = -1;
+    Py_INCREF(Py_None);
+    self->path = Py_None;
+    if ((self->lock = PyThread_allocate_lock()) == NULL) {
+        Py_DECREF(self);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    self->size = size;
+    if (!map) {
+        /* Blocks are aligned to cache lines. */
+        self->alloc = PyMem_RawCalloc(1, size + XXHASH_BLOOM_BLOCKSIZE);
+        if (self->alloc == NULL) {
+            Py_DECREF(self);
+            PyErr_NoMemory();
+            return NULL;
+        }
+        _bloom_attach(self, (void *)(((uintptr_t)self->alloc
+                                      + XXHASH_BLOOM_BLOCKSIZE - 1)
+                                     & ~(uintptr_t)(XXHASH_BLOOM_BLOCKSIZE - 1)));
+    }
+    return self;
+}
+
+/* Write a filter read from a file back to it. Returns 0 or an errno
+ * value. Called with self->lock held. */
+static int
+_bloom_sync(BloomFilterObject *self)
+{
+#ifdef HAVE_SYS_MMAN_H
+    if (self->mapped)
+        return msync(self->header, self->size, MS_SYNC) < 0 ? errno : 0;
+#endif
+    if (self->fd >= 0)
+        return _write_file(self->fd, self->header, self->size);
+    return 0;
+}
+
+/* Release the filter's memory and file. Returns 0 or the errno value of a
+ * failed write-back. Called with self->lock held. */
+static int
+_bloom_unmap(BloomFilterObject *self)
+{
+    int err = 0;
+
+    if (self->header == NULL)
+        return 0;
+    if (!self->readonly && !self->mapped)
+        err = _bloom_sync(self);
+#ifdef HAVE_SYS_MMAN_H
+    if (self->mapped)
+        munmap(self->header, self->size);
+#endif
+    PyMem_RawFree(self->alloc);
+    self->alloc = NULL;
+    self->header = NULL;
+    if (self->fd >= 0) {
+#ifdef MS_WINDOWS
+        _close(self->fd);
+#else
+        close(self->fd);
+#endif
+        self->fd = -1;
+    }
+    return err;
+}
+
+/* Expected false positive rate of a filter of nblocks blocks holding n
+ * keys with k probes each: the number of keys in a block is about Poisson
+ * distributed, which makes a blocked filter somewhat worse than a classic
+ * one of the same size. */
+static double
+_bloom_fp_rate(double n, uint64_t nblocks, uint32_t k)
+{
+    double lambda = n / (double)nblocks;
+    double fp = 0.0;
+    double end = lambda + 12.0 * sqrt(lambda) + 20.0;
+
+    for (double j = 0.0; j <= end; j++) {
+        double p = exp(j * log(lambda) - lambda - lgamma(j + 1.0));
+        double zero = pow(1.0 - 1.0 / XXHASH_BLOOM_BLOCKBITS, (double)k * j);
+        fp += p * pow(1.0 - zero, (double)k);
+    }
+    return fp;
+}
+
+/* Size a filter for n keys at false positive rate fp_rate: start from the
+ * size of a classic filter, bits = -n ln(p) / ln(2)^2, and grow it until
+ * the blocked layout reaches fp_rate with its best number of probes.
+ * Returns 0, or -1 if the filter would be too large. */
+static int
+_bloom_size(double n, double fp_rate, uint64_t *nblocks, uint32_t *k)
+{
+    double bits = -n * log(fp_rate) / (log(2.0) * log(2.0));
+    double blocks = ceil(bits / XXHASH_BLOOM_BLOCKBITS);
+
+    for (;;) {
+        if (blocks > (double)XXHASH_BLOOM_MAXBLOCKS)
+            return -1;
+        *nblocks = blocks < 1 ? 1 : (uint64_t)blocks;
+
+        double kopt = floor(*nblocks * (double)XXHASH_BLOOM_BLOCKBITS / n
+                            * log(2.0) + 0.5);
+        if (kopt < 2)
+            kopt = 2;
+        else if (kopt > XXHASH_BLOOM_MAXHASHES - 1)
+            kopt = XXHASH_BLOOM_MAXHASHES - 1;
+
+        double best = 1.0;
+        *k = (uint32_t)kopt;
+        for (uint32_t i = *k - 1; i <= (uint32_t)kopt + 1; i++) {
+            double fp = _bloom_fp_rate(n, *nblocks, i);
+            if (fp < best) {
+                best = fp;
+                *k = i;
+            }
+        }
+        if (best <= fp_rate)
+            return 0;
+        blocks = ceil(*nblocks * 1.02 + 1);
+    }
+}
+
+static PyObject *
+BloomFilter_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"capacity", "fp_rate", "seed", NULL};
+    Py_ssize_t capacity;
+    double fp_rate = 0.01;
+    unsigned long long seed = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "n|dK:BloomFilter",
+                                     keywords, &capacity, &fp_rate, &seed))
+        return NULL;
+    if (capacity < 1) {
+        PyErr_SetString(PyExc_ValueError,
+                        "BloomFilter() capacity must be positive");
+        return NULL;
+    }
+    if (!(fp_rate > 0.0 && fp_rate < 1.0)) {
+        PyErr_SetString(PyExc_ValueError,
+                        "BloomFilter() fp_rate must be between 0 and 1");
+        return NULL;
+    }
+
+    uint64_t nblocks;
+    uint32_t k;
+    if (_bloom_size((double)capacity, fp_rate, &nblocks, &k) < 0) {
+        PyErr_SetString(PyExc_OverflowError,
+                        "BloomFilter() capacity is too large for fp_rate");
+        return NULL;
+    }
+    BloomFilterObject *self = _bloom_alloc(
+        type, sizeof(xxhash_bloom_header) + nblocks * XXHASH_BLOOM_BLOCKSIZE,
+        0);
+    if (self == NULL)
+        return NULL;
+    memcpy(self->header->magic, XXHASH_BLOOM_MAGIC, 8);
+    self->header->version = XXHASH_BLOOM_VERSION;
+    self->header->num_hashes = k;
+    self->header->num_blocks = nblocks;
+    self->header->seed = seed;
+    self->header->capacity = (uint64_t)capacity;
+    self->header->fp_rate = fp_rate;
+    _bloom_attach(self, self->header);
+    return (PyObject *)self;
+}
+
+PyDoc_STRVAR(
+    BloomFilter_frombytes_doc,
+    "frombytes(data) -> BloomFilter\n\n"
+    "Return a copy of the filter serialized in the bytes-like object data,\n"
+    "as made by bytes(filter).");
+
+static PyObject *
+BloomFilter_frombytes(PyTypeObject *type, PyObject *data)
+{
+    Py_buffer buf;
+    xxhash_bloom_header header;
+
+    if (_get_buffer_or_str(data, &buf) < 0)
+        return NULL;
+    if ((size_t)buf.len < sizeof(header)
+        || (memcpy(&header, buf.buf, sizeof(header)),
+            _bloom_check_header(&header, (uint64_t)buf.len) < 0)) {
+        PyBuffer_Release(&buf);
+        PyErr_SetString(PyExc_ValueError, "data is not a BloomFilter");
+        return NULL;
+    }
+    BloomFilterObject *self = _bloom_alloc(type, (size_t)buf.len, 0);
+    if (self != NULL) {
+        memcpy(self->header, buf.buf, (size_t)buf.len);
+        _bloom_attach(self, self->header);
+    }
+    PyBuffer_Release(&buf);
+    return (PyObject *)self;
+}
+
+PyDoc_STRVAR(
+    BloomFilter_open_doc,
+    "open(path, writable=False) -> BloomFilter\n\n"
+    "Open the filter saved in the file at path, e.g. with\n"
+    "open(path, 'wb').write(filter). The file is memory-mapped where mmap()\n"
+    "is available, so processes opening it read-only share its pages. A\n"
+    "writable filter writes adds through to the file, on flush() and\n"
+    "close() at the latest.");
+
+static PyObject *
+BloomFilter_open(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"path", "writable", NULL};
+    PyObject *path;
+    int writable = 0;
+    xxhash_bloom_header header;
+    int64_t filesize = 0;
+    int err, fd;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|p:open", keywords,
+                                     &path, &writable))
+        return NULL;
+
+    size_t len;
+    xxhash_pchar *native = _native_path(path, &len);
+    if (native == NULL)
+        return NULL;
+
+    Py_BEGIN_ALLOW_THREADS
+#ifdef MS_WINDOWS
+    fd = _wopen(native, (writable ? _O_RDWR : _O_RDONLY) | _O_BINARY
+                        | _O_NOINHERIT);
+#else
+    do {
+        fd = open(native, (writable ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+    } while (fd < 0 && errno == EINTR);
+#endif
+    err = fd < 0 ? errno : 0;
+    if (!err)
+        err = _file_size(fd, &filesize);
+    if (!err && (uint64_t)filesize < sizeof(header))
+        err = EINVAL;
+    if (!err)
+        err = _read_file(fd, &header, sizeof(header));
+    if (!err && _bloom_check_header(&header, (uint64_t)filesize) < 0)
+        err = EINVAL;
+    Py_END_ALLOW_THREADS
+    PyMem_Free(native);
+
+    if (err) {
+        if (fd >= 0) {
+#ifdef MS_WINDOWS
+            _close(fd);
+#else
+            close(fd);
+#endif
+        }
+        errno = err;
+        if (err == EINVAL)
+            PyErr_Format(PyExc_ValueError, "%R is not a BloomFilter file",
+                         path);
+        else
+            PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+        return NULL;
+    }
+
+    void *map = NULL;
+#ifdef HAVE_SYS_MMAN_H
+    map = mmap(NULL, (size_t)filesize,
+               writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED,
+               fd, 0);
+    if (map == MAP_FAILED)
+        map = NULL;
+    if (map) {
+        /* The file may have been rewritten since its header was read:
+         * check the header that is actually mapped, and that the file
+         * still covers the whole mapping. */
+        int64_t mapsize = 0;
+        if (_file_size(fd, &mapsize) != 0 || mapsize != filesize
+            || _bloom_check_header(map, (uint64_t)filesize) < 0) {
+            munmap(map, (size_t)filesize);
+            close(fd);
+            PyErr_Format(PyExc_ValueError, "%R is not a BloomFilter file",
+                         path);
+            return NULL;
+        }
+    }
+#endif
+    BloomFilterObject *self = _bloom_alloc(type, (size_t)filesize,
+                                           map != NULL);
+    if (self == NULL) {
+#ifdef HAVE_SYS_MMAN_H
+        if (map)
+            munmap(map, (size_t)filesize);
+#endif
+#ifdef MS_WINDOWS
+        _close(fd);
+#else
+        close(fd);
+#endif
+        return NULL;
+    }
+    self->fd = fd;
+    self->readonly = !writable;
+    Py_INCREF(path);
+    Py_SETREF(self->path, path);
+    if (map) {
+        /* The mapping outlives the descriptor. */
+        self->mapped = 1;
+        _bloom_attach(self, map);
+#ifdef MS_WINDOWS
+        _close(fd);
+#else
+        close(fd);
+#endif
+        self->fd = -1;
+    } else {
+        Py_BEGIN_ALLOW_THREADS
+        err = _read_file(fd, self->header, self->size);
+        Py_END_ALLOW_THREADS
+        if (!err && _bloom_check_header(self->header, self->size) < 0)
+            err = EINVAL;
+        if (err) {
+            self->readonly = 1;     /* nothing to write back */
+            Py_DECREF(self);
+            errno = err;
+            return PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+        }
+        _bloom_attach(self, self->header);
+        if (!writable) {
+#ifdef MS_WINDOWS
+            _close(fd);
+#else
+            close(fd);
+#endif
+            self->fd = -1;
+        }
+    }
+    return (PyObject *)self;
+}
+
+/* path may be any path-like object, which can refer back to the filter. */
+static int
+BloomFilter_tp_traverse(BloomFilterObject *self, visitproc visit, void *arg)
+{
+    Py_VISIT(Py_TYPE(self));
+    Py_VISIT(self->path);
+    return 0;
+}
+
+static int
+BloomFilter_tp_clear(BloomFilterObject *self)
+{
+    Py_CLEAR(self->path);
+    return 0;
+}
+
+static void
+BloomFilter_dealloc(BloomFilterObject *self)
+{
+    PyObject_GC_UnTrack(self);
+    if (self->lock) {
+        _bloom_unmap(self);
+        PyThread_free_lock(self->lock);
+    }
+    Py_XDECREF(self->path);
+    PyTypeObject *tp = Py_TYPE(self);
+    tp->tp_free((PyObject *)self);
+    Py_DECREF(tp);
+}
+
+/* Take self->lock, raising ValueError if the filter is closed, or
+ * TypeError if write is set and it is read-only. Returns 0, or -1 with
+ * exception set and the lock released. */
+static int
+_bloom_acquire(BloomFilterObject *self, int write)
+{
+    if (!PyThread_acquire_lock(self->lock, NOWAIT_LOCK)) {
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(self->lock, WAIT_LOCK);
+        Py_END_ALLOW_THREADS
+    }
+    if (self->header == NULL) {
+        PyThread_release_lock(self->lock);
+        PyErr_SetString(PyExc_ValueError, "BloomFilter is closed");
+        return -1;
+    }
+    if (write && self->readonly) {
+        PyThread_release_lock(self->lock);
+        PyErr_SetString(PyExc_TypeError, "BloomFilter is read-only");
+        return -1;
+    }
+    return 0;
+}
+
+/* Hash one key with the filter's seed. Getting the key's buffer can run
+ * Python code, so this must be called without self->lock. Returns 0, or
+ * -1 with exception set. */
+static int
+_bloom_hash(BloomFilterObject *self, PyObject *key, XXH128_hash_t *h)
+{
+    Py_buffer buf;
+
+    if (_get_buffer_or_str(key, &buf) < 0)
+        return -1;
+    *h = XXH3_128bits_withSeed(buf.buf, (size_t)buf.len, self->seed);
+    PyBuffer_Release(&buf);
+    return 0;
+}
+
+PyDoc_STRVAR(
+    BloomFilter_add_doc,
+    "add(key)\n\n"
+    "Add the bytes-like object key to the filter.");
+
+static PyObject *
+BloomFilter_add(BloomFilterObject *self, PyObject *key)
+{
+    XXH128_hash_t h;
+
+    if (_bloom_hash(self, key, &h) < 0)
+        return NULL;
+    if (_bloom_acquire(self, 1) < 0)
+        return NULL;
+    self->header->count += _bloom_set(&self->filter, h);
+    PyThread_release_lock(self->lock);
+    Py_RETURN_NONE;
+}
+
+static int
+BloomFilter_contains(BloomFilterObject *self, PyObject *key)
+{
+    XXH128_hash_t h;
+
+    if (_bloom_hash(self, key, &h) < 0)
+        return -1;
+    if (_bloom_acquire(self, 0) < 0)
+        return -1;
+    int found = _bloom_test(&self->filter, h);
+    PyThread_release_lock(self->lock);
+    return found;
+}
+
+PyDoc_STRVAR(
+    BloomFilter_add_many_doc,
+    "add_many(keys, offsets=None)\n\n"
+    "Add every key in keys, a sequence of bytes-like objects or a buffer\n"
+    "such as an integer array whose items (or rows) are the keys. With\n"
+    "offsets, add the variable-length keys stored back to back in the\n"
+    "buffer keys, as taken by xxh3_64_hash_offsets().");
+
+static PyObject *
+BloomFilter_add_many(BloomFilterObject *self, PyObject *const *args,
+                     Py_ssize_t nargs, PyObject *kwnames)
+{
+    static const char *const names[] = {"keys", "offsets", NULL};
+    PyObject *argv[2];
+    xxhash_keys keys;
+
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, "add_many", names,
+                               2, 1, argv) < 0)
+        return NULL;
+    if (_get_keys(argv[0], argv[1], &keys, "add_many") < 0)
+        return NULL;
+    if (_bloom_acquire(self, 1) < 0) {
+        _keys_release(&keys);
+        return NULL;
+    }
+
+    keys.job.algo = XXHASH_ALGO_XXH3_128;
+    keys.job.seed = self->header->seed;
+    xxhash_bloom_job job = {.filter = self->filter, .keys = &keys.job};
+    /* One thread: adds would race on the bits. */
+    _run_task(PyType_GetModule(Py_TYPE(self)), _bloom_add_task, &job,
+              keys.n, XXHASH_SKETCH_COST(&keys), 1);
+    self->header->count += job.added;
+
+    PyThread_release_lock(self->lock);
+    _keys_release(&keys);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+    BloomFilter_contains_many_doc,
+    "contains_many(keys, offsets=None, *, out=None, nthreads=None)\n"
+    "    -> list of bool\n\n"
+    "Look up every key in keys, given as to add_many(), and return whether\n"
+    "each may be in the filter.\n\n"
+    "If out is given, 1 or 0 per key is written into that writable buffer\n"
+    "of bytes instead, and out is returned.\n\n"
+    XXHASH_NTHREADS_DOC);
+
+static PyObject *
+BloomFilter_contains_many(BloomFilterObject *self, PyObject *const *args,
+                          Py_ssize_t nargs, PyObject *kwnames)
+{
+    static const char *const names[] = {
+        "keys", "offsets", "out", "nthreads", NULL,
+    };
+    PyObject *argv[4];
+    xxhash_keys keys;
+    Py_buffer outview;
+    unsigned char *found;
+    PyObject *result = NULL;
+    int nthreads;
+
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, "contains_many", names,
+                               2, 1, argv) < 0)
+        return NULL;
+    if (_parse_nthreads(PyType_GetModule(Py_TYPE(self)), argv[3],
+                        "contains_many", &nthreads) < 0)
+        return NULL;
+    if (argv[2] == Py_None)
+        argv[2] = NULL;
+    if (_get_keys(argv[0], argv[1], &keys, "contains_many") < 0)
+        return NULL;
+    if (_batch_out_init(argv[2], keys.n, &outview, &found,
+                        "contains_many") < 0) {
+        _keys_release(&keys);
+        return NULL;
+    }
+    if (_bloom_acquire(self, 0) < 0)
+        goto done;
+
+    keys.job.algo = XXHASH_ALGO_XXH3_128;
+    keys.job.seed = self->header->seed;
+    xxhash_bloom_job job = {
+        .filter = self->filter, .keys = &keys.job, .found = found,
+    };
+    _run_task(PyType_GetModule(Py_TYPE(self)), _bloom_contains_task, &job,
+              keys.n, XXHASH_SKETCH_COST(&keys), nthreads);
+    PyThread_release_lock(self->lock);
+
+    if (argv[2]) {
+        Py_INCREF(argv[2]);
+        result = argv[2];
+    } else if ((result = PyList_New(keys.n)) != NULL) {
+        for (Py_ssize_t i = 0; i < keys.n; i++) {
+            PyObject *item = found[i] ? Py_True : Py_False;
+            Py_INCREF(item);
+            PyList_SET_ITEM(result, i, item);
+        }
+    }
+
+done:
+    _batch_out_release(&outview, found);
+    _keys_release(&keys);
+    return result;
+}
+
+PyDoc_STRVAR(
+    BloomFilter_flush_doc,
+    "flush()\n\n"
+    "Write a writable filter opened from a file back to it.");
+
+static PyObject *
+BloomFilter_flush(BloomFilterObject *self, PyObject *unused)
+{
+    int err = 0;
+
+    if (_bloom_acquire(self, 0) < 0)
+        return NULL;
+    if (!self->readonly) {
+        Py_BEGIN_ALLOW_THREADS
+        err = _bloom_sync(self);
+        Py_END_ALLOW_THREADS
+    }
+    PyThread_release_lock(self->lock);
+    if (err) {
+        errno = err;
+        return PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, self->path);
+    }
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+    BloomFilter_close_doc,
+    "close()\n\n"
+    "Write a writable filter back to its file, and release the filter.\n"
+    "Calling close() again has no effect.");
+
+static PyObject *
+BloomFilter_close(BloomFilterObject *self, PyObject *unused)
+{
+    int err;
+
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(self->lock, WAIT_LOCK);
+    Py_END_ALLOW_THREADS
+    if (self->exports > 0) {
+        PyThread_release_lock(self->lock);
+        PyErr_SetString(PyExc_BufferError,
+                        "cannot close a BloomFilter with exported buffers");
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    err = _bloom_unmap(self);
+    Py_END_ALLOW_THREADS
+    PyThread_release_lock(self->lock);
+    if (err) {
+        errno = err;
+        return PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, self->path);
+    }
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+    BloomFilter_bytes_doc,
+    "__bytes__() -> bytes\n\n"
+    "Return a copy of the serialized filter, taken under the filter's lock\n"
+    "so that it is consistent with concurrent adds.");
+
+static PyObject *
+BloomFilter_bytes(BloomFilterObject *self, PyObject *unused)
+{
+    if (_bloom_acquire(self, 0) < 0)
+        return NULL;
+    PyObject *result = PyBytes_FromStringAndSize((const char *)self->header,
+                                                 (Py_ssize_t)self->size);
+    PyThread_release_lock(self->lock);
+    return result;
+}
+
+static PyObject *
+BloomFilter_enter(BloomFilterObject *self, PyObject *unused)
+{
+    if (_bloom_acquire(self, 0) < 0)
+        return NULL;
+    PyThread_release_lock(self->lock);
+    Py_INCREF(self);
+    return (PyObject *)self;
+}
+
+static PyObject *
+BloomFilter_exit(BloomFilterObject *self, PyObject *args)
+{
+    return BloomFilter_close(self, NULL);
+}
+
+static int
+BloomFilter_getbuffer(BloomFilterObject *self, Py_buffer *view, int flags)
+{
+    if (!PyThread_acquire_lock(self->lock, NOWAIT_LOCK)) {
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(self->lock, WAIT_LOCK);
+        Py_END_ALLOW_THREADS
+    }
+    if (self->header == NULL) {
+        PyThread_release_lock(self->lock);
+        PyErr_SetString(PyExc_BufferError, "BloomFilter is closed");
+        return -1;
+    }
+    int rc = PyBuffer_FillInfo(view, (PyObject *)self, self->header,
+                               (Py_ssize_t)self->size, 1, flags);
+    if (rc == 0)
+        self->exports++;
+    PyThread_release_lock(self->lock);
+    return rc;
+}
+
+static void
+BloomFilter_releasebuffer(BloomFilterObject *self, Py_buffer *view)
+{
+    /* add_many() can hold the lock while it waits for the GIL. */
+    if (!PyThread_acquire_lock(self->lock, NOWAIT_LOCK)) {
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(self->lock, WAIT_LOCK);
+        Py_END_ALLOW_THREADS
+    }
+    self->exports--;
+    PyThread_release_lock(self->lock);
+}
+
+static PyMethodDef BloomFilter_methods[] = {
+    {"add", (PyCFunction)BloomFilter_add, METH_O, BloomFilter_add_doc},
+    {"add_many", (PyCFunction)BloomFilter_add_many, METH_FASTCALL | METH_KEYWORDS, BloomFilter_add_many_doc},
+    {"contains_many", (PyCFunction)BloomFilter_contains_many, METH_FASTCALL | METH_KEYWORDS, BloomFilter_contains_many_doc},
+    {"__bytes__", (PyCFunction)BloomFilter_bytes, METH_NOARGS, BloomFilter_bytes_doc},
+    {"flush", (PyCFunction)BloomFilter_flush, METH_NOARGS, BloomFilter_flush_doc},
+    {"close", (PyCFunction)BloomFilter_close, METH_NOARGS, BloomFilter_close_doc},
+    {"frombytes", (PyCFunction)BloomFilter_frombytes, METH_O | METH_CLASS, BloomFilter_frombytes_doc},
+    {"open", (PyCFunction)BloomFilter_open, METH_VARARGS | METH_KEYWORDS | METH_CLASS, BloomFilter_open_doc},
+    {"__enter__", (PyCFunction)BloomFilter_enter, METH_NOARGS, NULL},
+    {"__exit__", (PyCFunction)BloomFilter_exit, METH_VARARGS, NULL},
+    {NULL, NULL, 0, NULL}
+};
+
+enum {
+    XXHASH_BLOOM_CAPACITY,
+    XXHASH_BLOOM_FP_RATE,
+    XXHASH_BLOOM_SEED,
+    XXHASH_BLOOM_NUM_BITS,
+    XXHASH_BLOOM_NUM_HASHES,
+    XXHASH_BLOOM_COUNT,
+};
+
+static PyObject *
+BloomFilter_get_field(BloomFilterObject *self, void *closure)
+{
+    PyObject *value = NULL;
+
+    if (_bloom_acquire(self, 0) < 0)
+        return NULL;
+    const xxhash_bloom_header *h = self->header;
+    switch ((int)(intptr_t)closure) {
+    case XXHASH_BLOOM_CAPACITY:
+        value = PyLong_FromUnsignedLongLong(h->capacity);
+        break;
+    case XXHASH_BLOOM_FP_RATE:
+        value = PyFloat_FromDouble(h->fp_rate);
+        break;
+    case XXHASH_BLOOM_SEED:
+        value = PyLong_FromUnsignedLongLong(h->seed);
+        break;
+    case XXHASH_BLOOM_NUM_BITS:
+        value = PyLong_FromUnsignedLongLong(h->num_blocks
+                                            * XXHASH_BLOOM_BLOCKBITS);
+        break;
+    case XXHASH_BLOOM_NUM_HASHES:
+        value = PyLong_FromUnsignedLong(h->num_hashes);
+        break;
+    case XXHASH_BLOOM_COUNT:
+        value = PyLong_FromUnsignedLongLong(h->count);
+        break;
+    }
+    PyThread_release_lock(self->lock);
+    return value;
+}
+
+static PyObject *
+BloomFilter_get_readonly(BloomFilterObject *self, void *closure)
+{
+    return PyBool_FromLong(self->readonly);
+}
+
+static PyObject *
+BloomFilter_get_closed(BloomFilterObject *self, void *closure)
+{
+    return PyBool_FromLong(self->header == NULL);
+}
+
+static PyObject *
+BloomFilter_get_path(BloomFilterObject *self, void *closure)
+{
+    PyObject *path = self->path ? self->path : Py_None;
+    Py_INCREF(path);
+    return path;
+}
+
+static PyGetSetDef BloomFilter_getseters[] = {
+    {
+        "capacity",
+        (getter)BloomFilter_get_field, NULL,
+        "Number of keys the filter was sized for.",
+        (void *)XXHASH_BLOOM_CAPACITY
+    },
+    {
+        "fp_rate",
+        (getter)BloomFilter_get_field, NULL,
+        "False positive rate the filter was sized for.",
+        (void *)XXHASH_BLOOM_FP_RATE
+    },
+    {
+        "seed",
+        (getter)BloomFilter_get_field, NULL,
+        "Seed keys are hashed with.",
+        (void *)XXHASH_BLOOM_SEED
+    },
+    {
+        "num_bits",
+        (getter)BloomFilter_get_field, NULL,
+        "Size of the filter in bits.",
+        (void *)XXHASH_BLOOM_NUM_BITS
+    },
+    {
+        "num_hashes",
+        (getter)BloomFilter_get_field, NULL,
+        "Number of bits set per key.",
+        (void *)XXHASH_BLOOM_NUM_HASHES
+    },
+    {
+        "count",
+        (getter)BloomFilter_get_field, NULL,
+        "Number of adds that set at least one bit: about the number of\n"
+        "distinct keys added, while the filter is within capacity.",
+        (void *)XXHASH_BLOOM_COUNT
+    },
+    {
+        "readonly",
+        (getter)BloomFilter_get_readonly, NULL,
+        "True for a filter opened from a file without writable=True.",
+        NULL
+    },
+    {
+        "closed",
+        (getter)BloomFilter_get_closed, NULL,
+        "True once the filter has been closed.",
+        NULL
+    },
+    {
+        "path",
+        (getter)BloomFilter_get_path, NULL,
+        "Path of the file the filter was opened from, or None.",
+        NULL
+    },
+    {NULL}  /* Sentinel */
+};
+
+PyDoc_STRVAR(
+    BloomFilterType_doc,
+    "BloomFilter(capacity, fp_rate=0.01, seed=0)\n"
+    "\n"
+    "A Bloom filter of bytes-like keys, sized to hold capacity keys with a\n"
+    "false positive rate of about fp_rate. Keys are hashed once with\n"
+    "XXH3_128 and the given seed, and all the bits of a key lie in one\n"
+    "cache line.\n"
+    "\n"
+    "key in filter tests a key, add() adds one, and add_many() and\n"
+    "contains_many() take whole batches. bytes(filter) returns a consistent\n"
+    "copy of its serialized form, and the filter also exports that form\n"
+    "through the buffer protocol, so writing the filter to a file saves it\n"
+    "for BloomFilter.open(). The layout is native endian.");
+
+static PyType_Slot BloomFilterType_slots[] = {
+    {Py_tp_dealloc, BloomFilter_dealloc},
+    {Py_tp_traverse, BloomFilter_tp_traverse},
+    {Py_tp_clear, BloomFilter_tp_clear},
+    {Py_tp_doc, (void *)BloomFilterType_doc},
+    {Py_tp_methods, BloomFilter_methods},
+    {Py_tp_getset, BloomFilter_getseters},
+    {Py_tp_new, BloomFilter_new},
+    {Py_sq_contains, BloomFilter_contains},
+    {Py_bf_getbuffer, BloomFilter_getbuffer},
+    {Py_bf_releasebuffer, BloomFilter_releasebuffer},
+    {0, NULL},
+};
+
+static PyType_Spec BloomFilterType_spec = {
+    .name = "xxhash.BloomFilter",
+    .basicsize = sizeof(BloomFilterObject),
+    .flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC
+#if PY_VERSION_HEX >= 0x030c0000
+           | Py_TPFLAGS_IMMUTABLETYPE
+#endif
+    ,
+    .slots = BloomFilterType_slots,
+};
+
+/* Registers of a HyperLogLog are updated with an atomic max, so adds need
+ * no lock, on the free-threaded build and from batches running without
+ * the GIL alike. */
+static inline uint8_t
+_atomic_load_u8(const uint8_t *p)
+{
+#ifdef _MSC_VER
+    return (uint8_t)*(const volatile char *)p;
+#else
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline void
+_atomic_max_u8(uint8_t *p, uint8_t value)
+{
+#ifdef _MSC_VER
+    char old = *(volatile char *)p;
+    while ((uint8_t)old < value) {
+        char seen = _InterlockedCompareExchange8((volatile char *)p,
+                                                 (char)value, old);
+        if (seen == old)
+            break;
+        old = seen;
+    }
+#else
+    uint8_t old = __atomic_load_n(p, __ATOMIC_RELAXED);
+    while (old < value
+           && !__atomic_compare_exchange_n(p, &old, value, 1,
+                                           __ATOMIC_RELAXED,
+                                           __ATOMIC_RELAXED))
+        ;
+#endif
+}
+
+static inline int
+_clz64(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(x);
+#else
+    int n = 0;
+    while (!(x & ((uint64_t)1 << 63))) {
+        x <<= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+/* A HyperLogLog has 2**p one-byte registers. A key's XXH3_64 digest picks
+ * a register with its top p bits, and the register keeps the highest rank
+ * seen, the position of the first 1 bit among the remaining 64 - p bits
+ * (64 - p + 1 if there is none).
+ *
+ * The serialized form is a 16-byte header, "XXHHLL", a version byte, p
+ * and the seed as a little-endian uint64, followed by the registers, and
+ * is the same on every platform. */
+#define XXHASH_HLL_MAGIC  "XXHHLL"
+#define XXHASH_HLL_VERSION  1
+#define XXHASH_HLL_HEADERSIZE  16
+#define XXHASH_HLL_MINPRECISION  4
+#define XXHASH_HLL_MAXPRECISION  18
+
+typedef struct {
+    PyObject_HEAD
+    int precision;
+    XXH64_hash_t seed;
+    size_t size;            /* header and registers */
+    unsigned char *data;    /* header, then the registers */
+} HyperLogLogObject;
+
+static inline void
+_hll_add(uint8_t *registers, int p, XXH64_hash_t h)
+{
+    uint64_t rest = h << p;
+    uint8_t rank = (uint8_t)(rest ? _clz64(rest) + 1 : 64 - p + 1);
+    _atomic_max_u8(&registers[h >> (64 - p)], rank);
+}
+
+typedef struct {
+    uint8_t *registers;
+    int precision;
+    const xxhash_batch *keys;
+} xxhash_hll_job;
+
+static void
+_hll_add_task(void *arg, Py_ssize_t start, Py_ssize_t end)
+{
+    const xxhash_hll_job *job = arg;
+    XXH64_hash_t h[XXHASH_SKETCH_CHUNK];
+
+    while (start < end) {
+        Py_ssize_t n = end - start < XXHASH_SKETCH_CHUNK
+                       ? end - start : XXHASH_SKETCH_CHUNK;
+        _batch_hash_at(job->keys, start, n, h);
+        for (Py_ssize_t i = 0; i < n; i++) {
+            _hll_add(job->registers, job->precision, h[i]);
+        }
+        start += n;
+    }
+}
+
+/* sigma() and tau() of Ertl's improved estimator ("New cardinality
+ * estimation algorithms for HyperLogLog sketches", 2017), which needs no
+ * bias correction over the whole range of cardinalities. */
+static double
+_hll_sigma(double x)
+{
+    if (x == 1.0)
+        return Py_HUGE_VAL;
+    double y = 1.0, z = x, prev;
+    do {
+        x *= x;
+        prev = z;
+        z += x * y;
+        y += y;
+    } while (z != prev);
+    return z;
+}
+
+static double
+_hll_tau(double x)
+{
+    if (x == 0.0 || x == 1.0)
+        return 0.0;
+    double y = 1.0, z = 1.0 - x, prev;
+    do {
+        x = sqrt(x);
+        prev = z;
+        y *= 0.5;
+        z -= (1.0 - x) * (1.0 - x) * y;
+    } while (z != prev);
+    return z / 3.0;
+}
+
+static double
+_hll_estimate(const uint8_t *registers, int p)
+{
+    int q = 64 - p;
+    double m = (double)((size_t)1 << p);
+    Py_ssize_t counts[66] = {0};
+
+    for (size_t i = 0; i < ((size_t)1 << p); i++) {
+        counts[_atomic_load_u8(&registers[i])]++;
+    }
+    double z = m * _hll_tau(1.0 - (double)counts[q + 1] / m);
+    for (int k = q; k >= 1; k--) {
+        z = 0.5 * (z + (double)counts[k]);
+    }
+    z += m * _hll_sigma((double)counts[0] / m);
+    return m * m / (2.0 * log(2.0)) / z;
+}
+
+static HyperLogLogObject *
+_hll_alloc(PyTypeObject *type, int precision, XXH64_hash_t seed)
+{
+    HyperLogLogObject *self = (HyperLogLogObject *)type->tp_alloc(type, 0);
+    if (self == NULL)
+        return NULL;
+    self->precision = precision;
+    self->seed = seed;
+    self->size = XXHASH_HLL_HEADERSIZE + ((size_t)1 << precision);
+    if ((self->data = PyMem_Calloc(1, self->size)) == NULL) {
+        Py_DECREF(self);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    memcpy(self->data, XXHASH_HLL_MAGIC, 6);
+    self->data[6] = XXHASH_HLL_VERSION;
+    self->data[7] = (unsigned char)precision;
+    for (int i = 0; i < 8; i++) {
+        self->data[8 + i] = (unsigned char)(seed >> (8 * i));
+    }
+    return self;
+}
+
+static inline uint8_t *
+_hll_registers(HyperLogLogObject *self)
+{
+    return self->data + XXHASH_HLL_HEADERSIZE;
+}
+
+static PyObject *
+HyperLogLog_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"precision", "seed", NULL};
+    int precision = 14;
+    unsigned long long seed = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|iK:HyperLogLog",
+                                     keywords, &precision, &seed))
+        return NULL;
+    if (precision < XXHASH_HLL_MINPRECISION
+        || precision > XXHASH_HLL_MAXPRECISION) {
+        PyErr_Format(PyExc_ValueError,
+            "HyperLogLog() precision must be between %d and %d",
+            XXHASH_HLL_MINPRECISION, XXHASH_HLL_MAXPRECISION);
+        return NULL;
+    }
+    return (PyObject *)_hll_alloc(type, precision, seed);
+}
 
-    PyObject *ret = PyUnicode_New(XXH64_DIGESTSIZE * 2, 127);
-    if (ret == NULL) return NULL;
-    Py_UCS1 *b = PyUnicode_1BYTE_DATA(ret);
-    for (Py_ssize_t i = 0, j = 0; i < XXH64_DIGESTSIZE; i++) {
-        unsigned char c;
-        c = (digest[i] >> 4) & 0xf;
-        c = (c > 9) ? c + 'a' - 10 : c + '0';
-        b[j++] = c;
-        c = (digest[i] & 0xf);
-        c = (c > 9) ? c + 'a' - 10 : c + '0';
-        b[j++] = c;
+static void
+HyperLogLog_dealloc(HyperLogLogObject *self)
+{
+    PyMem_Free(self->data);
+    PyTypeObject *tp = Py_TYPE(self);
+    tp->tp_free((PyObject *)self);
+    Py_DECREF(tp);
+}
+
+PyDoc_STRVAR(
+    HyperLogLog_frombytes_doc,
+    "frombytes(data) -> HyperLogLog\n\n"
+    "Return the sketch serialized in the bytes-like object data, as made by\n"
+    "bytes(sketch).");
+
+static PyObject *
+HyperLogLog_frombytes(PyTypeObject *type, PyObject *data)
+{
+    Py_buffer buf;
+
+    if (_get_buffer_or_str(data, &buf) < 0)
+        return NULL;
+    const unsigned char *p = buf.buf;
+    int precision = buf.len >= XXHASH_HLL_HEADERSIZE ? p[7] : 0;
+    if (precision < XXHASH_HLL_MINPRECISION
+        || precision > XXHASH_HLL_MAXPRECISION
+        || memcmp(p, XXHASH_HLL_MAGIC, 6) != 0
+        || p[6] != XXHASH_HLL_VERSION
+        || (size_t)buf.len != XXHASH_HLL_HEADERSIZE + ((size_t)1 << precision)) {
+        PyBuffer_Release(&buf);
+        PyErr_SetString(PyExc_ValueError, "data is not a HyperLogLog");
+        return NULL;
+    }
+
+    XXH64_hash_t seed = 0;
+    for (int i = 0; i < 8; i++) {
+        seed |= (XXH64_hash_t)p[8 + i] << (8 * i);
+    }
+    HyperLogLogObject *self = _hll_alloc(type, precision, seed);
+    if (self != NULL) {
+        const uint8_t *registers = p + XXHASH_HLL_HEADERSIZE;
+        for (size_t i = 0; i < ((size_t)1 << precision); i++) {
+            if (registers[i] > 64 - precision + 1) {
+                PyErr_SetString(PyExc_ValueError,
+                                "data is not a HyperLogLog");
+                Py_CLEAR(self);
+                break;
+            }
+        }
+        if (self)
+            memcpy(_hll_registers(self), registers, (size_t)1 << precision);
+    }
+    PyBuffer_Release(&buf);
+    return (PyObject *)self;
+}
+
+PyDoc_STRVAR(
+    HyperLogLog_add_doc,
+    "add(key)\n\n"
+    "Add the bytes-like object key to the sketch.");
+
+static PyObject *
+HyperLogLog_add(HyperLogLogObject *self, PyObject *key)
+{
+    Py_buffer buf;
+
+    if (_get_buffer_or_str(key, &buf) < 0)
+        return NULL;
+    _hll_add(_hll_registers(self), self->precision,
+             XXH3_64bits_withSeed(buf.buf, (size_t)buf.len, self->seed));
+    PyBuffer_Release(&buf);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+    HyperLogLog_add_many_doc,
+    "add_many(keys, offsets=None, *, nthreads=None)\n\n"
+    "Add every key in keys, a sequence of bytes-like objects or a buffer\n"
+    "such as an integer array whose items (or rows) are the keys. With\n"
+    "offsets, add the variable-length keys stored back to back in the\n"
+    "buffer keys, as taken by xxh3_64_hash_offsets().\n\n"
+    XXHASH_NTHREADS_DOC);
+
+static PyObject *
+HyperLogLog_add_many(HyperLogLogObject *self, PyObject *const *args,
+                     Py_ssize_t nargs, PyObject *kwnames)
+{
+    static const char *const names[] = {
+        "keys", "offsets", "nthreads", NULL,
+    };
+    PyObject *argv[3];
+    xxhash_keys keys;
+    int nthreads;
+
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, "add_many", names,
+                               2, 1, argv) < 0)
+        return NULL;
+    if (_parse_nthreads(PyType_GetModule(Py_TYPE(self)), argv[2],
+                        "add_many", &nthreads) < 0)
+        return NULL;
+    if (_get_keys(argv[0], argv[1], &keys, "add_many") < 0)
+        return NULL;
+
+    keys.job.algo = XXHASH_ALGO_XXH3_64;
+    keys.job.seed = self->seed;
+    xxhash_hll_job job = {
+        .registers = _hll_registers(self), .precision = self->precision,
+        .keys = &keys.job,
+    };
+    _run_task(PyType_GetModule(Py_TYPE(self)), _hll_add_task, &job, keys.n,
+              keys.total, nthreads);
+    _keys_release(&keys);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+    HyperLogLog_merge_doc,
+    "merge(other)\n\n"
+    "Add the keys counted by other, a HyperLogLog of the same precision and\n"
+    "seed, to this sketch.");
+
+static PyObject *
+HyperLogLog_merge(HyperLogLogObject *self, PyObject *arg)
+{
+    if (!PyObject_TypeCheck(arg, Py_TYPE(self))) {
+        PyErr_Format(PyExc_TypeError,
+            "merge() argument must be a HyperLogLog, not '%.200s'",
+            Py_TYPE(arg)->tp_name);
+        return NULL;
+    }
+    HyperLogLogObject *other = (HyperLogLogObject *)arg;
+    if (other->precision != self->precision || other->seed != self->seed) {
+        PyErr_SetString(PyExc_ValueError,
+            "merge() needs a HyperLogLog of the same precision and seed");
+        return NULL;
+    }
+    uint8_t *dst = _hll_registers(self);
+    const uint8_t *src = _hll_registers(other);
+    for (size_t i = 0; i < ((size_t)1 << self->precision); i++) {
+        _atomic_max_u8(&dst[i], _atomic_load_u8(&src[i]));
+    }
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+    HyperLogLog_cardinality_doc,
+    "cardinality() -> float\n\n"
+    "Return the estimated number of distinct keys added, with a relative\n"
+    "standard error of about 1.04 / sqrt(2 ** precision).");
+
+static PyObject *
+HyperLogLog_cardinality(HyperLogLogObject *self, PyObject *unused)
+{
+    return PyFloat_FromDouble(_hll_estimate(_hll_registers(self),
+                                            self->precision));
+}
+
+static int
+HyperLogLog_getbuffer(HyperLogLogObject *self, Py_buffer *view, int flags)
+{
+    return PyBuffer_FillInfo(view, (PyObject *)self, self->data,
+                             (Py_ssize_t)self->size, 1, flags);
+}
+
+static PyMethodDef HyperLogLog_methods[] = {
+    {"add", (PyCFunction)HyperLogLog_add, METH_O, HyperLogLog_add_doc},
+    {"add_many", (PyCFunction)HyperLogLog_add_many, METH_FASTCALL | METH_KEYWORDS, HyperLogLog_add_many_doc},
+    {"merge", (PyCFunction)HyperLogLog_merge, METH_O, HyperLogLog_merge_doc},
+    {"cardinality", (PyCFunction)HyperLogLog_cardinality, METH_NOARGS, HyperLogLog_cardinality_doc},
+    {"frombytes", (PyCFunction)HyperLogLog_frombytes, METH_O | METH_CLASS, HyperLogLog_frombytes_doc},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyObject *
+HyperLogLog_get_precision(HyperLogLogObject *self, void *closure)
+{
+    return PyLong_FromLong(self->precision);
+}
+
+static PyObject *
+HyperLogLog_get_seed(HyperLogLogObject *self, void *closure)
+{
+    return PyLong_FromUnsignedLongLong(self->seed);
+}
+
+static PyGetSetDef HyperLogLog_getseters[] = {
+    {
+        "precision",
+        (getter)HyperLogLog_get_precision, NULL,
+        "Base-2 logarithm of the number of registers.",
+        NULL
+    },
+    {
+        "seed",
+        (getter)HyperLogLog_get_seed, NULL,
+        "Seed keys are hashed with.",
+        NULL
+    },
+    {NULL}  /* Sentinel */
+};
+
+PyDoc_STRVAR(
+    HyperLogLogType_doc,
+    "HyperLogLog(precision=14, seed=0)\n"
+    "\n"
+    "A HyperLogLog sketch estimating the number of distinct bytes-like keys\n"
+    "added, in 2 ** precision bytes of registers (precision 4 to 18).\n"
+    "Keys are hashed with XXH3_64 and the given seed.\n"
+    "\n"
+    "add() and add_many() may be called from several threads at once:\n"
+    "registers are raised with atomic operations, without a lock. Sketches\n"
+    "export their serialized form through the buffer protocol, which\n"
+    "bytes(sketch) copies and HyperLogLog.frombytes() reads back.");
+
+static PyType_Slot HyperLogLogType_slots[] = {
+    {Py_tp_dealloc, HyperLogLog_dealloc},
+    {Py_tp_doc, (void *)HyperLogLogType_doc},
+    {Py_tp_methods, HyperLogLog_methods},
+    {Py_tp_getset, HyperLogLog_getseters},
+    {Py_tp_new, HyperLogLog_new},
+    {Py_bf_getbuffer, HyperLogLog_getbuffer},
+    {0, NULL},
+};
+
+static PyType_Spec HyperLogLogType_spec = {
+    .name = "xxhash.HyperLogLog",
+    .basicsize = sizeof(HyperLogLogObject),
+    .flags = Py_TPFLAGS_DEFAULT
+#if PY_VERSION_HEX >= 0x030c0000
+           | Py_TPFLAGS_IMMUTABLETYPE
+#endif
+    ,
+    .slots = HyperLogLogType_slots,
+};
+
+/* A Count-Min sketch has depth rows of width counters. A key's XXH3_128
+ * digest (low64, high64) gives the column of row i as the top 32 bits of
+ * low64 + i * high64 scaled to width, so one hash serves every row and no
+ * division is needed. An add raises the key's counter in each row; with
+ * conservative update only the counters below the new estimate are raised,
+ * to it. The estimate is the smallest of the key's counters. Counters
+ * saturate at 2**64 - 1.
+ *
+ * The sketch is a 64-byte header followed by the rows, each stored as
+ * width native-endian uint64. */
+#define XXHASH_CMS_MAGIC  "XXHCOUNT"
+#define XXHASH_CMS_VERSION  1
+#define XXHASH_CMS_MAXDEPTH  32
+#define XXHASH_CMS_MAXWIDTH  ((uint64_t)1 << 32)
+#define XXHASH_CMS_CONSERVATIVE  1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t depth;
+    uint64_t width;
+    uint64_t seed;
+    uint64_t total;     /* sum of the weights added */
+    uint32_t flags;
+    unsigned char reserved[20];
+} xxhash_cms_header;
+
+/* What counting needs of a sketch, for use without the GIL. */
+typedef struct {
+    uint64_t *counters;
+    uint64_t width;
+    uint32_t depth;
+    int conservative;
+} xxhash_cms;
+
+typedef struct {
+    PyObject_HEAD
+    PyThread_type_lock lock;    /* guards the header and the counters */
+    xxhash_cms_header *header;
+    xxhash_cms sketch;
+    void *alloc;        /* memory the sketch lives in */
+    size_t size;        /* bytes from the header to the end of the rows */
+} CountMinSketchObject;
+
+static inline uint64_t *
+_cms_counter(const xxhash_cms *s, XXH128_hash_t h, uint32_t row)
+{
+    uint64_t g = h.low64 + row * h.high64;
+    return s->counters + row * s->width + ((g >> 32) * s->width >> 32);
+}
+
+static inline uint64_t
+_cms_saturating_add(uint64_t a, uint64_t b)
+{
+    return a + b < a ? UINT64_MAX : a + b;
+}
+
+static inline uint64_t
+_cms_estimate(const xxhash_cms *s, XXH128_hash_t h)
+{
+    uint64_t min = UINT64_MAX;
+
+    for (uint32_t i = 0; i < s->depth; i++) {
+        uint64_t c = *_cms_counter(s, h, i);
+        if (c < min)
+            min = c;
+    }
+    return min;
+}
+
+static inline void
+_cms_add(const xxhash_cms *s, XXH128_hash_t h, uint64_t weight)
+{
+    if (s->conservative) {
+        uint64_t target = _cms_saturating_add(_cms_estimate(s, h), weight);
+        for (uint32_t i = 0; i < s->depth; i++) {
+            uint64_t *c = _cms_counter(s, h, i);
+            if (*c < target)
+                *c = target;
+        }
+    } else {
+        for (uint32_t i = 0; i < s->depth; i++) {
+            uint64_t *c = _cms_counter(s, h, i);
+            *c = _cms_saturating_add(*c, weight);
+        }
+    }
+}
+
+/* A batch of keys to add to or estimate in a sketch. */
+typedef struct {
+    xxhash_cms sketch;
+    const xxhash_batch *keys;
+    const uint64_t *weights;    /* adds: per key, or NULL for 1 each */
+    unsigned char *out;         /* estimates: native uint64 per key */
+    uint64_t total;             /* adds: sum of the weights */
+} xxhash_cms_job;
+
+static inline void
+_cms_prefetch(const xxhash_cms *s, XXH128_hash_t h)
+{
+    for (uint32_t i = 0; i < s->depth; i++) {
+        XXHASH_PREFETCH(_cms_counter(s, h, i));
+    }
+}
+
+static void
+_cms_add_task(void *arg, Py_ssize_t start, Py_ssize_t end)
+{
+    xxhash_cms_job *job = arg;
+    XXH128_hash_t h[XXHASH_SKETCH_CHUNK];
+
+    while (start < end) {
+        Py_ssize_t n = end - start < XXHASH_SKETCH_CHUNK
+                       ? end - start : XXHASH_SKETCH_CHUNK;
+        _batch_hash_at(job->keys, start, n, h);
+        for (Py_ssize_t i = 0; i < n; i++) {
+            _cms_prefetch(&job->sketch, h[i]);
+        }
+        for (Py_ssize_t i = 0; i < n; i++) {
+            uint64_t weight = job->weights ? job->weights[start + i] : 1;
+            _cms_add(&job->sketch, h[i], weight);
+            job->total = _cms_saturating_add(job->total, weight);
+        }
+        start += n;
+    }
+}
+
+static void
+_cms_estimate_task(void *arg, Py_ssize_t start, Py_ssize_t end)
+{
+    const xxhash_cms_job *job = arg;
+    XXH128_hash_t h[XXHASH_SKETCH_CHUNK];
+
+    while (start < end) {
+        Py_ssize_t n = end - start < XXHASH_SKETCH_CHUNK
+                       ? end - start : XXHASH_SKETCH_CHUNK;
+        _batch_hash_at(job->keys, start, n, h);
+        for (Py_ssize_t i = 0; i < n; i++) {
+            _cms_prefetch(&job->sketch, h[i]);
+        }
+        for (Py_ssize_t i = 0; i < n; i++) {
+            uint64_t est = _cms_estimate(&job->sketch, h[i]);
+            memcpy(job->out + (start + i) * 8, &est, 8);
+        }
+        start += n;
+    }
+}
+
+/* Allocate a sketch object of width and depth with zeroed counters, its
+ * header filled in but for the magic. Returns NULL with exception set on
+ * error. */
+static CountMinSketchObject *
+_cms_alloc(PyTypeObject *type, uint64_t width, uint32_t depth)
+{
+    if (width > ((uint64_t)PY_SSIZE_T_MAX - 2 * sizeof(xxhash_cms_header))
+                / 8 / depth) {
+        PyErr_SetString(PyExc_OverflowError, "CountMinSketch is too large");
+        return NULL;
+    }
+    CountMinSketchObject *self =
+        (CountMinSketchObject *)type->tp_alloc(type, 0);
+    if (self == NULL)
+        return NULL;
+    if ((self->lock = PyThread_allocate_lock()) == NULL) {
+        Py_DECREF(self);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    self->size = sizeof(xxhash_cms_header) + (size_t)(width * depth * 8);
+    /* Rows are aligned to cache lines. */
+    self->alloc = PyMem_RawCalloc(1, self->size + sizeof(xxhash_cms_header));
+    if (self->alloc == NULL) {
+        Py_DECREF(self);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    self->header = (xxhash_cms_header *)(((uintptr_t)self->alloc
+                                          + sizeof(xxhash_cms_header) - 1)
+                                         & ~(uintptr_t)(sizeof(xxhash_cms_header) - 1));
+    self->header->version = XXHASH_CMS_VERSION;
+    self->header->depth = depth;
+    self->header->width = width;
+    self->sketch.counters = (uint64_t *)(self->header + 1);
+    self->sketch.width = width;
+    self->sketch.depth = depth;
+    return self;
+}
+
+static PyObject *
+CountMinSketch_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"width", "depth", "seed", "conservative", NULL};
+    Py_ssize_t width;
+    int depth = 4;
+    unsigned long long seed = 0;
+    int conservative = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "n|iK$p:CountMinSketch",
+                                     keywords, &width, &depth, &seed,
+                                     &conservative))
+        return NULL;
+    if (width < 1 || (uint64_t)width > XXHASH_CMS_MAXWIDTH) {
+        PyErr_Format(PyExc_ValueError,
+            "CountMinSketch() width must be between 1 and %llu",
+            (unsigned long long)XXHASH_CMS_MAXWIDTH);
+        return NULL;
+    }
+    if (depth < 1 || depth > XXHASH_CMS_MAXDEPTH) {
+        PyErr_Format(PyExc_ValueError,
+            "CountMinSketch() depth must be between 1 and %d",
+            XXHASH_CMS_MAXDEPTH);
+        return NULL;
+    }
+
+    CountMinSketchObject *self = _cms_alloc(type, (uint64_t)width,
+                                            (uint32_t)depth);
+    if (self == NULL)
+        return NULL;
+    memcpy(self->header->magic, XXHASH_CMS_MAGIC, 8);
+    self->header->seed = seed;
+    self->header->flags = conservative ? XXHASH_CMS_CONSERVATIVE : 0;
+    self->sketch.conservative = conservative;
+    return (PyObject *)self;
+}
+
+static void
+CountMinSketch_dealloc(CountMinSketchObject *self)
+{
+    PyMem_RawFree(self->alloc);
+    if (self->lock)
+        PyThread_free_lock(self->lock);
+    PyTypeObject *tp = Py_TYPE(self);
+    tp->tp_free((PyObject *)self);
+    Py_DECREF(tp);
+}
+
+/* Take self->lock, letting other threads run while waiting. */
+static void
+_cms_acquire(CountMinSketchObject *self)
+{
+    if (!PyThread_acquire_lock(self->lock, NOWAIT_LOCK)) {
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(self->lock, WAIT_LOCK);
+        Py_END_ALLOW_THREADS
+    }
+}
+
+PyDoc_STRVAR(
+    CountMinSketch_frombytes_doc,
+    "frombytes(data) -> CountMinSketch\n\n"
+    "Return a copy of the sketch serialized in the bytes-like object data,\n"
+    "as made by bytes(sketch).");
+
+static PyObject *
+CountMinSketch_frombytes(PyTypeObject *type, PyObject *data)
+{
+    Py_buffer buf;
+    xxhash_cms_header header;
+
+    if (_get_buffer_or_str(data, &buf) < 0)
+        return NULL;
+    if ((size_t)buf.len >= sizeof(header))
+        memcpy(&header, buf.buf, sizeof(header));
+    if ((size_t)buf.len < sizeof(header)
+        || memcmp(header.magic, XXHASH_CMS_MAGIC, 8) != 0
+        || header.version != XXHASH_CMS_VERSION
+        || header.depth < 1 || header.depth > XXHASH_CMS_MAXDEPTH
+        || header.width < 1 || header.width > XXHASH_CMS_MAXWIDTH
+        || (header.flags & ~(uint32_t)XXHASH_CMS_CONSERVATIVE) != 0
+        || (uint64_t)buf.len - sizeof(header) != header.width * header.depth * 8) {
+        PyBuffer_Release(&buf);
+        PyErr_SetString(PyExc_ValueError, "data is not a CountMinSketch");
+        return NULL;
+    }
+
+    CountMinSketchObject *self = _cms_alloc(type, header.width, header.depth);
+    if (self != NULL) {
+        memcpy(self->header, buf.buf, self->size);
+        self->sketch.conservative =
+            (header.flags & XXHASH_CMS_CONSERVATIVE) != 0;
+    }
+    PyBuffer_Release(&buf);
+    return (PyObject *)self;
+}
+
+/* Hash one key with the sketch's seed. Returns 0, or -1 with exception
+ * set. */
+static int
+_cms_hash(CountMinSketchObject *self, PyObject *key, XXH128_hash_t *h)
+{
+    Py_buffer buf;
+
+    if (_get_buffer_or_str(key, &buf) < 0)
+        return -1;
+    *h = XXH3_128bits_withSeed(buf.buf, (size_t)buf.len, self->header->seed);
+    PyBuffer_Release(&buf);
+    return 0;
+}
+
+PyDoc_STRVAR(
+    CountMinSketch_add_doc,
+    "add(key, count=1)\n\n"
+    "Count the bytes-like object key count more times.");
+
+static PyObject *
+CountMinSketch_add(CountMinSketchObject *self, PyObject *const *args,
+                   Py_ssize_t nargs, PyObject *kwnames)
+{
+    static const char *const names[] = {"key", "count", NULL};
+    PyObject *argv[2];
+    uint64_t count = 1;
+    XXH128_hash_t h;
+
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, "add", names,
+                               2, 1, argv) < 0)
+        return NULL;
+    if (argv[1]) {
+        count = PyLong_AsUnsignedLongLong(argv[1]);
+        if (count == (uint64_t)-1 && PyErr_Occurred())
+            return NULL;
+    }
+    if (_cms_hash(self, argv[0], &h) < 0)
+        return NULL;
+    _cms_acquire(self);
+    _cms_add(&self->sketch, h, count);
+    self->header->total = _cms_saturating_add(self->header->total, count);
+    PyThread_release_lock(self->lock);
+    Py_RETURN_NONE;
+}
+
+#define XXHASH_CMS_WEIGHTS(type)                                              \
+    do {                                                                      \
+        const type *w = view.buf;                                             \
+        for (Py_ssize_t i = 0; i < n; i++) {                                  \
+            weights[i] = w[i];                                                \
+        }                                                                     \
+    } while (0)
+#define XXHASH_CMS_SIGNED_WEIGHTS(type)                                       \
+    do {                                                                      \
+        const type *w = view.buf;                                             \
+        for (Py_ssize_t i = 0; i < n; i++) {                                  \
+            negative |= w[i] < 0;                                             \
+            weights[i] = (uint64_t)w[i];                                      \
+        }                                                                     \
+    } while (0)
+
+/* Convert the weights argument of add_many() for n keys to a new array of
+ * uint64. obj is a buffer of integers or a sequence of ints. Returns the
+ * array, or NULL with exception set. */
+static uint64_t *
+_cms_get_weights(PyObject *obj, Py_ssize_t n, const char *funcname)
+{
+    uint64_t *weights = PyMem_New(uint64_t, n ? n : 1);
+    if (weights == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    if (PyObject_CheckBuffer(obj)) {
+        Py_buffer view;
+        int negative = 0;
+
+        if (PyObject_GetBuffer(obj, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0)
+            goto error;
+        const char *format = view.format ? view.format : "B";
+        if (*format == '@' || *format == '=')
+            format++;
+#if PY_LITTLE_ENDIAN
+        else if (*format == '<')
+            format++;
+#else
+        else if (*format == '>' || *format == '!')
+            format++;
+#endif
+        char code = format[0] != '\0' && format[1] == '\0' ? format[0] : 0;
+        if (view.ndim > 1 || code == 0 || !strchr("bBhHiIlLqQnN", code)) {
+            PyErr_Format(PyExc_TypeError,
+                "%s() weights must be a one-dimensional buffer of native "
+                "integers, not format '%s'", funcname,
+                view.format ? view.format : "B");
+            PyBuffer_Release(&view);
+            goto error;
+        }
+        if (view.len / view.itemsize != n) {
+            PyErr_Format(PyExc_ValueError,
+                "%s() got %zd weights for %zd keys", funcname,
+                view.len / view.itemsize, n);
+            PyBuffer_Release(&view);
+            goto error;
+        }
+        int is_signed = Py_ISLOWER(code);
+        switch (view.itemsize * (is_signed ? -1 : 1)) {
+        case 1: XXHASH_CMS_WEIGHTS(uint8_t); break;
+        case 2: XXHASH_CMS_WEIGHTS(uint16_t); break;
+        case 4: XXHASH_CMS_WEIGHTS(uint32_t); break;
+        case 8: XXHASH_CMS_WEIGHTS(uint64_t); break;
+        case -1: XXHASH_CMS_SIGNED_WEIGHTS(int8_t); break;
+        case -2: XXHASH_CMS_SIGNED_WEIGHTS(int16_t); break;
+        case -4: XXHASH_CMS_SIGNED_WEIGHTS(int32_t); break;
+        case -8: XXHASH_CMS_SIGNED_WEIGHTS(int64_t); break;
+        }
+        PyBuffer_Release(&view);
+        if (negative) {
+            PyErr_Format(PyExc_ValueError,
+                "%s() weights must not be negative", funcname);
+            goto error;
+        }
+        return weights;
     }
-    return ret;
+
+    PyObject *seq = PySequence_Fast(obj,
+        "weights must be a sequence of ints or an integer buffer");
+    if (seq == NULL)
+        goto error;
+    if (PySequence_Fast_GET_SIZE(seq) != n) {
+        PyErr_Format(PyExc_ValueError,
+            "%s() got %zd weights for %zd keys", funcname,
+            PySequence_Fast_GET_SIZE(seq), n);
+        Py_DECREF(seq);
+        goto error;
+    }
+    PyObject **items = PySequence_Fast_ITEMS(seq);
+    for (Py_ssize_t i = 0; i < n; i++) {
+        weights[i] = PyLong_AsUnsignedLongLong(items[i]);
+        if (weights[i] == (uint64_t)-1 && PyErr_Occurred()) {
+            Py_DECREF(seq);
+            goto error;
+        }
+    }
+    Py_DECREF(seq);
+    return weights;
+
+error:
+    PyMem_Free(weights);
+    return NULL;
 }
 
+#undef XXHASH_CMS_WEIGHTS
+#undef XXHASH_CMS_SIGNED_WEIGHTS
+
 PyDoc_STRVAR(
-    PYXXH3_64_intdigest_doc,
-    "intdigest() -> int\n\n"
-    "Like digest(), but returns the digest as an integer, which is the integer\n"
-    "returned by the xxHash C API.");
+    CountMinSketch_add_many_doc,
+    "add_many(keys, offsets=None, *, weights=None)\n\n"
+    "Count every key in keys, a sequence of bytes-like objects or a buffer\n"
+    "such as an integer array whose items (or rows) are the keys. With\n"
+    "offsets, count the variable-length keys stored back to back in the\n"
+    "buffer keys, as taken by xxh3_64_hash_offsets().\n\n"
+    "weights, if given, is a sequence of ints or an integer array holding\n"
+    "how many times to count each key; otherwise each is counted once.");
 
-static PyObject *PYXXH3_64_intdigest(PYXXH3_64Object *self)
+static PyObject *
+CountMinSketch_add_many(CountMinSketchObject *self, PyObject *const *args,
+                        Py_ssize_t nargs, PyObject *kwnames)
 {
-    XXHASH_LOCK_ACQUIRE(self);
-    XXH64_hash_t intdigest = XXH3_64bits_digest(self->xxhash_state);
-    XXHASH_LOCK_RELEASE(self);
-    return PyLong_FromUnsignedLongLong(intdigest);
+    static const char *const names[] = {
+        "keys", "offsets", "weights", NULL,
+    };
+    PyObject *argv[3];
+    xxhash_keys keys;
+    uint64_t *weights = NULL;
+
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, "add_many", names,
+                               2, 1, argv) < 0)
+        return NULL;
+    if (_get_keys(argv[0], argv[1], &keys, "add_many") < 0)
+        return NULL;
+    if (argv[2] && argv[2] != Py_None
+        && (weights = _cms_get_weights(argv[2], keys.n, "add_many")) == NULL) {
+        _keys_release(&keys);
+        return NULL;
+    }
+
+    _cms_acquire(self);
+    keys.job.algo = XXHASH_ALGO_XXH3_128;
+    keys.job.seed = self->header->seed;
+    xxhash_cms_job job = {
+        .sketch = self->sketch, .keys = &keys.job, .weights = weights,
+    };
+    /* One thread: adds would race on the counters. */
+    _run_task(PyType_GetModule(Py_TYPE(self)), _cms_add_task, &job,
+              keys.n, XXHASH_SKETCH_COST(&keys), 1);
+    self->header->total = _cms_saturating_add(self->header->total, job.total);
+    PyThread_release_lock(self->lock);
+
+    PyMem_Free(weights);
+    _keys_release(&keys);
+    Py_RETURN_NONE;
 }
 
 PyDoc_STRVAR(
-    PYXXH3_64_copy_doc,
-    "copy() -> xxh3_64 object\n\n"
-    "Return a copy of the xxh3_64 object.");
+    CountMinSketch_estimate_doc,
+    "estimate(key) -> int\n\n"
+    "Return the estimated count of the bytes-like object key. It is never\n"
+    "below the true count.");
 
-static PyObject *PYXXH3_64_copy(PYXXH3_64Object *self)
+static PyObject *
+CountMinSketch_estimate(CountMinSketchObject *self, PyObject *key)
 {
-    PYXXH3_64Object *p;
+    XXH128_hash_t h;
 
-    if ((p = (PYXXH3_64Object *)Py_TYPE(self)->tp_alloc(Py_TYPE(self), 0)) == NULL) {
+    if (_cms_hash(self, key, &h) < 0)
         return NULL;
-    }
+    _cms_acquire(self);
+    uint64_t est = _cms_estimate(&self->sketch, h);
+    PyThread_release_lock(self->lock);
+    return PyLong_FromUnsignedLongLong(est);
+}
 
-    XXHASH_LOCK_INIT(p);
+PyDoc_STRVAR(
+    CountMinSketch_estimate_many_doc,
+    "estimate_many(keys, offsets=None, *, out=None, nthreads=None)\n"
+    "    -> list of int\n\n"
+    "Return the estimated count of every key in keys, given as to\n"
+    "add_many().\n\n"
+    "If out is given, the estimates are written into that writable buffer\n"
+    "as native-endian uint64 instead, and out is returned.\n\n"
+    XXHASH_NTHREADS_DOC);
 
-    if ((p->xxhash_state = XXH3_createState()) == NULL) {
-        Py_DECREF(p);
-        PyErr_NoMemory();
+static PyObject *
+CountMinSketch_estimate_many(CountMinSketchObject *self, PyObject *const *args,
+                             Py_ssize_t nargs, PyObject *kwnames)
+{
+    static const char *const names[] = {
+        "keys", "offsets", "out", "nthreads", NULL,
+    };
+    PyObject *argv[4];
+    xxhash_keys keys;
+    Py_buffer outview;
+    unsigned char *out;
+    PyObject *result = NULL;
+    int nthreads;
+
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, "estimate_many", names,
+                               2, 1, argv) < 0)
+        return NULL;
+    if (_parse_nthreads(PyType_GetModule(Py_TYPE(self)), argv[3],
+                        "estimate_many", &nthreads) < 0)
+        return NULL;
+    if (argv[2] == Py_None)
+        argv[2] = NULL;
+    if (_get_keys(argv[0], argv[1], &keys, "estimate_many") < 0)
+        return NULL;
+    if (_batch_out_init(argv[2], keys.n * 8, &outview, &out,
+                        "estimate_many") < 0) {
+        _keys_release(&keys);
         return NULL;
     }
 
-    XXHASH_LOCK_ACQUIRE(self);
-    p->seed = self->seed;
-    XXH3_copyState(p->xxhash_state, self->xxhash_state);
-#if XXH_VERSION_NUMBER < 704
-    // v0.7.3 and earlier have a bug where states reset with a seed
-    // will have a wild pointer to the original state when copied,
-    // causing a use-after-free if the original is freed.
-    if (p->xxhash_state->secret == &self->xxhash_state->customSecret[0])
-        p->xxhash_state->secret = &p->xxhash_state->customSecret[0];
-#endif
-    XXHASH_LOCK_RELEASE(self);
+    _cms_acquire(self);
+    keys.job.algo = XXHASH_ALGO_XXH3_128;
+    keys.job.seed = self->header->seed;
+    xxhash_cms_job job = {
+        .sketch = self->sketch, .keys = &keys.job, .out = out,
+    };
+    _run_task(PyType_GetModule(Py_TYPE(self)), _cms_estimate_task, &job,
+              keys.n, XXHASH_SKETCH_COST(&keys), nthreads);
+    PyThread_release_lock(self->lock);
+
+    if (argv[2]) {
+        Py_INCREF(argv[2]);
+        result = argv[2];
+    } else if ((result = PyList_New(keys.n)) != NULL) {
+        for (Py_ssize_t i = 0; i < keys.n; i++) {
+            uint64_t est;
+            memcpy(&est, out + i * 8, 8);
+            PyObject *item = PyLong_FromUnsignedLongLong(est);
+            if (item == NULL) {
+                Py_CLEAR(result);
+                break;
+            }
+            PyList_SET_ITEM(result, i, item);
+        }
+    }
 
-    return (PyObject *)p;
+    _batch_out_release(&outview, out);
+    _keys_release(&keys);
+    return result;
 }
 
 PyDoc_STRVAR(
-    PYXXH3_64_reset_doc,
-    "reset()\n\n"
-    "Reset state.");
+    CountMinSketch_merge_doc,
+    "merge(other)\n\n"
+    "Add the counts of other, a CountMinSketch of the same width, depth and\n"
+    "seed, to this sketch.");
 
-static PyObject *PYXXH3_64_reset(PYXXH3_64Object *self)
+static PyObject *
+CountMinSketch_merge(CountMinSketchObject *self, PyObject *arg)
 {
-    XXHASH_LOCK_ACQUIRE(self);
-    XXH3_64bits_reset_withSeed(self->xxhash_state, self->seed);
-    XXHASH_LOCK_RELEASE(self);
+    if (!PyObject_TypeCheck(arg, Py_TYPE(self))) {
+        PyErr_Format(PyExc_TypeError,
+            "merge() argument must be a CountMinSketch, not '%.200s'",
+            Py_TYPE(arg)->tp_name);
+        return NULL;
+    }
+    CountMinSketchObject *other = (CountMinSketchObject *)arg;
+    if (other->sketch.width != self->sketch.width
+        || other->sketch.depth != self->sketch.depth
+        || other->header->seed != self->header->seed) {
+        PyErr_SetString(PyExc_ValueError,
+            "merge() needs a CountMinSketch of the same width, depth and seed");
+        return NULL;
+    }
+
+    /* Lock in address order, so that a.merge(b) and b.merge(a) running at
+     * once cannot deadlock. */
+    CountMinSketchObject *first = self < other ? self : other;
+    CountMinSketchObject *second = self < other ? other : self;
+    _cms_acquire(first);
+    if (second != first)
+        _cms_acquire(second);
+    uint64_t *dst = self->sketch.counters;
+    const uint64_t *src = other->sketch.counters;
+    size_t ncounters = (size_t)(self->sketch.width * self->sketch.depth);
+    Py_BEGIN_ALLOW_THREADS
+    for (size_t i = 0; i < ncounters; i++) {
+        dst[i] = _cms_saturating_add(dst[i], src[i]);
+    }
+    Py_END_ALLOW_THREADS
+    self->header->total = _cms_saturating_add(self->header->total,
+                                              other->header->total);
+    if (second != first)
+        PyThread_release_lock(second->lock);
+    PyThread_release_lock(first->lock);
     Py_RETURN_NONE;
 }
 
-static PyMethodDef PYXXH3_64_methods[] = {
-    {"update", (PyCFunction)PYXXH3_64_update, METH_FASTCALL | METH_KEYWORDS, PYXXH3_64_update_doc},
-    {"digest", (PyCFunction)PYXXH3_64_digest, METH_NOARGS, PYXXH3_64_digest_doc},
-    {"hexdigest", (PyCFunction)PYXXH3_64_hexdigest, METH_NOARGS, PYXXH3_64_hexdigest_doc},
-    {"intdigest", (PyCFunction)PYXXH3_64_intdigest, METH_NOARGS, PYXXH3_64_intdigest_doc},
-    {"copy", (PyCFunction)PYXXH3_64_copy, METH_NOARGS, PYXXH3_64_copy_doc},
-    {"reset", (PyCFunction)PYXXH3_64_reset, METH_NOARGS, PYXXH3_64_reset_doc},
+static int
+CountMinSketch_getbuffer(CountMinSketchObject *self, Py_buffer *view,
+                         int flags)
+{
+    return PyBuffer_FillInfo(view, (PyObject *)self, self->header,
+                             (Py_ssize_t)self->size, 1, flags);
+}
+
+static PyMethodDef CountMinSketch_methods[] = {
+    {"add", (PyCFunction)CountMinSketch_add, METH_FASTCALL | METH_KEYWORDS, CountMinSketch_add_doc},
+    {"add_many", (PyCFunction)CountMinSketch_add_many, METH_FASTCALL | METH_KEYWORDS, CountMinSketch_add_many_doc},
+    {"estimate", (PyCFunction)CountMinSketch_estimate, METH_O, CountMinSketch_estimate_doc},
+    {"estimate_many", (PyCFunction)CountMinSketch_estimate_many, METH_FASTCALL | METH_KEYWORDS, CountMinSketch_estimate_many_doc},
+    {"merge", (PyCFunction)CountMinSketch_merge, METH_O, CountMinSketch_merge_doc},
+    {"frombytes", (PyCFunction)CountMinSketch_frombytes, METH_O | METH_CLASS, CountMinSketch_frombytes_doc},
     {NULL, NULL, 0, NULL}
 };
 
-static PyObject *PYXXH3_64_get_block_size(PYXXH3_64Object *self, void *closure)
-{
-    return PyLong_FromLong(XXH64_BLOCKSIZE);
+static PyObject *
+CountMinSketch_get_width(CountMinSketchObject *self, void *closure)
+{
+    return PyLong_FromUnsignedLongLong(self->sketch.width);
+}
+
+static PyObject *
+CountMinSketch_get_depth(CountMinSketchObject *self, void *closure)
+{
+    return PyLong_FromUnsignedLong(self->sketch.depth);
+}
+
+static PyObject *
+CountMinSketch_get_seed(CountMinSketchObject *self, void *closure)
+{
+    return PyLong_FromUnsignedLongLong(self->header->seed);
+}
+
+static PyObject *
+CountMinSketch_get_conservative(CountMinSketchObject *self, void *closure)
+{
+    return PyBool_FromLong(self->sketch.conservative);
+}
+
+static PyObject *
+CountMinSketch_get_total(CountMinSketchObject *self, void *closure)
+{
+    _cms_acquire(self);
+    uint64_t total = self->header->total;
+    PyThread_release_lock(self->lock);
+    return PyLong_FromUnsignedLongLong(total);
+}
+
+static PyGetSetDef CountMinSketch_getseters[] = {
+    {
+        "width",
+        (getter)CountMinSketch_get_width, NULL,
+        "Number of counters per row.",
+        NULL
+    },
+    {
+        "depth",
+        (getter)CountMinSketch_get_depth, NULL,
+        "Number of rows.",
+        NULL
+    },
+    {
+        "seed",
+        (getter)CountMinSketch_get_seed, NULL,
+        "Seed keys are hashed with.",
+        NULL
+    },
+    {
+        "conservative",
+        (getter)CountMinSketch_get_conservative, NULL,
+        "Whether adds use conservative update.",
+        NULL
+    },
+    {
+        "total",
+        (getter)CountMinSketch_get_total, NULL,
+        "Sum of the counts added, including merged sketches.",
+        NULL
+    },
+    {NULL}  /* Sentinel */
+};
+
+PyDoc_STRVAR(
+    CountMinSketchType_doc,
+    "CountMinSketch(width, depth=4, seed=0, *, conservative=False)\n"
+    "\n"
+    "A Count-Min sketch estimating how many times each bytes-like key was\n"
+    "counted, in depth rows of width 64-bit counters. Keys are hashed once\n"
+    "with XXH3_128 and the given seed. Estimates are never below the true\n"
+    "count, and exceed it by more than e / width * total with probability\n"
+    "at most exp(-depth).\n"
+    "\n"
+    "With conservative=True, an add raises only the counters below the\n"
+    "key's new estimate, which makes estimates tighter. Sketches export\n"
+    "their serialized form through the buffer protocol, which bytes(sketch)\n"
+    "copies and CountMinSketch.frombytes() reads back.");
+
+static PyType_Slot CountMinSketchType_slots[] = {
+    {Py_tp_dealloc, CountMinSketch_dealloc},
+    {Py_tp_doc, (void *)CountMinSketchType_doc},
+    {Py_tp_methods, CountMinSketch_methods},
+    {Py_tp_getset, CountMinSketch_getseters},
+    {Py_tp_new, CountMinSketch_new},
+    {Py_bf_getbuffer, CountMinSketch_getbuffer},
+    {0, NULL},
+};
+
+static PyType_Spec CountMinSketchType_spec = {
+    .name = "xxhash.CountMinSketch",
+    .basicsize = sizeof(CountMinSketchObject),
+    .flags = Py_TPFLAGS_DEFAULT
+#if PY_VERSION_HEX >= 0x030c0000
+           | Py_TPFLAGS_IMMUTABLETYPE
+#endif
+    ,
+    .slots = CountMinSketchType_slots,
+};
+
+/* MinHash signatures. A document's shingles are its runs of `shingle`
+ * consecutive bytes, or of `shingle` consecutive tokens; a document
+ * shorter than that is a single shingle, and an empty one has none.
+ * A byte shingle is hashed with XXH3_64. A token shingle is hashed as the
+ * concatenation of the little-endian XXH3_64 digests of its tokens, also
+ * with XXH3_64. Both hashes use the seed.
+ *
+ * Permutation i maps a shingle hash x to a_i * x + b_i mod 2**64, where
+ * a_i (made odd) and b_i are successive splitmix64 values from the seed.
+ * Signature value i is the least image of the document's shingles, or
+ * 2**64 - 1 if it has none. */
+#define XXHASH_MINHASH_MAXPERM  1024
+
+/* A document of a MinHash batch: bytes, or the little-endian digests of
+ * its tokens. len counts bytes or tokens. */
+typedef struct {
+    const unsigned char *data;
+    Py_ssize_t len;
+    int tokens;
+} xxhash_minhash_doc;
+
+typedef struct {
+    const uint64_t *a;
+    const uint64_t *b;
+    int k;
+    int shingle;
+    XXH64_hash_t seed;
+    const xxhash_minhash_doc *docs;
+    unsigned char *out;     /* k native uint64 per document */
+} xxhash_minhash_job;
+
+/* Lower sig[i] to the least a[i] * h[j] + b[i] over j < n, through the
+ * SIMD backend's kernel when there is one. */
+static void
+_minhash_update(uint64_t *sig, const uint64_t *a, const uint64_t *b, int k,
+                const uint64_t *h, Py_ssize_t n)
+{
+#ifdef XXHASH_DISPATCH
+    xxhash_minhash_update_dispatch(sig, a, b, (size_t)k, h, (size_t)n);
+#else
+    for (int i = 0; i < k; i++) {
+        uint64_t ai = a[i], bi = b[i];
+        uint64_t m0 = sig[i], m1 = m0, m2 = m0, m3 = m0;
+        Py_ssize_t j = 0;
+        /* Four running minima, to keep the multipliers busy. */
+        for (; j + 4 <= n; j += 4) {
+            uint64_t v0 = ai * h[j] + bi, v1 = ai * h[j + 1] + bi;
+            uint64_t v2 = ai * h[j + 2] + bi, v3 = ai * h[j + 3] + bi;
+            m0 = v0 < m0 ? v0 : m0;
+            m1 = v1 < m1 ? v1 : m1;
+            m2 = v2 < m2 ? v2 : m2;
+            m3 = v3 < m3 ? v3 : m3;
+        }
+        for (; j < n; j++) {
+            uint64_t v = ai * h[j] + bi;
+            m0 = v < m0 ? v : m0;
+        }
+        m0 = m1 < m0 ? m1 : m0;
+        m2 = m3 < m2 ? m3 : m2;
+        sig[i] = m2 < m0 ? m2 : m0;
+    }
+#endif
+}
+
+static void
+_minhash_task(void *arg, Py_ssize_t start, Py_ssize_t end)
+{
+    const xxhash_minhash_job *job = arg;
+    uint64_t sig[XXHASH_MINHASH_MAXPERM];
+    XXH64_hash_t h[XXHASH_SKETCH_CHUNK];
+
+    for (Py_ssize_t d = start; d < end; d++) {
+        const xxhash_minhash_doc *doc = &job->docs[d];
+        Py_ssize_t unit = doc->tokens ? 8 : 1;
+        Py_ssize_t width = doc->len < job->shingle ? doc->len : job->shingle;
+        Py_ssize_t nshingles = doc->len ? doc->len - width + 1 : 0;
+        /* Shingles overlap: each starts one unit after the previous. */
+        xxhash_batch shingles = {
+            .algo = XXHASH_ALGO_XXH3_64, .seed = job->seed,
+            .src = XXHASH_SRC_STRIDED, .base = doc->data, .stride = unit,
+            .length = width * unit,
+        };
+
+        for (int i = 0; i < job->k; i++) {
+            sig[i] = UINT64_MAX;
+        }
+        for (Py_ssize_t j = 0; j < nshingles; j += XXHASH_SKETCH_CHUNK) {
+            Py_ssize_t n = nshingles - j < XXHASH_SKETCH_CHUNK
+                           ? nshingles - j : XXHASH_SKETCH_CHUNK;
+            _batch_hash_at(&shingles, j, n, h);
+            _minhash_update(sig, job->a, job->b, job->k, h, n);
+        }
+        memcpy(job->out + d * job->k * 8, sig, (size_t)job->k * 8);
+    }
+}
+
+/* The documents of a MinHash call and what they hold. */
+typedef struct {
+    Py_ssize_t n;
+    Py_ssize_t total;           /* bytes and tokens of all documents */
+    xxhash_minhash_doc *docs;
+    PyObject *seq;              /* the sequence, if documents are objects */
+    Py_buffer *views;           /* per document given as a bytes-like object */
+    unsigned char *digests;     /* token digests of all documents */
+    Py_ssize_t ndigests;
+    xxhash_keys keys;           /* documents given as a buffer */
+    int has_keys;
+} xxhash_minhash_input;
+
+static void
+_minhash_input_release(xxhash_minhash_input *in)
+{
+    if (in->views) {
+        for (Py_ssize_t i = 0; i < in->n; i++) {
+            PyBuffer_Release(&in->views[i]);
+        }
+        PyMem_Free(in->views);
+    }
+    if (in->has_keys)
+        _keys_release(&in->keys);
+    Py_XDECREF(in->seq);
+    PyMem_Free(in->docs);
+    PyMem_Free(in->digests);
+}
+
+/* Hash the tokens of the i-th document, the sequence obj, into
+ * in->digests. Shingles depend on token order, so sets, dicts and other
+ * unordered iterables are refused: the signature of a set of str would
+ * change with PYTHONHASHSEED. Returns 0, or -1 with exception set. */
+static int
+_minhash_tokens(xxhash_minhash_input *in, Py_ssize_t i, PyObject *obj,
+                XXH64_hash_t seed, const char *funcname)
+{
+    if (!PySequence_Check(obj)) {
+        PyErr_Format(PyExc_TypeError,
+            "%s() documents must be bytes-like objects or sequences of "
+            "tokens, not '%.200s'", funcname, Py_TYPE(obj)->tp_name);
+        return -1;
+    }
+    PyObject *tokens = PySequence_Fast(obj,
+        "documents must be bytes-like objects or sequences of tokens");
+    if (tokens == NULL)
+        return -1;
+    Py_ssize_t ntokens = PySequence_Fast_GET_SIZE(tokens);
+    unsigned char *digests = PyMem_Realloc(in->digests,
+                                           (size_t)(in->ndigests + ntokens) * 8
+                                           + 1);
+    if (digests == NULL) {
+        Py_DECREF(tokens);
+        PyErr_NoMemory();
+        return -1;
+    }
+    in->digests = digests;
+
+    PyObject **items = PySequence_Fast_ITEMS(tokens);
+    for (Py_ssize_t t = 0; t < ntokens; t++) {
+        XXH128_hash_t h;
+        if (PyUnicode_Check(items[t])) {
+#if PY_VERSION_HEX < 0x030C0000
+            if (PyUnicode_READY(items[t]) < 0)
+                goto error;
+#endif
+            if (_xxh3_str_nogil(items[t], XXHASH_ALGO_XXH3_64, seed, &h) < 0) {
+                _str_utf8_error(items[t], funcname);
+                goto error;
+            }
+        } else {
+            Py_buffer buf;
+            if (_get_buffer_or_str(items[t], &buf) < 0)
+                goto error;
+            h.low64 = XXH3_64bits_withSeed(buf.buf, (size_t)buf.len, seed);
+            PyBuffer_Release(&buf);
+        }
+        unsigned char *p = digests + (in->ndigests + t) * 8;
+        for (int b = 0; b < 8; b++) {
+            p[b] = (unsigned char)(h.low64 >> (8 * b));
+        }
+    }
+    Py_DECREF(tokens);
+    /* data is set once all documents are in, as digests may move. */
+    in->docs[i].len = ntokens;
+    in->docs[i].tokens = 1;
+    in->ndigests += ntokens;
+    in->total += ntokens;
+    return 0;
+
+error:
+    Py_DECREF(tokens);
+    return -1;
+}
+
+/* Read one document, obj, as the i-th of in. Returns 0, or -1 with
+ * exception set. */
+static int
+_minhash_doc(xxhash_minhash_input *in, Py_ssize_t i, PyObject *obj,
+             XXH64_hash_t seed, const char *funcname)
+{
+    if (PyUnicode_Check(obj)) {
+        PyErr_Format(PyExc_TypeError,
+            "%s() documents must be encoded before hashing, or be "
+            "sequences of str tokens", funcname);
+        return -1;
+    }
+    if (!PyObject_CheckBuffer(obj))
+        return _minhash_tokens(in, i, obj, seed, funcname);
+    if (_get_buffer_or_str(obj, &in->views[i]) < 0)
+        return -1;
+    in->docs[i].data = in->views[i].buf;
+    in->docs[i].len = in->views[i].len;
+    in->total += in->views[i].len;
+    return 0;
+}
+
+/* Acquire the documents of a MinHash call: the single document obj if
+ * single is set, else the documents in obj, or in obj and offsets as
+ * taken by xxh3_64_hash_offsets(). Token digests are computed here, with
+ * the GIL held. Returns 0, or -1 with exception set and nothing held. */
+static int
+_get_minhash_input(PyObject *obj, PyObject *offsets, int single,
+                   XXH64_hash_t seed, xxhash_minhash_input *in,
+                   const char *funcname)
+{
+    memset(in, 0, sizeof(*in));
+    if (!single && ((offsets && offsets != Py_None)
+                    || (PyObject_CheckBuffer(obj) && !PyBytes_Check(obj)
+                        && !PyByteArray_Check(obj)))) {
+        if (_get_keys(obj, offsets, &in->keys, funcname) < 0)
+            return -1;
+        in->has_keys = 1;
+        in->n = in->keys.n;
+        in->total = in->keys.total;
+        if ((in->docs = PyMem_New(xxhash_minhash_doc, in->n ? in->n : 1)) == NULL) {
+            _minhash_input_release(in);
+            PyErr_NoMemory();
+            return -1;
+        }
+        for (Py_ssize_t i = 0; i < in->n; i++) {
+            size_t len;
+            in->docs[i].data = _batch_input(&in->keys.job, i, &len);
+            in->docs[i].len = (Py_ssize_t)len;
+            in->docs[i].tokens = 0;
+        }
+        return 0;
+    }
+
+    PyObject *const *items = &obj;
+    if (single) {
+        in->n = 1;
+    } else {
+        if (PyBytes_Check(obj) || PyByteArray_Check(obj) || PyUnicode_Check(obj)) {
+            PyErr_Format(PyExc_TypeError,
+                "%s() expects a sequence of documents, not a single '%.200s'",
+                funcname, Py_TYPE(obj)->tp_name);
+            return -1;
+        }
+        in->seq = PySequence_Fast(obj,
+            "documents must be a sequence or a buffer");
+        if (in->seq == NULL)
+            return -1;
+        in->n = PySequence_Fast_GET_SIZE(in->seq);
+        items = PySequence_Fast_ITEMS(in->seq);
+    }
+    in->docs = PyMem_New(xxhash_minhash_doc, in->n ? in->n : 1);
+    in->views = PyMem_New(Py_buffer, in->n ? in->n : 1);
+    if (in->docs == NULL || in->views == NULL) {
+        PyMem_Free(in->views);
+        in->views = NULL;
+        _minhash_input_release(in);
+        PyErr_NoMemory();
+        return -1;
+    }
+    memset(in->docs, 0, sizeof(*in->docs) * (size_t)in->n);
+    for (Py_ssize_t i = 0; i < in->n; i++) {
+        in->views[i].obj = NULL;
+    }
+    for (Py_ssize_t i = 0; i < in->n; i++) {
+        if (_minhash_doc(in, i, items[i], seed, funcname) < 0) {
+            _minhash_input_release(in);
+            return -1;
+        }
+    }
+
+    unsigned char *digests = in->digests;
+    for (Py_ssize_t i = 0; i < in->n; i++) {
+        if (in->docs[i].tokens) {
+            in->docs[i].data = digests;
+            digests += in->docs[i].len * 8;
+        }
+    }
+    return 0;
+}
+
+/* Parse num_perm, shingle and seed, and fill the permutations of job.
+ * Returns 0, or -1 with exception set. */
+static int
+_minhash_params(PyObject *num_perm, PyObject *shingle, PyObject *seed,
+                xxhash_minhash_job *job, uint64_t *perms,
+                const char *funcname)
+{
+    long k = 128, w = 5;
+    uint64_t state = 0;
+
+    if (num_perm && (k = PyLong_AsLong(num_perm)) == -1 && PyErr_Occurred())
+        return -1;
+    if (shingle && (w = PyLong_AsLong(shingle)) == -1 && PyErr_Occurred())
+        return -1;
+    if (seed) {
+        state = (uint64_t)PyLong_AsUnsignedLongLongMask(seed);
+        if (PyErr_Occurred())
+            return -1;
+    }
+    if (k < 1 || k > XXHASH_MINHASH_MAXPERM) {
+        PyErr_Format(PyExc_ValueError,
+            "%s() num_perm must be between 1 and %d", funcname,
+            XXHASH_MINHASH_MAXPERM);
+        return -1;
+    }
+    if (w < 1 || w > INT_MAX / 8) {
+        PyErr_Format(PyExc_ValueError,
+            "%s() shingle must be between 1 and %d", funcname, INT_MAX / 8);
+        return -1;
+    }
+
+    job->k = (int)k;
+    job->shingle = (int)w;
+    job->seed = state;
+    job->a = perms;
+    job->b = perms + k;
+    for (long i = 0; i < k; i++) {
+        perms[i] = _splitmix64(&state) | 1;
+        perms[k + i] = _splitmix64(&state);
+    }
+    return 0;
+}
+
+/* The signatures in out as a list of k ints, or a list of n such lists if
+ * many is set. */
+static PyObject *
+_minhash_result(const unsigned char *out, Py_ssize_t n, int k, int many)
+{
+    PyObject *result = PyList_New(many ? n : k);
+    if (result == NULL)
+        return NULL;
+    for (Py_ssize_t d = 0; d < (many ? n : 1); d++) {
+        PyObject *sig = many ? PyList_New(k) : result;
+        if (sig == NULL)
+            goto error;
+        if (many)
+            PyList_SET_ITEM(result, d, sig);
+        for (int i = 0; i < k; i++) {
+            uint64_t v;
+            memcpy(&v, out + (d * k + i) * 8, 8);
+            PyObject *item = PyLong_FromUnsignedLongLong(v);
+            if (item == NULL)
+                goto error;
+            PyList_SET_ITEM(sig, i, item);
+        }
+    }
+    return result;
+
+error:
+    Py_DECREF(result);
+    return NULL;
 }
 
+/* Shared implementation of minhash() and minhash_many(). */
 static PyObject *
-PYXXH3_64_get_digest_size(PYXXH3_64Object *self, void *closure)
+_xxhash_minhash(PyObject *module, PyObject *docs, PyObject *offsets,
+                PyObject *const *params, PyObject *outobj, int nthreads,
+                int many, const char *funcname)
 {
-    return PyLong_FromLong(XXH64_DIGESTSIZE);
+    uint64_t perms[2 * XXHASH_MINHASH_MAXPERM];
+    xxhash_minhash_job job;
+    xxhash_minhash_input in;
+    Py_buffer outview;
+    unsigned char *out;
+    PyObject *result = NULL;
+
+    if (outobj == Py_None)
+        outobj = NULL;
+    if (_minhash_params(params[0], params[1], params[2], &job, perms,
+                        funcname) < 0)
+        return NULL;
+    if (_get_minhash_input(docs, offsets, !many, job.seed, &in, funcname) < 0)
+        return NULL;
+    if (_batch_out_init(outobj, in.n * job.k * 8, &outview, &out,
+                        funcname) < 0) {
+        _minhash_input_release(&in);
+        return NULL;
+    }
+
+    job.docs = in.docs;
+    job.out = out;
+    /* A shingle costs about what hashing num_perm bytes does. */
+    Py_ssize_t cost = (in.total + in.n) > PY_SSIZE_T_MAX / job.k
+                      ? PY_SSIZE_T_MAX : (in.total + in.n) * job.k;
+    _run_task(module, _minhash_task, &job, in.n, cost, nthreads);
+
+    if (outobj) {
+        Py_INCREF(outobj);
+        result = outobj;
+    } else {
+        result = _minhash_result(out, in.n, job.k, many);
+    }
+    _batch_out_release(&outview, out);
+    _minhash_input_release(&in);
+    return result;
 }
 
+PyDoc_STRVAR(
+    minhash_doc,
+    "minhash(data, num_perm=128, shingle=5, seed=0, *, out=None)\n"
+    "    -> list of int\n\n"
+    "Return the MinHash signature of a document: num_perm 64-bit values,\n"
+    "the fraction of which two documents share estimates the Jaccard\n"
+    "similarity of their sets of shingles.\n\n"
+    "data is a bytes-like object, whose shingles are its runs of shingle\n"
+    "consecutive bytes, or a sequence of tokens (bytes-like objects or str,\n"
+    "hashed as UTF-8), whose shingles are runs of shingle consecutive\n"
+    "tokens; sets and other unordered collections are refused, as their\n"
+    "order is not stable. Each shingle is hashed once with XXH3_64 and the\n"
+    "seed, then permuted num_perm times by multiply-add.\n\n"
+    "If out is given, the signature is written into that writable buffer\n"
+    "as native-endian uint64 instead, and out is returned.");
+
 static PyObject *
-PYXXH3_64_get_name(PYXXH3_64Object *self, void *closure)
+minhash(PyObject *module, PyObject *const *args, Py_ssize_t nargs,
+        PyObject *kwnames)
 {
-    return PyUnicode_FromString("XXH3_64");
+    static const char *const names[] = {
+        "data", "num_perm", "shingle", "seed", "out", NULL,
+    };
+    PyObject *argv[5];
+
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, "minhash", names,
+                               4, 1, argv) < 0)
+        return NULL;
+    return _xxhash_minhash(module, argv[0], NULL, &argv[1], argv[4], 1, 0,
+                           "minhash");
 }
 
+PyDoc_STRVAR(
+    minhash_many_doc,
+    "minhash_many(documents, num_perm=128, shingle=5, seed=0, *,\n"
+    "             offsets=None, out=None, nthreads=None) -> list of list\n\n"
+    "Return the MinHash signature of every document, as minhash() does.\n"
+    "documents is a sequence of bytes-like objects or token sequences, or,\n"
+    "with offsets, a buffer holding the documents back to back, as taken by\n"
+    "xxh3_64_hash_offsets().\n\n"
+    "If out is given, the signatures are written into that writable buffer\n"
+    "back to back, as native-endian uint64, instead, and out is returned.\n\n"
+    XXHASH_NTHREADS_DOC);
+
 static PyObject *
-PYXXH3_64_get_seed(PYXXH3_64Object *self, void *closure)
+minhash_many(PyObject *module, PyObject *const *args, Py_ssize_t nargs,
+             PyObject *kwnames)
 {
-    return PyLong_FromUnsignedLongLong(self->seed);
+    static const char *const names[] = {
+        "documents", "num_perm", "shingle", "seed", "offsets", "out",
+        "nthreads", NULL,
+    };
+    PyObject *argv[7];
+    int nthreads;
+
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, "minhash_many", names,
+                               4, 1, argv) < 0)
+        return NULL;
+    if (_parse_nthreads(module, argv[6], "minhash_many", &nthreads) < 0)
+        return NULL;
+    return _xxhash_minhash(module, argv[0], argv[4], &argv[1], argv[5],
+                           nthreads, 1, "minhash_many");
 }
 
-static PyGetSetDef PYXXH3_64_getseters[] = {
-    {
-        "digest_size",
-        (getter)PYXXH3_64_get_digest_size, NULL,
-        "Digest size.",
-        NULL
-    },
-    {
-        "block_size",
-        (getter)PYXXH3_64_get_block_size, NULL,
-        "Block size.",
-        NULL
-    },
-    {
-        "name",
-        (getter)PYXXH3_64_get_name, NULL,
-        "Name. Always XXH3_64.",
-        NULL
-    },
-    {
-        "digestsize",
-        (getter)PYXXH3_64_get_digest_size, NULL,
-        "Digest size.",
-        NULL
-    },
-    {
-        "seed",
-        (getter)PYXXH3_64_get_seed, NULL,
-        "Seed.",
-        NULL
-    },
-    {NULL}  /* Sentinel */
-};
+/*****************************************************************************
+ * Consistent Hashing *********************************************************
+ ****************************************************************************/
 
-PyDoc_STRVAR(
-    PYXXH3_64Type_doc,
-    "An xxh3_64 represents the object used to calculate the XXH3_64 hash of a\n"
-    "bytes-like object.\n"
-    "\n"
-    "Methods:\n"
-    "\n"
-    "update(data) -- updates the current hash state with additional data\n"
-    "digest() -- return the current digest value\n"
-    "hexdigest() -- return the current digest as a string of hexadecimal digits\n"
-    "intdigest() -- return the current digest as an integer\n"
-    "copy() -- return a copy of the current xxh3_64 object");
+/* Key-to-shard assignment. Keys are hashed with XXH3_64 and the seed, and
+ * every function writes the shard of each key as a native uint32: a
+ * bucket number, or an index into the nodes it was given. */
 
-static PyType_Slot XXH3_64Type_slots[] = {
-    {Py_tp_dealloc, PYXXH3_64_dealloc},
-    {Py_tp_doc, (void *)PYXXH3_64Type_doc},
-    {Py_tp_methods, PYXXH3_64_methods},
-    {Py_tp_getset, PYXXH3_64_getseters},
-    {Py_tp_init, PYXXH3_64_init},
-    {Py_tp_new, PYXXH3_64_new},
-    {0, NULL},
-};
+/* Return the list of the n uint32 shard indices at out. */
+static PyObject *
+_shard_result(const unsigned char *out, Py_ssize_t n)
+{
+    PyObject *result = PyList_New(n);
+    if (result == NULL)
+        return NULL;
+    for (Py_ssize_t i = 0; i < n; i++) {
+        uint32_t index;
+        memcpy(&index, out + i * 4, 4);
+        PyObject *item = PyLong_FromUnsignedLong(index);
+        if (item == NULL) {
+            Py_DECREF(result);
+            return NULL;
+        }
+        PyList_SET_ITEM(result, i, item);
+    }
+    return result;
+}
 
-static PyType_Spec XXH3_64Type_spec = {
-    .name = "xxhash.xxh3_64",
-    .basicsize = sizeof(PYXXH3_64Object),
-    .flags = Py_TPFLAGS_DEFAULT
-#if PY_VERSION_HEX >= 0x030c0000
-           | Py_TPFLAGS_IMMUTABLETYPE
-#endif
-    ,
-    .slots = XXH3_64Type_slots,
-};
+/* Parse a seed argument, or leave *seed alone if it was not given.
+ * Returns 0, or -1 with exception set. */
+static int
+_shard_seed(PyObject *obj, XXH64_hash_t *seed)
+{
+    if (obj == NULL)
+        return 0;
+    *seed = (XXH64_hash_t)PyLong_AsUnsignedLongLongMask(obj);
+    return PyErr_Occurred() ? -1 : 0;
+}
 
-/* XXH3_128 */
+/* Jump consistent hash (Lamping and Veach, "A Fast, Minimal Memory,
+ * Consistent Hash Algorithm", 2014) of a key's XXH3_64 digest h. Going
+ * from n to n + 1 buckets moves 1 / (n + 1) of the keys, all to the new
+ * bucket, and the buckets take no memory. */
+static inline uint32_t
+_jump_hash(uint64_t h, uint32_t num_buckets)
+{
+    int64_t b = -1, j = 0;
+
+    while (j < (int64_t)num_buckets) {
+        b = j;
+        h = h * 2862933555777941757ULL + 1;
+        j = (int64_t)((double)(b + 1)
+                      * ((double)((int64_t)1 << 31) / (double)((h >> 33) + 1)));
+    }
+    return (uint32_t)b;
+}
 
 typedef struct {
-    PyObject_HEAD
-    XXH3_state_t *xxhash_state;
-    XXH64_hash_t seed;
-    XXHASH_LOCK_FIELD
-} PYXXH3_128Object;
+    const xxhash_batch *keys;
+    uint32_t num_buckets;
+    unsigned char *out;
+} xxhash_jump_job;
 
-static void PYXXH3_128_dealloc(PYXXH3_128Object *self)
+static void
+_jump_task(void *arg, Py_ssize_t start, Py_ssize_t end)
 {
-    if (self->xxhash_state)
-        XXH3_freeState(self->xxhash_state);
-    XXHASH_LOCK_FINI(self);
-    PyTypeObject *tp = Py_TYPE(self);
-    tp->tp_free((PyObject *)self);
-    Py_DECREF(tp);
+    const xxhash_jump_job *job = arg;
+    XXH64_hash_t h[XXHASH_SKETCH_CHUNK];
+
+    while (start < end) {
+        Py_ssize_t n = end - start < XXHASH_SKETCH_CHUNK
+                       ? end - start : XXHASH_SKETCH_CHUNK;
+        _batch_hash_at(job->keys, start, n, h);
+        for (Py_ssize_t i = 0; i < n; i++) {
+            uint32_t bucket = _jump_hash(h[i], job->num_buckets);
+            memcpy(job->out + (start + i) * 4, &bucket, 4);
+        }
+        start += n;
+    }
 }
 
-XXHASH_DO_UPDATE(XXH3_128, XXH3_128bits_update)
+PyDoc_STRVAR(
+    jump_hash_many_doc,
+    "jump_hash_many(keys, num_buckets, seed=0, *, offsets=None, out=None,\n"
+    "               nthreads=None) -> list of int\n\n"
+    "Return the bucket, in range(num_buckets), of every key in keys by jump\n"
+    "consistent hashing of its XXH3_64 digest. Growing num_buckets by one\n"
+    "moves the fewest possible keys, all to the new bucket. keys is a\n"
+    "sequence of bytes-like objects, a buffer such as an integer array whose\n"
+    "items (or rows) are the keys, or, with offsets, a buffer holding the\n"
+    "keys back to back, as taken by xxh3_64_hash_offsets().\n\n"
+    "If out is given, the buckets are written into that writable buffer as\n"
+    "native-endian uint32 instead, and out is returned.\n\n"
+    XXHASH_NTHREADS_DOC);
 
 static PyObject *
-PYXXH3_128_vectorcall(PyObject *type, PyObject *const *args,
-                      size_t nargsf, PyObject *kwnames)
+jump_hash_many(PyObject *module, PyObject *const *args, Py_ssize_t nargs,
+               PyObject *kwnames)
 {
-    Py_ssize_t nargs = PyVectorcall_NARGS(nargsf);
+    static const char *const names[] = {
+        "keys", "num_buckets", "seed", "offsets", "out", "nthreads", NULL,
+    };
+    PyObject *argv[6];
     XXH64_hash_t seed = 0;
-    Py_buffer buf;
-    unsigned long long raw_seed;
-
-    if (_parse_fastcall_args(args, nargs, kwnames, "xxhash.xxh3_128", 0,
-                             &buf, &raw_seed) < 0)
+    xxhash_keys keys;
+    Py_buffer outview;
+    unsigned char *out;
+    PyObject *result;
+    int nthreads;
+
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, "jump_hash_many", names,
+                               3, 2, argv) < 0)
         return NULL;
-    seed = (XXH64_hash_t)raw_seed;
-
-    PYXXH3_128Object *self = (PYXXH3_128Object *)
-        ((PyTypeObject *)type)->tp_alloc((PyTypeObject *)type, 0);
-    if (self == NULL) {
-        PyBuffer_Release(&buf);
+    Py_ssize_t num_buckets = PyLong_AsSsize_t(argv[1]);
+    if (num_buckets == -1 && PyErr_Occurred())
+        return NULL;
+    if (num_buckets < 1 || (uint64_t)num_buckets > UINT32_MAX) {
+        PyErr_Format(PyExc_ValueError,
+            "jump_hash_many() num_buckets must be between 1 and %lu",
+            (unsigned long)UINT32_MAX);
         return NULL;
     }
-
-    XXHASH_LOCK_INIT(self);
-
-    self->xxhash_state = XXH3_createState();
-    if (self->xxhash_state == NULL) {
-        Py_DECREF(self);
-        PyBuffer_Release(&buf);
-        return PyErr_NoMemory();
+    if (_shard_seed(argv[2], &seed) < 0)
+        return NULL;
+    if (_parse_nthreads(module, argv[5], "jump_hash_many", &nthreads) < 0)
+        return NULL;
+    if (argv[4] == Py_None)
+        argv[4] = NULL;
+    if (_get_keys(argv[0], argv[3], &keys, "jump_hash_many") < 0)
+        return NULL;
+    if (_batch_out_init(argv[4], keys.n * 4, &outview, &out,
+                        "jump_hash_many") < 0) {
+        _keys_release(&keys);
+        return NULL;
     }
-    self->seed = seed;
-    XXH3_128bits_reset_withSeed(self->xxhash_state, seed);
 
-    if (buf.obj) {
-        /* Constructor: no concurrent access possible, skip locking. */
-        if (buf.len > XXHASH_GIL_MINSIZE) {
-            Py_BEGIN_ALLOW_THREADS
-            XXH3_128bits_update(self->xxhash_state, buf.buf, buf.len);
-            Py_END_ALLOW_THREADS
-        } else {
-            XXH3_128bits_update(self->xxhash_state, buf.buf, buf.len);
-        }
-        PyBuffer_Release(&buf);
+    keys.job.algo = XXHASH_ALGO_XXH3_64;
+    keys.job.seed = seed;
+    xxhash_jump_job job = {
+        .keys = &keys.job, .num_buckets = (uint32_t)num_buckets, .out = out,
+    };
+    _run_task(module, _jump_task, &job, keys.n, XXHASH_SKETCH_COST(&keys),
+              nthreads);
+
+    if (argv[4]) {
+        Py_INCREF(argv[4]);
+        result = argv[4];
+    } else {
+        result = _shard_result(out, keys.n);
     }
-    return (PyObject *)self;
+    _batch_out_release(&outview, out);
+    _keys_release(&keys);
+    return result;
 }
-static PyObject *PYXXH3_128_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+
+/* The XXH3_64 digests of the nodes in obj, a sequence of bytes-like
+ * objects or a buffer of rows as taken for keys, in a new array of
+ * *count. There must be between 1 and UINT32_MAX nodes. Returns the
+ * array, or NULL with exception set. */
+static uint64_t *
+_shard_nodes(PyObject *obj, XXH64_hash_t seed, Py_ssize_t *count,
+             const char *funcname)
 {
-    PYXXH3_128Object *self;
+    xxhash_keys nodes;
+    uint64_t *digests = NULL;
 
-    if ((self = (PYXXH3_128Object *)type->tp_alloc(type, 0)) == NULL) {
+    if (_get_keys(obj, NULL, &nodes, funcname) < 0)
         return NULL;
-    }
-
-    XXHASH_LOCK_INIT(self);
-
-    if ((self->xxhash_state = XXH3_createState()) == NULL) {
-        Py_DECREF(self);
+    if (nodes.n < 1 || (uint64_t)nodes.n > UINT32_MAX) {
+        PyErr_Format(PyExc_ValueError,
+            "%s() needs between 1 and %lu nodes, got %zd", funcname,
+            (unsigned long)UINT32_MAX, nodes.n);
+    } else if ((digests = PyMem_New(uint64_t, nodes.n)) == NULL) {
         PyErr_NoMemory();
-        return NULL;
+    } else {
+        nodes.job.algo = XXHASH_ALGO_XXH3_64;
+        nodes.job.seed = seed;
+        _batch_hash_at(&nodes.job, 0, nodes.n, digests);
+        *count = nodes.n;
     }
-
-    self->seed = 0;
-    XXH3_128bits_reset_withSeed(self->xxhash_state, 0);
-
-    return (PyObject *)self;
+    _keys_release(&nodes);
+    return digests;
 }
 
-XXHASH_INIT(XXH3_128, "xxhash.xxh3_128", XXH3_128bits_reset_withSeed, XXH3_128bits_update, XXH64_hash_t)
-
-PyDoc_STRVAR(
-    PYXXH3_128_update_doc,
-    "update (data)\n\n"
-    "Update the xxh3_128 object with bytes-like data. Repeated calls are\n"
-    "equivalent to a single call with the concatenation of all the arguments.");
-
-static PyObject *PYXXH3_128_update(PYXXH3_128Object *self, PyObject *const *args,
-                                 Py_ssize_t nargs, PyObject *kwnames)
+/* Rendezvous (highest random weight) hashing: a key goes to the node with
+ * the highest score, where the score of a key digest k for a node digest d
+ * is the splitmix64 step of k ^ d. With weights, that score s becomes
+ * -w / ln(u) for u = ((s >> 11) + 0.5) / 2**53, so each node draws keys in
+ * proportion to its weight. Removing a node moves only its own keys. Ties
+ * go to the lowest index. */
+typedef struct {
+    const xxhash_batch *keys;
+    const uint64_t *nodes;
+    const double *weights;  /* NULL for unweighted */
+    uint32_t n_nodes;
+    unsigned char *out;
+} xxhash_rendezvous_job;
+
+static inline uint64_t
+_rendezvous_score(uint64_t key, uint64_t node)
 {
-    PyObject *arg = NULL;
+    uint64_t state = key ^ node;
+    return _splitmix64(&state);
+}
 
-    /* validate keywords first */
-    if (kwnames) {
-        Py_ssize_t nkw = PyTuple_GET_SIZE(kwnames);
-        for (Py_ssize_t i = 0; i < nkw; i++) {
-            PyObject *key = PyTuple_GET_ITEM(kwnames, i);
-            if (PyUnicode_CompareWithASCIIString(key, "data") == 0) {
-                if (nargs >= 1) {
-                    PyErr_SetString(PyExc_TypeError,
-                        "xxh3_128.update() got multiple values for argument 'data'");
-                    return NULL;
+static void
+_rendezvous_task(void *arg, Py_ssize_t start, Py_ssize_t end)
+{
+    const xxhash_rendezvous_job *job = arg;
+    XXH64_hash_t h[XXHASH_SKETCH_CHUNK];
+
+    while (start < end) {
+        Py_ssize_t n = end - start < XXHASH_SKETCH_CHUNK
+                       ? end - start : XXHASH_SKETCH_CHUNK;
+        _batch_hash_at(job->keys, start, n, h);
+        for (Py_ssize_t i = 0; i < n; i++) {
+            uint32_t best = 0;
+            if (job->weights) {
+                double top = -1.0;
+                for (uint32_t j = 0; j < job->n_nodes; j++) {
+                    uint64_t s = _rendezvous_score(h[i], job->nodes[j]);
+                    double u = ((double)(s >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+                    double score = -job->weights[j] / log(u);
+                    if (score > top) {
+                        top = score;
+                        best = j;
+                    }
                 }
-                arg = args[nargs + i];
             } else {
-                PyErr_Format(PyExc_TypeError,
-                    "'%U' is an invalid keyword argument for 'xxh3_128.update()'",
-                    key);
-                return NULL;
+                uint64_t top = _rendezvous_score(h[i], job->nodes[0]);
+                for (uint32_t j = 1; j < job->n_nodes; j++) {
+                    uint64_t s = _rendezvous_score(h[i], job->nodes[j]);
+                    if (s > top) {
+                        top = s;
+                        best = j;
+                    }
+                }
             }
+            memcpy(job->out + (start + i) * 4, &best, 4);
         }
+        start += n;
     }
+}
 
-    if (nargs >= 1) {
-        if (nargs > 1) {
-            PyErr_Format(PyExc_TypeError,
-                "xxh3_128.update() takes at most 1 positional argument (%zd given)", nargs);
-            return NULL;
-        }
-        arg = args[0];
+/* Convert the weights argument of funcname for n nodes, a sequence of
+ * positive finite numbers, to a new array of double. Returns the array, or
+ * NULL with exception set. */
+static double *
+_rendezvous_weights(PyObject *obj, Py_ssize_t n, const char *funcname)
+{
+    PyObject *seq = PySequence_Fast(obj, "weights must be a sequence of numbers");
+    if (seq == NULL)
+        return NULL;
+    if (PySequence_Fast_GET_SIZE(seq) != n) {
+        PyErr_Format(PyExc_ValueError,
+            "%s() got %zd weights for %zd nodes", funcname,
+            PySequence_Fast_GET_SIZE(seq), n);
+        Py_DECREF(seq);
+        return NULL;
     }
-
-    if (!arg) {
-        PyErr_SetString(PyExc_TypeError, "xxh3_128.update() missing required argument 'data'");
+    double *weights = PyMem_New(double, n);
+    if (weights == NULL) {
+        PyErr_NoMemory();
+        Py_DECREF(seq);
         return NULL;
     }
+    PyObject **items = PySequence_Fast_ITEMS(seq);
+    for (Py_ssize_t i = 0; i < n; i++) {
+        weights[i] = PyFloat_AsDouble(items[i]);
+        if (weights[i] == -1.0 && PyErr_Occurred())
+            goto error;
+        if (!(weights[i] > 0.0) || !Py_IS_FINITE(weights[i])) {
+            PyErr_Format(PyExc_ValueError,
+                "%s() weights must be positive and finite", funcname);
+            goto error;
+        }
+    }
+    Py_DECREF(seq);
+    return weights;
 
-    Py_buffer buf;
-    if (_get_buffer_or_str(arg, &buf) < 0)
-        return NULL;
-    PYXXH3_128_do_update(self, &buf);
-    Py_RETURN_NONE;
+error:
+    PyMem_Free(weights);
+    Py_DECREF(seq);
+    return NULL;
 }
 
 PyDoc_STRVAR(
-    PYXXH3_128_digest_doc,
-    "digest() -> bytes\n\n"
-    "Return the digest of the data passed to the update() method so\n"
-    "far. This is a 16-byte value which may contain non-ASCII characters,\n"
-    "including null bytes.");
+    rendezvous_many_doc,
+    "rendezvous_many(keys, node_ids, weights=None, seed=0, *, offsets=None,\n"
+    "                out=None, nthreads=None) -> list of int\n\n"
+    "Return the index in node_ids of the node every key in keys is assigned\n"
+    "to by rendezvous (highest random weight) hashing of XXH3_64 digests.\n"
+    "Removing a node only moves the keys it had. keys is given as to\n"
+    "jump_hash_many(). node_ids is a sequence of bytes-like objects or a\n"
+    "buffer such as an integer array whose items are the node ids.\n"
+    "weights, if given, is a sequence of positive numbers, one per node,\n"
+    "in proportion to which nodes get keys.\n\n"
+    "Every key is scored against every node, so this suits up to a few\n"
+    "hundred nodes; HashRing lookups take the same time for any number.\n\n"
+    "If out is given, the indices are written into that writable buffer as\n"
+    "native-endian uint32 instead, and out is returned.\n\n"
+    XXHASH_NTHREADS_DOC);
 
-static PyObject *PYXXH3_128_digest(PYXXH3_128Object *self)
+static PyObject *
+rendezvous_many(PyObject *module, PyObject *const *args, Py_ssize_t nargs,
+                PyObject *kwnames)
 {
-    XXH128_hash_t intdigest;
+    static const char *const names[] = {
+        "keys", "node_ids", "weights", "seed", "offsets", "out", "nthreads",
+        NULL,
+    };
+    PyObject *argv[7];
+    XXH64_hash_t seed = 0;
+    Py_ssize_t n_nodes;
+    uint64_t *nodes;
+    double *weights = NULL;
+    xxhash_keys keys;
+    Py_buffer outview;
+    unsigned char *out;
+    PyObject *result = NULL;
+    int nthreads;
 
-    XXHASH_LOCK_ACQUIRE(self);
-    intdigest = XXH3_128bits_digest(self->xxhash_state);
-    XXHASH_LOCK_RELEASE(self);
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, "rendezvous_many", names,
+                               4, 2, argv) < 0)
+        return NULL;
+    if (_shard_seed(argv[3], &seed) < 0)
+        return NULL;
+    if (_parse_nthreads(module, argv[6], "rendezvous_many", &nthreads) < 0)
+        return NULL;
+    if (argv[5] == Py_None)
+        argv[5] = NULL;
+    if ((nodes = _shard_nodes(argv[1], seed, &n_nodes,
+                              "rendezvous_many")) == NULL)
+        return NULL;
+    if (argv[2] && argv[2] != Py_None
+        && (weights = _rendezvous_weights(argv[2], n_nodes,
+                                          "rendezvous_many")) == NULL)
+        goto done;
+    if (_get_keys(argv[0], argv[4], &keys, "rendezvous_many") < 0)
+        goto done;
+    if (_batch_out_init(argv[5], keys.n * 4, &outview, &out,
+                        "rendezvous_many") < 0) {
+        _keys_release(&keys);
+        goto done;
+    }
 
-    PyObject *ret = PyBytes_FromStringAndSize(NULL, XXH128_DIGESTSIZE);
-    if (ret == NULL) return NULL;
-    XXH128_canonicalFromHash((XXH128_canonical_t *)PyBytes_AS_STRING(ret), intdigest);
-    return ret;
+    keys.job.algo = XXHASH_ALGO_XXH3_64;
+    keys.job.seed = seed;
+    xxhash_rendezvous_job job = {
+        .keys = &keys.job, .nodes = nodes, .weights = weights,
+        .n_nodes = (uint32_t)n_nodes, .out = out,
+    };
+    /* Scoring a node costs about what hashing 8 bytes does. */
+    Py_ssize_t cost = keys.n > (PY_SSIZE_T_MAX - keys.total) / n_nodes / 8
+                      ? PY_SSIZE_T_MAX : keys.total + keys.n * n_nodes * 8;
+    _run_task(module, _rendezvous_task, &job, keys.n, cost, nthreads);
+
+    if (argv[5]) {
+        Py_INCREF(argv[5]);
+        result = argv[5];
+    } else {
+        result = _shard_result(out, keys.n);
+    }
+    _batch_out_release(&outview, out);
+    _keys_release(&keys);
+
+done:
+    PyMem_Free(weights);
+    PyMem_Free(nodes);
+    return result;
 }
 
-PyDoc_STRVAR(
-    PYXXH3_128_hexdigest_doc,
-    "hexdigest() -> string\n\n"
-    "Like digest(), but returns the digest as a string of hexadecimal digits.");
+/* A consistent hash ring. Node i, with XXH3_64 digest d, owns vnodes
+ * points: the first vnodes values of the splitmix64 sequence from d. A key
+ * goes to the owner of the first point at or after its XXH3_64 digest,
+ * wrapping around to the first point; of equal points, the one of the
+ * lowest node counts.
+ *
+ * Points are kept sorted, and index[t] is the first point whose top bits
+ * (as many as it takes to number about one point per slot) are at least t,
+ * so a lookup searches the slot of its digest only: about two cache
+ * misses for any size of ring. The ring never changes after creation, so
+ * lookups need no lock. */
+#define XXHASH_RING_MAXVNODES  65536
+#define XXHASH_RING_MAXBITS  24
 
-static PyObject *PYXXH3_128_hexdigest(PYXXH3_128Object *self)
-{
-    XXH128_hash_t intdigest;
-    char digest[XXH128_DIGESTSIZE];
+typedef struct {
+    const uint64_t *points;
+    const uint32_t *owners;     /* node index of each point */
+    const uint32_t *index;      /* (1 << bits) + 1 slot starts */
+    uint32_t npoints;
+    int bits;
+} xxhash_ring;
 
-    XXHASH_LOCK_ACQUIRE(self);
-    intdigest = XXH3_128bits_digest(self->xxhash_state);
-    XXHASH_LOCK_RELEASE(self);
-    XXH128_canonicalFromHash((XXH128_canonical_t *)digest, intdigest);
+typedef struct {
+    PyObject_HEAD
+    xxhash_ring ring;
+    void *alloc;        /* memory the arrays live in */
+    uint32_t n_nodes;
+    uint32_t vnodes;
+    XXH64_hash_t seed;
+} HashRingObject;
 
-    PyObject *ret = PyUnicode_New(XXH128_DIGESTSIZE * 2, 127);
-    if (ret == NULL) return NULL;
-    Py_UCS1 *b = PyUnicode_1BYTE_DATA(ret);
-    for (Py_ssize_t i = 0, j = 0; i < XXH128_DIGESTSIZE; i++) {
-        unsigned char c;
-        c = (digest[i] >> 4) & 0xf;
-        c = (c > 9) ? c + 'a' - 10 : c + '0';
-        b[j++] = c;
-        c = (digest[i] & 0xf);
-        c = (c > 9) ? c + 'a' - 10 : c + '0';
-        b[j++] = c;
+static inline uint32_t
+_ring_lookup(const xxhash_ring *r, uint64_t h)
+{
+    uint64_t slot = h >> (64 - r->bits);
+    uint32_t lo = r->index[slot], hi = r->index[slot + 1];
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (r->points[mid] < h)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
-    return ret;
+    return r->owners[lo == r->npoints ? 0 : lo];
 }
 
-PyDoc_STRVAR(
-    PYXXH3_128_intdigest_doc,
-    "intdigest() -> int\n\n"
-    "Like digest(), but returns the digest as an integer, which is the integer\n"
-    "returned by the xxHash C API.");
+typedef struct {
+    xxhash_ring ring;
+    const xxhash_batch *keys;
+    unsigned char *out;
+} xxhash_ring_job;
 
-static PyObject *PYXXH3_128_intdigest(PYXXH3_128Object *self)
+static void
+_ring_task(void *arg, Py_ssize_t start, Py_ssize_t end)
 {
-    XXH128_hash_t intdigest;
-    PyObject *result, *high, *low, *sixtyfour;
-
-    XXHASH_LOCK_ACQUIRE(self);
-    intdigest = XXH3_128bits_digest(self->xxhash_state);
-    XXHASH_LOCK_RELEASE(self);
-
-    sixtyfour = PyLong_FromLong(64);
-    low = PyLong_FromUnsignedLongLong(intdigest.low64);
-    high = PyLong_FromUnsignedLongLong(intdigest.high64);
-    result = NULL;
-
-    if (sixtyfour && low && high) {
-        PyObject *shifted = PyNumber_Lshift(high, sixtyfour);
-        if (shifted) {
-            result = PyNumber_Add(shifted, low);
-            Py_DECREF(shifted);
+    const xxhash_ring_job *job = arg;
+    const xxhash_ring *r = &job->ring;
+    XXH64_hash_t h[XXHASH_SKETCH_CHUNK];
+
+    while (start < end) {
+        Py_ssize_t n = end - start < XXHASH_SKETCH_CHUNK
+                       ? end - start : XXHASH_SKETCH_CHUNK;
+        _batch_hash_at(job->keys, start, n, h);
+        for (Py_ssize_t i = 0; i < n; i++) {
+            XXHASH_PREFETCH(&r->index[h[i] >> (64 - r->bits)]);
         }
+        for (Py_ssize_t i = 0; i < n; i++) {
+            uint32_t owner = _ring_lookup(r, h[i]);
+            memcpy(job->out + (start + i) * 4, &owner, 4);
+        }
+        start += n;
     }
-    Py_XDECREF(high);
-    Py_XDECREF(low);
-    Py_XDECREF(sixtyfour);
-    return result;
 }
 
-PyDoc_STRVAR(
-    PYXXH3_128_copy_doc,
-    "copy() -> xxh3_128 object\n\n"
-    "Return a copy of the xxh3_128 object.");
+typedef struct {
+    uint64_t point;
+    uint32_t owner;
+} xxhash_ring_point;
 
-static PyObject *PYXXH3_128_copy(PYXXH3_128Object *self)
+static int
+_ring_point_cmp(const void *a, const void *b)
 {
-    PYXXH3_128Object *p;
+    const xxhash_ring_point *x = a, *y = b;
+    if (x->point != y->point)
+        return x->point < y->point ? -1 : 1;
+    return x->owner < y->owner ? -1 : x->owner > y->owner;
+}
 
-    if ((p = (PYXXH3_128Object *)Py_TYPE(self)->tp_alloc(Py_TYPE(self), 0)) == NULL) {
+static PyObject *
+HashRing_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"nodes", "vnodes", "seed", NULL};
+    PyObject *nodes_obj;
+    int vnodes = 160;
+    unsigned long long seed = 0;
+    Py_ssize_t n_nodes;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|iK:HashRing", keywords,
+                                     &nodes_obj, &vnodes, &seed))
+        return NULL;
+    if (vnodes < 1 || vnodes > XXHASH_RING_MAXVNODES) {
+        PyErr_Format(PyExc_ValueError,
+            "HashRing() vnodes must be between 1 and %d",
+            XXHASH_RING_MAXVNODES);
+        return NULL;
+    }
+    uint64_t *nodes = _shard_nodes(nodes_obj, seed, &n_nodes, "HashRing");
+    if (nodes == NULL)
+        return NULL;
+    if ((uint64_t)n_nodes * (uint64_t)vnodes >= UINT32_MAX
+        || (uint64_t)n_nodes * (uint64_t)vnodes
+           > (uint64_t)PY_SSIZE_T_MAX / (2 * sizeof(xxhash_ring_point))) {
+        PyMem_Free(nodes);
+        PyErr_SetString(PyExc_OverflowError, "HashRing is too large");
         return NULL;
     }
 
-    XXHASH_LOCK_INIT(p);
+    uint32_t npoints = (uint32_t)n_nodes * (uint32_t)vnodes;
+    int bits = 1;
+    while (bits < XXHASH_RING_MAXBITS && ((uint32_t)1 << bits) < npoints)
+        bits++;
+    size_t nslots = ((size_t)1 << bits) + 1;
+
+    HashRingObject *self = (HashRingObject *)type->tp_alloc(type, 0);
+    xxhash_ring_point *sorted = PyMem_RawMalloc(npoints * sizeof(*sorted));
+    if (self != NULL) {
+        self->alloc = PyMem_RawMalloc(npoints * (sizeof(uint64_t) + sizeof(uint32_t))
+                                      + nslots * sizeof(uint32_t));
+    }
+    if (self == NULL || sorted == NULL || self->alloc == NULL) {
+        PyMem_RawFree(sorted);
+        PyMem_Free(nodes);
+        Py_XDECREF(self);
+        return PyErr_NoMemory();
+    }
 
-    if ((p->xxhash_state = XXH3_createState()) == NULL) {
-        Py_DECREF(p);
-        PyErr_NoMemory();
-        return NULL;
+    for (uint32_t i = 0, k = 0; i < (uint32_t)n_nodes; i++) {
+        uint64_t state = nodes[i];
+        for (int v = 0; v < vnodes; v++, k++) {
+            sorted[k].point = _splitmix64(&state);
+            sorted[k].owner = i;
+        }
+    }
+    PyMem_Free(nodes);
+    Py_BEGIN_ALLOW_THREADS
+    qsort(sorted, npoints, sizeof(*sorted), _ring_point_cmp);
+    Py_END_ALLOW_THREADS
+
+    uint64_t *points = self->alloc;
+    uint32_t *owners = (uint32_t *)(points + npoints);
+    uint32_t *index = owners + npoints;
+    for (uint32_t k = 0; k < npoints; k++) {
+        points[k] = sorted[k].point;
+        owners[k] = sorted[k].owner;
+    }
+    PyMem_RawFree(sorted);
+    for (size_t t = 0, k = 0; t < nslots; t++) {
+        while (k < npoints && (points[k] >> (64 - bits)) < t)
+            k++;
+        index[t] = (uint32_t)k;
     }
 
-    XXHASH_LOCK_ACQUIRE(self);
-    p->seed = self->seed;
-    XXH3_copyState(p->xxhash_state, self->xxhash_state);
-#if XXH_VERSION_NUMBER < 704
-    // v0.7.3 and earlier have a bug where states reset with a seed
-    // will have a wild pointer to the original state when copied,
-    // causing a use-after-free if the original is freed.
-    if (p->xxhash_state->secret == &self->xxhash_state->customSecret[0])
-        p->xxhash_state->secret = &p->xxhash_state->customSecret[0];
-#endif
-    XXHASH_LOCK_RELEASE(self);
+    self->ring = (xxhash_ring){
+        .points = points, .owners = owners, .index = index,
+        .npoints = npoints, .bits = bits,
+    };
+    self->n_nodes = (uint32_t)n_nodes;
+    self->vnodes = (uint32_t)vnodes;
+    self->seed = seed;
+    return (PyObject *)self;
+}
 
-    return (PyObject *)p;
+static void
+HashRing_dealloc(HashRingObject *self)
+{
+    PyMem_RawFree(self->alloc);
+    PyTypeObject *tp = Py_TYPE(self);
+    tp->tp_free((PyObject *)self);
+    Py_DECREF(tp);
 }
 
 PyDoc_STRVAR(
-    PYXXH3_128_reset_doc,
-    "reset()\n\n"
-    "Reset state.");
+    HashRing_lookup_doc,
+    "lookup(key) -> int\n\n"
+    "Return the index of the node the bytes-like object key is assigned to.");
 
-static PyObject *PYXXH3_128_reset(PYXXH3_128Object *self)
+static PyObject *
+HashRing_lookup(HashRingObject *self, PyObject *key)
 {
-    XXHASH_LOCK_ACQUIRE(self);
-    XXH3_128bits_reset_withSeed(self->xxhash_state, self->seed);
-    XXHASH_LOCK_RELEASE(self);
-    Py_RETURN_NONE;
+    Py_buffer buf;
+
+    if (_get_buffer_or_str(key, &buf) < 0)
+        return NULL;
+    XXH64_hash_t h = XXH3_64bits_withSeed(buf.buf, (size_t)buf.len, self->seed);
+    PyBuffer_Release(&buf);
+    return PyLong_FromUnsignedLong(_ring_lookup(&self->ring, h));
 }
 
-static PyMethodDef PYXXH3_128_methods[] = {
-    {"update", (PyCFunction)PYXXH3_128_update, METH_FASTCALL | METH_KEYWORDS, PYXXH3_128_update_doc},
-    {"digest", (PyCFunction)PYXXH3_128_digest, METH_NOARGS, PYXXH3_128_digest_doc},
-    {"hexdigest", (PyCFunction)PYXXH3_128_hexdigest, METH_NOARGS, PYXXH3_128_hexdigest_doc},
-    {"intdigest", (PyCFunction)PYXXH3_128_intdigest, METH_NOARGS, PYXXH3_128_intdigest_doc},
-    {"copy", (PyCFunction)PYXXH3_128_copy, METH_NOARGS, PYXXH3_128_copy_doc},
-    {"reset", (PyCFunction)PYXXH3_128_reset, METH_NOARGS, PYXXH3_128_reset_doc},
-    {NULL, NULL, 0, NULL}
-};
+PyDoc_STRVAR(
+    HashRing_lookup_many_doc,
+    "lookup_many(keys, offsets=None, *, out=None, nthreads=None)\n"
+    "    -> list of int\n\n"
+    "Return the index of the node every key in keys is assigned to. keys is\n"
+    "a sequence of bytes-like objects, a buffer such as an integer array\n"
+    "whose items (or rows) are the keys, or, with offsets, a buffer holding\n"
+    "the keys back to back, as taken by xxh3_64_hash_offsets().\n\n"
+    "If out is given, the indices are written into that writable buffer as\n"
+    "native-endian uint32 instead, and out is returned.\n\n"
+    XXHASH_NTHREADS_DOC);
 
-static PyObject *PYXXH3_128_get_block_size(PYXXH3_128Object *self, void *closure)
+static PyObject *
+HashRing_lookup_many(HashRingObject *self, PyObject *const *args,
+                     Py_ssize_t nargs, PyObject *kwnames)
 {
-    return PyLong_FromLong(XXH128_BLOCKSIZE);
+    static const char *const names[] = {
+        "keys", "offsets", "out", "nthreads", NULL,
+    };
+    PyObject *argv[4];
+    xxhash_keys keys;
+    Py_buffer outview;
+    unsigned char *out;
+    PyObject *result;
+    int nthreads;
+
+    if (_parse_fastcall_kwargs(args, nargs, kwnames, "lookup_many", names,
+                               2, 1, argv) < 0)
+        return NULL;
+    if (_parse_nthreads(PyType_GetModule(Py_TYPE(self)), argv[3],
+                        "lookup_many", &nthreads) < 0)
+        return NULL;
+    if (argv[2] == Py_None)
+        argv[2] = NULL;
+    if (_get_keys(argv[0], argv[1], &keys, "lookup_many") < 0)
+        return NULL;
+    if (_batch_out_init(argv[2], keys.n * 4, &outview, &out,
+                        "lookup_many") < 0) {
+        _keys_release(&keys);
+        return NULL;
+    }
+
+    keys.job.algo = XXHASH_ALGO_XXH3_64;
+    keys.job.seed = self->seed;
+    xxhash_ring_job job = {
+        .ring = self->ring, .keys = &keys.job, .out = out,
+    };
+    _run_task(PyType_GetModule(Py_TYPE(self)), _ring_task, &job, keys.n,
+              XXHASH_SKETCH_COST(&keys), nthreads);
+
+    if (argv[2]) {
+        Py_INCREF(argv[2]);
+        result = argv[2];
+    } else {
+        result = _shard_result(out, keys.n);
+    }
+    _batch_out_release(&outview, out);
+    _keys_release(&keys);
+    return result;
 }
 
+static PyMethodDef HashRing_methods[] = {
+    {"lookup", (PyCFunction)HashRing_lookup, METH_O, HashRing_lookup_doc},
+    {"lookup_many", (PyCFunction)HashRing_lookup_many, METH_FASTCALL | METH_KEYWORDS, HashRing_lookup_many_doc},
+    {NULL, NULL, 0, NULL}
+};
+
 static PyObject *
-PYXXH3_128_get_digest_size(PYXXH3_128Object *self, void *closure)
+HashRing_get_num_nodes(HashRingObject *self, void *closure)
 {
-    return PyLong_FromLong(XXH128_DIGESTSIZE);
+    return PyLong_FromUnsignedLong(self->n_nodes);
 }
 
 static PyObject *
-PYXXH3_128_get_name(PYXXH3_128Object *self, void *closure)
+HashRing_get_vnodes(HashRingObject *self, void *closure)
 {
-    return PyUnicode_FromString("XXH3_128");
+    return PyLong_FromUnsignedLong(self->vnodes);
 }
 
 static PyObject *
-PYXXH3_128_get_seed(PYXXH3_128Object *self, void *closure)
+HashRing_get_seed(HashRingObject *self, void *closure)
 {
     return PyLong_FromUnsignedLongLong(self->seed);
 }
 
-static PyGetSetDef PYXXH3_128_getseters[] = {
-    {
-        "digest_size",
-        (getter)PYXXH3_128_get_digest_size, NULL,
-        "Digest size.",
-        NULL
-    },
-    {
-        "block_size",
-        (getter)PYXXH3_128_get_block_size, NULL,
-        "Block size.",
-        NULL
-    },
+static PyGetSetDef HashRing_getseters[] = {
     {
-        "name",
-        (getter)PYXXH3_128_get_name, NULL,
-        "Name. Always XXH3_128.",
+        "num_nodes",
+        (getter)HashRing_get_num_nodes, NULL,
+        "Number of nodes.",
         NULL
     },
     {
-        "digestsize",
-        (getter)PYXXH3_128_get_digest_size, NULL,
-        "Digest size.",
+        "vnodes",
+        (getter)HashRing_get_vnodes, NULL,
+        "Number of points each node has on the ring.",
         NULL
     },
     {
         "seed",
-        (getter)PYXXH3_128_get_seed, NULL,
-        "Seed.",
+        (getter)HashRing_get_seed, NULL,
+        "Seed nodes and keys are hashed with.",
         NULL
     },
     {NULL}  /* Sentinel */
 };
 
 PyDoc_STRVAR(
-    PYXXH3_128Type_doc,
-    "An xxh3_128 represents the object used to calculate the XXH3_128 hash of a\n"
-    "bytes-like object.\n"
+    HashRingType_doc,
+    "HashRing(nodes, vnodes=160, seed=0)\n"
     "\n"
-    "Methods:\n"
+    "An immutable consistent hash ring over nodes, a sequence of bytes-like\n"
+    "node ids or a buffer such as an integer array whose items are the ids.\n"
+    "Each node is placed at vnodes points derived from its XXH3_64 digest,\n"
+    "and a key goes to the node of the first point at or after the XXH3_64\n"
+    "digest of the key. Lookups return the index of the node in nodes.\n"
     "\n"
-    "update(data) -- updates the current hash state with additional data\n"
-    "digest() -- return the current digest value\n"
-    "hexdigest() -- return the current digest as a string of hexadecimal digits\n"
-    "intdigest() -- return the current digest as an integer\n"
-    "copy() -- return a copy of the current xxh3_128 object");
-
-static PyType_Slot XXH3_128Type_slots[] = {
-    {Py_tp_dealloc, PYXXH3_128_dealloc},
-    {Py_tp_doc, (void *)PYXXH3_128Type_doc},
-    {Py_tp_methods, PYXXH3_128_methods},
-    {Py_tp_getset, PYXXH3_128_getseters},
-    {Py_tp_init, PYXXH3_128_init},
-    {Py_tp_new, PYXXH3_128_new},
+    "Adding a node to the list only moves keys to it, and removing one only\n"
+    "moves the keys it had; build a new ring to change the nodes. Lookups\n"
+    "take no lock and cost about two cache misses for any number of nodes.");
+
+static PyType_Slot HashRingType_slots[] = {
+    {Py_tp_dealloc, HashRing_dealloc},
+    {Py_tp_doc, (void *)HashRingType_doc},
+    {Py_tp_methods, HashRing_methods},
+    {Py_tp_getset, HashRing_getseters},
+    {Py_tp_new, HashRing_new},
     {0, NULL},
 };
 
-static PyType_Spec XXH3_128Type_spec = {
-    .name = "xxhash.xxh3_128",
-    .basicsize = sizeof(PYXXH3_128Object),
+static PyType_Spec HashRingType_spec = {
+    .name = "xxhash.HashRing",
+    .basicsize = sizeof(HashRingObject),
     .flags = Py_TPFLAGS_DEFAULT
 #if PY_VERSION_HEX >= 0x030c0000
            | Py_TPFLAGS_IMMUTABLETYPE
 #endif
     ,
-    .slots = XXH3_128Type_slots,
+    .slots = HashRingType_slots,
 };
 
 /*****************************************************************************
  * Module Init ****************************************************************
  ****************************************************************************/
 
+#ifdef XXHASH_DISPATCH
+/* Select the XXH3 SIMD backend, once per process: the one named by the
+ * XXHASH_SIMD_BACKEND environment variable if it is set and supported,
+ * otherwise the widest one this CPU supports. */
+static int
+_select_simd_backend(void)
+{
+    static int selected = 0;
+    const char *name;
+
+    if (selected)
+        return 0;
+    selected = 1;
+    name = getenv("XXHASH_SIMD_BACKEND");
+    if (name && *name && xxhash_dispatch_select(name) == 0)
+        return 0;
+    xxhash_dispatch_select(NULL);
+    if (name && *name)
+        return PyErr_WarnFormat(PyExc_RuntimeWarning, 1,
+            "XXHASH_SIMD_BACKEND=%.100s is not supported here, using %s",
+            name, xxhash_dispatch_backend());
+    return 0;
+}
+
+/* Add simd_backend and _SIMD_BACKENDS, the backends this CPU supports. */
+static int
+_add_simd_backend(PyObject *module)
+{
+    PyObject *names;
+    const char *name;
+
+    if (_select_simd_backend() < 0)
+        return -1;
+    if (PyModule_AddStringConstant(module, "simd_backend",
+                                   xxhash_dispatch_backend()) < 0)
+        return -1;
+    names = PyList_New(0);
+    if (names == NULL)
+        return -1;
+    for (int i = 0; (name = xxhash_dispatch_available(i)) != NULL; i++) {
+        PyObject *item = PyUnicode_FromString(name);
+        if (item == NULL || PyList_Append(names, item) < 0) {
+            Py_XDECREF(item);
+            Py_DECREF(names);
+            return -1;
+        }
+        Py_DECREF(item);
+    }
+    Py_SETREF(names, PyList_AsTuple(names));
+    if (names == NULL || PyModule_AddObject(module, "_SIMD_BACKENDS", names) < 0) {
+        Py_XDECREF(names);
+        return -1;
+    }
+    return 0;
+}
+#else
+/* Linked to libxxhash.so, whose build decides: the backend is unknown. */
+static int
+_add_simd_backend(PyObject *module)
+{
+    PyObject *names = PyTuple_New(0);
+
+    Py_INCREF(Py_None);
+    if (PyModule_AddObject(module, "simd_backend", Py_None) < 0) {
+        Py_DECREF(Py_None);
+        Py_XDECREF(names);
+        return -1;
+    }
+    if (names == NULL || PyModule_AddObject(module, "_SIMD_BACKENDS", names) < 0) {
+        Py_XDECREF(names);
+        return -1;
+    }
+    return 0;
+}
+#endif
+
 static int _exec(PyObject *module)
 {
+    xxhash_state *state = _get_state(module);
+
+    state->default_nthreads = 1;
+
     /* Build heap types from specs (bound to module for sub-interpreter safety). */
     PyObject *xxh32_type = PyType_FromModuleAndSpec(module, &XXH32Type_spec, NULL);
     if (!xxh32_type) return -1;
@@ -2182,7 +11707,7 @@ static int _exec(PyObject *module)
     if (PyModule_AddType(module, (PyTypeObject *)xxh32_type) < 0) {
         Py_DECREF(xxh32_type); return -1;
     }
-    Py_DECREF(xxh32_type);
+    state->types[XXHASH_ALGO_XXH32] = xxh32_type;
 
     PyObject *xxh64_type = PyType_FromModuleAndSpec(module, &XXH64Type_spec, NULL);
     if (!xxh64_type) return -1;
@@ -2190,7 +11715,7 @@ static int _exec(PyObject *module)
     if (PyModule_AddType(module, (PyTypeObject *)xxh64_type) < 0) {
         Py_DECREF(xxh64_type); return -1;
     }
-    Py_DECREF(xxh64_type);
+    state->types[XXHASH_ALGO_XXH64] = xxh64_type;
 
     PyObject *xxh3_64_type = PyType_FromModuleAndSpec(module, &XXH3_64Type_spec, NULL);
     if (!xxh3_64_type) return -1;
@@ -2198,7 +11723,7 @@ static int _exec(PyObject *module)
     if (PyModule_AddType(module, (PyTypeObject *)xxh3_64_type) < 0) {
         Py_DECREF(xxh3_64_type); return -1;
     }
-    Py_DECREF(xxh3_64_type);
+    state->types[XXHASH_ALGO_XXH3_64] = xxh3_64_type;
 
     PyObject *xxh3_128_type = PyType_FromModuleAndSpec(module, &XXH3_128Type_spec, NULL);
     if (!xxh3_128_type) return -1;
@@ -2206,17 +11731,120 @@ static int _exec(PyObject *module)
     if (PyModule_AddType(module, (PyTypeObject *)xxh3_128_type) < 0) {
         Py_DECREF(xxh3_128_type); return -1;
     }
-    Py_DECREF(xxh3_128_type);
+    state->types[XXHASH_ALGO_XXH3_128] = xxh3_128_type;
+
+    PyObject *cache_type = PyType_FromModuleAndSpec(module, &DigestCacheType_spec, NULL);
+    if (!cache_type) return -1;
+    if (PyModule_AddType(module, (PyTypeObject *)cache_type) < 0) {
+        Py_DECREF(cache_type); return -1;
+    }
+    state->cache_type = cache_type;
+
+    PyObject *bound_type = PyType_FromModuleAndSpec(module, &BoundHasherType_spec, NULL);
+    if (!bound_type) return -1;
+#if PY_VERSION_HEX < 0x030a0000
+    ((PyTypeObject *)bound_type)->tp_new = NULL;   /* made by xxh*_hasher() only */
+#endif
+    if (PyModule_AddType(module, (PyTypeObject *)bound_type) < 0) {
+        Py_DECREF(bound_type); return -1;
+    }
+    state->bound_type = bound_type;
+
+    PyObject *bloom_type = PyType_FromModuleAndSpec(module, &BloomFilterType_spec, NULL);
+    if (!bloom_type) return -1;
+    if (PyModule_AddType(module, (PyTypeObject *)bloom_type) < 0) {
+        Py_DECREF(bloom_type); return -1;
+    }
+    state->bloom_type = bloom_type;
+
+    PyObject *hll_type = PyType_FromModuleAndSpec(module, &HyperLogLogType_spec, NULL);
+    if (!hll_type) return -1;
+    if (PyModule_AddType(module, (PyTypeObject *)hll_type) < 0) {
+        Py_DECREF(hll_type); return -1;
+    }
+    state->hll_type = hll_type;
+
+    PyObject *cms_type = PyType_FromModuleAndSpec(module, &CountMinSketchType_spec, NULL);
+    if (!cms_type) return -1;
+    if (PyModule_AddType(module, (PyTypeObject *)cms_type) < 0) {
+        Py_DECREF(cms_type); return -1;
+    }
+    state->cms_type = cms_type;
+
+    PyObject *ring_type = PyType_FromModuleAndSpec(module, &HashRingType_spec, NULL);
+    if (!ring_type) return -1;
+    if (PyModule_AddType(module, (PyTypeObject *)ring_type) < 0) {
+        Py_DECREF(ring_type); return -1;
+    }
+    state->ring_type = ring_type;
 
     if (PyModule_AddStringConstant(module, "XXHASH_VERSION", VALUE_TO_STRING(XXHASH_VERSION)) < 0)
         return -1;
 
+    if (_add_simd_backend(module) < 0)
+        return -1;
+
+    if (PyModule_AddIntConstant(module, "XXH3_SECRET_SIZE_MIN", XXH3_SECRET_SIZE_MIN) < 0)
+        return -1;
+
+    if (PyModule_AddIntConstant(module, "XXH3_SECRET_DEFAULT_SIZE", XXH3_SECRET_DEFAULT_SIZE) < 0)
+        return -1;
+
     if (PyModule_AddIntConstant(module, "_GIL_MINSIZE", XXHASH_GIL_MINSIZE) < 0)
         return -1;
 
+    if (PyModule_AddIntConstant(module, "_PARALLEL_MINSIZE", XXHASH_PARALLEL_MINSIZE) < 0)
+        return -1;
+
+    if (PyModule_AddIntConstant(module, "_PARALLEL_MINITEMS", XXHASH_PARALLEL_MINITEMS) < 0)
+        return -1;
+
+    return 0;
+}
+
+static int _traverse(PyObject *module, visitproc visit, void *arg)
+{
+    xxhash_state *state = _get_state(module);
+    for (int i = 0; i < XXHASH_NUM_ALGOS; i++) {
+        Py_VISIT(state->types[i]);
+    }
+    Py_VISIT(state->cache_type);
+    Py_VISIT(state->bound_type);
+    Py_VISIT(state->bloom_type);
+    Py_VISIT(state->hll_type);
+    Py_VISIT(state->cms_type);
+    Py_VISIT(state->ring_type);
+    return 0;
+}
+
+static int _clear(PyObject *module)
+{
+    xxhash_state *state = _get_state(module);
+    for (int i = 0; i < XXHASH_NUM_ALGOS; i++) {
+        Py_CLEAR(state->types[i]);
+#if XXHASH_FREELIST_SIZE > 0
+        while (state->nfree[i] > 0)
+            PyObject_Free(state->freelist[i][--state->nfree[i]]);
+#endif
+    }
+    Py_CLEAR(state->cache_type);
+    Py_CLEAR(state->bound_type);
+    Py_CLEAR(state->bloom_type);
+    Py_CLEAR(state->hll_type);
+    Py_CLEAR(state->cms_type);
+    Py_CLEAR(state->ring_type);
     return 0;
 }
 
+static void _free(void *module)
+{
+    xxhash_state *state = _get_state((PyObject *)module);
+    if (state) {
+        _clear((PyObject *)module);
+        _pool_fini(&state->pool);
+    }
+}
+
 static PyModuleDef_Slot slots[] = {
     {Py_mod_exec, _exec},
 #if PY_VERSION_HEX >= 0x030c0000  /* Python 3.12+: sub-interpreter support */
@@ -2242,6 +11870,42 @@ static PyMethodDef methods[] = {
     {"xxh3_128_digest",    (PyCFunction)xxh3_128_digest,    METH_FASTCALL | METH_KEYWORDS, "xxh3_128_digest"},
     {"xxh3_128_intdigest", (PyCFunction)xxh3_128_intdigest, METH_FASTCALL | METH_KEYWORDS, "xxh3_128_intdigest"},
     {"xxh3_128_hexdigest", (PyCFunction)xxh3_128_hexdigest, METH_FASTCALL | METH_KEYWORDS, "xxh3_128_hexdigest"},
+    {"xxh3_64_intdigest_str",  (PyCFunction)xxh3_64_intdigest_str,  METH_FASTCALL | METH_KEYWORDS, xxh3_64_intdigest_str_doc},
+    {"xxh3_128_intdigest_str", (PyCFunction)xxh3_128_intdigest_str, METH_FASTCALL | METH_KEYWORDS, xxh3_128_intdigest_str_doc},
+    {"xxh3_generate_secret", (PyCFunction)xxh3_generate_secret, METH_FASTCALL | METH_KEYWORDS, xxh3_generate_secret_doc},
+    {"xxh32_hasher",       (PyCFunction)xxh32_hasher,       METH_FASTCALL | METH_KEYWORDS, xxh32_hasher_doc},
+    {"xxh64_hasher",       (PyCFunction)xxh64_hasher,       METH_FASTCALL | METH_KEYWORDS, xxh64_hasher_doc},
+    {"xxh3_64_hasher",     (PyCFunction)xxh3_64_hasher,     METH_FASTCALL | METH_KEYWORDS, xxh3_64_hasher_doc},
+    {"xxh3_128_hasher",    (PyCFunction)xxh3_128_hasher,    METH_FASTCALL | METH_KEYWORDS, xxh3_128_hasher_doc},
+    {"xxh32_digest_many",       (PyCFunction)xxh32_digest_many,       METH_FASTCALL | METH_KEYWORDS, xxh32_digest_many_doc},
+    {"xxh32_intdigest_many",    (PyCFunction)xxh32_intdigest_many,    METH_FASTCALL | METH_KEYWORDS, xxh32_intdigest_many_doc},
+    {"xxh64_digest_many",       (PyCFunction)xxh64_digest_many,       METH_FASTCALL | METH_KEYWORDS, xxh64_digest_many_doc},
+    {"xxh64_intdigest_many",    (PyCFunction)xxh64_intdigest_many,    METH_FASTCALL | METH_KEYWORDS, xxh64_intdigest_many_doc},
+    {"xxh3_64_digest_many",     (PyCFunction)xxh3_64_digest_many,     METH_FASTCALL | METH_KEYWORDS, xxh3_64_digest_many_doc},
+    {"xxh3_64_intdigest_many",  (PyCFunction)xxh3_64_intdigest_many,  METH_FASTCALL | METH_KEYWORDS, xxh3_64_intdigest_many_doc},
+    {"xxh3_128_digest_many",    (PyCFunction)xxh3_128_digest_many,    METH_FASTCALL | METH_KEYWORDS, xxh3_128_digest_many_doc},
+    {"xxh3_128_intdigest_many", (PyCFunction)xxh3_128_intdigest_many, METH_FASTCALL | METH_KEYWORDS, xxh3_128_intdigest_many_doc},
+    {"xxh3_64_hash_strided",    (PyCFunction)xxh3_64_hash_strided,    METH_FASTCALL | METH_KEYWORDS, xxh3_64_hash_strided_doc},
+    {"xxh3_128_hash_strided",   (PyCFunction)xxh3_128_hash_strided,   METH_FASTCALL | METH_KEYWORDS, xxh3_128_hash_strided_doc},
+    {"hash_uint32_array",       (PyCFunction)hash_uint32_array,       METH_FASTCALL | METH_KEYWORDS, hash_uint32_array_doc},
+    {"hash_uint64_array",       (PyCFunction)hash_uint64_array,       METH_FASTCALL | METH_KEYWORDS, hash_uint64_array_doc},
+    {"hash_uint128_array",      (PyCFunction)hash_uint128_array,      METH_FASTCALL | METH_KEYWORDS, hash_uint128_array_doc},
+    {"xxh3_64_hash_offsets",    (PyCFunction)xxh3_64_hash_offsets,    METH_FASTCALL | METH_KEYWORDS, xxh3_64_hash_offsets_doc},
+    {"xxh3_128_hash_offsets",   (PyCFunction)xxh3_128_hash_offsets,   METH_FASTCALL | METH_KEYWORDS, xxh3_128_hash_offsets_doc},
+    {"xxh3_64_hash_columns",    (PyCFunction)xxh3_64_hash_columns,    METH_FASTCALL | METH_KEYWORDS, xxh3_64_hash_columns_doc},
+    {"xxh3_128_hash_columns",   (PyCFunction)xxh3_128_hash_columns,   METH_FASTCALL | METH_KEYWORDS, xxh3_128_hash_columns_doc},
+    {"file_digest",             (PyCFunction)file_digest,             METH_FASTCALL | METH_KEYWORDS, file_digest_doc},
+    {"file_block_digests",      (PyCFunction)file_block_digests,      METH_FASTCALL | METH_KEYWORDS, file_block_digests_doc},
+    {"copy_and_hash",           (PyCFunction)copy_and_hash,           METH_FASTCALL | METH_KEYWORDS, copy_and_hash_doc},
+    {"hash_tree",               (PyCFunction)hash_tree,               METH_FASTCALL | METH_KEYWORDS, hash_tree_doc},
+    {"verify_manifest",         (PyCFunction)verify_manifest,         METH_FASTCALL | METH_KEYWORDS, verify_manifest_doc},
+    {"hash_object",             (PyCFunction)hash_object,             METH_FASTCALL | METH_KEYWORDS, hash_object_doc},
+    {"minhash",                 (PyCFunction)minhash,                 METH_FASTCALL | METH_KEYWORDS, minhash_doc},
+    {"minhash_many",            (PyCFunction)minhash_many,            METH_FASTCALL | METH_KEYWORDS, minhash_many_doc},
+    {"jump_hash_many",          (PyCFunction)jump_hash_many,          METH_FASTCALL | METH_KEYWORDS, jump_hash_many_doc},
+    {"rendezvous_many",         (PyCFunction)rendezvous_many,         METH_FASTCALL | METH_KEYWORDS, rendezvous_many_doc},
+    {"set_default_nthreads",    (PyCFunction)set_default_nthreads,    METH_O,                        set_default_nthreads_doc},
+    {"get_default_nthreads",    (PyCFunction)get_default_nthreads,    METH_NOARGS,                   get_default_nthreads_doc},
     {NULL, NULL, 0, NULL}
 };
 
@@ -2251,13 +11915,19 @@ static struct PyModuleDef moduledef = {
     "Low-level C extension for the xxhash package.\n"
     "\n"
     "Provides the XXH32, XXH64, XXH3_64, and XXH3_128 hash types plus\n"
-    "their one-shot digest(), intdigest(), and hexdigest() functions.",
-    0,
+    "their one-shot digest(), intdigest(), and hexdigest() functions and\n"
+    "the BoundHasher type; the batch digest_many(), intdigest_many(),\n"
+    "offsets, strided, array and column functions; file_digest(),\n"
+    "file_block_digests(), copy_and_hash(), hash_tree(), verify_manifest()\n"
+    "and the DigestCache type; hash_object(); the BloomFilter, HyperLogLog\n"
+    "and CountMinSketch sketches and minhash()/minhash_many(); and the\n"
+    "jump_hash_many(), rendezvous_many() and HashRing sharding helpers.",
+    sizeof(xxhash_state),
     methods,
     slots,
-    NULL,
-    NULL,
-    NULL
+    _traverse,
+    _clear,
+    _free
 };
 
 PyMODINIT_FUNC
@@ -0,0 +1,1392 @@
+/*
+ * Copyright (c) 2014-2026, Yue Du
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice,
+ *       this list of conditions and the following disclaimer in the documentation
+ *       and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Runtime SIMD dispatch for the bundled XXH3, see xxhash_dispatch.h.
+ *
+ * xxhash.h is included with XXH_INLINE_ALL, so this unit gets private
+ * copies of the XXH3 internals. Only inputs longer than XXH3_MIDSIZE_MAX
+ * bytes and streaming updates reach the vector loops; shorter inputs take
+ * the scalar paths whatever the backend, except in the multi-input
+ * kernels of the batch functions. */
+
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) \
+     || defined(_M_IX86)) && !defined(_M_ARM64EC) \
+    && (defined(__GNUC__) || defined(_MSC_VER))
+#  define XXHASH_X86DISPATCH 1
+#  define XXH_X86DISPATCH
+#  define XXH_DISPATCH_AVX2 1
+#  define XXH_DISPATCH_AVX512 1
+#  if defined(__GNUC__)
+     /* Vector intrinsics are usable in functions that enable their target,
+      * without compiling the whole unit for it. */
+#    include <immintrin.h>
+#    define XXH_TARGET_SSE2   __attribute__((__target__("sse2")))
+#    define XXH_TARGET_AVX2   __attribute__((__target__("avx2")))
+#    define XXH_TARGET_AVX512 __attribute__((__target__("avx512f")))
+#  else
+#    include <intrin.h>
+#    define XXH_TARGET_SSE2
+#    define XXH_TARGET_AVX2
+#    define XXH_TARGET_AVX512
+#  endif
+#endif
+
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+#define XXHASH_DISPATCH_NO_REPLACE
+#include "xxhash_dispatch.h"
+
+/* Kernels hashing several inputs at once, one per vector lane, and how
+ * many inputs each takes per step (1 for the one-at-a-time loops). */
+typedef struct {
+    void (*xxh3_64_short)(const void *const *, const size_t *, size_t,
+                          XXH64_hash_t, XXH64_hash_t *);
+    int xxh3_64_short_lanes;
+    void (*xxh32)(const void *const *, const size_t *, size_t,
+                  XXH32_hash_t, XXH32_hash_t *);
+    int xxh32_lanes;
+    void (*xxh64)(const void *const *, const size_t *, size_t,
+                  XXH64_hash_t, XXH64_hash_t *);
+    int xxh64_lanes;
+    void (*xxh3_64_fixed)(const void *, size_t, size_t, XXH64_hash_t,
+                          XXH64_hash_t *);
+    void (*minhash)(XXH64_hash_t *, const XXH64_hash_t *,
+                    const XXH64_hash_t *, size_t, const XXH64_hash_t *,
+                    size_t);
+} xxhash_many_kernels;
+
+/* One set of the XXH3 functions that touch the vector unit, built for the
+ * target enabled by attr from the given accumulate, scramble and secret
+ * initialization steps, and the multi-input kernels for that target. */
+typedef struct {
+    const char *name;
+    XXH64_hash_t (*hashLong64_default)(const void *, size_t);
+    XXH64_hash_t (*hashLong64_seed)(const void *, size_t, XXH64_hash_t);
+    XXH64_hash_t (*hashLong64_secret)(const void *, size_t,
+                                      const void *, size_t);
+    XXH128_hash_t (*hashLong128_default)(const void *, size_t);
+    XXH128_hash_t (*hashLong128_seed)(const void *, size_t, XXH64_hash_t);
+    XXH128_hash_t (*hashLong128_secret)(const void *, size_t,
+                                        const void *, size_t);
+    XXH_errorcode (*update)(XXH3_state_t *, const void *, size_t);
+    const xxhash_many_kernels *many;
+} xxhash_backend;
+
+#define XXHASH_DEFINE_BACKEND(suffix, attr, f_acc, f_scramble, f_initSec)   \
+XXH_NO_INLINE attr XXH64_hash_t                                             \
+xxhash_hashLong64_default_##suffix(const void *input, size_t len)           \
+{                                                                           \
+    return XXH3_hashLong_64b_internal(input, len, XXH3_kSecret,             \
+                                      sizeof(XXH3_kSecret),                 \
+                                      f_acc, f_scramble);                   \
+}                                                                           \
+XXH_NO_INLINE attr XXH64_hash_t                                             \
+xxhash_hashLong64_seed_##suffix(const void *input, size_t len,              \
+                                XXH64_hash_t seed)                          \
+{                                                                           \
+    return XXH3_hashLong_64b_withSeed_internal(input, len, seed, f_acc,     \
+                                               f_scramble, f_initSec);      \
+}                                                                           \
+XXH_NO_INLINE attr XXH64_hash_t                                             \
+xxhash_hashLong64_secret_##suffix(const void *input, size_t len,            \
+                                  const void *secret, size_t secretLen)     \
+{                                                                           \
+    return XXH3_hashLong_64b_internal(input, len, secret, secretLen,        \
+                                      f_acc, f_scramble);                   \
+}                                                                           \
+XXH_NO_INLINE attr XXH128_hash_t                                            \
+xxhash_hashLong128_default_##suffix(const void *input, size_t len)          \
+{                                                                           \
+    return XXH3_hashLong_128b_internal(input, len, XXH3_kSecret,            \
+                                       sizeof(XXH3_kSecret),                \
+                                       f_acc, f_scramble);                  \
+}                                                                           \
+XXH_NO_INLINE attr XXH128_hash_t                                            \
+xxhash_hashLong128_seed_##suffix(const void *input, size_t len,             \
+                                 XXH64_hash_t seed)                         \
+{                                                                           \
+    return XXH3_hashLong_128b_withSeed_internal(input, len, seed, f_acc,    \
+                                                f_scramble, f_initSec);     \
+}                                                                           \
+XXH_NO_INLINE attr XXH128_hash_t                                            \
+xxhash_hashLong128_secret_##suffix(const void *input, size_t len,           \
+                                   const void *secret, size_t secretLen)    \
+{                                                                           \
+    return XXH3_hashLong_128b_internal(input, len, secret, secretLen,       \
+                                       f_acc, f_scramble);                  \
+}                                                                           \
+XXH_NO_INLINE attr XXH_errorcode                                            \
+xxhash_update_##suffix(XXH3_state_t *state, const void *input, size_t len)  \
+{                                                                           \
+    return XXH3_update(state, (const xxh_u8 *)input, len,                   \
+                       f_acc, f_scramble);                                  \
+}
+
+#define XXHASH_BACKEND(name, suffix, many)                                  \
+    {                                                                       \
+        name,                                                               \
+        xxhash_hashLong64_default_##suffix,                                 \
+        xxhash_hashLong64_seed_##suffix,                                    \
+        xxhash_hashLong64_secret_##suffix,                                  \
+        xxhash_hashLong128_default_##suffix,                                \
+        xxhash_hashLong128_seed_##suffix,                                   \
+        xxhash_hashLong128_secret_##suffix,                                 \
+        xxhash_update_##suffix,                                             \
+        &many,                                                              \
+    }
+
+/* One input at a time, for backends without a multi-lane kernel. */
+static void
+xxhash_short64_scalar(const void *const *inputs, const size_t *lens,
+                      size_t n, XXH64_hash_t seed, XXH64_hash_t *out)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = XXH3_64bits_withSeed(inputs[i], lens[i], seed);
+}
+
+static void
+xxhash_xxh32_scalar(const void *const *inputs, const size_t *lens,
+                    size_t n, XXH32_hash_t seed, XXH32_hash_t *out)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = XXH32(inputs[i], lens[i], seed);
+}
+
+static void
+xxhash_xxh64_scalar(const void *const *inputs, const size_t *lens,
+                    size_t n, XXH64_hash_t seed, XXH64_hash_t *out)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = XXH64(inputs[i], lens[i], seed);
+}
+
+/* XXH3_64bits_withSeed() of n inputs of width bytes each, back to back.
+ * The length being a constant for the loop drops the branches on it. */
+static void
+xxhash_fixed64_scalar(const void *input, size_t width, size_t n,
+                      XXH64_hash_t seed, XXH64_hash_t *out)
+{
+    const xxh_u8 *const p = (const xxh_u8 *)input;
+    size_t i;
+
+    switch (width) {
+    case 4:
+        for (i = 0; i < n; i++)
+            out[i] = XXH3_len_4to8_64b(p + 4 * i, 4, XXH3_kSecret, seed);
+        break;
+    case 8:
+        for (i = 0; i < n; i++)
+            out[i] = XXH3_len_4to8_64b(p + 8 * i, 8, XXH3_kSecret, seed);
+        break;
+    case 16:
+        for (i = 0; i < n; i++)
+            out[i] = XXH3_len_9to16_64b(p + 16 * i, 16, XXH3_kSecret, seed);
+        break;
+    default:
+        for (i = 0; i < n; i++)
+            out[i] = XXH3_64bits_withSeed(p + width * i, width, seed);
+        break;
+    }
+}
+
+/* The constants XXH3_len_4to8_64b() and XXH3_len_9to16_64b() fold into the
+ * input for a given seed. */
+XXH_FORCE_INLINE xxh_u64
+xxhash_bitflip4to8(XXH64_hash_t seed)
+{
+    xxh_u64 const seed4 = seed ^ ((xxh_u64)XXH_swap32((xxh_u32)seed) << 32);
+    return (XXH_readLE64(XXH3_kSecret + 8) ^ XXH_readLE64(XXH3_kSecret + 16))
+           - seed4;
+}
+
+XXH_FORCE_INLINE xxh_u64
+xxhash_bitflip9to16_lo(XXH64_hash_t seed)
+{
+    return (XXH_readLE64(XXH3_kSecret + 24) ^ XXH_readLE64(XXH3_kSecret + 32))
+           + seed;
+}
+
+XXH_FORCE_INLINE xxh_u64
+xxhash_bitflip9to16_hi(XXH64_hash_t seed)
+{
+    return (XXH_readLE64(XXH3_kSecret + 40) ^ XXH_readLE64(XXH3_kSecret + 48))
+           - seed;
+}
+
+/* MinHash update: lower sig[i] to the least a[i] * h[j] + b[i] (mod
+ * 2**64) over j < n, for each i < k. Each permutation keeps four running
+ * minima, so the multiplies of consecutive hashes overlap. */
+static void
+xxhash_minhash_scalar(XXH64_hash_t *sig, const XXH64_hash_t *a,
+                      const XXH64_hash_t *b, size_t k,
+                      const XXH64_hash_t *h, size_t n)
+{
+    for (size_t i = 0; i < k; i++) {
+        xxh_u64 const ai = a[i], bi = b[i];
+        xxh_u64 m0 = sig[i], m1 = m0, m2 = m0, m3 = m0;
+        size_t j = 0;
+        for (; j + 4 <= n; j += 4) {
+            xxh_u64 const v0 = ai * h[j] + bi, v1 = ai * h[j + 1] + bi;
+            xxh_u64 const v2 = ai * h[j + 2] + bi, v3 = ai * h[j + 3] + bi;
+            m0 = v0 < m0 ? v0 : m0;
+            m1 = v1 < m1 ? v1 : m1;
+            m2 = v2 < m2 ? v2 : m2;
+            m3 = v3 < m3 ? v3 : m3;
+        }
+        for (; j < n; j++) {
+            xxh_u64 const v = ai * h[j] + bi;
+            m0 = v < m0 ? v : m0;
+        }
+        m0 = m1 < m0 ? m1 : m0;
+        m2 = m3 < m2 ? m3 : m2;
+        sig[i] = m2 < m0 ? m2 : m0;
+    }
+}
+
+static const xxhash_many_kernels xxhash_many_scalar = {
+    xxhash_short64_scalar, 1,
+    xxhash_xxh32_scalar, 1,
+    xxhash_xxh64_scalar, 1,
+    xxhash_fixed64_scalar,
+    xxhash_minhash_scalar,
+};
+
+/* XXH32 and XXH64 of one input from the accumulators v after the first
+ * done bytes (a multiple of the stripe size), as XXH32_endian_align() and
+ * XXH64_endian_align() would finish it. The multi-buffer kernels run the
+ * stripes their inputs have in common in lockstep and leave the rest to
+ * these. */
+static XXH32_hash_t
+xxhash_xxh32_finish(const xxh_u8 *input, size_t len, size_t done,
+                    const xxh_u32 v[4], XXH32_hash_t seed)
+{
+    const xxh_u8 *p = input + done;
+    xxh_u32 h32;
+
+    if (len >= 16) {
+        const xxh_u8 *const limit = input + len - 15;
+        xxh_u32 v1 = v[0], v2 = v[1], v3 = v[2], v4 = v[3];
+        while (p < limit) {
+            v1 = XXH32_round(v1, XXH_readLE32(p)); p += 4;
+            v2 = XXH32_round(v2, XXH_readLE32(p)); p += 4;
+            v3 = XXH32_round(v3, XXH_readLE32(p)); p += 4;
+            v4 = XXH32_round(v4, XXH_readLE32(p)); p += 4;
+        }
+        h32 = XXH_rotl32(v1, 1) + XXH_rotl32(v2, 7)
+            + XXH_rotl32(v3, 12) + XXH_rotl32(v4, 18);
+    } else {
+        h32 = seed + XXH_PRIME32_5;
+    }
+    h32 += (xxh_u32)len;
+    return XXH32_finalize(h32, p, len & 15, XXH_unaligned);
+}
+
+static XXH64_hash_t
+xxhash_xxh64_finish(const xxh_u8 *input, size_t len, size_t done,
+                    const xxh_u64 v[4], XXH64_hash_t seed)
+{
+    const xxh_u8 *p = input + done;
+    xxh_u64 h64;
+
+    if (len >= 32) {
+        const xxh_u8 *const limit = input + len - 31;
+        xxh_u64 v1 = v[0], v2 = v[1], v3 = v[2], v4 = v[3];
+        while (p < limit) {
+            v1 = XXH64_round(v1, XXH_readLE64(p)); p += 8;
+            v2 = XXH64_round(v2, XXH_readLE64(p)); p += 8;
+            v3 = XXH64_round(v3, XXH_readLE64(p)); p += 8;
+            v4 = XXH64_round(v4, XXH_readLE64(p)); p += 8;
+        }
+        h64 = XXH_rotl64(v1, 1) + XXH_rotl64(v2, 7)
+            + XXH_rotl64(v3, 12) + XXH_rotl64(v4, 18);
+        h64 = XXH64_mergeRound(h64, v1);
+        h64 = XXH64_mergeRound(h64, v2);
+        h64 = XXH64_mergeRound(h64, v3);
+        h64 = XXH64_mergeRound(h64, v4);
+    } else {
+        h64 = seed + XXH_PRIME64_5;
+    }
+    h64 += (xxh_u64)len;
+    return XXH64_finalize(h64, p, len, XXH_unaligned);
+}
+
+XXHASH_DEFINE_BACKEND(scalar, , XXH3_accumulate_scalar,
+                      XXH3_scrambleAcc_scalar, XXH3_initCustomSecret_scalar)
+
+#ifdef XXHASH_X86DISPATCH
+
+XXHASH_DEFINE_BACKEND(sse2, XXH_TARGET_SSE2, XXH3_accumulate_sse2,
+                      XXH3_scrambleAcc_sse2, XXH3_initCustomSecret_sse2)
+XXHASH_DEFINE_BACKEND(avx2, XXH_TARGET_AVX2, XXH3_accumulate_avx2,
+                      XXH3_scrambleAcc_avx2, XXH3_initCustomSecret_avx2)
+
+/* Multi-buffer XXH32: eight inputs at once, one per 32-bit lane, each of
+ * the four accumulators of XXH32 being a vector over the inputs. XXH32 is
+ * serial within one input, but independent inputs run in lockstep for the
+ * stripes they have in common. */
+
+XXH_FORCE_INLINE XXH_TARGET_AVX2 __m256i
+xxhash_xxh32_round_avx2(__m256i acc, __m256i input)
+{
+    acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(
+        input, _mm256_set1_epi32((int)XXH_PRIME32_2)));
+    acc = _mm256_or_si256(_mm256_slli_epi32(acc, 13),
+                          _mm256_srli_epi32(acc, 19));
+    return _mm256_mullo_epi32(acc, _mm256_set1_epi32((int)XXH_PRIME32_1));
+}
+
+/* 16 bytes at offset of inputs j and j + 4, in the low and high halves. */
+XXH_FORCE_INLINE XXH_TARGET_AVX2 __m256i
+xxhash_load_pair_avx2(const xxh_u8 *const *p, int j, size_t offset)
+{
+    return _mm256_inserti128_si256(
+        _mm256_castsi128_si256(
+            _mm_loadu_si128((const __m128i *)(const void *)(p[j] + offset))),
+        _mm_loadu_si128((const __m128i *)(const void *)(p[j + 4] + offset)),
+        1);
+}
+
+static XXH_TARGET_AVX2 void
+xxhash_xxh32_avx2(const void *const *inputs, const size_t *lens, size_t n,
+                  XXH32_hash_t seed, XXH32_hash_t *out)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        const xxh_u8 *p[8];
+        size_t stripes = (size_t)-1;
+        xxh_u32 v[4][8];
+        int j;
+
+        for (j = 0; j < 8; j++) {
+            p[j] = (const xxh_u8 *)inputs[i + j];
+            if (lens[i + j] / 16 < stripes)
+                stripes = lens[i + j] / 16;
+        }
+        if (stripes == 0) {
+            xxhash_xxh32_scalar(inputs + i, lens + i, 8, seed, out + i);
+            continue;
+        }
+        {
+            __m256i v1 = _mm256_set1_epi32(
+                (int)(seed + XXH_PRIME32_1 + XXH_PRIME32_2));
+            __m256i v2 = _mm256_set1_epi32((int)(seed + XXH_PRIME32_2));
+            __m256i v3 = _mm256_set1_epi32((int)seed);
+            __m256i v4 = _mm256_set1_epi32((int)(seed - XXH_PRIME32_1));
+            for (size_t off = 0; off < stripes * 16; off += 16) {
+                /* Transpose the 4 words of 8 stripes to 4 vectors of the
+                 * i-th word of inputs 0-7. */
+                __m256i const a = xxhash_load_pair_avx2(p, 0, off);
+                __m256i const b = xxhash_load_pair_avx2(p, 1, off);
+                __m256i const c = xxhash_load_pair_avx2(p, 2, off);
+                __m256i const d = xxhash_load_pair_avx2(p, 3, off);
+                __m256i const ab_lo = _mm256_unpacklo_epi32(a, b);
+                __m256i const ab_hi = _mm256_unpackhi_epi32(a, b);
+                __m256i const cd_lo = _mm256_unpacklo_epi32(c, d);
+                __m256i const cd_hi = _mm256_unpackhi_epi32(c, d);
+                v1 = xxhash_xxh32_round_avx2(
+                    v1, _mm256_unpacklo_epi64(ab_lo, cd_lo));
+                v2 = xxhash_xxh32_round_avx2(
+                    v2, _mm256_unpackhi_epi64(ab_lo, cd_lo));
+                v3 = xxhash_xxh32_round_avx2(
+                    v3, _mm256_unpacklo_epi64(ab_hi, cd_hi));
+                v4 = xxhash_xxh32_round_avx2(
+                    v4, _mm256_unpackhi_epi64(ab_hi, cd_hi));
+            }
+            _mm256_storeu_si256((__m256i *)(void *)v[0], v1);
+            _mm256_storeu_si256((__m256i *)(void *)v[1], v2);
+            _mm256_storeu_si256((__m256i *)(void *)v[2], v3);
+            _mm256_storeu_si256((__m256i *)(void *)v[3], v4);
+        }
+        for (j = 0; j < 8; j++) {
+            xxh_u32 const acc[4] = { v[0][j], v[1][j], v[2][j], v[3][j] };
+            out[i + j] = xxhash_xxh32_finish(p[j], lens[i + j], stripes * 16,
+                                             acc, seed);
+        }
+    }
+    xxhash_xxh32_scalar(inputs + i, lens + i, n - i, seed, out + i);
+}
+
+/* Fixed-width XXH3_64: inputs of 4, 8 or 16 bytes back to back, as in
+ * an array of integers, one per 64-bit lane. Unlike the short kernel
+ * below, the length is the same in every lane, so there are no masks or
+ * gathers, only plain loads, and four lanes already beat scalar code. */
+
+/* Lanes of the low 64 bits of lhs * rhs. */
+XXH_FORCE_INLINE XXH_TARGET_AVX2 __m256i
+xxhash_mult64_avx2(__m256i lhs, __m256i rhs)
+{
+    __m256i const cross = _mm256_add_epi64(
+        _mm256_mul_epu32(_mm256_srli_epi64(lhs, 32), rhs),
+        _mm256_mul_epu32(lhs, _mm256_srli_epi64(rhs, 32)));
+    return _mm256_add_epi64(_mm256_mul_epu32(lhs, rhs),
+                            _mm256_slli_epi64(cross, 32));
+}
+
+XXH_FORCE_INLINE XXH_TARGET_AVX2 __m256i
+xxhash_rotl64_avx2(__m256i v, int r)
+{
+    return _mm256_or_si256(_mm256_slli_epi64(v, r),
+                           _mm256_srli_epi64(v, 64 - r));
+}
+
+/* Lanes of XXH3_mul128_fold64(). */
+XXH_FORCE_INLINE XXH_TARGET_AVX2 __m256i
+xxhash_mul128_fold64_avx2(__m256i lhs, __m256i rhs)
+{
+    __m256i const mask32 = _mm256_set1_epi64x(0xFFFFFFFF);
+    __m256i const lhs_hi = _mm256_srli_epi64(lhs, 32);
+    __m256i const rhs_hi = _mm256_srli_epi64(rhs, 32);
+    __m256i const lo_lo = _mm256_mul_epu32(lhs, rhs);
+    __m256i const lo_hi = _mm256_mul_epu32(lhs, rhs_hi);
+    __m256i const hi_lo = _mm256_mul_epu32(lhs_hi, rhs);
+    __m256i const hi_hi = _mm256_mul_epu32(lhs_hi, rhs_hi);
+    __m256i const cross = _mm256_add_epi64(
+        _mm256_add_epi64(_mm256_srli_epi64(lo_lo, 32),
+                         _mm256_and_si256(lo_hi, mask32)),
+        _mm256_and_si256(hi_lo, mask32));
+    __m256i const lower = _mm256_or_si256(_mm256_slli_epi64(cross, 32),
+                                          _mm256_and_si256(lo_lo, mask32));
+    __m256i const upper = _mm256_add_epi64(
+        _mm256_add_epi64(hi_hi, _mm256_srli_epi64(lo_hi, 32)),
+        _mm256_add_epi64(_mm256_srli_epi64(hi_lo, 32),
+                         _mm256_srli_epi64(cross, 32)));
+    return _mm256_xor_si256(lower, upper);
+}
+
+/* Lanes of XXH3_rrmxmx() and XXH3_avalanche(). */
+XXH_FORCE_INLINE XXH_TARGET_AVX2 __m256i
+xxhash_rrmxmx_avx2(__m256i h, __m256i len)
+{
+    __m256i const prime = _mm256_set1_epi64x(0x9FB21C651E98DF25ULL);
+    h = _mm256_xor_si256(h, _mm256_xor_si256(xxhash_rotl64_avx2(h, 49),
+                                             xxhash_rotl64_avx2(h, 24)));
+    h = xxhash_mult64_avx2(h, prime);
+    h = _mm256_xor_si256(h, _mm256_add_epi64(_mm256_srli_epi64(h, 35), len));
+    h = xxhash_mult64_avx2(h, prime);
+    return _mm256_xor_si256(h, _mm256_srli_epi64(h, 28));
+}
+
+XXH_FORCE_INLINE XXH_TARGET_AVX2 __m256i
+xxhash_avalanche_avx2(__m256i h)
+{
+    h = _mm256_xor_si256(h, _mm256_srli_epi64(h, 37));
+    h = xxhash_mult64_avx2(h, _mm256_set1_epi64x(0x165667919E3779F9ULL));
+    return _mm256_xor_si256(h, _mm256_srli_epi64(h, 32));
+}
+
+static XXH_TARGET_AVX2 void
+xxhash_fixed64_avx2(const void *input, size_t width, size_t n,
+                    XXH64_hash_t seed, XXH64_hash_t *out)
+{
+    const xxh_u8 *const p = (const xxh_u8 *)input;
+    size_t i = 0;
+
+    if (width == 4 || width == 8) {
+        /* XXH3_len_4to8_64b() reads the first and last 4 bytes, which are
+         * the same word for 4 bytes and the two halves for 8. */
+        __m256i const bitflip = _mm256_set1_epi64x(
+            (long long)xxhash_bitflip4to8(seed));
+        __m256i const len = _mm256_set1_epi64x((long long)width);
+        for (; i + 4 <= n; i += 4) {
+            __m256i x;
+            if (width == 4) {
+                x = _mm256_cvtepu32_epi64(_mm_loadu_si128(
+                    (const __m128i *)(const void *)(p + 4 * i)));
+                x = _mm256_or_si256(x, _mm256_slli_epi64(x, 32));
+            } else {
+                x = _mm256_shuffle_epi32(_mm256_loadu_si256(
+                    (const __m256i *)(const void *)(p + 8 * i)), 0xB1);
+            }
+            _mm256_storeu_si256(
+                (__m256i *)(void *)(out + i),
+                xxhash_rrmxmx_avx2(_mm256_xor_si256(x, bitflip), len));
+        }
+    } else if (width == 16) {
+        __m256i const bitflip_lo = _mm256_set1_epi64x(
+            (long long)xxhash_bitflip9to16_lo(seed));
+        __m256i const bitflip_hi = _mm256_set1_epi64x(
+            (long long)xxhash_bitflip9to16_hi(seed));
+        for (; i + 4 <= n; i += 4) {
+            /* Inputs 0, 1 and 2, 3; unpacking leaves the lanes in the
+             * order 0, 2, 1, 3, put back in order by the permute. */
+            __m256i const a = _mm256_loadu_si256(
+                (const __m256i *)(const void *)(p + 16 * i));
+            __m256i const b = _mm256_loadu_si256(
+                (const __m256i *)(const void *)(p + 16 * i + 32));
+            __m256i const lo = _mm256_xor_si256(
+                _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(a, b), 0xD8),
+                bitflip_lo);
+            __m256i const hi = _mm256_xor_si256(
+                _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(a, b), 0xD8),
+                bitflip_hi);
+            __m256i const swapped = _mm256_shuffle_epi8(lo, _mm256_set_epi8(
+                8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7,
+                8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7));
+            __m256i const acc = _mm256_add_epi64(
+                _mm256_add_epi64(_mm256_set1_epi64x(16), swapped),
+                _mm256_add_epi64(hi, xxhash_mul128_fold64_avx2(lo, hi)));
+            _mm256_storeu_si256((__m256i *)(void *)(out + i),
+                                xxhash_avalanche_avx2(acc));
+        }
+    }
+    xxhash_fixed64_scalar(p + width * i, width, n - i, seed, out + i);
+}
+
+/* MinHash update with permutations in the lanes, each hash broadcast.
+ * AVX2 has no unsigned 64-bit compare, so minima are kept with the sign
+ * bit flipped, and compared signed; adding 2**63 to b[i] flips it in the
+ * images for free. */
+static XXH_TARGET_AVX2 void
+xxhash_minhash_avx2(XXH64_hash_t *sig, const XXH64_hash_t *a,
+                    const XXH64_hash_t *b, size_t k,
+                    const XXH64_hash_t *h, size_t n)
+{
+    __m256i const sign = _mm256_set1_epi64x((long long)(1ULL << 63));
+    size_t i = 0;
+
+    for (; i + 8 <= k; i += 8) {
+        __m256i const a0 = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i const a1 = _mm256_loadu_si256((const __m256i *)(a + i + 4));
+        __m256i const a0_hi = _mm256_srli_epi64(a0, 32);
+        __m256i const a1_hi = _mm256_srli_epi64(a1, 32);
+        __m256i const b0 = _mm256_xor_si256(
+            _mm256_loadu_si256((const __m256i *)(b + i)), sign);
+        __m256i const b1 = _mm256_xor_si256(
+            _mm256_loadu_si256((const __m256i *)(b + i + 4)), sign);
+        __m256i m0 = _mm256_xor_si256(
+            _mm256_loadu_si256((const __m256i *)(sig + i)), sign);
+        __m256i m1 = _mm256_xor_si256(
+            _mm256_loadu_si256((const __m256i *)(sig + i + 4)), sign);
+        for (size_t j = 0; j < n; j++) {
+            __m256i const x = _mm256_set1_epi64x((long long)h[j]);
+            __m256i const x_hi = _mm256_set1_epi64x((long long)(h[j] >> 32));
+            __m256i const v0 = _mm256_add_epi64(
+                _mm256_add_epi64(_mm256_mul_epu32(a0, x), b0),
+                _mm256_slli_epi64(_mm256_add_epi64(
+                    _mm256_mul_epu32(a0_hi, x), _mm256_mul_epu32(a0, x_hi)),
+                    32));
+            __m256i const v1 = _mm256_add_epi64(
+                _mm256_add_epi64(_mm256_mul_epu32(a1, x), b1),
+                _mm256_slli_epi64(_mm256_add_epi64(
+                    _mm256_mul_epu32(a1_hi, x), _mm256_mul_epu32(a1, x_hi)),
+                    32));
+            m0 = _mm256_blendv_epi8(m0, v0, _mm256_cmpgt_epi64(m0, v0));
+            m1 = _mm256_blendv_epi8(m1, v1, _mm256_cmpgt_epi64(m1, v1));
+        }
+        _mm256_storeu_si256((__m256i *)(sig + i), _mm256_xor_si256(m0, sign));
+        _mm256_storeu_si256((__m256i *)(sig + i + 4),
+                            _mm256_xor_si256(m1, sign));
+    }
+    xxhash_minhash_scalar(sig + i, a + i, b + i, k - i, h, n);
+}
+
+static const xxhash_many_kernels xxhash_many_avx2 = {
+    xxhash_short64_scalar, 1,
+    xxhash_xxh32_avx2, 8,
+    xxhash_xxh64_scalar, 1,
+    xxhash_fixed64_avx2,
+    xxhash_minhash_avx2,
+};
+XXHASH_DEFINE_BACKEND(avx512, XXH_TARGET_AVX512, XXH3_accumulate_avx512,
+                      XXH3_scrambleAcc_avx512, XXH3_initCustomSecret_avx512)
+
+/* Lanes of the low 64 bits of lhs * rhs. AVX512F has no 64-bit multiply. */
+XXH_FORCE_INLINE XXH_TARGET_AVX512 __m512i
+xxhash_mult64_avx512(__m512i lhs, __m512i rhs)
+{
+    __m512i const cross = _mm512_add_epi64(
+        _mm512_mul_epu32(_mm512_srli_epi64(lhs, 32), rhs),
+        _mm512_mul_epu32(lhs, _mm512_srli_epi64(rhs, 32)));
+    return _mm512_add_epi64(_mm512_mul_epu32(lhs, rhs),
+                            _mm512_slli_epi64(cross, 32));
+}
+
+/* Lanes of XXH3_mul128_fold64(): the 128-bit product from four 32x32->64
+ * multiplies. */
+XXH_FORCE_INLINE XXH_TARGET_AVX512 __m512i
+xxhash_mul128_fold64_avx512(__m512i lhs, __m512i rhs)
+{
+    __m512i const mask32 = _mm512_set1_epi64(0xFFFFFFFF);
+    __m512i const lhs_hi = _mm512_srli_epi64(lhs, 32);
+    __m512i const rhs_hi = _mm512_srli_epi64(rhs, 32);
+    __m512i const lo_lo = _mm512_mul_epu32(lhs, rhs);
+    __m512i const lo_hi = _mm512_mul_epu32(lhs, rhs_hi);
+    __m512i const hi_lo = _mm512_mul_epu32(lhs_hi, rhs);
+    __m512i const hi_hi = _mm512_mul_epu32(lhs_hi, rhs_hi);
+    __m512i const cross = _mm512_add_epi64(
+        _mm512_add_epi64(_mm512_srli_epi64(lo_lo, 32),
+                         _mm512_and_si512(lo_hi, mask32)),
+        _mm512_and_si512(hi_lo, mask32));
+    __m512i const lower = _mm512_or_si512(_mm512_slli_epi64(cross, 32),
+                                          _mm512_and_si512(lo_lo, mask32));
+    __m512i const upper = _mm512_add_epi64(
+        _mm512_add_epi64(hi_hi, _mm512_srli_epi64(lo_hi, 32)),
+        _mm512_add_epi64(_mm512_srli_epi64(hi_lo, 32),
+                         _mm512_srli_epi64(cross, 32)));
+    return _mm512_xor_si512(lower, upper);
+}
+
+XXH_FORCE_INLINE XXH_TARGET_AVX512 __m512i
+xxhash_xorshift64_avx512(__m512i v, int shift)
+{
+    return _mm512_xor_si512(v, _mm512_srli_epi64(v, shift));
+}
+
+/* Lanes of XXH_swap64(). AVX512F has no byte shuffle. */
+XXH_FORCE_INLINE XXH_TARGET_AVX512 __m512i
+xxhash_swap64_avx512(__m512i v)
+{
+    __m512i const mask8 = _mm512_set1_epi64(0x00FF00FF00FF00FFULL);
+    __m512i const mask16 = _mm512_set1_epi64(0x0000FFFF0000FFFFULL);
+    v = _mm512_or_si512(_mm512_slli_epi64(_mm512_and_si512(v, mask8), 8),
+                        _mm512_and_si512(_mm512_srli_epi64(v, 8), mask8));
+    v = _mm512_or_si512(_mm512_slli_epi64(_mm512_and_si512(v, mask16), 16),
+                        _mm512_and_si512(_mm512_srli_epi64(v, 16), mask16));
+    return _mm512_rol_epi64(v, 32);
+}
+
+/* Lanes of XXH3_rrmxmx() and XXH3_avalanche(). */
+XXH_FORCE_INLINE XXH_TARGET_AVX512 __m512i
+xxhash_rrmxmx_avx512(__m512i h, __m512i len)
+{
+    __m512i const prime = _mm512_set1_epi64(0x9FB21C651E98DF25ULL);
+    h = _mm512_xor_si512(h, _mm512_xor_si512(_mm512_rol_epi64(h, 49),
+                                             _mm512_rol_epi64(h, 24)));
+    h = xxhash_mult64_avx512(h, prime);
+    h = _mm512_xor_si512(h, _mm512_add_epi64(_mm512_srli_epi64(h, 35), len));
+    h = xxhash_mult64_avx512(h, prime);
+    return xxhash_xorshift64_avx512(h, 28);
+}
+
+XXH_FORCE_INLINE XXH_TARGET_AVX512 __m512i
+xxhash_avalanche_avx512(__m512i h)
+{
+    h = xxhash_xorshift64_avx512(h, 37);
+    h = xxhash_mult64_avx512(h, _mm512_set1_epi64(0x165667919E3779F9ULL));
+    return xxhash_xorshift64_avx512(h, 32);
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+/* Multi-lane XXH3_64 for short inputs: eight inputs per step, one in each
+ * 64-bit lane, following XXH3_len_4to8_64b(), XXH3_len_9to16_64b() and
+ * XXH3_len_17to128_64b() with the length checks turned into lane masks.
+ * Lanes only load bytes of their own input, using masked gathers, so the
+ * result is the same as hashing one at a time, without reading past any
+ * input. This trades the unpredictable branches on the length for vector
+ * work, which pays off when lengths vary. AVX2 has the same instructions
+ * but only four lanes, too few to beat scalar 64x64->128 multiplies. */
+
+/* Load 8 bytes at addr + offset in the lanes set in mask, 0 elsewhere.
+ * addr holds absolute addresses, so the gathers use a null base. */
+XXH_FORCE_INLINE XXH_TARGET_AVX512 __m512i
+xxhash_load64_avx512(__mmask8 mask, __m512i addr, long long offset)
+{
+    return _mm512_mask_i64gather_epi64(
+        _mm512_setzero_si512(), mask,
+        _mm512_add_epi64(addr, _mm512_set1_epi64(offset)), (void const *)0, 1);
+}
+
+/* Same for 4 bytes, zero extended. */
+XXH_FORCE_INLINE XXH_TARGET_AVX512 __m512i
+xxhash_load32_avx512(__mmask8 mask, __m512i addr, long long offset)
+{
+    return _mm512_cvtepu32_epi64(_mm512_mask_i64gather_epi32(
+        _mm256_setzero_si256(), mask,
+        _mm512_add_epi64(addr, _mm512_set1_epi64(offset)), (void const *)0, 1));
+}
+
+/* One XXH3_mix16B() per lane in mask, 16 bytes at addr + offset with the
+ * 16 bytes of secret. */
+XXH_FORCE_INLINE XXH_TARGET_AVX512 __m512i
+xxhash_mix16B_avx512(__mmask8 mask, __m512i addr, long long offset,
+                     const xxh_u8 *secret, XXH64_hash_t seed)
+{
+    return xxhash_mul128_fold64_avx512(
+        _mm512_xor_si512(xxhash_load64_avx512(mask, addr, offset),
+                         _mm512_set1_epi64(XXH_readLE64(secret) + seed)),
+        _mm512_xor_si512(xxhash_load64_avx512(mask, addr, offset + 8),
+                         _mm512_set1_epi64(XXH_readLE64(secret + 8) - seed)));
+}
+
+static XXH_TARGET_AVX512 void
+xxhash_short64_avx512(const void *const *inputs, const size_t *lens,
+                      size_t n, XXH64_hash_t seed, XXH64_hash_t *out)
+{
+    const xxh_u8 *const secret = XXH3_kSecret;
+    /* Secret words of the 4-8 and 9-16 byte paths, XORed with the seed. */
+    XXH64_hash_t const seed4 = seed ^ ((xxh_u64)XXH_swap32((xxh_u32)seed) << 32);
+    __m512i const bitflip4 = _mm512_set1_epi64(
+        (XXH_readLE64(secret + 8) ^ XXH_readLE64(secret + 16)) - seed4);
+    __m512i const bitflip9_lo = _mm512_set1_epi64(
+        (XXH_readLE64(secret + 24) ^ XXH_readLE64(secret + 32)) + seed);
+    __m512i const bitflip9_hi = _mm512_set1_epi64(
+        (XXH_readLE64(secret + 40) ^ XXH_readLE64(secret + 48)) - seed);
+    __m512i const mix_lo = _mm512_set1_epi64(XXH_readLE64(secret) + seed);
+    __m512i const mix_hi = _mm512_set1_epi64(XXH_readLE64(secret + 8) - seed);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m512i const start = _mm512_loadu_si512((const void *)(inputs + i));
+        __m512i const len = _mm512_loadu_si512((const void *)(lens + i));
+        __m512i const end = _mm512_add_epi64(start, len);
+        __mmask8 const m17 = _mm512_cmpgt_epu64_mask(len, _mm512_set1_epi64(16));
+        __mmask8 const m9 = _mm512_cmpgt_epu64_mask(len, _mm512_set1_epi64(8));
+        __mmask8 const m9to16 = (__mmask8)(m9 & ~m17);
+        __mmask8 const m4to8 = (__mmask8)(
+            _mm512_cmpgt_epu64_mask(len, _mm512_set1_epi64(3)) & ~m9);
+        unsigned tiny = (unsigned)(__mmask8)~(m9 | m4to8);
+        __m512i h = _mm512_setzero_si512();
+
+        if (m9) {
+            /* 9-16 and 17-128 bytes both start by folding the first 8
+             * bytes into a product, and both load the last 8 bytes, so
+             * share those between the two paths. */
+            __m512i const first = xxhash_load64_avx512(m9, start, 0);
+            __m512i const last = xxhash_load64_avx512(m9, end, -8);
+            __m512i const lo = _mm512_xor_si512(
+                first, _mm512_mask_mov_epi64(mix_lo, m9to16, bitflip9_lo));
+            __m512i const hi9 = _mm512_xor_si512(last, bitflip9_hi);
+            __m512i const hi = _mm512_mask_mov_epi64(
+                _mm512_xor_si512(xxhash_load64_avx512(m17, start, 8), mix_hi),
+                m9to16, hi9);
+            __m512i acc = _mm512_add_epi64(
+                len, xxhash_mul128_fold64_avx512(lo, hi));
+
+            if (m9to16) {
+                acc = _mm512_mask_add_epi64(
+                    acc, m9to16, acc,
+                    _mm512_add_epi64(xxhash_swap64_avx512(lo), hi9));
+            }
+            if (m17) {
+                __mmask8 active = m17;
+                int r;
+                /* len * PRIME64_1, len already being in acc. */
+                acc = _mm512_mask_add_epi64(acc, m17, acc, _mm512_add_epi64(
+                    xxhash_mult64_avx512(
+                        len, _mm512_set1_epi64(XXH_PRIME64_1 - 1)),
+                    xxhash_mul128_fold64_avx512(
+                        _mm512_xor_si512(
+                            xxhash_load64_avx512(m17, end, -16),
+                            _mm512_set1_epi64(XXH_readLE64(secret + 16)
+                                              + seed)),
+                        _mm512_xor_si512(
+                            last,
+                            _mm512_set1_epi64(XXH_readLE64(secret + 24)
+                                              - seed)))));
+                for (r = 1; r < 4; r++) {
+                    active &= _mm512_cmpgt_epu64_mask(
+                        len, _mm512_set1_epi64(32 * r));
+                    if (!active)
+                        break;
+                    acc = _mm512_mask_add_epi64(acc, active, acc,
+                        _mm512_add_epi64(
+                            xxhash_mix16B_avx512(active, start, 16 * r,
+                                                 secret + 32 * r, seed),
+                            xxhash_mix16B_avx512(active, end, -16 * (r + 1),
+                                                 secret + 32 * r + 16, seed)));
+                }
+            }
+            h = xxhash_avalanche_avx512(acc);
+        }
+        if (m4to8) {
+            __m512i const v = _mm512_xor_si512(
+                _mm512_add_epi64(
+                    xxhash_load32_avx512(m4to8, end, -4),
+                    _mm512_slli_epi64(
+                        xxhash_load32_avx512(m4to8, start, 0), 32)),
+                bitflip4);
+            h = _mm512_mask_mov_epi64(h, m4to8,
+                                      xxhash_rrmxmx_avx512(v, len));
+        }
+        _mm512_storeu_si512((void *)(out + i), h);
+        /* 0-3 bytes are rare enough to do one by one. */
+        for (int j = 0; tiny; j++, tiny >>= 1) {
+            if (tiny & 1)
+                out[i + j] = XXH3_64bits_withSeed(inputs[i + j], lens[i + j],
+                                                  seed);
+        }
+    }
+    xxhash_short64_scalar(inputs + i, lens + i, n - i, seed, out + i);
+}
+
+#  define XXHASH_AVX512_SHORT_LANES 8
+#else
+/* The kernel takes pointers and sizes as 64-bit lanes. */
+#  define xxhash_short64_avx512 xxhash_short64_scalar
+#  define XXHASH_AVX512_SHORT_LANES 1
+#endif
+
+/* Multi-buffer XXH64, the same as xxhash_xxh32_avx2() with eight 64-bit
+ * lanes. AVX512F has no 64-bit multiply, and the three 32-bit ones taking
+ * its place only pay off once the inputs have about 1 KiB in common. AVX2
+ * with four lanes is slower than scalar code at any length. */
+#define XXHASH_XXH64_MIN_STRIPES 32
+
+XXH_FORCE_INLINE XXH_TARGET_AVX512 __m512i
+xxhash_xxh64_round_avx512(__m512i acc, __m512i input)
+{
+    acc = _mm512_add_epi64(acc, xxhash_mult64_avx512(
+        input, _mm512_set1_epi64((long long)XXH_PRIME64_2)));
+    acc = _mm512_rol_epi64(acc, 31);
+    return xxhash_mult64_avx512(acc,
+                                _mm512_set1_epi64((long long)XXH_PRIME64_1));
+}
+
+/* 32 bytes at offset of inputs j and j + 4, in the low and high halves. */
+XXH_FORCE_INLINE XXH_TARGET_AVX512 __m512i
+xxhash_load_pair_avx512(const xxh_u8 *const *p, int j, size_t offset)
+{
+    return _mm512_inserti64x4(
+        _mm512_castsi256_si512(_mm256_loadu_si256(
+            (const __m256i *)(const void *)(p[j] + offset))),
+        _mm256_loadu_si256((const __m256i *)(const void *)(p[j + 4] + offset)),
+        1);
+}
+
+static XXH_TARGET_AVX512 void
+xxhash_xxh64_avx512(const void *const *inputs, const size_t *lens, size_t n,
+                    XXH64_hash_t seed, XXH64_hash_t *out)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        const xxh_u8 *p[8];
+        size_t stripes = (size_t)-1;
+        xxh_u64 v[4][8];
+        int j;
+
+        for (j = 0; j < 8; j++) {
+            p[j] = (const xxh_u8 *)inputs[i + j];
+            if (lens[i + j] / 32 < stripes)
+                stripes = lens[i + j] / 32;
+        }
+        if (stripes < XXHASH_XXH64_MIN_STRIPES) {
+            xxhash_xxh64_scalar(inputs + i, lens + i, 8, seed, out + i);
+            continue;
+        }
+        {
+            __m512i v1 = _mm512_set1_epi64(
+                (long long)(seed + XXH_PRIME64_1 + XXH_PRIME64_2));
+            __m512i v2 = _mm512_set1_epi64((long long)(seed + XXH_PRIME64_2));
+            __m512i v3 = _mm512_set1_epi64((long long)seed);
+            __m512i v4 = _mm512_set1_epi64((long long)(seed - XXH_PRIME64_1));
+            /* Picks words 0 (or 2 with odd) of inputs 0-3 from the low
+             * halves of the unpacked pairs and 4-7 from the high ones. */
+            __m512i const even = _mm512_set_epi64(13, 12, 5, 4, 9, 8, 1, 0);
+            __m512i const odd = _mm512_set_epi64(15, 14, 7, 6, 11, 10, 3, 2);
+            for (size_t off = 0; off < stripes * 32; off += 32) {
+                __m512i const a = xxhash_load_pair_avx512(p, 0, off);
+                __m512i const b = xxhash_load_pair_avx512(p, 1, off);
+                __m512i const c = xxhash_load_pair_avx512(p, 2, off);
+                __m512i const d = xxhash_load_pair_avx512(p, 3, off);
+                __m512i const ab_lo = _mm512_unpacklo_epi64(a, b);
+                __m512i const ab_hi = _mm512_unpackhi_epi64(a, b);
+                __m512i const cd_lo = _mm512_unpacklo_epi64(c, d);
+                __m512i const cd_hi = _mm512_unpackhi_epi64(c, d);
+                v1 = xxhash_xxh64_round_avx512(
+                    v1, _mm512_permutex2var_epi64(ab_lo, even, cd_lo));
+                v2 = xxhash_xxh64_round_avx512(
+                    v2, _mm512_permutex2var_epi64(ab_hi, even, cd_hi));
+                v3 = xxhash_xxh64_round_avx512(
+                    v3, _mm512_permutex2var_epi64(ab_lo, odd, cd_lo));
+                v4 = xxhash_xxh64_round_avx512(
+                    v4, _mm512_permutex2var_epi64(ab_hi, odd, cd_hi));
+            }
+            _mm512_storeu_si512((void *)v[0], v1);
+            _mm512_storeu_si512((void *)v[1], v2);
+            _mm512_storeu_si512((void *)v[2], v3);
+            _mm512_storeu_si512((void *)v[3], v4);
+        }
+        for (j = 0; j < 8; j++) {
+            xxh_u64 const acc[4] = { v[0][j], v[1][j], v[2][j], v[3][j] };
+            out[i + j] = xxhash_xxh64_finish(p[j], lens[i + j], stripes * 32,
+                                             acc, seed);
+        }
+    }
+    xxhash_xxh64_scalar(inputs + i, lens + i, n - i, seed, out + i);
+}
+
+/* xxhash_fixed64_avx2() with eight lanes. */
+static XXH_TARGET_AVX512 void
+xxhash_fixed64_avx512(const void *input, size_t width, size_t n,
+                      XXH64_hash_t seed, XXH64_hash_t *out)
+{
+    const xxh_u8 *const p = (const xxh_u8 *)input;
+    size_t i = 0;
+
+    if (width == 4 || width == 8) {
+        __m512i const bitflip = _mm512_set1_epi64(
+            (long long)xxhash_bitflip4to8(seed));
+        __m512i const len = _mm512_set1_epi64((long long)width);
+        for (; i + 8 <= n; i += 8) {
+            __m512i x;
+            if (width == 4) {
+                x = _mm512_cvtepu32_epi64(_mm256_loadu_si256(
+                    (const __m256i *)(const void *)(p + 4 * i)));
+                x = _mm512_or_si512(x, _mm512_slli_epi64(x, 32));
+            } else {
+                x = _mm512_rol_epi64(_mm512_loadu_si512(
+                    (const void *)(p + 8 * i)), 32);
+            }
+            _mm512_storeu_si512(
+                (void *)(out + i),
+                xxhash_rrmxmx_avx512(_mm512_xor_si512(x, bitflip), len));
+        }
+    } else if (width == 16) {
+        __m512i const bitflip_lo = _mm512_set1_epi64(
+            (long long)xxhash_bitflip9to16_lo(seed));
+        __m512i const bitflip_hi = _mm512_set1_epi64(
+            (long long)xxhash_bitflip9to16_hi(seed));
+        __m512i const even = _mm512_set_epi64(14, 12, 10, 8, 6, 4, 2, 0);
+        __m512i const odd = _mm512_set_epi64(15, 13, 11, 9, 7, 5, 3, 1);
+        for (; i + 8 <= n; i += 8) {
+            __m512i const a = _mm512_loadu_si512((const void *)(p + 16 * i));
+            __m512i const b = _mm512_loadu_si512(
+                (const void *)(p + 16 * i + 64));
+            __m512i const lo = _mm512_xor_si512(
+                _mm512_permutex2var_epi64(a, even, b), bitflip_lo);
+            __m512i const hi = _mm512_xor_si512(
+                _mm512_permutex2var_epi64(a, odd, b), bitflip_hi);
+            __m512i const acc = _mm512_add_epi64(
+                _mm512_add_epi64(_mm512_set1_epi64(16),
+                                 xxhash_swap64_avx512(lo)),
+                _mm512_add_epi64(hi, xxhash_mul128_fold64_avx512(lo, hi)));
+            _mm512_storeu_si512((void *)(out + i),
+                                xxhash_avalanche_avx512(acc));
+        }
+    }
+    xxhash_fixed64_scalar(p + width * i, width, n - i, seed, out + i);
+}
+
+/* xxhash_minhash_avx2() with eight lanes, and 32 permutations per pass
+ * over the hashes. */
+XXH_FORCE_INLINE XXH_TARGET_AVX512 __m512i
+xxhash_minhash_step_avx512(__m512i m, __m512i a, __m512i a_hi, __m512i b,
+                           __m512i x, __m512i x_hi)
+{
+    __m512i const cross = _mm512_add_epi64(_mm512_mul_epu32(a_hi, x),
+                                           _mm512_mul_epu32(a, x_hi));
+    __m512i const v = _mm512_add_epi64(
+        _mm512_add_epi64(_mm512_mul_epu32(a, x), b),
+        _mm512_slli_epi64(cross, 32));
+    return _mm512_min_epu64(m, v);
+}
+
+static XXH_TARGET_AVX512 void
+xxhash_minhash_avx512(XXH64_hash_t *sig, const XXH64_hash_t *a,
+                      const XXH64_hash_t *b, size_t k,
+                      const XXH64_hash_t *h, size_t n)
+{
+    size_t i = 0;
+
+    for (; i + 32 <= k; i += 32) {
+        __m512i av[4], av_hi[4], bv[4], m[4];
+        for (int q = 0; q < 4; q++) {
+            av[q] = _mm512_loadu_si512((const void *)(a + i + 8 * q));
+            av_hi[q] = _mm512_srli_epi64(av[q], 32);
+            bv[q] = _mm512_loadu_si512((const void *)(b + i + 8 * q));
+            m[q] = _mm512_loadu_si512((const void *)(sig + i + 8 * q));
+        }
+        for (size_t j = 0; j < n; j++) {
+            __m512i const x = _mm512_set1_epi64((long long)h[j]);
+            __m512i const x_hi = _mm512_set1_epi64((long long)(h[j] >> 32));
+            for (int q = 0; q < 4; q++) {
+                m[q] = xxhash_minhash_step_avx512(m[q], av[q], av_hi[q],
+                                                  bv[q], x, x_hi);
+            }
+        }
+        for (int q = 0; q < 4; q++) {
+            _mm512_storeu_si512((void *)(sig + i + 8 * q), m[q]);
+        }
+    }
+    for (; i + 8 <= k; i += 8) {
+        __m512i const av = _mm512_loadu_si512((const void *)(a + i));
+        __m512i const av_hi = _mm512_srli_epi64(av, 32);
+        __m512i const bv = _mm512_loadu_si512((const void *)(b + i));
+        __m512i m = _mm512_loadu_si512((const void *)(sig + i));
+        for (size_t j = 0; j < n; j++) {
+            m = xxhash_minhash_step_avx512(
+                m, av, av_hi, bv, _mm512_set1_epi64((long long)h[j]),
+                _mm512_set1_epi64((long long)(h[j] >> 32)));
+        }
+        _mm512_storeu_si512((void *)(sig + i), m);
+    }
+    xxhash_minhash_scalar(sig + i, a + i, b + i, k - i, h, n);
+}
+
+static const xxhash_many_kernels xxhash_many_avx512 = {
+    xxhash_short64_avx512, XXHASH_AVX512_SHORT_LANES,
+    xxhash_xxh32_avx2, 8,
+    xxhash_xxh64_avx512, 8,
+    xxhash_fixed64_avx512,
+    xxhash_minhash_avx512,
+};
+
+/* Widest first; xxhash_cpu_level() indexes this from the end. */
+static const xxhash_backend xxhash_backends[] = {
+    XXHASH_BACKEND("avx512", avx512, xxhash_many_avx512),
+    XXHASH_BACKEND("avx2", avx2, xxhash_many_avx2),
+    XXHASH_BACKEND("sse2", sse2, xxhash_many_scalar),
+    XXHASH_BACKEND("scalar", scalar, xxhash_many_scalar),
+};
+
+#if defined(_MSC_VER)
+#  define XXHASH_CPUID(leaf, sub, r) __cpuidex((int *)(r), (leaf), (sub))
+#  define XXHASH_XGETBV() ((unsigned)_xgetbv(0))
+#else
+#  include <cpuid.h>
+#  define XXHASH_CPUID(leaf, sub, r) \
+    __cpuid_count((leaf), (sub), (r)[0], (r)[1], (r)[2], (r)[3])
+static unsigned
+XXHASH_XGETBV(void)
+{
+    unsigned eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return eax;
+}
+#endif
+
+/* Number of backends this CPU supports, counting from scalar upwards:
+ * 1 scalar, 2 SSE2, 3 AVX2, 4 AVX-512. AVX needs the OS to save the YMM
+ * state and AVX-512 also the opmask and ZMM state, as reported by XCR0. */
+static int
+xxhash_cpu_level(void)
+{
+    unsigned r[4], max_leaf, xcr0;
+    int level = 1;
+
+    XXHASH_CPUID(0, 0, r);
+    max_leaf = r[0];
+    if (max_leaf < 1)
+        return level;
+    XXHASH_CPUID(1, 0, r);
+    if (!(r[3] & (1u << 26)))             /* SSE2 */
+        return level;
+    level = 2;
+    if (max_leaf < 7
+        || !(r[2] & (1u << 27))           /* OSXSAVE */
+        || !(r[2] & (1u << 28)))          /* AVX */
+        return level;
+    xcr0 = XXHASH_XGETBV();
+    if ((xcr0 & 0x6) != 0x6)              /* XMM and YMM state */
+        return level;
+    XXHASH_CPUID(7, 0, r);
+    if (!(r[1] & (1u << 5)))              /* AVX2 */
+        return level;
+    level = 3;
+    if ((xcr0 & 0xe0) != 0xe0             /* opmask and ZMM state */
+        || !(r[1] & (1u << 16)))          /* AVX512F */
+        return level;
+    return 4;
+}
+
+#else  /* !XXHASH_X86DISPATCH */
+
+/* Elsewhere the vector unit is part of the compile-time baseline (NEON on
+ * AArch64), so there is only that and the scalar fallback. */
+#if XXH_VECTOR == XXH_SCALAR
+static const xxhash_backend xxhash_backends[] = {
+    XXHASH_BACKEND("scalar", scalar, xxhash_many_scalar),
+};
+#else
+#  if XXH_VECTOR == XXH_NEON
+#    define XXHASH_NATIVE_NAME "neon"
+#  elif XXH_VECTOR == XXH_VSX
+#    define XXHASH_NATIVE_NAME "vsx"
+#  elif XXH_VECTOR == XXH_SVE
+#    define XXHASH_NATIVE_NAME "sve"
+#  elif XXH_VECTOR == XXH_AVX512
+#    define XXHASH_NATIVE_NAME "avx512"
+#  elif XXH_VECTOR == XXH_AVX2
+#    define XXHASH_NATIVE_NAME "avx2"
+#  else
+#    define XXHASH_NATIVE_NAME "sse2"
+#  endif
+XXHASH_DEFINE_BACKEND(native, , XXH3_accumulate, XXH3_scrambleAcc,
+                      XXH3_initCustomSecret)
+
+static const xxhash_backend xxhash_backends[] = {
+    XXHASH_BACKEND(XXHASH_NATIVE_NAME, native, xxhash_many_scalar),
+    XXHASH_BACKEND("scalar", scalar, xxhash_many_scalar),
+};
+#endif
+
+static int
+xxhash_cpu_level(void)
+{
+    return (int)(sizeof(xxhash_backends) / sizeof(xxhash_backends[0]));
+}
+
+#endif  /* XXHASH_X86DISPATCH */
+
+#define XXHASH_NUM_BACKENDS \
+    ((int)(sizeof(xxhash_backends) / sizeof(xxhash_backends[0])))
+
+/* The selected backend. It starts at the scalar one, the last, so calls
+ * made before xxhash_dispatch_select() are still correct. Backends only
+ * differ in speed, so a racing reader may use either one. */
+static const xxhash_backend *xxhash_backend_selected =
+    &xxhash_backends[XXHASH_NUM_BACKENDS - 1];
+
+const char *
+xxhash_dispatch_available(int i)
+{
+    int first = XXHASH_NUM_BACKENDS - xxhash_cpu_level();
+
+    if (i < 0 || first + i >= XXHASH_NUM_BACKENDS)
+        return NULL;
+    return xxhash_backends[first + i].name;
+}
+
+int
+xxhash_dispatch_select(const char *name)
+{
+    int first = XXHASH_NUM_BACKENDS - xxhash_cpu_level();
+
+    if (name == NULL) {
+        xxhash_backend_selected = &xxhash_backends[first];
+        return 0;
+    }
+    for (int i = first; i < XXHASH_NUM_BACKENDS; i++) {
+        if (strcmp(xxhash_backends[i].name, name) == 0) {
+            xxhash_backend_selected = &xxhash_backends[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *
+xxhash_dispatch_backend(void)
+{
+    return xxhash_backend_selected->name;
+}
+
+/* The one-shot functions keep XXH3's own short-input paths and only route
+ * long inputs through the selected backend, adapting its signatures to
+ * the XXH3_hashLong*_f callbacks. */
+
+static XXH64_hash_t
+xxhash_hashLong64_default(const void *XXH_RESTRICT input, size_t len,
+                          XXH64_hash_t seed, const xxh_u8 *XXH_RESTRICT secret,
+                          size_t secretLen)
+{
+    (void)seed; (void)secret; (void)secretLen;
+    return xxhash_backend_selected->hashLong64_default(input, len);
+}
+
+static XXH64_hash_t
+xxhash_hashLong64_seed(const void *XXH_RESTRICT input, size_t len,
+                       XXH64_hash_t seed, const xxh_u8 *XXH_RESTRICT secret,
+                       size_t secretLen)
+{
+    (void)secret; (void)secretLen;
+    return xxhash_backend_selected->hashLong64_seed(input, len, seed);
+}
+
+static XXH64_hash_t
+xxhash_hashLong64_secret(const void *XXH_RESTRICT input, size_t len,
+                         XXH64_hash_t seed, const xxh_u8 *XXH_RESTRICT secret,
+                         size_t secretLen)
+{
+    (void)seed;
+    return xxhash_backend_selected->hashLong64_secret(input, len, secret,
+                                                     secretLen);
+}
+
+static XXH128_hash_t
+xxhash_hashLong128_default(const void *XXH_RESTRICT input, size_t len,
+                           XXH64_hash_t seed, const void *XXH_RESTRICT secret,
+                           size_t secretLen)
+{
+    (void)seed; (void)secret; (void)secretLen;
+    return xxhash_backend_selected->hashLong128_default(input, len);
+}
+
+static XXH128_hash_t
+xxhash_hashLong128_seed(const void *XXH_RESTRICT input, size_t len,
+                        XXH64_hash_t seed, const void *XXH_RESTRICT secret,
+                        size_t secretLen)
+{
+    (void)secret; (void)secretLen;
+    return xxhash_backend_selected->hashLong128_seed(input, len, seed);
+}
+
+static XXH128_hash_t
+xxhash_hashLong128_secret(const void *XXH_RESTRICT input, size_t len,
+                          XXH64_hash_t seed, const void *XXH_RESTRICT secret,
+                          size_t secretLen)
+{
+    (void)seed;
+    return xxhash_backend_selected->hashLong128_secret(input, len, secret,
+                                                      secretLen);
+}
+
+XXH64_hash_t
+XXH3_64bits_dispatch(const void *input, size_t len)
+{
+    return XXH3_64bits_internal(input, len, 0, XXH3_kSecret,
+                                sizeof(XXH3_kSecret),
+                                xxhash_hashLong64_default);
+}
+
+XXH64_hash_t
+XXH3_64bits_withSeed_dispatch(const void *input, size_t len,
+                              XXH64_hash_t seed)
+{
+    return XXH3_64bits_internal(input, len, seed, XXH3_kSecret,
+                                sizeof(XXH3_kSecret),
+                                xxhash_hashLong64_seed);
+}
+
+XXH64_hash_t
+XXH3_64bits_withSecret_dispatch(const void *input, size_t len,
+                                const void *secret, size_t secretLen)
+{
+    return XXH3_64bits_internal(input, len, 0, secret, secretLen,
+                                xxhash_hashLong64_secret);
+}
+
+XXH64_hash_t
+XXH3_64bits_withSecretandSeed_dispatch(const void *input, size_t len,
+                                       const void *secret, size_t secretLen,
+                                       XXH64_hash_t seed)
+{
+    if (len <= XXH3_MIDSIZE_MAX)
+        return XXH3_64bits_withSeed(input, len, seed);
+    return xxhash_backend_selected->hashLong64_secret(input, len, secret,
+                                                     secretLen);
+}
+
+XXH_errorcode
+XXH3_64bits_update_dispatch(XXH3_state_t *state, const void *input,
+                            size_t len)
+{
+    return xxhash_backend_selected->update(state, input, len);
+}
+
+XXH128_hash_t
+XXH3_128bits_dispatch(const void *input, size_t len)
+{
+    return XXH3_128bits_internal(input, len, 0, XXH3_kSecret,
+                                 sizeof(XXH3_kSecret),
+                                 xxhash_hashLong128_default);
+}
+
+XXH128_hash_t
+XXH3_128bits_withSeed_dispatch(const void *input, size_t len,
+                               XXH64_hash_t seed)
+{
+    return XXH3_128bits_internal(input, len, seed, XXH3_kSecret,
+                                 sizeof(XXH3_kSecret),
+                                 xxhash_hashLong128_seed);
+}
+
+XXH128_hash_t
+XXH3_128bits_withSecret_dispatch(const void *input, size_t len,
+                                 const void *secret, size_t secretLen)
+{
+    return XXH3_128bits_internal(input, len, 0, secret, secretLen,
+                                 xxhash_hashLong128_secret);
+}
+
+XXH128_hash_t
+XXH3_128bits_withSecretandSeed_dispatch(const void *input, size_t len,
+                                        const void *secret, size_t secretLen,
+                                        XXH64_hash_t seed)
+{
+    if (len <= XXH3_MIDSIZE_MAX)
+        return XXH3_128bits_withSeed(input, len, seed);
+    return xxhash_backend_selected->hashLong128_secret(input, len, secret,
+                                                      secretLen);
+}
+
+XXH_errorcode
+XXH3_128bits_update_dispatch(XXH3_state_t *state, const void *input,
+                             size_t len)
+{
+    return xxhash_backend_selected->update(state, input, len);
+}
+
+int
+xxhash_dispatch_short_lanes(void)
+{
+    return xxhash_backend_selected->many->xxh3_64_short_lanes;
+}
+
+void
+XXH3_64bits_short_many_dispatch(const void *const *inputs, const size_t *lens,
+                                size_t n, XXH64_hash_t seed,
+                                XXH64_hash_t *out)
+{
+    xxhash_backend_selected->many->xxh3_64_short(inputs, lens, n, seed, out);
+}
+
+int
+xxhash_dispatch_xxh32_lanes(void)
+{
+    return xxhash_backend_selected->many->xxh32_lanes;
+}
+
+void
+XXH32_many_dispatch(const void *const *inputs, const size_t *lens, size_t n,
+                    XXH32_hash_t seed, XXH32_hash_t *out)
+{
+    xxhash_backend_selected->many->xxh32(inputs, lens, n, seed, out);
+}
+
+int
+xxhash_dispatch_xxh64_lanes(void)
+{
+    return xxhash_backend_selected->many->xxh64_lanes;
+}
+
+void
+XXH64_many_dispatch(const void *const *inputs, const size_t *lens, size_t n,
+                    XXH64_hash_t seed, XXH64_hash_t *out)
+{
+    xxhash_backend_selected->many->xxh64(inputs, lens, n, seed, out);
+}
+
+void
+XXH3_64bits_fixed_many_dispatch(const void *input, size_t width, size_t n,
+                                XXH64_hash_t seed, XXH64_hash_t *out)
+{
+    xxhash_backend_selected->many->xxh3_64_fixed(input, width, n, seed, out);
+}
+
+void
+xxhash_minhash_update_dispatch(XXH64_hash_t *sig, const XXH64_hash_t *a,
+                               const XXH64_hash_t *b, size_t k,
+                               const XXH64_hash_t *h, size_t n)
+{
+    xxhash_backend_selected->many->minhash(sig, a, b, k, h, n);
+}
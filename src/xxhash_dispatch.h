@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2014-2026, Yue Du
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice,
+ *       this list of conditions and the following disclaimer in the documentation
+ *       and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Runtime SIMD dispatch for the bundled XXH3.
+ *
+ * Wheels are compiled for the baseline of their platform (SSE2 on x86-64),
+ * which leaves AVX2 and AVX-512 unused on hosts that have them. This unit
+ * builds the XXH3 long-input loops once per vector extension and picks the
+ * widest one the CPU supports, like xxHash's xxh_x86dispatch.c, but with
+ * the selected backend queryable and selectable by name. Backends also
+ * carry kernels hashing several inputs at once across vector lanes, for
+ * the batch functions.
+ *
+ * Including this header after xxhash.h redirects the XXH3 one-shot and
+ * update functions to their dispatching versions, unless
+ * XXHASH_DISPATCH_NO_REPLACE is defined. Only the bundled build defines
+ * XXHASH_DISPATCH; when linking to libxxhash.so the library's own build
+ * decides. */
+
+#ifndef XXHASH_DISPATCH_H
+#define XXHASH_DISPATCH_H
+
+#include "xxhash.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Select a backend by name ("scalar", "sse2", "avx2", "avx512", or the
+ * compile-time vector unit on other architectures), or the widest one
+ * supported by this CPU if name is NULL.
+ * Returns 0 on success, -1 if name is unknown or not supported here. */
+int xxhash_dispatch_select(const char *name);
+
+/* Name of the selected backend. */
+const char *xxhash_dispatch_backend(void);
+
+/* Name of the i-th backend supported by this CPU, in order of preference
+ * from widest, or NULL past the last one. */
+const char *xxhash_dispatch_available(int i);
+
+XXH64_hash_t XXH3_64bits_dispatch(const void *input, size_t len);
+XXH64_hash_t XXH3_64bits_withSeed_dispatch(const void *input, size_t len,
+                                           XXH64_hash_t seed);
+XXH64_hash_t XXH3_64bits_withSecret_dispatch(const void *input, size_t len,
+                                             const void *secret,
+                                             size_t secretLen);
+XXH64_hash_t XXH3_64bits_withSecretandSeed_dispatch(const void *input,
+                                                    size_t len,
+                                                    const void *secret,
+                                                    size_t secretLen,
+                                                    XXH64_hash_t seed);
+XXH_errorcode XXH3_64bits_update_dispatch(XXH3_state_t *state,
+                                          const void *input, size_t len);
+
+XXH128_hash_t XXH3_128bits_dispatch(const void *input, size_t len);
+XXH128_hash_t XXH3_128bits_withSeed_dispatch(const void *input, size_t len,
+                                             XXH64_hash_t seed);
+XXH128_hash_t XXH3_128bits_withSecret_dispatch(const void *input, size_t len,
+                                               const void *secret,
+                                               size_t secretLen);
+XXH128_hash_t XXH3_128bits_withSecretandSeed_dispatch(const void *input,
+                                                      size_t len,
+                                                      const void *secret,
+                                                      size_t secretLen,
+                                                      XXH64_hash_t seed);
+XXH_errorcode XXH3_128bits_update_dispatch(XXH3_state_t *state,
+                                           const void *input, size_t len);
+
+/* Longest input XXH3_64bits_short_many_dispatch() takes. */
+#define XXHASH_SHORT_MAX 128
+
+/* Number of inputs the selected backend hashes at once in
+ * XXH3_64bits_short_many_dispatch(), 1 if it has no multi-lane kernel. */
+int xxhash_dispatch_short_lanes(void);
+
+/* Store XXH3_64bits_withSeed(inputs[i], lens[i], seed) to out[i] for each
+ * i < n. Every lens[i] must be at most XXHASH_SHORT_MAX. */
+void XXH3_64bits_short_many_dispatch(const void *const *inputs,
+                                     const size_t *lens, size_t n,
+                                     XXH64_hash_t seed, XXH64_hash_t *out);
+
+/* Same for XXH32() and XXH64() of inputs of any length. The multi-buffer
+ * kernels run inputs in lockstep for the stripes they have in common, so
+ * they gain most when consecutive inputs have similar lengths. */
+int xxhash_dispatch_xxh32_lanes(void);
+void XXH32_many_dispatch(const void *const *inputs, const size_t *lens,
+                         size_t n, XXH32_hash_t seed, XXH32_hash_t *out);
+int xxhash_dispatch_xxh64_lanes(void);
+void XXH64_many_dispatch(const void *const *inputs, const size_t *lens,
+                         size_t n, XXH64_hash_t seed, XXH64_hash_t *out);
+
+/* Store XXH3_64bits_withSeed() of the i-th width bytes at input to out[i]
+ * for each i < n. Widths of 4, 8 and 16 bytes, as of integer arrays, take
+ * vector kernels; others hash one at a time. */
+void XXH3_64bits_fixed_many_dispatch(const void *input, size_t width,
+                                     size_t n, XXH64_hash_t seed,
+                                     XXH64_hash_t *out);
+
+/* Lower sig[i] to the least a[i] * h[j] + b[i] (mod 2**64) over j < n,
+ * for each i < k: the MinHash signature update for n shingle hashes.
+ * Vector backends run permutations across lanes. */
+void xxhash_minhash_update_dispatch(XXH64_hash_t *sig, const XXH64_hash_t *a,
+                                    const XXH64_hash_t *b, size_t k,
+                                    const XXH64_hash_t *h, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifndef XXHASH_DISPATCH_NO_REPLACE
+#  undef XXH3_64bits
+#  define XXH3_64bits XXH3_64bits_dispatch
+#  undef XXH3_64bits_withSeed
+#  define XXH3_64bits_withSeed XXH3_64bits_withSeed_dispatch
+#  undef XXH3_64bits_withSecret
+#  define XXH3_64bits_withSecret XXH3_64bits_withSecret_dispatch
+#  undef XXH3_64bits_withSecretandSeed
+#  define XXH3_64bits_withSecretandSeed XXH3_64bits_withSecretandSeed_dispatch
+#  undef XXH3_64bits_update
+#  define XXH3_64bits_update XXH3_64bits_update_dispatch
+
+#  undef XXH128
+#  define XXH128 XXH3_128bits_withSeed_dispatch
+#  undef XXH3_128bits
+#  define XXH3_128bits XXH3_128bits_dispatch
+#  undef XXH3_128bits_withSeed
+#  define XXH3_128bits_withSeed XXH3_128bits_withSeed_dispatch
+#  undef XXH3_128bits_withSecret
+#  define XXH3_128bits_withSecret XXH3_128bits_withSecret_dispatch
+#  undef XXH3_128bits_withSecretandSeed
+#  define XXH3_128bits_withSecretandSeed XXH3_128bits_withSecretandSeed_dispatch
+#  undef XXH3_128bits_update
+#  define XXH3_128bits_update XXH3_128bits_update_dispatch
+#endif
+
+#endif /* XXHASH_DISPATCH_H */
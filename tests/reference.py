@@ -0,0 +1,143 @@
+"""Pure Python models of the sketch and sharding layouts.
+
+Each function restates, bit for bit, what the C code in src/_xxhash.c
+computes, so the tests can compare whole serialized states and result
+lists against it.
+"""
+import bisect
+import math
+import struct
+
+import xxhash
+
+M64 = 2**64 - 1
+GOLDEN = 0x9E3779B97F4A7C15
+
+
+def splitmix64(state):
+    """Advance a SplitMix64 generator; return (output, new state)."""
+    state = (state + GOLDEN) & M64
+    z = state
+    z = ((z ^ (z >> 30)) * 0xBF58476D1CE4E5B9) & M64
+    z = ((z ^ (z >> 27)) * 0x94D049BB133111EB) & M64
+    return z ^ (z >> 31), state
+
+
+def bloom_probes(digest, k):
+    """Bit positions within its block of a key with XXH3_128 digest."""
+    bits, state = digest & M64, digest >> 64
+    for i in range(k):
+        if i and i % 7 == 0:
+            bits, state = splitmix64(state)
+        yield bits & 511
+        bits >>= 9
+
+
+def bloom_blocks(keys, nblocks, k, seed):
+    """The block array of a BloomFilter after adding keys."""
+    blocks = [0] * nblocks
+    for key in keys:
+        digest = xxhash.xxh3_128_intdigest(key, seed)
+        block = ((digest >> 64) & 0xFFFFFFFF) * nblocks >> 32
+        for pos in bloom_probes(digest, k):
+            blocks[block] |= 1 << pos
+    return b''.join(
+        b''.join(struct.pack('=Q', (b >> (64 * w)) & M64) for w in range(8))
+        for b in blocks)
+
+
+def hll_state(keys, precision, seed):
+    """The serialized HyperLogLog after adding keys."""
+    registers = bytearray(1 << precision)
+    for key in keys:
+        h = xxhash.xxh3_64_intdigest(key, seed)
+        rest = (h << precision) & M64
+        rank = 64 - rest.bit_length() + 1 if rest else 64 - precision + 1
+        index = h >> (64 - precision)
+        registers[index] = max(registers[index], rank)
+    return (b'XXHHLL' + bytes([1, precision]) + struct.pack('<Q', seed)
+            + bytes(registers))
+
+
+def cms_columns(key, width, depth, seed):
+    """The column of key in each row of a CountMinSketch."""
+    digest = xxhash.xxh3_128_intdigest(key, seed)
+    low, high = digest & M64, digest >> 64
+    return [((((low + i * high) & M64) >> 32) * width) >> 32 for i in range(depth)]
+
+
+def cms_counters(keys, weights, width, depth, seed, conservative=False):
+    """The counter rows of a CountMinSketch after adding keys."""
+    rows = [[0] * width for _ in range(depth)]
+    for key, weight in zip(keys, weights):
+        cols = cms_columns(key, width, depth, seed)
+        if conservative:
+            target = min(rows[i][c] for i, c in enumerate(cols)) + weight
+            for i, c in enumerate(cols):
+                rows[i][c] = max(rows[i][c], target)
+        else:
+            for i, c in enumerate(cols):
+                rows[i][c] += weight
+    return b''.join(struct.pack('=%dQ' % width, *row) for row in rows)
+
+
+def minhash_permutations(seed, k):
+    """The (a, b) pairs of the k permutations h -> a * h + b."""
+    state, perms = seed, []
+    for _ in range(k):
+        a, state = splitmix64(state)
+        b, state = splitmix64(state)
+        perms.append((a | 1, b))
+    return perms
+
+
+def minhash(data, num_perm=128, shingle=5, seed=0):
+    """The MinHash signature of a bytes document or a token sequence."""
+    if isinstance(data, (bytes, bytearray)):
+        unit = 1
+    else:
+        data = b''.join(struct.pack('<Q', xxhash.xxh3_64_intdigest(
+            t.encode('utf-8') if isinstance(t, str) else t, seed)) for t in data)
+        unit = 8
+    n = len(data) // unit
+    width = min(shingle, n) * unit
+    hashes = [xxhash.xxh3_64_intdigest(data[i:i + width], seed)
+              for i in range(0, len(data) - width + 1, unit)] if n else []
+    return [min(((a * x + b) & M64 for x in hashes), default=M64)
+            for a, b in minhash_permutations(seed, num_perm)]
+
+
+def jump(h, num_buckets):
+    """Lamping and Veach's jump consistent hash of the 64-bit key h."""
+    b, j = -1, 0
+    while j < num_buckets:
+        b = j
+        h = (h * 2862933555777941757 + 1) & M64
+        j = int((b + 1) * ((1 << 31) / ((h >> 33) + 1)))
+    return b
+
+
+def rendezvous(key, nodes, weights, seed):
+    """The index of the node with the highest score for key."""
+    h = xxhash.xxh3_64_intdigest(key, seed)
+    scores = []
+    for i, node in enumerate(nodes):
+        s = splitmix64(h ^ xxhash.xxh3_64_intdigest(node, seed))[0]
+        if weights is not None:
+            s = -weights[i] / math.log(((s >> 11) + 0.5) / 2**53)
+        scores.append(s)
+    return scores.index(max(scores))
+
+
+def ring(keys, nodes, vnodes, seed):
+    """The owner of each key on a HashRing of nodes."""
+    points = []
+    for i, node in enumerate(nodes):
+        state = xxhash.xxh3_64_intdigest(node, seed)
+        for _ in range(vnodes):
+            point, state = splitmix64(state)
+            points.append((point, i))
+    points.sort()
+    positions = [p for p, _ in points]
+    return [points[bisect.bisect_left(positions, xxhash.xxh3_64_intdigest(k, seed))
+                   % len(points)][1] for k in keys]
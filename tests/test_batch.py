@@ -0,0 +1,617 @@
+"""Tests for the batch hashing functions (xxh*_digest_many etc.)."""
+import array
+import os
+import random
+import struct
+import subprocess
+import sys
+import threading
+import unittest
+
+import xxhash
+
+
+def getrefcount(obj):
+    if hasattr(sys, "getrefcount"):
+        return sys.getrefcount(obj)
+    else:
+        # Non-CPython implementation
+        return 0
+
+
+ALGORITHMS = ('xxh32', 'xxh64', 'xxh3_64', 'xxh3_128')
+
+
+class TestMany(unittest.TestCase):
+    def setUp(self):
+        self.keys = [os.urandom(random.randint(0, 300)) for _ in range(200)]
+
+    def test_matches_oneshot(self):
+        for algo in ALGORITHMS:
+            digest = getattr(xxhash, f'{algo}_digest')
+            intdigest = getattr(xxhash, f'{algo}_intdigest')
+            digest_many = getattr(xxhash, f'{algo}_digest_many')
+            intdigest_many = getattr(xxhash, f'{algo}_intdigest_many')
+            for seed in (0, 1, 2**32 - 1, 2**64 - 1):
+                self.assertEqual(digest_many(self.keys, seed),
+                                 [digest(k, seed) for k in self.keys])
+                self.assertEqual(intdigest_many(self.keys, seed=seed),
+                                 [intdigest(k, seed) for k in self.keys])
+
+    def test_similar_lengths(self):
+        # Runs of inputs with stripes in common, as the multi-buffer XXH32
+        # and XXH64 kernels take them, with lengths off by a few bytes and
+        # counts that do not fill the last group of lanes.
+        for base_len in (15, 16, 33, 1024, 1100, 5000):
+            keys = [os.urandom(base_len + random.randint(0, 40))
+                    for _ in range(random.randint(1, 40))]
+            for algo in ('xxh32', 'xxh64'):
+                intdigest = getattr(xxhash, f'{algo}_intdigest')
+                intdigest_many = getattr(xxhash, f'{algo}_intdigest_many')
+                for seed in (0, 2**32 - 1, 2**64 - 1):
+                    self.assertEqual(intdigest_many(keys, seed),
+                                     [intdigest(k, seed) for k in keys])
+
+    def test_aliases(self):
+        self.assertIs(xxhash.xxh128_digest_many, xxhash.xxh3_128_digest_many)
+        self.assertIs(xxhash.xxh128_intdigest_many, xxhash.xxh3_128_intdigest_many)
+
+    def test_empty(self):
+        for algo in ALGORITHMS:
+            self.assertEqual(getattr(xxhash, f'{algo}_digest_many')([]), [])
+            self.assertEqual(getattr(xxhash, f'{algo}_intdigest_many')(()), [])
+
+    def test_buffer_types(self):
+        data = [b'ab\x00c', bytearray(b'ab\x00c'), memoryview(b'ab\x00c'),
+                array.array('b', b'ab\x00c')]
+        old_refcounts = list(map(getrefcount, data))
+        for algo in ALGORITHMS:
+            values = getattr(xxhash, f'{algo}_intdigest_many')(data)
+            self.assertEqual(len(set(values)), 1, values)
+        self.assertEqual(list(map(getrefcount, data)), old_refcounts)
+
+    def test_iterables(self):
+        expected = xxhash.xxh3_64_intdigest_many(self.keys)
+        self.assertEqual(xxhash.xxh3_64_intdigest_many(tuple(self.keys)), expected)
+        self.assertEqual(xxhash.xxh3_64_intdigest_many(k for k in self.keys), expected)
+
+    def test_large_total(self):
+        # Total input above the GIL release threshold.
+        keys = [os.urandom(70000), b'', os.urandom(100000)]
+        self.assertEqual(xxhash.xxh3_128_intdigest_many(keys),
+                         [xxhash.xxh3_128_intdigest(k) for k in keys])
+
+    def test_errors(self):
+        f = xxhash.xxh3_64_intdigest_many
+        with self.assertRaises(TypeError):
+            f()
+        with self.assertRaises(TypeError):
+            f([b'a'], 0, 1)
+        with self.assertRaises(TypeError):
+            f([b'a'], foo=1)
+        with self.assertRaises(TypeError):
+            f([b'a'], data=[b'b'])
+        with self.assertRaises(TypeError):
+            f(b'single buffer')
+        with self.assertRaises(TypeError):
+            f(42)
+        with self.assertRaisesRegex(TypeError, 'Strings must be encoded'):
+            f([b'a', 'b'])
+        with self.assertRaises(TypeError):
+            f([b'a', None])
+
+
+class TestOut(unittest.TestCase):
+    def setUp(self):
+        self.keys = [os.urandom(random.randint(0, 100)) for _ in range(50)]
+
+    def test_oneshot_digest_out(self):
+        for algo in ALGORITHMS:
+            digest = getattr(xxhash, f'{algo}_digest')
+            out = bytearray(64)
+            ret = digest(b'xxhash', 42, out=out)
+            self.assertIs(ret, out)
+            expected = digest(b'xxhash', 42)
+            self.assertEqual(bytes(out[:len(expected)]), expected)
+            self.assertEqual(bytes(out[len(expected):]), bytes(64 - len(expected)))
+
+    def test_oneshot_intdigest_out(self):
+        out = array.array('Q', [0])
+        self.assertIs(xxhash.xxh64_intdigest(b'a', out=out), out)
+        self.assertEqual(out[0], xxhash.xxh64_intdigest(b'a'))
+        xxhash.xxh3_64_intdigest(b'a', seed=1, out=out)
+        self.assertEqual(out[0], xxhash.xxh3_64_intdigest(b'a', 1))
+
+        out = array.array('I', [0])
+        xxhash.xxh32_intdigest(b'a', out=out)
+        self.assertEqual(out[0], xxhash.xxh32_intdigest(b'a'))
+
+        out = array.array('Q', [0, 0])
+        xxhash.xxh3_128_intdigest(b'a', out=out)
+        self.assertEqual(out[0] | out[1] << 64, xxhash.xxh3_128_intdigest(b'a'))
+
+    def test_oneshot_out_none(self):
+        self.assertEqual(xxhash.xxh3_64_intdigest(b'a', out=None),
+                         xxhash.xxh3_64_intdigest(b'a'))
+
+    def test_many_digest_out(self):
+        for algo in ALGORITHMS:
+            expected = b''.join(getattr(xxhash, f'{algo}_digest_many')(self.keys))
+            out = bytearray(len(expected))
+            ret = getattr(xxhash, f'{algo}_digest_many')(self.keys, out=out)
+            self.assertIs(ret, out)
+            self.assertEqual(bytes(out), expected)
+
+    def test_many_intdigest_out(self):
+        for algo, typecode in (('xxh32', 'I'), ('xxh64', 'Q'), ('xxh3_64', 'Q')):
+            out = array.array(typecode, [0] * len(self.keys))
+            getattr(xxhash, f'{algo}_intdigest_many')(self.keys, 7, out=out)
+            self.assertEqual(out.tolist(),
+                             getattr(xxhash, f'{algo}_intdigest_many')(self.keys, 7))
+
+        out = array.array('Q', [0] * 2 * len(self.keys))
+        xxhash.xxh3_128_intdigest_many(self.keys, out=out)
+        self.assertEqual([out[i] | out[i + 1] << 64 for i in range(0, len(out), 2)],
+                         xxhash.xxh3_128_intdigest_many(self.keys))
+
+    def test_out_reuse(self):
+        out = bytearray(8 * 100)
+        for _ in range(3):
+            keys = [os.urandom(8) for _ in range(100)]
+            xxhash.xxh3_64_intdigest_many(keys, out=out)
+            self.assertEqual(list(struct.unpack('=100Q', out)),
+                             xxhash.xxh3_64_intdigest_many(keys))
+
+    def test_out_errors(self):
+        with self.assertRaises(ValueError):
+            xxhash.xxh3_64_intdigest(b'a', out=bytearray(7))
+        with self.assertRaises(ValueError):
+            xxhash.xxh3_64_intdigest_many([b'a', b'b'], out=bytearray(15))
+        with self.assertRaises(BufferError):
+            xxhash.xxh3_64_intdigest(b'a', out=b'readonly')
+        with self.assertRaises(BufferError):
+            xxhash.xxh3_64_digest_many([b'a'], out=bytes(8))
+        with self.assertRaises(TypeError):
+            xxhash.xxh3_64_intdigest(b'a', out=[0])
+        with self.assertRaises(TypeError):
+            xxhash.xxh3_64_hexdigest(b'a', out=bytearray(16))
+        with self.assertRaises(TypeError):
+            xxhash.xxh3_64(b'a', out=bytearray(8))
+
+
+def _strided_reference(func, data, record_size, stride=None, offset=0,
+                       length=None, seed=0):
+    stride = stride or record_size
+    if length is None:
+        length = record_size - offset
+    starts = range(0, len(data) - record_size + 1, stride)
+    return [func(data[i + offset:i + offset + length], seed) for i in starts]
+
+
+class TestStrided(unittest.TestCase):
+    data = os.urandom(10007)
+
+    def test_records(self):
+        for record_size in (1, 8, 16, 100, 4096, 10007, 20000):
+            self.assertEqual(
+                xxhash.xxh3_64_hash_strided(self.data, record_size),
+                _strided_reference(xxhash.xxh3_64_intdigest, self.data, record_size))
+            self.assertEqual(
+                xxhash.xxh3_128_hash_strided(self.data, record_size),
+                _strided_reference(xxhash.xxh3_128_intdigest, self.data, record_size))
+
+    def test_stride_and_field(self):
+        cases = [
+            dict(record_size=24, stride=32),
+            dict(record_size=24, stride=32, offset=8),
+            dict(record_size=24, offset=4, length=8),
+            dict(record_size=24, offset=24),
+            dict(record_size=24, length=0),
+            dict(record_size=16, stride=1),
+            dict(record_size=24, seed=2**64 - 1),
+        ]
+        for kwargs in cases:
+            with self.subTest(**kwargs):
+                self.assertEqual(
+                    xxhash.xxh3_64_hash_strided(self.data, **kwargs),
+                    _strided_reference(xxhash.xxh3_64_intdigest, self.data, **kwargs))
+        self.assertEqual(xxhash.xxh3_64_hash_strided(self.data, 24, 32),
+                         xxhash.xxh3_64_hash_strided(self.data, 24, stride=32))
+
+    def test_buffer_types(self):
+        rows = array.array('Q', range(1000))
+        self.assertEqual(
+            xxhash.xxh3_64_hash_strided(rows, 8),
+            [xxhash.xxh3_64_intdigest(x.to_bytes(8, sys.byteorder)) for x in range(1000)])
+        self.assertEqual(xxhash.xxh3_64_hash_strided(memoryview(self.data), 10),
+                         xxhash.xxh3_64_hash_strided(self.data, 10))
+
+    def test_out(self):
+        expected = xxhash.xxh3_64_hash_strided(self.data, 100, offset=3, length=50)
+        out = array.array('Q', [0] * len(expected))
+        ret = xxhash.xxh3_64_hash_strided(self.data, 100, offset=3, length=50, out=out)
+        self.assertIs(ret, out)
+        self.assertEqual(out.tolist(), expected)
+
+        expected = xxhash.xxh3_128_hash_strided(self.data, 100)
+        out = array.array('Q', [0] * 2 * len(expected))
+        xxhash.xxh3_128_hash_strided(self.data, 100, out=out)
+        self.assertEqual([out[i] | out[i + 1] << 64 for i in range(0, len(out), 2)],
+                         expected)
+        self.assertIs(xxhash.xxh128_hash_strided, xxhash.xxh3_128_hash_strided)
+
+    def test_short_input(self):
+        self.assertEqual(xxhash.xxh3_64_hash_strided(b'', 8), [])
+        self.assertEqual(xxhash.xxh3_64_hash_strided(b'1234567', 8), [])
+        self.assertEqual(xxhash.xxh3_64_hash_strided(b'', 8, out=bytearray()), bytearray())
+
+    def test_errors(self):
+        f = xxhash.xxh3_64_hash_strided
+        with self.assertRaises(TypeError):
+            f(self.data)
+        with self.assertRaises(TypeError):
+            f('str', 1)
+        with self.assertRaises(ValueError):
+            f(self.data, 0)
+        with self.assertRaises(ValueError):
+            f(self.data, -1)
+        with self.assertRaises(ValueError):
+            f(self.data, 8, 0)
+        with self.assertRaises(ValueError):
+            f(self.data, 8, offset=9)
+        with self.assertRaises(ValueError):
+            f(self.data, 8, offset=4, length=5)
+        with self.assertRaises(ValueError):
+            f(self.data, 8, out=bytearray(8))
+        with self.assertRaises(TypeError):
+            f(self.data, 8, 8, 0)
+
+
+class TestOffsets(unittest.TestCase):
+    def setUp(self):
+        self.values = [os.urandom(random.randint(0, 300)) for _ in range(500)]
+        self.data = b''.join(self.values)
+        offsets = [0]
+        for v in self.values:
+            offsets.append(offsets[-1] + len(v))
+        self.offsets = offsets
+
+    def test_int32_int64_offsets(self):
+        for typecode in ('i', 'l', 'q'):
+            offsets = array.array(typecode, self.offsets)
+            self.assertEqual(xxhash.xxh3_64_hash_offsets(self.data, offsets),
+                             xxhash.xxh3_64_intdigest_many(self.values))
+            self.assertEqual(xxhash.xxh3_128_hash_offsets(self.data, offsets, seed=3),
+                             xxhash.xxh3_128_intdigest_many(self.values, 3))
+
+    def test_short_values(self):
+        # Every length through 0-128 bytes, where XXH3 has separate paths,
+        # mixed in one batch as for the multi-lane kernel.
+        values = [os.urandom(n) for n in range(140) for _ in range(3)]
+        random.shuffle(values)
+        offsets = [0]
+        for v in values:
+            offsets.append(offsets[-1] + len(v))
+        data = b''.join(values)
+        for seed in (0, 1, 2**32 - 1, 2**64 - 1):
+            expected = [xxhash.xxh3_64_intdigest(v, seed) for v in values]
+            self.assertEqual(xxhash.xxh3_64_hash_offsets(
+                data, array.array('q', offsets), seed=seed), expected)
+            self.assertEqual(xxhash.xxh3_64_intdigest_many(values, seed), expected)
+            self.assertEqual(xxhash.xxh3_64_digest_many(values, seed),
+                             [xxhash.xxh3_64_digest(v, seed) for v in values])
+
+    def test_sliced_offsets(self):
+        # Offsets need not start at 0 (e.g. a sliced Arrow array).
+        offsets = array.array('q', self.offsets[100:201])
+        self.assertEqual(xxhash.xxh3_64_hash_offsets(self.data, offsets),
+                         xxhash.xxh3_64_intdigest_many(self.values[100:200]))
+
+    def test_out(self):
+        offsets = array.array('i', self.offsets)
+        out = array.array('Q', [0] * len(self.values))
+        self.assertIs(xxhash.xxh3_64_hash_offsets(self.data, offsets, out=out), out)
+        self.assertEqual(out.tolist(), xxhash.xxh3_64_intdigest_many(self.values))
+
+        out = bytearray(16 * len(self.values))
+        xxhash.xxh3_128_hash_offsets(self.data, offsets, out=out)
+        halves = struct.unpack(f'={2 * len(self.values)}Q', out)
+        self.assertEqual([halves[i] | halves[i + 1] << 64 for i in range(0, len(halves), 2)],
+                         xxhash.xxh3_128_intdigest_many(self.values))
+        self.assertIs(xxhash.xxh128_hash_offsets, xxhash.xxh3_128_hash_offsets)
+
+    def test_empty(self):
+        self.assertEqual(xxhash.xxh3_64_hash_offsets(b'', array.array('i')), [])
+        self.assertEqual(xxhash.xxh3_64_hash_offsets(b'', array.array('i', [0])), [])
+        self.assertEqual(xxhash.xxh3_64_hash_offsets(b'abc', array.array('i', [1, 1])),
+                         [xxhash.xxh3_64_intdigest(b'')])
+
+    def test_errors(self):
+        f = xxhash.xxh3_64_hash_offsets
+        with self.assertRaises(TypeError):
+            f(b'abc')
+        with self.assertRaises(TypeError):
+            f(b'abc', array.array('d', [0, 1]))
+        with self.assertRaises(TypeError):
+            f(b'abc', array.array('h', [0, 1]))
+        with self.assertRaises(TypeError):
+            f(b'abc', b'\x00\x00\x00\x00\x01\x00\x00\x00')
+        with self.assertRaises(ValueError):
+            f(b'abc', array.array('i', [0, 4]))
+        with self.assertRaises(ValueError):
+            f(b'abc', array.array('i', [-1, 2]))
+        with self.assertRaises(ValueError):
+            f(b'abc', array.array('i', [0, 2, 1]))
+        with self.assertRaises(ValueError):
+            f(b'abc', array.array('q', [0, 1, 2]), out=bytearray(8))
+
+
+class TestUintArray(unittest.TestCase):
+    FUNCS = ((4, 'I', xxhash.hash_uint32_array),
+             (8, 'Q', xxhash.hash_uint64_array),
+             (16, None, xxhash.hash_uint128_array))
+
+    def test_matches_oneshot(self):
+        for width, _, func in self.FUNCS:
+            for n in (0, 1, 7, 8, 9, 33, 1000):
+                data = os.urandom(width * n)
+                for seed in (0, 1, 2**32 + 7, 2**64 - 1):
+                    with self.subTest(width=width, n=n, seed=seed):
+                        self.assertEqual(
+                            func(data, seed),
+                            [xxhash.xxh3_64_intdigest(data[i:i + width], seed)
+                             for i in range(0, len(data), width)])
+
+    def test_typed_arrays(self):
+        values = array.array('q', [0, 1, -1, 2**63 - 1, -2**63] + list(range(100)))
+        self.assertEqual(
+            xxhash.hash_uint64_array(values),
+            [xxhash.xxh3_64_intdigest(struct.pack('=q', v)) for v in values])
+        floats = array.array('d', [0.0, -0.0, 1.5, float('inf')])
+        self.assertEqual(xxhash.hash_uint64_array(floats, seed=3),
+                         [xxhash.xxh3_64_intdigest(struct.pack('=d', v), 3) for v in floats])
+        ids = array.array('I', range(50))
+        self.assertEqual(xxhash.hash_uint32_array(ids), xxhash.hash_uint32_array(bytes(ids)))
+        self.assertEqual(xxhash.hash_uint32_array(memoryview(bytes(ids)).cast('I')),
+                         xxhash.hash_uint32_array(ids))
+
+    def test_same_as_strided(self):
+        for width, _, func in self.FUNCS:
+            data = os.urandom(width * 101)
+            self.assertEqual(func(data, 5), xxhash.xxh3_64_hash_strided(data, width, seed=5))
+
+    def test_out(self):
+        for width, _, func in self.FUNCS:
+            data = os.urandom(width * 37)
+            expected = func(data, 9)
+            out = array.array('Q', [0] * 37)
+            self.assertIs(func(data, 9, out=out), out)
+            self.assertEqual(out.tolist(), expected)
+            # Digests land at any alignment.
+            out = bytearray(8 * 37 + 1)
+            func(data, 9, out=memoryview(out)[1:])
+            self.assertEqual(list(struct.unpack('=37Q', out[1:])), expected)
+
+    def test_errors(self):
+        for width, code, func in self.FUNCS:
+            with self.assertRaises(TypeError):
+                func('str')
+            with self.assertRaises(TypeError):
+                func([1, 2, 3])
+            with self.assertRaises(ValueError):
+                func(bytes(width + 1))
+            with self.assertRaises(ValueError):
+                func(bytes(width), out=bytearray(7))
+            with self.assertRaises(TypeError):
+                func(bytes(width), 0, None)
+            with self.assertRaises(TypeError):
+                func(array.array('H', [0] * width))
+        with self.assertRaises(TypeError):
+            xxhash.hash_uint64_array(array.array('I', [0, 0]))
+        with self.assertRaises(BufferError):
+            xxhash.hash_uint64_array(memoryview(bytes(32))[::2])
+
+
+class TestColumns(unittest.TestCase):
+    FUNCS = ((8, xxhash.xxh3_64_intdigest, xxhash.xxh3_64_hash_columns),
+             (16, xxhash.xxh3_128_intdigest, xxhash.xxh3_128_hash_columns))
+
+    def _columns(self, n):
+        ids = array.array('Q', range(n))
+        flags = array.array('I', [i % 3 for i in range(n)])
+        values = [os.urandom(i % 150) for i in range(n)]
+        offsets = array.array('q', [0])
+        for v in values:
+            offsets.append(offsets[-1] + len(v))
+        records = os.urandom(12 * n)
+        columns = [ids, (b''.join(values), offsets), flags,
+                   memoryview(records).cast('B', (n, 12)) if n else bytearray()]
+        rows = [(struct.pack('=Q', ids[i]), values[i], struct.pack('=I', flags[i]),
+                 records[12 * i:12 * i + 12]) for i in range(n)]
+        return columns, rows
+
+    def test_matches_reference(self):
+        for size, intdigest, func in self.FUNCS:
+            for n in (0, 1, 9, 1000):
+                columns, rows = self._columns(n)
+                for seed in (0, 2**64 - 1):
+                    with self.subTest(size=size, n=n, seed=seed):
+                        self.assertEqual(func(columns, seed), [
+                            intdigest(b''.join(intdigest(cell, seed).to_bytes(size, 'little')
+                                               for cell in row), seed)
+                            for row in rows])
+
+    def test_order_sensitive(self):
+        a = array.array('Q', range(100))
+        b = array.array('Q', range(1, 101))
+        self.assertNotEqual(xxhash.xxh3_64_hash_columns([a, b]),
+                            xxhash.xxh3_64_hash_columns([b, a]))
+        # Cells do not run into each other.
+        data = b'abab'
+        self.assertNotEqual(
+            xxhash.xxh3_64_hash_columns([(data, array.array('i', [0, 1])),
+                                         (data, array.array('i', [1, 4]))]),
+            xxhash.xxh3_64_hash_columns([(data, array.array('i', [0, 2])),
+                                         (data, array.array('i', [2, 4]))]))
+
+    def test_many_columns(self):
+        ids = array.array('I', range(300))
+        for size, intdigest, func in self.FUNCS:
+            self.assertEqual(func([ids] * 256, 3), [
+                intdigest(intdigest(struct.pack('=I', i), 3).to_bytes(size, 'little') * 256, 3)
+                for i in ids])
+
+    def test_out(self):
+        columns, _ = self._columns(37)
+        for size, _, func in self.FUNCS:
+            expected = func(columns, 9)
+            out = array.array('Q', [0] * (37 * size // 8))
+            self.assertIs(func(columns, 9, out=out), out)
+            if size == 8:
+                self.assertEqual(out.tolist(), expected)
+            else:
+                self.assertEqual([lo | hi << 64 for lo, hi in zip(out[::2], out[1::2])],
+                                 expected)
+            # Digests land at any alignment.
+            unaligned = bytearray(size * 37 + 1)
+            func(columns, 9, out=memoryview(unaligned)[1:])
+            self.assertEqual(unaligned[1:], out.tobytes())
+
+    def test_errors(self):
+        ids = array.array('Q', range(4))
+        for _, _, func in self.FUNCS:
+            with self.assertRaises(ValueError):
+                func([])
+            with self.assertRaises(ValueError):
+                func([ids] * 257)
+            with self.assertRaises(ValueError):
+                func([ids, array.array('Q', range(5))])
+            with self.assertRaises(ValueError):
+                func([ids, (b'abc', array.array('q', [0, 1, 2, 3, 4]))])
+            with self.assertRaises(ValueError):
+                func([(b'abc', array.array('q', [0, 2, 1]))])
+            with self.assertRaises(TypeError):
+                func([ids, 'str'])
+            with self.assertRaises(TypeError):
+                func([ids, (b'abc', array.array('d', [0.0, 1.0]))])
+            with self.assertRaises(TypeError):
+                func([ids, 3])
+            with self.assertRaises(TypeError):
+                func(ids)
+            with self.assertRaises(TypeError):
+                func([memoryview(b'x').cast('B', ())])
+            with self.assertRaises(BufferError):
+                func([memoryview(bytes(32))[::2]])
+            with self.assertRaises(ValueError):
+                func([ids], out=bytearray(7))
+            with self.assertRaises(TypeError):
+                func([ids], 0, None)
+
+
+class TestThreads(unittest.TestCase):
+    def setUp(self):
+        # Enough elements to cross _PARALLEL_MINITEMS, with uneven sizes.
+        self.keys = [os.urandom(i % 97) for i in range(xxhash._xxhash._PARALLEL_MINITEMS + 1000)]
+        self.default = xxhash.get_default_nthreads()
+
+    def tearDown(self):
+        xxhash.set_default_nthreads(self.default)
+
+    def test_many(self):
+        for algo in ALGORITHMS:
+            digest_many = getattr(xxhash, f'{algo}_digest_many')
+            intdigest_many = getattr(xxhash, f'{algo}_intdigest_many')
+            expected = intdigest_many(self.keys, 7, nthreads=1)
+            for nthreads in (2, 3, 8):
+                self.assertEqual(intdigest_many(self.keys, 7, nthreads=nthreads), expected)
+            self.assertEqual(digest_many(self.keys, nthreads=4),
+                             digest_many(self.keys, nthreads=1))
+
+    def test_large_elements(self):
+        keys = [os.urandom(300000), os.urandom(5), os.urandom(900000), b'']
+        self.assertEqual(xxhash.xxh3_128_intdigest_many(keys, nthreads=4),
+                         [xxhash.xxh3_128_intdigest(k) for k in keys])
+
+    def test_strided_and_offsets(self):
+        data = os.urandom(2 * xxhash._xxhash._PARALLEL_MINSIZE + 5)
+        for func, size in ((xxhash.xxh3_64_hash_strided, 8),
+                           (xxhash.xxh3_128_hash_strided, 16)):
+            self.assertEqual(func(data, 24, nthreads=4), func(data, 24, nthreads=1))
+            out = bytearray(len(data) // 24 * size)
+            self.assertIs(func(data, 24, nthreads=4, out=out), out)
+            self.assertEqual(out, func(data, 24, out=bytearray(len(out))))
+        offsets = array.array('q', range(0, len(data), 13))
+        for func in (xxhash.xxh3_64_hash_offsets, xxhash.xxh3_128_hash_offsets):
+            self.assertEqual(func(data, offsets, nthreads=3), func(data, offsets))
+        data = data[:len(data) // 16 * 16]
+        for func in (xxhash.hash_uint32_array, xxhash.hash_uint64_array,
+                     xxhash.hash_uint128_array):
+            self.assertEqual(func(data, nthreads=4), func(data, nthreads=1))
+        rows = len(offsets) - 1
+        columns = [memoryview(data[:rows * 13]).cast('B', (rows, 13)), (data, offsets)]
+        for func in (xxhash.xxh3_64_hash_columns, xxhash.xxh3_128_hash_columns):
+            self.assertEqual(func(columns, nthreads=4), func(columns, nthreads=1))
+
+    def test_default(self):
+        self.assertEqual(xxhash.get_default_nthreads(), 1)
+        xxhash.set_default_nthreads(4)
+        self.assertEqual(xxhash.get_default_nthreads(), 4)
+        self.assertEqual(xxhash.xxh64_intdigest_many(self.keys),
+                         xxhash.xxh64_intdigest_many(self.keys, nthreads=1))
+        xxhash.set_default_nthreads(10**6)
+        self.assertEqual(xxhash.get_default_nthreads(), 256)
+
+    def test_errors(self):
+        for nthreads in (0, -1):
+            with self.assertRaises(ValueError):
+                xxhash.xxh64_intdigest_many([b'a'], nthreads=nthreads)
+            with self.assertRaises(ValueError):
+                xxhash.set_default_nthreads(nthreads)
+        with self.assertRaises(TypeError):
+            xxhash.xxh64_intdigest_many([b'a'], nthreads=1.5)
+        with self.assertRaises(TypeError):
+            xxhash.xxh3_64_hash_strided(b'abcd', 2, 2, 4)
+        with self.assertRaises(TypeError):
+            xxhash.set_default_nthreads(None)
+
+    def test_concurrent_callers(self):
+        # Only one parallel job runs at a time; other callers hash on
+        # their own thread and must get the same results.
+        expected = xxhash.xxh3_64_intdigest_many(self.keys)
+        results = []
+
+        def worker():
+            for _ in range(5):
+                results.append(xxhash.xxh3_64_intdigest_many(self.keys, nthreads=4))
+
+        threads = [threading.Thread(target=worker) for _ in range(4)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        self.assertEqual(len(results), 20)
+        for r in results:
+            self.assertEqual(r, expected)
+
+    @unittest.skipUnless(hasattr(os, 'fork'), 'requires os.fork()')
+    def test_fork(self):
+        code = """if 1:
+            import os, xxhash
+            keys = [bytes([i % 256]) * (i % 50) for i in range(100000)]
+            expected = xxhash.xxh64_intdigest_many(keys, nthreads=1)
+            assert xxhash.xxh64_intdigest_many(keys, nthreads=4) == expected
+            pid = os.fork()
+            if pid == 0:
+                ok = xxhash.xxh64_intdigest_many(keys, nthreads=4) == expected
+                os._exit(0 if ok else 1)
+            _, status = os.waitpid(pid, 0)
+            assert status == 0, status
+            assert xxhash.xxh64_intdigest_many(keys, nthreads=4) == expected
+        """
+        proc = subprocess.run([sys.executable, '-W', 'ignore', '-c', code],
+                              capture_output=True, text=True, timeout=120)
+        self.assertEqual(proc.returncode, 0, proc.stderr)
+
+
+if __name__ == '__main__':
+    unittest.main()
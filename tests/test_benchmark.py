@@ -13,6 +13,7 @@ DATA_1KB = os.urandom(1000)
 DATA_10KB = os.urandom(10000)
 DATA_64KB = os.urandom(65536)
 DATA_2MB = os.urandom(2 * 1024 * 1024)
+KEYS_1000x16B = [os.urandom(16) for _ in range(1000)]
 
 # Hash types to bench.
 # xxh128 is an alias for xxh3_128 — we skip it to avoid duplicating work.
@@ -843,3 +844,32 @@ def test_xxh3_128_stream_update_hexdigest_2mb():
     h = xxhash.xxh3_128(DATA_2MB, seed=SEED_64)
     h.update(DATA_2MB)
     h.hexdigest()
+
+
+# ---------------------------------------------------------------------------
+#  Batch  —  xxh3_64_intdigest_many([bytes, ...], seed=…)
+# ---------------------------------------------------------------------------
+
+@pytest.mark.benchmark
+def test_xxh32_intdigest_many_1000x16b():
+    xxhash.xxh32_intdigest_many(KEYS_1000x16B, seed=SEED_32)
+
+
+@pytest.mark.benchmark
+def test_xxh64_intdigest_many_1000x16b():
+    xxhash.xxh64_intdigest_many(KEYS_1000x16B, seed=SEED_64)
+
+
+@pytest.mark.benchmark
+def test_xxh3_64_intdigest_many_1000x16b():
+    xxhash.xxh3_64_intdigest_many(KEYS_1000x16B, seed=SEED_64)
+
+
+@pytest.mark.benchmark
+def test_xxh3_128_digest_many_1000x16b():
+    xxhash.xxh3_128_digest_many(KEYS_1000x16B, seed=SEED_64)
+
+
+@pytest.mark.benchmark
+def test_xxh3_64_hash_strided_2mb_nthreads_4():
+    xxhash.xxh3_64_hash_strided(DATA_2MB, 64, seed=SEED_64, nthreads=4)
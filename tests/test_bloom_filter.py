@@ -0,0 +1,298 @@
+"""Tests for BloomFilter."""
+import array
+import gc
+import os
+import pathlib
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import textwrap
+import threading
+import unittest
+import weakref
+
+import xxhash
+
+from tests import reference
+
+
+class TestBloomFilter(unittest.TestCase):
+    def test_known_answer(self):
+        # One 512-bit block and eight probes, so the probe bits are refilled
+        # once from the high half of the digest.
+        for seed, expected in ((0, [75, 145, 261, 336, 378, 412, 482, 505]),
+                               (1, [35, 40, 84, 123, 136, 241, 429, 433])):
+            bf = xxhash.BloomFilter(40, 0.01, seed)
+            self.assertEqual((bf.num_bits, bf.num_hashes), (512, 8))
+            bf.add(b'abc')
+            bits = int.from_bytes(bytes(bf)[64:], 'little')
+            self.assertEqual([i for i in range(512) if bits >> i & 1], expected)
+
+    def test_add_and_contains(self):
+        bf = xxhash.BloomFilter(1000, 0.01)
+        keys = [b'key%d' % i for i in range(1000)]
+        for key in keys[:500]:
+            bf.add(key)
+        bf.add_many(keys[500:])
+        self.assertTrue(all(key in bf for key in keys))
+        self.assertEqual(bf.contains_many(keys), [True] * 1000)
+        self.assertGreater(bf.count, 990)
+        self.assertLessEqual(bf.count, 1000)
+
+    def test_layout(self):
+        keys = [b'', b'a', b'abc', os.urandom(300)] + [b'%d' % i for i in range(100)]
+        for capacity, fp_rate, seed in ((100, 0.01, 0), (50, 1e-6, 2**64 - 1)):
+            bf = xxhash.BloomFilter(capacity, fp_rate, seed)
+            bf.add_many(keys)
+            nblocks = bf.num_bits // 512
+            data = bytes(bf)
+            self.assertEqual(len(data), 64 + 64 * nblocks)
+            self.assertEqual(data[:8], b'XXHBLOOM')
+            self.assertEqual(data[64:], reference.bloom_blocks(keys, nblocks, bf.num_hashes, seed))
+
+    def test_fp_rate(self):
+        for capacity, fp_rate in ((20000, 0.05), (20000, 0.01), (10000, 0.001)):
+            bf = xxhash.BloomFilter(capacity, fp_rate)
+            bf.add_many(array.array('Q', range(capacity)))
+            queries = 400000
+            hits = sum(bf.contains_many(array.array('Q', range(capacity, capacity + queries))))
+            self.assertLess(hits / queries, fp_rate * 1.3, (capacity, fp_rate))
+            self.assertGreater(hits / queries, fp_rate * 0.5, (capacity, fp_rate))
+
+    def test_properties(self):
+        bf = xxhash.BloomFilter(1000, 0.01, seed=7)
+        self.assertEqual((bf.capacity, bf.fp_rate, bf.seed), (1000, 0.01, 7))
+        self.assertEqual(bf.num_bits % 512, 0)
+        self.assertGreaterEqual(bf.num_bits, 9585)
+        self.assertIn(bf.num_hashes, range(5, 10))
+        self.assertEqual(bf.count, 0)
+        self.assertFalse(bf.readonly)
+        self.assertFalse(bf.closed)
+        self.assertIsNone(bf.path)
+
+    def test_seed(self):
+        a = xxhash.BloomFilter(100, seed=1)
+        b = xxhash.BloomFilter(100, seed=2)
+        a.add(b'x')
+        b.add(b'x')
+        self.assertNotEqual(bytes(a), bytes(b))
+        self.assertIn(b'x', b)
+
+    def test_key_types(self):
+        bf = xxhash.BloomFilter(1000)
+        values = [b'alpha', b'beta', b'gamma']
+        data = b''.join(values)
+        for offsets in (array.array('i', [0, 5, 9, 14]), array.array('q', [0, 5, 9, 14])):
+            self.assertEqual(bf.contains_many(data, offsets), [False] * 3)
+        bf.add_many(data, array.array('i', [0, 5, 9, 14]))
+        self.assertEqual(bf.contains_many(values), [True] * 3)
+        self.assertIn(bytearray(b'beta'), bf)
+        self.assertIn(memoryview(b'xgammax')[1:6], bf)
+
+        ids = array.array('Q', range(100))
+        bf.add_many(ids)
+        self.assertTrue(all(struct.pack('=Q', i) in bf for i in ids))
+        records = memoryview(bytes(range(48))).cast('B', (4, 12))
+        bf.add_many(records)
+        self.assertEqual(bf.contains_many([bytes(range(i, i + 12)) for i in range(0, 48, 12)]),
+                         [True] * 4)
+
+    def test_out_and_threads(self):
+        bf = xxhash.BloomFilter(100000)
+        bf.add_many(array.array('Q', range(0, 200000, 2)))
+        keys = array.array('Q', range(xxhash._xxhash._PARALLEL_MINITEMS + 1000))
+        expected = [i % 2 == 0 and i < 200000 for i in range(len(keys))]
+        for nthreads in (1, 4):
+            found = bf.contains_many(keys, nthreads=nthreads)
+            self.assertEqual(sum(a and not b for a, b in zip(expected, found)), 0)
+            out = bytearray(len(keys))
+            self.assertIs(bf.contains_many(keys, out=out, nthreads=nthreads), out)
+            self.assertEqual(list(out), [int(f) for f in found])
+
+    def test_release_buffer_during_add_many(self):
+        # add_many() holds the filter's lock while its batch waits for the
+        # GIL, so releasing an export must not block on the lock with the
+        # GIL held. Run in a child so that a deadlock fails instead of hangs.
+        code = textwrap.dedent("""
+            import array, threading, xxhash
+            bf = xxhash.BloomFilter(100000)
+            keys = array.array('Q', range(200000))
+            done = threading.Event()
+
+            def release():
+                while not done.is_set():
+                    memoryview(bf).release()
+
+            t = threading.Thread(target=release)
+            t.start()
+            for _ in range(20):
+                bf.add_many(keys)
+            done.set()
+            t.join()
+        """)
+        try:
+            subprocess.run([sys.executable, '-c', code], check=True, timeout=60)
+        except subprocess.TimeoutExpired:
+            self.fail('deadlocked releasing a buffer during add_many()')
+
+    def test_bytes_during_add_many(self):
+        batches = [array.array('Q', range(i, i + 200000)) for i in range(0, 1000000, 200000)]
+        bf = xxhash.BloomFilter(1000000)
+        states = {bytes(bf)}
+        for batch in batches:
+            bf.add_many(batch)
+            states.add(bytes(bf))
+        bf = xxhash.BloomFilter(1000000)
+        snapshots = []
+        thread = threading.Thread(target=lambda: [bf.add_many(b) for b in batches])
+        thread.start()
+        while thread.is_alive():
+            snapshots.append(bytes(bf))
+        thread.join()
+        # Every copy is the filter between two batches, never part way.
+        for data in snapshots:
+            self.assertIn(data, states)
+
+    def test_frombytes(self):
+        bf = xxhash.BloomFilter(1000, seed=3)
+        bf.add_many([b'a', b'b'])
+        copy = xxhash.BloomFilter.frombytes(bytes(bf))
+        self.assertEqual(bytes(copy), bytes(bf))
+        self.assertEqual((copy.seed, copy.count, copy.num_hashes), (3, 2, bf.num_hashes))
+        copy.add(b'c')
+        self.assertIn(b'c', copy)
+        self.assertNotIn(b'c', bf)
+        for data in (b'', bytes(bf)[:-1], b'Y' + bytes(bf)[1:]):
+            with self.assertRaises(ValueError):
+                xxhash.BloomFilter.frombytes(data)
+
+    def test_buffer(self):
+        bf = xxhash.BloomFilter(100)
+        view = memoryview(bf)
+        self.assertTrue(view.readonly)
+        bf.add(b'x')
+        self.assertEqual(view.tobytes(), bytes(bf))
+        with self.assertRaises(BufferError):
+            bf.close()
+        view.release()
+        bf.close()
+        self.assertTrue(bf.closed)
+        with self.assertRaises(BufferError):
+            memoryview(bf)
+
+    @unittest.skipIf(sys.version_info < (3, 12), 'needs __buffer__')
+    def test_reentrant_key(self):
+        # Exporting a key's buffer may use the filter it is added to.
+        bf = xxhash.BloomFilter(100)
+
+        class Key:
+            def __buffer__(self, flags):
+                self.seen = b'inner' in bf
+                bf.add(b'inner')
+                return memoryview(b'outer')
+
+        key = Key()
+        bf.add(key)
+        self.assertIn(key, bf)
+        self.assertFalse(key.seen)
+        self.assertIn(b'outer', bf)
+
+    def test_errors(self):
+        bf = xxhash.BloomFilter(100)
+        with self.assertRaises(ValueError):
+            xxhash.BloomFilter(0)
+        for fp_rate in (0.0, 1.0, -0.5, float('nan')):
+            with self.assertRaises(ValueError):
+                xxhash.BloomFilter(100, fp_rate)
+        with self.assertRaises(OverflowError):
+            xxhash.BloomFilter(sys.maxsize, 1e-300)
+        with self.assertRaises(TypeError):
+            bf.add('str')
+        with self.assertRaises(TypeError):
+            'str' in bf
+        with self.assertRaises(TypeError):
+            bf.add_many(b'abc')
+        with self.assertRaises(TypeError):
+            bf.add_many([b'a', 1])
+        with self.assertRaises(TypeError):
+            bf.contains_many(1)
+        with self.assertRaises(ValueError):
+            bf.contains_many(b'abc', array.array('i', [0, 4]))
+        with self.assertRaises(ValueError):
+            bf.contains_many([b'a'], out=bytearray(0))
+        bf.close()
+        bf.close()
+        with self.assertRaises(ValueError):
+            b'a' in bf
+        with self.assertRaises(ValueError):
+            bf.add_many([b'a'])
+        with self.assertRaises(ValueError):
+            bf.count
+
+
+class TestBloomFilterFile(unittest.TestCase):
+    def setUp(self):
+        self.tmpdir = tempfile.mkdtemp()
+        self.path = os.path.join(self.tmpdir, 'keys.bloom')
+        self.keys = [os.urandom(12) for _ in range(1000)]
+        bf = xxhash.BloomFilter(1000, seed=5)
+        bf.add_many(self.keys)
+        with open(self.path, 'wb') as f:
+            f.write(bf)
+        self.data = bytes(bf)
+
+    def tearDown(self):
+        shutil.rmtree(self.tmpdir)
+
+    def test_open(self):
+        with xxhash.BloomFilter.open(self.path) as bf:
+            self.assertTrue(bf.readonly)
+            self.assertEqual(bf.path, self.path)
+            self.assertEqual(bytes(bf), self.data)
+            self.assertEqual(bf.contains_many(self.keys), [True] * 1000)
+            with self.assertRaises(TypeError):
+                bf.add(b'x')
+            with self.assertRaises(TypeError):
+                bf.add_many([b'x'])
+        self.assertTrue(bf.closed)
+
+    def test_writable(self):
+        reader = xxhash.BloomFilter.open(self.path)
+        with xxhash.BloomFilter.open(self.path, writable=True) as bf:
+            self.assertFalse(bf.readonly)
+            bf.add(b'new')
+            bf.flush()
+            with open(self.path, 'rb') as f:
+                self.assertNotEqual(f.read(), self.data)
+        self.assertIn(b'new', xxhash.BloomFilter.open(self.path))
+        reader.close()
+
+    def test_errors(self):
+        with self.assertRaises(FileNotFoundError):
+            xxhash.BloomFilter.open(os.path.join(self.tmpdir, 'missing'))
+        with open(self.path, 'r+b') as f:
+            f.truncate(len(self.data) - 64)
+        with self.assertRaises(ValueError):
+            xxhash.BloomFilter.open(self.path)
+        with open(self.path, 'wb') as f:
+            f.write(b'not a filter')
+        with self.assertRaises(ValueError):
+            xxhash.BloomFilter.open(self.path)
+
+    def test_path_cycle(self):
+        class Path(pathlib.PurePath().__class__):
+            pass
+
+        path = Path(self.path)
+        path.filter = xxhash.BloomFilter.open(path)
+        self.assertIs(path.filter.path, path)
+        ref = weakref.ref(path)
+        del path
+        gc.collect()
+        self.assertIsNone(ref())
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,181 @@
+"""Tests for CountMinSketch."""
+import array
+import collections
+import math
+import random
+import struct
+import threading
+import unittest
+
+import xxhash
+
+from tests import reference
+from tests.reference import M64
+
+
+class TestCountMinSketch(unittest.TestCase):
+    def test_known_answer(self):
+        cms = xxhash.CountMinSketch(16, 4)
+        cms.add(b'abc', 3)
+        cms.add(b'xyz')
+        rows = struct.unpack('=64Q', bytes(cms)[64:])
+        self.assertEqual([{i: c for i, c in enumerate(rows[r * 16:r * 16 + 16]) if c}
+                          for r in range(4)],
+                         [{6: 1, 7: 3}, {5: 1, 7: 3}, {4: 1, 8: 3}, {4: 1, 8: 3}])
+
+    def test_layout(self):
+        keys = [b'', b'a', b'abc'] + [b'%d' % (i % 37) for i in range(300)]
+        weights = [i % 5 for i in range(len(keys))]
+        for width, depth, seed in ((1, 1, 0), (37, 3, 5), (100, 7, 2**64 - 1)):
+            for conservative in (False, True):
+                cms = xxhash.CountMinSketch(width, depth, seed, conservative=conservative)
+                cms.add_many(keys[:150], weights=weights[:150])
+                for key, weight in zip(keys[150:], weights[150:]):
+                    cms.add(key, weight)
+                data = bytes(cms)
+                self.assertEqual(len(data), 64 + 8 * width * depth)
+                self.assertEqual(data[:8], b'XXHCOUNT')
+                self.assertEqual(data[64:], reference.cms_counters(keys, weights, width, depth, seed,
+                                                              conservative))
+                self.assertEqual(cms.total, sum(weights))
+
+    def test_estimates(self):
+        rng = random.Random(1)
+        keys = [rng.randrange(20000) if rng.random() < 0.7 else int(rng.paretovariate(1.0))
+                for _ in range(100000)]
+        counts = collections.Counter(keys)
+        distinct = array.array('Q', counts)
+        bound = math.e / 1000 * len(keys)
+        errors = {}
+        for conservative in (False, True):
+            cms = xxhash.CountMinSketch(1000, 5, conservative=conservative)
+            cms.add_many(array.array('Q', keys))
+            over = [e - counts[k] for k, e in zip(distinct, cms.estimate_many(distinct))]
+            self.assertGreaterEqual(min(over), 0)
+            self.assertLess(sum(o > bound for o in over), len(over) * math.exp(-5))
+            errors[conservative] = sum(over)
+        self.assertLess(errors[True], errors[False])
+
+    def test_estimate(self):
+        cms = xxhash.CountMinSketch(1000)
+        self.assertEqual(cms.estimate(b'x'), 0)
+        cms.add(b'x')
+        cms.add(b'x', count=41)
+        cms.add(bytearray(b'y'), 0)
+        self.assertEqual(cms.estimate(b'x'), 42)
+        self.assertEqual(cms.estimate(memoryview(b'-x-')[1:2]), 42)
+        self.assertEqual(cms.estimate_many([b'x', b'y', b'z']), [42, 0, 0])
+        self.assertEqual(cms.total, 42)
+
+    def test_key_types(self):
+        values = [b'alpha', b'beta', b'gamma']
+        cms = xxhash.CountMinSketch(10000, 3)
+        cms.add_many(b''.join(values), array.array('q', [0, 5, 9, 14]),
+                     weights=array.array('b', [1, 2, 3]))
+        self.assertEqual(cms.estimate_many(values), [1, 2, 3])
+        ids = array.array('I', range(50))
+        cms.add_many(ids, weights=[7] * 50)
+        self.assertEqual(cms.estimate(struct.pack('=I', 10)), 7)
+        for weights in (array.array('H', [1] * 50), array.array('Q', [1] * 50),
+                        array.array('l', [1] * 50), range(50)):
+            cms.add_many(ids, weights=weights)
+        self.assertEqual(cms.estimate(struct.pack('=I', 10)), 7 + 3 + 10)
+
+    def test_saturation(self):
+        cms = xxhash.CountMinSketch(10, 2)
+        cms.add(b'x', M64 - 1)
+        cms.add_many([b'x', b'x'], weights=[1, 1])
+        self.assertEqual(cms.estimate(b'x'), M64)
+        self.assertEqual(cms.total, M64)
+
+    def test_merge(self):
+        a = xxhash.CountMinSketch(64, 3, seed=2)
+        b = xxhash.CountMinSketch(64, 3, seed=2)
+        both = xxhash.CountMinSketch(64, 3, seed=2)
+        a.add_many([b'%d' % i for i in range(100)])
+        b.add_many([b'%d' % i for i in range(50, 200)])
+        both.add_many([b'%d' % i for i in range(100)] + [b'%d' % i for i in range(50, 200)])
+        a.merge(b)
+        self.assertEqual(bytes(a), bytes(both))
+        a.merge(a)
+        self.assertEqual(a.total, 500)
+        for other in (xxhash.CountMinSketch(65, 3, seed=2), xxhash.CountMinSketch(64, 4, seed=2),
+                      xxhash.CountMinSketch(64, 3)):
+            with self.assertRaises(ValueError):
+                a.merge(other)
+        with self.assertRaises(TypeError):
+            a.merge(bytes(b))
+
+    def test_frombytes(self):
+        cms = xxhash.CountMinSketch(50, 2, seed=9, conservative=True)
+        cms.add_many([b'x', b'y', b'x'])
+        copy = xxhash.CountMinSketch.frombytes(bytes(cms))
+        self.assertEqual(bytes(copy), bytes(cms))
+        self.assertEqual((copy.width, copy.depth, copy.seed, copy.conservative, copy.total),
+                         (50, 2, 9, True, 3))
+        copy.add(b'z')
+        self.assertEqual((copy.estimate(b'z'), cms.estimate(b'z')), (1, 0))
+        data = bytes(cms)
+        for bad in (b'', data[:-1], data + b'\0' * 8, b'Y' + data[1:],
+                    data[:12] + b'\0' * 4 + data[16:]):
+            with self.assertRaises(ValueError):
+                xxhash.CountMinSketch.frombytes(bad)
+        self.assertTrue(memoryview(cms).readonly)
+
+    def test_out_and_threads(self):
+        cms = xxhash.CountMinSketch(4096, 4)
+        cms.add_many(array.array('Q', range(0, 20000, 2)))
+        keys = array.array('Q', range(xxhash._xxhash._PARALLEL_MINITEMS + 1000))
+        expected = cms.estimate_many(keys, nthreads=1)
+        for nthreads in (1, 4):
+            self.assertEqual(cms.estimate_many(keys, nthreads=nthreads), expected)
+            out = array.array('Q', [0]) * len(keys)
+            self.assertIs(cms.estimate_many(keys, out=out, nthreads=nthreads), out)
+            self.assertEqual(out.tolist(), expected)
+
+        # Concurrent adds from Python threads lose no counts.
+        shared = xxhash.CountMinSketch(4096, 4)
+
+        def worker():
+            shared.add_many(keys[:5000])
+            for i in range(500):
+                shared.add(struct.pack('=Q', i))
+
+        threads = [threading.Thread(target=worker) for _ in range(4)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        self.assertEqual(shared.total, 4 * 5500)
+        self.assertGreaterEqual(min(shared.estimate_many(keys[:500])), 8)
+
+    def test_errors(self):
+        for args in ((0,), (-1,), (2**32 + 1,), (10, 0), (10, 33)):
+            with self.assertRaises(ValueError):
+                xxhash.CountMinSketch(*args)
+        with self.assertRaises(OverflowError):
+            xxhash.CountMinSketch(2**64)
+        cms = xxhash.CountMinSketch(10)
+        with self.assertRaises(TypeError):
+            cms.add('str')
+        with self.assertRaises(OverflowError):
+            cms.add(b'x', -1)
+        with self.assertRaises(TypeError):
+            cms.estimate('str')
+        with self.assertRaises(TypeError):
+            cms.add_many(b'abc')
+        with self.assertRaises(ValueError):
+            cms.add_many([b'a', b'b'], weights=[1])
+        with self.assertRaises(ValueError):
+            cms.add_many([b'a'], weights=array.array('i', [-1]))
+        with self.assertRaises(OverflowError):
+            cms.add_many([b'a'], weights=[-1])
+        with self.assertRaises(TypeError):
+            cms.add_many([b'a'], weights=array.array('d', [1.0]))
+        with self.assertRaises(ValueError):
+            cms.estimate_many([b'a'], out=bytearray(7))
+        self.assertEqual(cms.total, 0)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -2,6 +2,7 @@
 
 Covers all four hash algorithms across digest/intdigest/hexdigest variants.
 """
+import ctypes
 import unittest
 import xxhash
 
@@ -186,6 +187,21 @@ class TestFastcallErrors(unittest.TestCase):
     def test_duplicate_seed(self):
         self._assert_all_raise(TypeError, self.data, 0, seed=1)
 
+    def test_duplicate_keyword_out(self):
+        # Python rejects repeated keywords itself, so pass them through
+        # the vectorcall protocol directly.
+        vectorcall = ctypes.pythonapi.PyObject_Vectorcall
+        vectorcall.restype = ctypes.py_object
+        vectorcall.argtypes = [ctypes.py_object, ctypes.POINTER(ctypes.py_object),
+                               ctypes.c_size_t, ctypes.py_object]
+        for fn, name in ((xxhash.xxh64_digest, 'out'), (xxhash.xxh3_64_digest, 'out'),
+                         (xxhash.xxh3_128_intdigest, 'secret')):
+            buf = bytearray(256)
+            args = (ctypes.py_object * 3)(self.data, buf, buf)
+            with self.subTest(fn=fn.__name__, name=name), \
+                 self.assertRaisesRegex(TypeError, 'multiple values'):
+                vectorcall(fn, args, 1, (name, name))
+
     # ── invalid seed type ─────────────────────────────────────────
 
     def test_invalid_seed_positional(self):
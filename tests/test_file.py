@@ -0,0 +1,681 @@
+"""Tests for the native file hashing functions (xxhash.file_digest etc.)."""
+import array
+import gc
+import io
+import os
+import pathlib
+import shutil
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import threading
+import unittest
+import weakref
+
+import xxhash
+
+
+ALGORITHMS = ('xxh32', 'xxh64', 'xxh3_64', 'xxh3_128')
+
+
+class TestFileDigest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        cls.tmpdir = tempfile.mkdtemp()
+        cls.data = os.urandom(3 * 1024 * 1024 + 17)
+        cls.path = os.path.join(cls.tmpdir, 'data.bin')
+        with open(cls.path, 'wb') as f:
+            f.write(cls.data)
+
+    @classmethod
+    def tearDownClass(cls):
+        shutil.rmtree(cls.tmpdir)
+
+    def test_algorithms(self):
+        for algo in ALGORITHMS:
+            hasher = getattr(xxhash, algo)
+            for mmap in (False, True):
+                h = xxhash.file_digest(self.path, algo, mmap=mmap)
+                self.assertIs(type(h), hasher)
+                self.assertEqual(h.digest(), hasher(self.data).digest())
+                h = xxhash.file_digest(self.path, hasher, seed=42, mmap=mmap)
+                self.assertEqual(h.seed, 42)
+                self.assertEqual(h.digest(), hasher(self.data, seed=42).digest())
+
+    def test_xxh128_alias(self):
+        self.assertEqual(xxhash.file_digest(self.path, 'xxh128').intdigest(),
+                         xxhash.xxh128_intdigest(self.data))
+
+    def test_hasher_is_usable(self):
+        h = xxhash.file_digest(self.path, 'xxh64')
+        h.update(b'tail')
+        self.assertEqual(h.intdigest(), xxhash.xxh64_intdigest(self.data + b'tail'))
+
+    def test_path_types(self):
+        expected = xxhash.xxh3_64_intdigest(self.data)
+        for path in (self.path, os.fsencode(self.path), pathlib.Path(self.path)):
+            self.assertEqual(xxhash.file_digest(path, 'xxh3_64').intdigest(), expected)
+
+    def test_fd(self):
+        fd = os.open(self.path, os.O_RDONLY | getattr(os, 'O_BINARY', 0))
+        try:
+            os.lseek(fd, 1000, os.SEEK_SET)
+            for mmap in (False, True):
+                os.lseek(fd, 1000, os.SEEK_SET)
+                h = xxhash.file_digest(fd, 'xxh3_128', mmap=mmap)
+                self.assertEqual(h.intdigest(), xxhash.xxh3_128_intdigest(self.data[1000:]))
+                # Read to end of file, fd left open.
+                self.assertEqual(os.lseek(fd, 0, os.SEEK_CUR), len(self.data))
+        finally:
+            os.close(fd)
+
+    def test_small_buffer(self):
+        for mmap in (False, True):
+            h = xxhash.file_digest(self.path, 'xxh64', buffer_size=1000, mmap=mmap)
+            self.assertEqual(h.intdigest(), xxhash.xxh64_intdigest(self.data))
+
+    def test_empty_file(self):
+        path = os.path.join(self.tmpdir, 'empty')
+        open(path, 'wb').close()
+        for mmap in (False, True):
+            self.assertEqual(xxhash.file_digest(path, 'xxh32', mmap=mmap).intdigest(),
+                             xxhash.xxh32_intdigest(b''))
+
+    def test_pipe(self):
+        r, w = os.pipe()
+        try:
+            os.write(w, b'hello pipe')
+            os.close(w)
+            w = None
+            h = xxhash.file_digest(r, 'xxh3_64', mmap=True)
+            self.assertEqual(h.intdigest(), xxhash.xxh3_64_intdigest(b'hello pipe'))
+        finally:
+            os.close(r)
+            if w is not None:
+                os.close(w)
+
+    def test_errors(self):
+        with self.assertRaises(FileNotFoundError):
+            xxhash.file_digest(os.path.join(self.tmpdir, 'missing'), 'xxh64')
+        with self.assertRaises(ValueError):
+            xxhash.file_digest(self.path, 'md5')
+        with self.assertRaises(TypeError):
+            xxhash.file_digest(self.path, len)
+        with self.assertRaises(TypeError):
+            xxhash.file_digest(1.5, 'xxh64')
+        with self.assertRaises(TypeError):
+            xxhash.file_digest(True, 'xxh64')
+        with self.assertRaises(ValueError):
+            xxhash.file_digest(self.path, 'xxh64', buffer_size=0)
+        with self.assertRaises(ValueError):
+            xxhash.file_digest(-1, 'xxh64')
+        with self.assertRaises(TypeError):
+            xxhash.file_digest(self.path)
+
+    @unittest.skipIf(sys.platform == 'win32', 'directories cannot be opened')
+    def test_directory(self):
+        with self.assertRaises(IsADirectoryError) as cm:
+            xxhash.file_digest(self.tmpdir, 'xxh64')
+        self.assertEqual(cm.exception.filename, self.tmpdir)
+
+    @unittest.skipIf(sys.platform == 'win32', 'mmap mode maps files on POSIX only')
+    def test_mmap_shrinking_file(self):
+        # A mapped file truncated under the hash raises SIGBUS on access;
+        # that must end the mapping, not the process.
+        path = os.path.join(self.tmpdir, 'shrinking')
+        code = ('import os, sys, threading, time, xxhash\n'
+                'with open(sys.argv[1], "wb") as f:\n'
+                '    f.truncate(1 << 30)\n'
+                'threading.Thread(target=lambda: (time.sleep(0.02), '
+                'os.truncate(sys.argv[1], 4096))).start()\n'
+                'xxhash.file_digest(sys.argv[1], "xxh3_64", mmap=True)\n')
+        proc = subprocess.run([sys.executable, '-c', code, path], timeout=120)
+        self.assertEqual(proc.returncode, 0)
+
+
+class TestFileBlockDigests(unittest.TestCase):
+    BLOCK = 256 * 1024
+
+    @classmethod
+    def setUpClass(cls):
+        cls.tmpdir = tempfile.mkdtemp()
+        cls.data = os.urandom(5 * cls.BLOCK + 1234)
+        cls.path = os.path.join(cls.tmpdir, 'data.bin')
+        with open(cls.path, 'wb') as f:
+            f.write(cls.data)
+
+    @classmethod
+    def tearDownClass(cls):
+        shutil.rmtree(cls.tmpdir)
+
+    def _expected(self, algo, ranges, seed=0):
+        intdigest = getattr(xxhash, f'{algo}_intdigest')
+        return [intdigest(self.data[off:off + length], seed) for off, length in ranges]
+
+    def test_block_size(self):
+        ranges = [(off, self.BLOCK) for off in range(0, len(self.data), self.BLOCK)]
+        for algo in ALGORITHMS:
+            expected = self._expected(algo, ranges, seed=9)
+            for nthreads in (1, 4):
+                for mmap in (False, True):
+                    self.assertEqual(
+                        xxhash.file_block_digests(self.path, algo, self.BLOCK, seed=9,
+                                                  mmap=mmap, nthreads=nthreads),
+                        expected)
+
+    def test_ranges(self):
+        ranges = [(0, 0), (7, 100), (len(self.data) - 3, 3), (1000, 3 * self.BLOCK), (7, 100)]
+        for algo in ALGORITHMS:
+            for mmap in (False, True):
+                self.assertEqual(
+                    xxhash.file_block_digests(self.path, getattr(xxhash, algo),
+                                              ranges=ranges, mmap=mmap, nthreads=3),
+                    self._expected(algo, ranges))
+
+    def test_out(self):
+        n = (len(self.data) + self.BLOCK - 1) // self.BLOCK
+        out = array.array('Q', bytes(8 * n))
+        self.assertIs(xxhash.file_block_digests(self.path, 'xxh3_64', self.BLOCK, out=out), out)
+        self.assertEqual(list(out), xxhash.file_block_digests(self.path, 'xxh3_64', self.BLOCK))
+        out128 = bytearray(16 * n)
+        xxhash.file_block_digests(self.path, 'xxh3_128', self.BLOCK, out=out128, nthreads=2)
+        values = xxhash.file_block_digests(self.path, 'xxh3_128', self.BLOCK)
+        pairs = struct.unpack(f'={2 * n}Q', out128)
+        self.assertEqual([lo | hi << 64 for lo, hi in zip(pairs[::2], pairs[1::2])], values)
+        with self.assertRaises(ValueError):
+            xxhash.file_block_digests(self.path, 'xxh3_64', self.BLOCK, out=bytearray(8))
+
+    def test_fd(self):
+        fd = os.open(self.path, os.O_RDONLY | getattr(os, 'O_BINARY', 0))
+        try:
+            self.assertEqual(xxhash.file_block_digests(fd, 'xxh64', self.BLOCK),
+                             xxhash.file_block_digests(self.path, 'xxh64', self.BLOCK))
+        finally:
+            os.close(fd)
+
+    def test_empty_file(self):
+        path = os.path.join(self.tmpdir, 'empty')
+        open(path, 'wb').close()
+        self.assertEqual(xxhash.file_block_digests(path, 'xxh64', 4096), [])
+
+    def test_errors(self):
+        f = xxhash.file_block_digests
+        with self.assertRaises(TypeError):
+            f(self.path, 'xxh64')
+        with self.assertRaises(TypeError):
+            f(self.path, 'xxh64', 4096, ranges=[(0, 1)])
+        with self.assertRaises(ValueError):
+            f(self.path, 'xxh64', 0)
+        with self.assertRaises(ValueError):
+            f(self.path, 'xxh64', ranges=[(len(self.data), 1)])
+        with self.assertRaises(ValueError):
+            f(self.path, 'xxh64', ranges=[(-1, 1)])
+        with self.assertRaises(TypeError):
+            f(self.path, 'xxh64', ranges=[(0, 1, 2)])
+        with self.assertRaises(TypeError):
+            f(True, 'xxh64', 4096)
+        missing = os.path.join(self.tmpdir, 'missing')
+        with self.assertRaises(FileNotFoundError) as cm:
+            f(missing, 'xxh64', 4096)
+        self.assertEqual(cm.exception.filename, missing)
+
+    @unittest.skipUnless(hasattr(os, 'pipe'), 'requires os.pipe()')
+    def test_not_regular(self):
+        r, w = os.pipe()
+        try:
+            with self.assertRaises(ValueError):
+                xxhash.file_block_digests(r, 'xxh64', 4096)
+        finally:
+            os.close(r)
+            os.close(w)
+
+    @unittest.skipIf(sys.platform == 'win32', 'mmap mode maps files on POSIX only')
+    def test_mmap_shrinking_file(self):
+        path = os.path.join(self.tmpdir, 'shrinking')
+        code = ('import os, sys, threading, time, xxhash\n'
+                'with open(sys.argv[1], "wb") as f:\n'
+                '    f.truncate(1 << 30)\n'
+                'threading.Thread(target=lambda: (time.sleep(0.02), '
+                'os.truncate(sys.argv[1], 4096))).start()\n'
+                'try:\n'
+                '    xxhash.file_block_digests(sys.argv[1], "xxh3_64", 1 << 20, '
+                'mmap=True, nthreads=1)\n'
+                'except OSError:\n'
+                '    pass\n')
+        proc = subprocess.run([sys.executable, '-c', code, path], timeout=120)
+        self.assertEqual(proc.returncode, 0)
+
+
+class TestCopyAndHash(unittest.TestCase):
+    def setUp(self):
+        self.tmpdir = tempfile.mkdtemp()
+        self.data = os.urandom(2 * 1024 * 1024 + 5)
+        self.src = os.path.join(self.tmpdir, 'src')
+        self.dst = os.path.join(self.tmpdir, 'dst')
+        with open(self.src, 'wb') as f:
+            f.write(self.data)
+
+    def tearDown(self):
+        shutil.rmtree(self.tmpdir)
+
+    def test_files(self):
+        for algo in ALGORITHMS:
+            with open(self.src, 'rb') as src, open(self.dst, 'wb') as dst:
+                h = xxhash.copy_and_hash(src, dst.fileno(), algo, buffer_size=65536)
+            self.assertEqual(h.digest(), getattr(xxhash, f'{algo}_digest')(self.data))
+            with open(self.dst, 'rb') as f:
+                self.assertEqual(f.read(), self.data)
+
+    def test_length_and_seed(self):
+        with open(self.src, 'rb') as src, open(self.dst, 'wb') as dst:
+            src.seek(10)
+            h = xxhash.copy_and_hash(src, dst, xxhash.xxh64, 1000, seed=7)
+            self.assertIsInstance(h, xxhash.xxh64)
+            self.assertEqual(h.intdigest(), xxhash.xxh64_intdigest(self.data[10:1010], 7))
+            self.assertEqual(src.tell(), 1010)
+            h = xxhash.copy_and_hash(src, dst, 'xxh3_64', 0)
+            self.assertEqual(h.intdigest(), xxhash.xxh3_64_intdigest(b''))
+        with open(self.dst, 'rb') as f:
+            self.assertEqual(f.read(), self.data[10:1010])
+
+    def test_pipe(self):
+        r, w = os.pipe()
+        out_r, out_w = os.pipe()
+        received = []
+
+        def feed():
+            with os.fdopen(w, 'wb') as f:
+                f.write(self.data)
+
+        def drain():
+            with os.fdopen(out_r, 'rb') as f:
+                received.append(f.read())
+
+        threads = [threading.Thread(target=feed), threading.Thread(target=drain)]
+        for t in threads:
+            t.start()
+        try:
+            h = xxhash.copy_and_hash(r, out_w, 'xxh3_128')
+        finally:
+            os.close(r)
+            os.close(out_w)
+            for t in threads:
+                t.join()
+        self.assertEqual(h.digest(), xxhash.xxh3_128_digest(self.data))
+        self.assertEqual(received, [self.data])
+
+    @unittest.skipIf(sys.platform == 'win32', 'sockets are not file descriptors on Windows')
+    def test_socketpair(self):
+        a, b = socket.socketpair()
+        with a, b, open(self.dst, 'wb') as dst:
+            t = threading.Thread(target=a.sendall, args=(self.data,))
+            t.start()
+            h = xxhash.copy_and_hash(b, dst, 'xxh64', len(self.data))
+            t.join()
+        self.assertEqual(h.intdigest(), xxhash.xxh64_intdigest(self.data))
+        with open(self.dst, 'rb') as f:
+            self.assertEqual(f.read(), self.data)
+
+    def test_short_source(self):
+        with open(self.src, 'rb') as src, open(self.dst, 'wb') as dst:
+            with self.assertRaisesRegex(EOFError, 'after 2097157 of 2097200 bytes'):
+                xxhash.copy_and_hash(src, dst, 'xxh64', len(self.data) + 43)
+        self.assertEqual(os.path.getsize(self.dst), len(self.data))
+
+    def test_errors(self):
+        with open(self.src, 'rb') as src:
+            with self.assertRaises(TypeError):
+                xxhash.copy_and_hash(self.src, self.dst, 'xxh64')
+            with self.assertRaises(ValueError):
+                xxhash.copy_and_hash(src, src, 'md5')
+            with self.assertRaises(ValueError):
+                xxhash.copy_and_hash(src, src, 'xxh64', -1)
+            with self.assertRaises(ValueError):
+                xxhash.copy_and_hash(src, src, 'xxh64', buffer_size=0)
+            with self.assertRaises(OSError):
+                xxhash.copy_and_hash(src, src, 'xxh64')
+
+
+class TestHashTree(unittest.TestCase):
+    FILES = {
+        'top.txt': b'top',
+        os.path.join('a', 'one'): b'one',
+        os.path.join('a', 'b', 'big'): os.urandom(2 * 1024 * 1024),
+        os.path.join('c', 'empty'): b'',
+    }
+
+    def setUp(self):
+        self.tmpdir = tempfile.mkdtemp()
+        self.root = os.path.join(self.tmpdir, 'root')
+        for name, data in self.FILES.items():
+            path = os.path.join(self.root, name)
+            os.makedirs(os.path.dirname(path), exist_ok=True)
+            with open(path, 'wb') as f:
+                f.write(data)
+        os.makedirs(os.path.join(self.root, 'd', 'empty_dir'))
+
+    def tearDown(self):
+        shutil.rmtree(self.tmpdir)
+
+    def _expected(self, algo):
+        hexdigest = getattr(xxhash, f'{algo}_hexdigest')
+        return {os.path.join(self.root, name): hexdigest(data)
+                for name, data in sorted(self.FILES.items())}
+
+    def test_digests(self):
+        for algo in ALGORITHMS:
+            for nthreads in (1, 3):
+                self.assertEqual(xxhash.hash_tree(self.root, algo, nthreads=nthreads),
+                                 self._expected(algo))
+        self.assertEqual(xxhash.hash_tree(self.root), self._expected('xxh3_128'))
+        self.assertEqual(xxhash.hash_tree(pathlib.Path(self.root), xxhash.xxh64),
+                         self._expected('xxh64'))
+
+    def test_order(self):
+        self.assertEqual(list(xxhash.hash_tree(self.root)), sorted(self._expected('xxh64')))
+
+    def test_manifest_gnu(self):
+        out = io.BytesIO()
+        xxhash.hash_tree(self.root, 'xxh64', manifest=out)
+        lines = out.getvalue().decode().splitlines()
+        self.assertEqual(lines, [f'{h}  {p}' for p, h in self._expected('xxh64').items()])
+        out = io.BytesIO()
+        xxhash.hash_tree(self.root, 'xxh3_64', manifest=out)
+        self.assertTrue(all(line.startswith('XXH3_')
+                            for line in out.getvalue().decode().splitlines()))
+
+    def test_manifest_bsd(self):
+        path = os.path.join(self.tmpdir, 'manifest.txt')
+        xxhash.hash_tree(self.root, 'xxh128', manifest=path, format='bsd')
+        with open(path) as f:
+            lines = f.read().splitlines()
+        self.assertEqual(lines, [f'XXH128 ({p}) = {h}' for p, h in self._expected('xxh3_128').items()])
+
+    @unittest.skipIf(sys.platform == 'win32', 'file names cannot contain newlines')
+    def test_manifest_escaping(self):
+        name = os.path.join(self.root, 'new\nline\\back')
+        with open(name, 'wb') as f:
+            f.write(b'x')
+        for fmt in ('gnu', 'bsd'):
+            out = io.BytesIO()
+            xxhash.hash_tree(self.root, 'xxh32', manifest=out, format=fmt)
+            self.assertIn(b'new\\nline\\\\back', out.getvalue())
+            out.seek(0)
+            self.assertEqual(xxhash.verify_manifest(out)[name], 'OK')
+
+    @unittest.skipUnless(hasattr(os, 'symlink') and sys.platform != 'win32', 'requires symlinks')
+    def test_symlinks(self):
+        os.symlink('top.txt', os.path.join(self.root, 'link'))
+        os.symlink('a', os.path.join(self.root, 'dirlink'))
+        os.symlink('missing', os.path.join(self.root, 'dangling'))
+        self.assertEqual(xxhash.hash_tree(self.root, 'xxh64'), self._expected('xxh64'))
+        followed = xxhash.hash_tree(self.root, 'xxh64', follow_symlinks=True)
+        self.assertEqual(followed[os.path.join(self.root, 'link')],
+                         xxhash.xxh64_hexdigest(b'top'))
+        self.assertEqual(followed[os.path.join(self.root, 'dirlink', 'one')],
+                         xxhash.xxh64_hexdigest(b'one'))
+
+    @unittest.skipUnless(hasattr(os, 'symlink') and sys.platform != 'win32', 'requires symlinks')
+    def test_symlink_cycle(self):
+        os.symlink('..', os.path.join(self.root, 'a', 'up'))
+        os.symlink(self.root, os.path.join(self.root, 'c', 'root'))
+        self.assertEqual(xxhash.hash_tree(self.root, 'xxh64', follow_symlinks=True),
+                         self._expected('xxh64'))
+        os.symlink(os.path.join('..', 'c'), os.path.join(self.root, 'a', 'c'))
+        followed = xxhash.hash_tree(self.root, 'xxh64', follow_symlinks=True)
+        self.assertEqual(followed[os.path.join(self.root, 'a', 'c', 'empty')],
+                         xxhash.xxh64_hexdigest(b''))
+
+    def test_bytes_root(self):
+        root = os.fsencode(self.root)
+        expected = {os.fsencode(p): h for p, h in self._expected('xxh64').items()}
+        self.assertEqual(xxhash.hash_tree(root, 'xxh64'), expected)
+        out = io.BytesIO()
+        xxhash.hash_tree(root, 'xxh64', manifest=out)
+        self.assertEqual(out.getvalue().splitlines(),
+                         [h.encode() + b'  ' + p for p, h in expected.items()])
+        with self.assertRaises(FileNotFoundError) as cm:
+            xxhash.hash_tree(os.path.join(root, b'missing'))
+        self.assertIsInstance(cm.exception.filename, bytes)
+
+    def test_errors(self):
+        with self.assertRaises(FileNotFoundError):
+            xxhash.hash_tree(os.path.join(self.tmpdir, 'missing'))
+        with self.assertRaises(NotADirectoryError):
+            xxhash.hash_tree(os.path.join(self.root, 'top.txt'))
+        with self.assertRaises(ValueError):
+            xxhash.hash_tree(self.root, format='sha')
+        with self.assertRaises(ValueError):
+            xxhash.hash_tree(self.root, 'md5')
+
+
+class TestVerifyManifest(unittest.TestCase):
+    def setUp(self):
+        self.tmpdir = tempfile.mkdtemp()
+        self.files = {}
+        for i in range(20):
+            name = os.path.join(self.tmpdir, f'f{i}')
+            data = os.urandom(i * 1000)
+            with open(name, 'wb') as f:
+                f.write(data)
+            self.files[name] = data
+
+    def tearDown(self):
+        shutil.rmtree(self.tmpdir)
+
+    def test_all_ok(self):
+        for algo in ALGORITHMS:
+            out = io.BytesIO()
+            xxhash.hash_tree(self.tmpdir, algo, manifest=out)
+            out.seek(0)
+            result = xxhash.verify_manifest(out, nthreads=4)
+            self.assertEqual(result, dict.fromkeys(sorted(self.files), 'OK'))
+
+    def test_mixed_formats(self):
+        names = sorted(self.files)
+        lines = [
+            f'{xxhash.xxh32_hexdigest(self.files[names[0]])}  {names[0]}',
+            f'XXH3_{xxhash.xxh3_64_hexdigest(self.files[names[1]])}  {names[1]}',
+            f'{xxhash.xxh64_hexdigest(self.files[names[2]]).upper()} *{names[2]}',
+            f'XXH64 ({names[3]}) = {xxhash.xxh64_hexdigest(self.files[names[3]])}',
+            f'XXH3 ({names[4]}) = {xxhash.xxh3_64_hexdigest(self.files[names[4]])}',
+            f'XXH32 ({names[5]}) = {xxhash.xxh32_hexdigest(self.files[names[5]])}',
+            '',
+            f'{xxhash.xxh128_hexdigest(self.files[names[6]])}  {names[6]}',
+        ]
+        out = io.BytesIO('\r\n'.join(lines).encode())
+        self.assertEqual(xxhash.verify_manifest(out), dict.fromkeys(names[:7], 'OK'))
+
+    def test_failed_and_error(self):
+        path = os.path.join(self.tmpdir, 'manifest')
+        with open(path, 'wb') as f:
+            xxhash.hash_tree(self.tmpdir, 'xxh64', manifest=f)
+        names = sorted(self.files)
+        with open(names[3], 'ab') as f:
+            f.write(b'!')
+        os.remove(names[5])
+        result = xxhash.verify_manifest(path)
+        self.assertEqual(result[names[3]], 'FAILED')
+        self.assertEqual(result[names[5]], 'ERROR')
+        self.assertEqual(sum(v == 'OK' for v in result.values()), len(names) - 2)
+
+    def test_duplicates(self):
+        name = sorted(self.files)[1]
+        good = xxhash.xxh64_hexdigest(self.files[name])
+        bad = xxhash.xxh64_hexdigest(self.files[name] + b'!')
+        for digests, status in (((good, good), 'OK'), ((good, bad), 'FAILED'),
+                                ((bad, good), 'FAILED')):
+            out = io.BytesIO(''.join(f'{d}  {name}\n' for d in digests).encode())
+            self.assertEqual(xxhash.verify_manifest(out, nthreads=2), {name: status})
+
+    def test_root(self):
+        out = io.BytesIO()
+        for name in sorted(self.files):
+            out.write(f'{xxhash.xxh64_hexdigest(self.files[name])}  {os.path.basename(name)}\n'.encode())
+        out.seek(0)
+        result = xxhash.verify_manifest(out, root=self.tmpdir)
+        self.assertEqual(set(result.values()), {'OK'})
+        self.assertIn('f0', result)
+
+    def test_invalid_lines(self):
+        for line in (b'nothex  file', b'0123456789abcdef file', b'0123  file',
+                     b'XXH3_01234567  file', b'XXH64 (file) = 0123', b'MD5 (file) = 00'):
+            with self.assertRaises(ValueError):
+                xxhash.verify_manifest(io.BytesIO(line + b'\n'))
+
+
+class TestDigestCache(unittest.TestCase):
+    def setUp(self):
+        self.tmpdir = tempfile.mkdtemp()
+        self.root = os.path.join(self.tmpdir, 'root')
+        self.cache_path = os.path.join(self.tmpdir, 'digests.cache')
+        os.makedirs(self.root)
+        self.files = {}
+        for i in range(40):
+            self._write(os.path.join(self.root, f'f{i:02}'), os.urandom(i * 100))
+
+    def tearDown(self):
+        shutil.rmtree(self.tmpdir)
+
+    def _write(self, path, data, mtime=1000000000):
+        with open(path, 'wb') as f:
+            f.write(data)
+        # Files modified in the last two seconds are not cached.
+        os.utime(path, ns=(mtime * 10**9, mtime * 10**9))
+        self.files[path] = data
+
+    def _expected(self, algo='xxh3_128'):
+        hexdigest = getattr(xxhash, f'{algo}_hexdigest')
+        return {name: hexdigest(data) for name, data in sorted(self.files.items())}
+
+    def test_hits(self):
+        with xxhash.DigestCache(self.cache_path) as cache:
+            for algo in ALGORITHMS:
+                self.assertEqual(xxhash.hash_tree(self.root, algo, cache=cache, nthreads=3),
+                                 self._expected(algo))
+            stats = cache.stats()
+            self.assertEqual((stats['hits'], stats['misses'], stats['stores']), (0, 160, 160))
+            self.assertEqual(stats['entries'], 160)
+            for algo in ALGORITHMS:
+                self.assertEqual(xxhash.hash_tree(self.root, algo, cache=cache),
+                                 self._expected(algo))
+            stats = cache.stats()
+            self.assertEqual((stats['hits'], stats['misses']), (160, 160))
+            self.assertEqual(stats['hit_rate'], 0.5)
+
+    def test_persistent(self):
+        with xxhash.DigestCache(self.cache_path, capacity=1000) as cache:
+            xxhash.hash_tree(self.root, cache=cache)
+            self.assertEqual(cache.capacity, 1024)
+        self.assertTrue(cache.closed)
+        with xxhash.DigestCache(pathlib.Path(self.cache_path)) as cache:
+            self.assertEqual(cache.capacity, 1024)
+            self.assertEqual(xxhash.hash_tree(self.root, cache=cache), self._expected())
+            self.assertEqual(cache.stats()['hits'], 40)
+
+    @unittest.skipIf(sys.platform == 'win32', 'the table is not mapped on Windows')
+    def test_processes(self):
+        # Processes creating and filling one cache file at once must agree
+        # on its header and entry count.
+        roots = [os.path.join(self.tmpdir, f'tree{i}') for i in range(4)]
+        for i, root in enumerate(roots):
+            os.makedirs(root)
+            for j in range(500):
+                self._write(os.path.join(root, f'f{j}'), b'%d-%d' % (i, j))
+        code = ('import sys, xxhash\n'
+                'with xxhash.DigestCache(sys.argv[1], capacity=1 << 16) as cache:\n'
+                '    xxhash.hash_tree(sys.argv[2], cache=cache)\n')
+        procs = [subprocess.Popen([sys.executable, '-c', code, self.cache_path, root])
+                 for root in roots]
+        for proc in procs:
+            self.assertEqual(proc.wait(timeout=60), 0)
+        with xxhash.DigestCache(self.cache_path) as cache:
+            self.assertEqual(cache.stats()['entries'], 2000)
+            for root in roots:
+                xxhash.hash_tree(root, cache=cache)
+            self.assertEqual(cache.stats()['hits'], 2000)
+
+    def test_invalidation(self):
+        names = sorted(self.files)
+        with xxhash.DigestCache(self.cache_path) as cache:
+            xxhash.hash_tree(self.root, cache=cache)
+            self._write(names[1], b'longer than before')
+            self._write(names[2], os.urandom(200), mtime=1000000001)
+            # Replaced by a new inode with the same size and mtime.
+            self._write(names[0], os.urandom(300))
+            os.replace(names[0], names[3])
+            self.files[names[3]] = self.files.pop(names[0])
+            self.assertEqual(xxhash.hash_tree(self.root, cache=cache), self._expected())
+            self.assertEqual(cache.stats()['hits'], 36)
+
+            # Same size and mtime: the cached digest is returned until cleared.
+            stale = xxhash.hash_tree(self.root, cache=cache)[names[5]]
+            self._write(names[5], os.urandom(500))
+            self.assertEqual(xxhash.hash_tree(self.root, cache=cache)[names[5]], stale)
+            cache.clear()
+            self.assertEqual(cache.stats()['entries'], 0)
+            self.assertEqual(xxhash.hash_tree(self.root, cache=cache), self._expected())
+
+    def test_racy_files_not_stored(self):
+        path = os.path.join(self.root, 'fresh')
+        with open(path, 'wb') as f:
+            f.write(b'just written')
+        self.files[path] = b'just written'
+        with xxhash.DigestCache(self.cache_path) as cache:
+            self.assertEqual(xxhash.hash_tree(self.root, cache=cache), self._expected())
+            self.assertEqual(cache.stats()['stores'], 40)
+            xxhash.hash_tree(self.root, cache=cache)
+            self.assertEqual(cache.stats()['hits'], 40)
+
+    def test_small_capacity(self):
+        with xxhash.DigestCache(self.cache_path, capacity=1) as cache:
+            self.assertEqual(cache.capacity, 16)
+            for _ in range(3):
+                self.assertEqual(xxhash.hash_tree(self.root, 'xxh64', cache=cache),
+                                 self._expected('xxh64'))
+            self.assertLessEqual(cache.stats()['entries'], 16)
+
+    def test_verify_manifest(self):
+        out = io.BytesIO()
+        with xxhash.DigestCache(self.cache_path) as cache:
+            xxhash.hash_tree(self.root, 'xxh64', manifest=out, cache=cache)
+            out.seek(0)
+            result = xxhash.verify_manifest(out, cache=cache)
+            self.assertEqual(set(result.values()), {'OK'})
+            self.assertEqual(cache.stats()['hits'], 40)
+
+    def test_errors(self):
+        with self.assertRaises(TypeError):
+            xxhash.hash_tree(self.root, cache=self.cache_path)
+        with self.assertRaises(ValueError):
+            xxhash.DigestCache(self.cache_path, capacity=0)
+        with self.assertRaises(OSError):
+            xxhash.DigestCache(os.path.join(self.tmpdir, 'missing', 'cache'))
+        bogus = os.path.join(self.root, 'f10')
+        with self.assertRaises(ValueError):
+            xxhash.DigestCache(bogus)
+        cache = xxhash.DigestCache(self.cache_path)
+        cache.close()
+        cache.close()
+        for call in (cache.stats, cache.clear, cache.flush,
+                     lambda: xxhash.hash_tree(self.root, cache=cache)):
+            with self.assertRaises(ValueError):
+                call()
+
+    def test_path_cycle(self):
+        class Path(pathlib.PurePath().__class__):
+            pass
+
+        path = Path(self.cache_path)
+        path.cache = xxhash.DigestCache(path)
+        self.assertIs(path.cache.path, path)
+        ref = weakref.ref(path)
+        del path
+        gc.collect()
+        self.assertIsNone(ref())
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,145 @@
+"""Tests for hash_object()."""
+import array
+import math
+import struct
+import unittest
+
+import xxhash
+
+
+def _tag(tag, value):
+    return tag + struct.pack('<Q', value & (2**64 - 1))
+
+
+def _encode(obj, seed=0, unordered_dicts=False):
+    """Reference encoder, as documented in hash_object()."""
+    if obj is None:
+        return b'N'
+    if obj is True or obj is False:
+        return b'T' if obj else b'F'
+    if isinstance(obj, int):
+        if -2**63 <= obj < 2**63:
+            return _tag(b'i', obj)
+        text = hex(obj).encode('ascii')
+        return _tag(b'I', len(text)) + text
+    if isinstance(obj, float):
+        if math.isnan(obj):
+            return _tag(b'd', 0x7FF8000000000000)
+        return b'd' + struct.pack('<d', obj)
+    if isinstance(obj, str):
+        return _tag(b's', len(obj)) + obj.encode('utf-8')
+    if isinstance(obj, (tuple, list)):
+        tag = b't' if isinstance(obj, tuple) else b'l'
+        return _tag(tag, len(obj)) + b''.join(
+            _encode(x, seed, unordered_dicts) for x in obj)
+    if isinstance(obj, dict):
+        if not unordered_dicts:
+            return _tag(b'm', len(obj)) + b''.join(
+                _encode(k, seed, unordered_dicts) + _encode(v, seed, unordered_dicts)
+                for k, v in obj.items())
+        return _unordered(b'M', [_encode(k, seed, True) + _encode(v, seed, True)
+                                 for k, v in obj.items()], seed)
+    if isinstance(obj, (set, frozenset)):
+        return _unordered(b'e', [_encode(x, seed, unordered_dicts) for x in obj], seed)
+    data = bytes(memoryview(obj))
+    return _tag(b'b', len(data)) + data
+
+
+def _unordered(tag, encodings, seed):
+    digests = sorted(xxhash.xxh3_128_digest(e, seed) for e in encodings)
+    return _tag(tag, len(digests)) + b''.join(digests)
+
+
+OBJECTS = [
+    None, True, False, 0, 1, -1, 2**63 - 1, -2**63, 2**63, -2**63 - 1, 10**40,
+    0.0, -0.0, 1.5, float('inf'), float('nan'), '', 'key', 'caf\xe9',
+    '日本' * 200, '\U0001f600', b'', b'bytes', bytearray(b'abc'),
+    memoryview(b'view'), array.array('I', [1, 2]), (), [], {}, set(),
+    (1, 'a', b'a', None), [[1, 2], (3, 4)], {'a': 1, 'b': [2, 3]},
+    {1: {2: {3: 'x'}}}, {1, 2, 3}, frozenset(['a', 'b']), ['x' * 1000] * 5,
+    {'nested': ({'k': frozenset([1.5, None])}, [True, False])},
+    {'x' * (i * 97) for i in range(60)}, frozenset(b'y' * (i * 131) for i in range(40)),
+    {'k%d' % i: ['v' * (i * 53), {i}] for i in range(50)},
+]
+
+
+class TestHashObject(unittest.TestCase):
+    def test_encoding(self):
+        for obj in OBJECTS:
+            for seed in (0, 2**64 - 1):
+                with self.subTest(obj=obj, seed=seed):
+                    self.assertEqual(xxhash.hash_object(obj, seed=seed),
+                                     xxhash.xxh3_128_intdigest(_encode(obj, seed), seed))
+
+    def test_algorithms(self):
+        # Small encodings are hashed in one shot, large ones streamed.
+        for obj in ({'a': [1, 2.5, 'x'], 'b': (None, b'y')},
+                    {'a': [1, 2.5, 'x' * 2000], 'b': (None, b'y' * 300)}):
+            for algorithm, name in ((xxhash.xxh32, 'xxh32'), (xxhash.xxh64, 'xxh64'),
+                                    (xxhash.xxh3_64, 'xxh3_64'), (xxhash.xxh3_128, 'xxh128')):
+                expected = algorithm(_encode(obj), seed=7).intdigest()
+                self.assertEqual(xxhash.hash_object(obj, name, 7), expected)
+                self.assertEqual(xxhash.hash_object(obj, algorithm, seed=7), expected)
+
+    def test_stable(self):
+        # Digests are part of the API and must never change.
+        self.assertEqual(xxhash.hash_object(None, 'xxh3_64'), 0x1a038927df1311d6)
+        self.assertEqual(xxhash.hash_object((1, 'a', [2.5, None]), 'xxh3_64'),
+                         0xb9e39447d2efe9f9)
+        self.assertEqual(xxhash.hash_object({'k': {1, 2}}, 'xxh3_64', unordered_dicts=True),
+                         0xc7d51bc33ed78dfe)
+
+    def test_distinct(self):
+        objs = [None, False, 0, 0.0, '', b'', (), [], {}, set(), ('',), ([],),
+                ('a', 'b'), ('ab',), ((1,), 2), (1, (2,)), [1, [2]], {'a': 'b'},
+                {'a': ('b',)}, 1, True, 1.0, '1', b'1']
+        digests = [xxhash.hash_object(o) for o in objs]
+        self.assertEqual(len(set(digests)), len(objs))
+
+    def test_unordered(self):
+        a = {'x': 1, 'y': [2, 3], 'z': {'p': None}}
+        b = {'z': {'p': None}, 'y': [2, 3], 'x': 1}
+        self.assertNotEqual(xxhash.hash_object(a), xxhash.hash_object(b))
+        self.assertEqual(xxhash.hash_object(a, unordered_dicts=True),
+                         xxhash.hash_object(b, unordered_dicts=True))
+        self.assertEqual(xxhash.hash_object({3, 1, 2}), xxhash.hash_object({2, 3, 1}))
+        self.assertEqual(xxhash.hash_object(set(range(1000))),
+                         xxhash.hash_object(set(reversed(range(1000)))))
+        self.assertNotEqual(xxhash.hash_object({1, 2}), xxhash.hash_object(frozenset({1, 2, 3})))
+        big = {'k%d' % i: ['v' * (i * 53), {'w' * i: i}] for i in range(50)}
+        self.assertEqual(xxhash.hash_object(big, unordered_dicts=True),
+                         xxhash.xxh3_128_intdigest(_encode(big, unordered_dicts=True)))
+
+    def test_subclasses(self):
+        class S(str):
+            pass
+
+        class T(tuple):
+            pass
+
+        self.assertEqual(xxhash.hash_object(S('a')), xxhash.hash_object('a'))
+        self.assertEqual(xxhash.hash_object(T((1, 2))), xxhash.hash_object((1, 2)))
+
+    def test_errors(self):
+        with self.assertRaises(TypeError):
+            xxhash.hash_object(object())
+        with self.assertRaises(TypeError):
+            xxhash.hash_object([1, {'a': object()}])
+        with self.assertRaises(TypeError):
+            xxhash.hash_object({frozenset([1, object()])})
+        with self.assertRaises(UnicodeEncodeError):
+            xxhash.hash_object(['\ud800'])
+        with self.assertRaises(ValueError):
+            xxhash.hash_object(1, 'md5')
+        with self.assertRaises(TypeError):
+            xxhash.hash_object()
+        with self.assertRaises(TypeError):
+            xxhash.hash_object(1, 'xxh3_64', 0, True)
+        cyclic = []
+        cyclic.append(cyclic)
+        with self.assertRaises(RecursionError):
+            xxhash.hash_object(cyclic)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -162,3 +162,19 @@ class TestHashlibCompat(unittest.TestCase):
             self.assertEqual(a.digest(), b.digest())
             b.update(b'more')
             self.assertNotEqual(a.digest(), b.digest())
+
+    def test_recycled_objects(self):
+        # Freed hashers are reused; a recycled one must not carry over the
+        # previous object's seed or data.
+        for algo in ('xxh32', 'xxh64', 'xxh3_64', 'xxh3_128'):
+            cls = getattr(xxhash, algo)
+            expected = [cls(self.data, seed=seed).digest() for seed in range(3)]
+            for _ in range(3):
+                hashers = [cls(b'junk' * 100, seed=12345) for _ in range(100)]
+                copies = [h.copy() for h in hashers]
+                del hashers, copies
+                self.assertEqual([cls(self.data, seed=seed).digest() for seed in range(3)],
+                                 expected)
+                fresh = cls()
+                fresh.update(self.data)
+                self.assertEqual(fresh.digest(), expected[0])
@@ -0,0 +1,133 @@
+"""Tests for HyperLogLog."""
+import array
+import os
+import struct
+import threading
+import unittest
+
+import xxhash
+
+from tests import reference
+
+
+class TestHyperLogLog(unittest.TestCase):
+    def test_known_answer(self):
+        hll = xxhash.HyperLogLog(4)
+        hll.add_many([b'a', b'b', b'c', b'abc'])
+        self.assertEqual(bytes(hll), bytes.fromhex(
+            '585848484c4c01040000000000000000' '00000000000200010100000000000200'))
+
+    def test_layout(self):
+        keys = [b'', b'a', os.urandom(100)] + [b'%d' % i for i in range(2000)]
+        for precision, seed in ((4, 0), (10, 2**64 - 1), (14, 7)):
+            hll = xxhash.HyperLogLog(precision, seed)
+            hll.add_many(keys[:1000])
+            for key in keys[1000:]:
+                hll.add(key)
+            self.assertEqual(bytes(hll), reference.hll_state(keys, precision, seed))
+
+    def test_cardinality(self):
+        self.assertEqual(xxhash.HyperLogLog().cardinality(), 0.0)
+        for precision in (10, 14):
+            error = 1.04 / (1 << precision) ** 0.5
+            for n in (1, 10, 100, 1000, 10**4, 10**5, 10**6):
+                hll = xxhash.HyperLogLog(precision)
+                hll.add_many(array.array('Q', range(n)))
+                # Well within four standard errors, across the small-range
+                # and large-range regimes alike.
+                self.assertLess(abs(hll.cardinality() / n - 1), 4 * error + 0.01, (precision, n))
+
+    def test_duplicates(self):
+        hll = xxhash.HyperLogLog()
+        keys = [b'key%d' % (i % 500) for i in range(20000)]
+        hll.add_many(keys)
+        self.assertLess(abs(hll.cardinality() - 500), 10)
+
+    def test_key_types(self):
+        values = [b'alpha', b'beta', b'gamma']
+        a = xxhash.HyperLogLog(8)
+        a.add_many(values)
+        b = xxhash.HyperLogLog(8)
+        b.add_many(b''.join(values), array.array('q', [0, 5, 9, 14]))
+        self.assertEqual(bytes(a), bytes(b))
+        c = xxhash.HyperLogLog(8)
+        c.add_many(array.array('I', range(100)))
+        d = xxhash.HyperLogLog(8)
+        d.add_many([struct.pack('=I', i) for i in range(100)])
+        self.assertEqual(bytes(c), bytes(d))
+
+    def test_merge(self):
+        a = xxhash.HyperLogLog(12, seed=3)
+        b = xxhash.HyperLogLog(12, seed=3)
+        both = xxhash.HyperLogLog(12, seed=3)
+        a.add_many(array.array('Q', range(0, 60000)))
+        b.add_many(array.array('Q', range(30000, 90000)))
+        both.add_many(array.array('Q', range(0, 90000)))
+        a.merge(b)
+        self.assertEqual(bytes(a), bytes(both))
+        a.merge(a)
+        self.assertEqual(bytes(a), bytes(both))
+        with self.assertRaises(ValueError):
+            a.merge(xxhash.HyperLogLog(11, seed=3))
+        with self.assertRaises(ValueError):
+            a.merge(xxhash.HyperLogLog(12))
+        with self.assertRaises(TypeError):
+            a.merge(bytes(b))
+
+    def test_frombytes(self):
+        hll = xxhash.HyperLogLog(6, seed=9)
+        hll.add_many([b'x', b'y'])
+        copy = xxhash.HyperLogLog.frombytes(bytes(hll))
+        self.assertEqual((copy.precision, copy.seed), (6, 9))
+        self.assertEqual(bytes(copy), bytes(hll))
+        copy.add(b'z')
+        self.assertNotEqual(bytes(copy), bytes(hll))
+        data = bytes(hll)
+        bad_rank = data[:16] + bytes([64]) + data[17:]
+        for bad in (b'', data[:-1], data + b'\0', b'Y' + data[1:], bad_rank,
+                    data[:7] + b'\x03' + data[8:]):
+            with self.assertRaises(ValueError):
+                xxhash.HyperLogLog.frombytes(bad)
+        self.assertTrue(memoryview(hll).readonly)
+
+    def test_threads(self):
+        keys = array.array('Q', range(xxhash._xxhash._PARALLEL_MINITEMS * 2))
+        one = xxhash.HyperLogLog()
+        one.add_many(keys, nthreads=1)
+        many = xxhash.HyperLogLog()
+        many.add_many(keys, nthreads=4)
+        self.assertEqual(bytes(many), bytes(one))
+
+        # Concurrent adds from Python threads lose no register updates.
+        shared = xxhash.HyperLogLog()
+
+        def worker(start):
+            for i in range(start, len(keys), 4):
+                shared.add(struct.pack('=Q', keys[i]))
+
+        threads = [threading.Thread(target=worker, args=(i,)) for i in range(4)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        self.assertEqual(bytes(shared), bytes(one))
+
+    def test_errors(self):
+        for precision in (3, 19, -1):
+            with self.assertRaises(ValueError):
+                xxhash.HyperLogLog(precision)
+        hll = xxhash.HyperLogLog()
+        with self.assertRaises(TypeError):
+            hll.add('str')
+        with self.assertRaises(TypeError):
+            hll.add_many(b'abc')
+        with self.assertRaises(TypeError):
+            hll.add_many([b'a', None])
+        with self.assertRaises(ValueError):
+            hll.add_many(b'abc', array.array('i', [0, 4]))
+        with self.assertRaises(ValueError):
+            hll.add_many([b'a'], nthreads=0)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -266,6 +266,19 @@ for i in range(16):
 """))
             _interp_mod.destroy(iid)
 
+    def test_destroy_after_parallel_batch(self):
+        # The module's worker threads are stopped when the interpreter
+        # goes away.
+        for _ in range(4):
+            iid = _interp_mod.create()
+            _interp_mod.run_string(iid, _subinterp_code("""\
+import xxhash
+keys = [bytes([i % 256]) * (i % 40) for i in range(100000)]
+assert (xxhash.xxh3_64_intdigest_many(keys, nthreads=4)
+        == xxhash.xxh3_64_intdigest_many(keys, nthreads=1))
+"""))
+            _interp_mod.destroy(iid)
+
 
 # ── concurrent.interpreters (Python 3.14+) ──────────────────────────────
 
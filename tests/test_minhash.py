@@ -0,0 +1,133 @@
+"""Tests for minhash() and minhash_many()."""
+import array
+import os
+import random
+import struct
+import unittest
+
+import xxhash
+
+from tests import reference
+from tests.reference import M64
+
+
+def _similarity(a, b):
+    return sum(x == y for x, y in zip(a, b)) / len(a)
+
+
+class TestMinHash(unittest.TestCase):
+    def test_known_answer(self):
+        # The first two SplitMix64 outputs from state 0 are the published
+        # 0xe220a8397b1dcdaf and 0x6e789e6aa1b965f4.
+        a, b = 0xE220A8397B1DCDAF, 0x6E789E6AA1B965F4
+        self.assertEqual(xxhash.minhash(b'x', 1, 1),
+                         [(a * xxhash.xxh3_64_intdigest(b'x') + b) & M64])
+        self.assertEqual(xxhash.minhash(b'hello world', 4),
+                         [0x10F6FF758BEE0FE7, 0x1E0D76F76F3211D2,
+                          0x32DDC72743851419, 0x1910CAC287EDB73A])
+        self.assertEqual(xxhash.minhash(['the', 'quick', 'brown', 'fox'], 3, 2, 1),
+                         [0x67DFF9DDF3C32356, 0x475396BF0FCCDD26, 0x24E943D9935192F7])
+
+    def test_reference(self):
+        rng = random.Random(3)
+        docs = [b'', b'a', b'abcd', b'abcde', b'hello world, hello world',
+                bytes(rng.randrange(256) for _ in range(1000))]
+        for doc in docs:
+            for num_perm, shingle, seed in ((128, 5, 0), (1, 1, 0), (43, 3, M64), (8, 9, 7)):
+                with self.subTest(doc=doc[:10], num_perm=num_perm, shingle=shingle):
+                    self.assertEqual(xxhash.minhash(doc, num_perm, shingle, seed),
+                                     reference.minhash(doc, num_perm, shingle, seed))
+
+    def test_tokens(self):
+        words = 'the quick brown fox jumps over the lazy dog'.split()
+        self.assertEqual(xxhash.minhash(words, shingle=2), reference.minhash(words, shingle=2))
+        self.assertEqual(xxhash.minhash(words[:3], 16, 5, 1), reference.minhash(words[:3], 16, 5, 1))
+        mixed = [b'caf', 'caf\xe9', bytearray(b'x'), memoryview(b'-y-')[1:2]]
+        self.assertEqual(xxhash.minhash(mixed, 32, 2), reference.minhash(mixed, 32, 2))
+        self.assertEqual(xxhash.minhash([w.encode() for w in words]), xxhash.minhash(words))
+        self.assertEqual(xxhash.minhash(tuple(words)), xxhash.minhash(words))
+        self.assertEqual(xxhash.minhash([]), [M64] * 128)
+
+    def test_similarity(self):
+        rng = random.Random(5)
+        vocab = ['w%d' % i for i in range(5000)]
+        base = [rng.choice(vocab) for _ in range(2000)]
+        for changed in (100, 500, 1000):
+            other = list(base)
+            for i in rng.sample(range(len(base)), changed):
+                other[i] = rng.choice(vocab)
+            a, b = set(zip(base, base[1:], base[2:])), set(zip(other, other[1:], other[2:]))
+            jaccard = len(a & b) / len(a | b)
+            estimate = _similarity(xxhash.minhash(base, 512, 3), xxhash.minhash(other, 512, 3))
+            # Within four standard errors of sqrt(J * (1 - J) / num_perm).
+            self.assertLess(abs(estimate - jaccard),
+                            4 * (jaccard * (1 - jaccard) / 512) ** 0.5 + 0.01, changed)
+
+    def test_out(self):
+        out = array.array('Q', [0]) * 64
+        self.assertIs(xxhash.minhash(b'some document', 64, out=out), out)
+        self.assertEqual(out.tolist(), xxhash.minhash(b'some document', 64))
+        out = bytearray(8 * 16)
+        xxhash.minhash(b'text', num_perm=16, out=out)
+        self.assertEqual(list(struct.unpack('=16Q', out)), xxhash.minhash(b'text', 16))
+
+    def test_many(self):
+        rng = random.Random(7)
+        docs = [os.urandom(rng.randrange(0, 3000)) for _ in range(100)]
+        docs += [b'', b'xy', 'one two three four five six'.split(), []]
+        expected = [xxhash.minhash(d, 32, 4, 2) for d in docs]
+        self.assertEqual(xxhash.minhash_many(docs, 32, 4, 2), expected)
+        self.assertEqual(xxhash.minhash_many([]), [])
+
+        data = b''.join(docs[:100])
+        offsets = array.array('q', [0])
+        for d in docs[:100]:
+            offsets.append(offsets[-1] + len(d))
+        self.assertEqual(xxhash.minhash_many(data, 32, 4, 2, offsets=offsets), expected[:100])
+        offsets = array.array('i', offsets)
+        self.assertEqual(xxhash.minhash_many(data, 32, 4, 2, offsets=offsets), expected[:100])
+
+        out = array.array('Q', [0]) * (32 * len(docs))
+        self.assertIs(xxhash.minhash_many(docs, 32, 4, 2, out=out), out)
+        self.assertEqual([out[i:i + 32].tolist() for i in range(0, len(out), 32)], expected)
+
+    def test_threads(self):
+        docs = [os.urandom(500) for _ in range(600)]
+        expected = xxhash.minhash_many(docs, nthreads=1)
+        for nthreads in (2, 4):
+            self.assertEqual(xxhash.minhash_many(docs, nthreads=nthreads), expected)
+
+    def test_errors(self):
+        for num_perm in (0, -1, 1025):
+            with self.assertRaises(ValueError):
+                xxhash.minhash(b'abc', num_perm)
+        for shingle in (0, -1):
+            with self.assertRaises(ValueError):
+                xxhash.minhash(b'abc', shingle=shingle)
+        with self.assertRaises(TypeError):
+            xxhash.minhash('str')
+        with self.assertRaises(TypeError):
+            xxhash.minhash([b'a', 1])
+        with self.assertRaises(TypeError):
+            xxhash.minhash(1)
+        for unordered in ({'a', 'b'}, frozenset(['a']), {'a': 1}, iter(['a'])):
+            with self.assertRaises(TypeError):
+                xxhash.minhash(unordered)
+        with self.assertRaises(TypeError):
+            xxhash.minhash_many([['a'], {'b'}])
+        with self.assertRaises(UnicodeEncodeError):
+            xxhash.minhash(['\ud800'])
+        with self.assertRaises(TypeError):
+            xxhash.minhash(b'abc', 8, 5, 0, None)
+        with self.assertRaises(ValueError):
+            xxhash.minhash(b'abc', 8, out=bytearray(63))
+        with self.assertRaises(TypeError):
+            xxhash.minhash_many(['str'])
+        with self.assertRaises(ValueError):
+            xxhash.minhash_many(b'abc', offsets=array.array('i', [0, 4]))
+        with self.assertRaises(ValueError):
+            xxhash.minhash_many([b'a'], nthreads=0)
+
+
+if __name__ == '__main__':
+    unittest.main()
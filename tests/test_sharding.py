@@ -0,0 +1,199 @@
+"""Tests for jump_hash_many(), rendezvous_many() and HashRing."""
+import array
+import struct
+import unittest
+
+import xxhash
+
+from tests import reference
+from tests.reference import M64
+
+
+KEYS = [b'', b'a', b'abc'] + [b'key%d' % i for i in range(2000)]
+NODES = [b'node-a', b'node-b', b'node-c', b'node-d', b'node-e']
+
+
+class TestJumpHash(unittest.TestCase):
+    def test_known_answer(self):
+        # Published vectors for the algorithm itself, then through xxh3_64.
+        for key, num_buckets, bucket in ((1, 1, 0), (42, 57, 43), (0xDEAD10CC, 1, 0),
+                                         (0xDEAD10CC, 666, 361), (256, 1024, 520)):
+            self.assertEqual(reference.jump(key, num_buckets), bucket)
+        keys = [b'', b'a', b'abc', b'key']
+        self.assertEqual(xxhash.jump_hash_many(keys, 1000), [241, 350, 780, 329])
+        self.assertEqual(xxhash.jump_hash_many(keys, 7), [0, 1, 2, 0])
+
+    def test_reference(self):
+        for num_buckets in (1, 2, 10, 1000, 2**32 - 1):
+            for seed in (0, M64):
+                self.assertEqual(
+                    xxhash.jump_hash_many(KEYS, num_buckets, seed),
+                    [reference.jump(xxhash.xxh3_64_intdigest(k, seed), num_buckets) for k in KEYS])
+
+    def test_consistency(self):
+        keys = array.array('Q', range(50000))
+        before = xxhash.jump_hash_many(keys, 10)
+        after = xxhash.jump_hash_many(keys, 11)
+        moved = [b for a, b in zip(before, after) if a != b]
+        self.assertEqual(set(moved), {10})
+        self.assertLess(abs(len(moved) / len(keys) - 1 / 11), 0.01)
+        counts = [before.count(i) for i in range(10)]
+        self.assertLess(max(counts) - min(counts), 0.1 * len(keys) / 10)
+
+    def test_inputs(self):
+        values = [b'alpha', b'beta', b'gamma']
+        expected = xxhash.jump_hash_many(values, 7)
+        offsets = array.array('i', [0, 5, 9, 14])
+        self.assertEqual(xxhash.jump_hash_many(b''.join(values), 7, offsets=offsets), expected)
+        ids = array.array('I', range(100))
+        self.assertEqual(xxhash.jump_hash_many(ids, 7),
+                         xxhash.jump_hash_many([struct.pack('=I', i) for i in ids], 7))
+        out = array.array('I', [0]) * 3
+        self.assertIs(xxhash.jump_hash_many(values, 7, out=out), out)
+        self.assertEqual(out.tolist(), expected)
+        self.assertEqual(xxhash.jump_hash_many([], 7), [])
+
+    def test_threads(self):
+        keys = array.array('Q', range(xxhash._xxhash._PARALLEL_MINITEMS * 2))
+        expected = xxhash.jump_hash_many(keys, 1000, nthreads=1)
+        self.assertEqual(xxhash.jump_hash_many(keys, 1000, nthreads=4), expected)
+
+    def test_errors(self):
+        for num_buckets in (0, -1, 2**32):
+            with self.assertRaises(ValueError):
+                xxhash.jump_hash_many([b'a'], num_buckets)
+        with self.assertRaises(TypeError):
+            xxhash.jump_hash_many([b'a'])
+        with self.assertRaises(TypeError):
+            xxhash.jump_hash_many(['str'], 2)
+        with self.assertRaises(TypeError):
+            xxhash.jump_hash_many(b'abc', 2)
+        with self.assertRaises(ValueError):
+            xxhash.jump_hash_many([b'a'], 2, out=bytearray(3))
+
+
+class TestRendezvous(unittest.TestCase):
+    def test_known_answer(self):
+        keys = [b'', b'a', b'abc', b'key', b'k2', b'k3']
+        self.assertEqual(xxhash.rendezvous_many(keys, NODES[:3]), [0, 1, 1, 0, 1, 2])
+        self.assertEqual(xxhash.rendezvous_many(keys, NODES[:3], [1, 2, 4]),
+                         [2, 1, 1, 0, 1, 2])
+
+    def test_reference(self):
+        for seed in (0, 7):
+            self.assertEqual(xxhash.rendezvous_many(KEYS, NODES, seed=seed),
+                             [reference.rendezvous(k, NODES, None, seed) for k in KEYS])
+            weights = [1, 2, 0.5, 3, 1]
+            self.assertEqual(xxhash.rendezvous_many(KEYS, NODES, weights, seed),
+                             [reference.rendezvous(k, NODES, weights, seed) for k in KEYS])
+
+    def test_consistency(self):
+        keys = array.array('Q', range(20000))
+        before = xxhash.rendezvous_many(keys, NODES)
+        after = xxhash.rendezvous_many(keys, NODES[:2] + NODES[3:])
+        for a, b in zip(before, after):
+            if a != 2:
+                self.assertEqual(b, a - (a > 2))
+
+    def test_weights(self):
+        keys = array.array('Q', range(100000))
+        weights = [1, 2, 3, 4]
+        owners = xxhash.rendezvous_many(keys, NODES[:4], weights)
+        for i, w in enumerate(weights):
+            self.assertLess(abs(owners.count(i) / len(keys) - w / 10), 0.01)
+        self.assertEqual(xxhash.rendezvous_many(keys[:1000], NODES, [3] * 5),
+                         xxhash.rendezvous_many(keys[:1000], NODES))
+
+    def test_inputs(self):
+        nodes = array.array('Q', range(10))
+        expected = xxhash.rendezvous_many(KEYS, [struct.pack('=Q', i) for i in nodes])
+        self.assertEqual(xxhash.rendezvous_many(KEYS, nodes), expected)
+        out = array.array('I', [0]) * len(KEYS)
+        self.assertIs(xxhash.rendezvous_many(KEYS, nodes, out=out), out)
+        self.assertEqual(out.tolist(), expected)
+        keys = array.array('Q', range(xxhash._xxhash._PARALLEL_MINITEMS + 1000))
+        self.assertEqual(xxhash.rendezvous_many(keys, nodes, nthreads=4),
+                         xxhash.rendezvous_many(keys, nodes, nthreads=1))
+
+    def test_errors(self):
+        with self.assertRaises(ValueError):
+            xxhash.rendezvous_many([b'a'], [])
+        with self.assertRaises(ValueError):
+            xxhash.rendezvous_many([b'a'], NODES, [1, 2])
+        for bad in (0, -1, float('inf'), float('nan')):
+            with self.assertRaises(ValueError):
+                xxhash.rendezvous_many([b'a'], NODES, [1, 1, bad, 1, 1])
+        with self.assertRaises(TypeError):
+            xxhash.rendezvous_many([b'a'], NODES, ['x'] * 5)
+        with self.assertRaises(TypeError):
+            xxhash.rendezvous_many([b'a'], ['node'])
+        with self.assertRaises(TypeError):
+            xxhash.rendezvous_many([b'a'], b'node')
+
+
+class TestHashRing(unittest.TestCase):
+    def test_known_answer(self):
+        keys = [b'', b'a', b'abc', b'key', b'k2', b'k3']
+        self.assertEqual(xxhash.HashRing(NODES[:3]).lookup_many(keys), [0, 2, 0, 0, 1, 0])
+        self.assertEqual(xxhash.HashRing(NODES[:3], 1, 5).lookup_many(keys),
+                         [0, 0, 0, 2, 2, 1])
+
+    def test_reference(self):
+        for vnodes, seed in ((1, 0), (10, 3), (160, M64)):
+            ring = xxhash.HashRing(NODES, vnodes, seed)
+            expected = reference.ring(KEYS, NODES, vnodes, seed)
+            self.assertEqual(ring.lookup_many(KEYS), expected)
+            self.assertEqual([ring.lookup(k) for k in KEYS], expected)
+        self.assertEqual(xxhash.HashRing([b'only']).lookup_many(KEYS), [0] * len(KEYS))
+
+    def test_consistency(self):
+        keys = array.array('Q', range(50000))
+        nodes = [b'n%d' % i for i in range(20)]
+        before = xxhash.HashRing(nodes).lookup_many(keys)
+        after = xxhash.HashRing(nodes + [b'new']).lookup_many(keys)
+        moved = [b for a, b in zip(before, after) if a != b]
+        self.assertEqual(set(moved), {20})
+        self.assertLess(abs(len(moved) / len(keys) - 1 / 21), 0.015)
+        counts = [before.count(i) for i in range(20)]
+        self.assertLess(max(counts) / min(counts), 1.5)
+
+    def test_large(self):
+        nodes = array.array('Q', range(1000))
+        ring = xxhash.HashRing(nodes, 200)
+        self.assertEqual((ring.num_nodes, ring.vnodes, ring.seed), (1000, 200, 0))
+        keys = [b'%d' % i for i in range(200)]
+        self.assertEqual(ring.lookup_many(keys),
+                         reference.ring(keys, [struct.pack('=Q', i) for i in nodes], 200, 0))
+
+    def test_inputs(self):
+        ring = xxhash.HashRing(NODES)
+        values = [b'alpha', b'beta', b'gamma']
+        expected = ring.lookup_many(values)
+        self.assertEqual(ring.lookup_many(b''.join(values), array.array('q', [0, 5, 9, 14])),
+                         expected)
+        self.assertEqual(ring.lookup(memoryview(b'-beta-')[1:5]), expected[1])
+        out = array.array('I', [0]) * 3
+        self.assertIs(ring.lookup_many(values, out=out), out)
+        self.assertEqual(out.tolist(), expected)
+        keys = array.array('Q', range(xxhash._xxhash._PARALLEL_MINITEMS + 1000))
+        self.assertEqual(ring.lookup_many(keys, nthreads=4), ring.lookup_many(keys, nthreads=1))
+
+    def test_errors(self):
+        for vnodes in (0, -1, 65537):
+            with self.assertRaises(ValueError):
+                xxhash.HashRing(NODES, vnodes)
+        with self.assertRaises(ValueError):
+            xxhash.HashRing([])
+        with self.assertRaises(TypeError):
+            xxhash.HashRing(['str'])
+        ring = xxhash.HashRing(NODES)
+        with self.assertRaises(TypeError):
+            ring.lookup('str')
+        with self.assertRaises(TypeError):
+            ring.lookup_many(b'abc')
+        with self.assertRaises(ValueError):
+            ring.lookup_many([b'a'], nthreads=0)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,94 @@
+import os
+import subprocess
+import sys
+import unittest
+
+import xxhash
+
+
+# Hash lengths on both sides of the XXH3 short-input, mid-size and
+# block boundaries through every entry point that reaches the vector loops,
+# batches through the multi-lane and fixed-width kernels, and MinHash
+# signatures through the permutation kernels.
+_DIGESTS = """if 1:
+    import xxhash
+    secret = xxhash.xxh3_generate_secret(b'simd')
+    out = [xxhash.simd_backend]
+    for n in [0, 1, 16, 17, 128, 129, 240, 241, 1024, 1025, 4096, 100003]:
+        data = bytes((i * 7 + n) % 251 for i in range(n))
+        out.append(xxhash.xxh3_64_intdigest(data))
+        out.append(xxhash.xxh3_64_intdigest(data, 2**64 - 1))
+        out.append(xxhash.xxh3_64_intdigest(data, secret=secret))
+        out.append(xxhash.xxh3_128_intdigest(data))
+        out.append(xxhash.xxh3_128_intdigest(data, 1))
+        out.append(xxhash.xxh3_128_intdigest(data, secret=secret))
+        out.append(xxhash.xxh3_64_hasher(3)(data))
+        out.append(xxhash.xxh3_128_hasher(3)(data))
+        h = xxhash.xxh3_64(seed=5)
+        for i in range(0, n, 333):
+            h.update(data[i:i + 333])
+        out.append(h.intdigest())
+        h = xxhash.xxh3_128(secret=secret)
+        for i in range(0, n, 1000):
+            h.update(data[i:i + 1000])
+        out.append(h.intdigest())
+    values = [bytes(range(n % 131)) for n in range(1000)]
+    out.extend(xxhash.xxh3_64_intdigest_many(values, 7))
+    values = [bytes(range(251)) * 20 + bytes(n % 37) for n in range(50)]
+    out.extend(xxhash.xxh32_intdigest_many(values, 7))
+    out.extend(xxhash.xxh64_intdigest_many(values, 7))
+    ints = bytes((i * 13) % 256 for i in range(16 * 37))
+    out.extend(xxhash.hash_uint32_array(ints, 2**64 - 1))
+    out.extend(xxhash.hash_uint64_array(ints, 7))
+    out.extend(xxhash.hash_uint128_array(ints, 7))
+    for k in (1, 7, 8, 31, 32, 43, 128):
+        out.extend(xxhash.minhash(bytes(range(251)) * 3, k, 4, 9))
+    # Unordered containers stream their items through nested XXH3 states.
+    big = ['x' * (i * 97) for i in range(60)]
+    out.append(xxhash.hash_object(set(big)))
+    out.append(xxhash.hash_object(frozenset(s.encode() for s in big), 'xxh3_64'))
+    out.append(xxhash.hash_object({s: [s, {s}] for s in big}, unordered_dicts=True))
+    print(out)
+"""
+
+
+def _run(backend):
+    env = dict(os.environ, XXHASH_SIMD_BACKEND=backend)
+    proc = subprocess.run([sys.executable, '-c', _DIGESTS], env=env,
+                          capture_output=True, text=True, timeout=120)
+    return proc
+
+
+class TestSIMDBackend(unittest.TestCase):
+    def test_simd_backend(self):
+        if xxhash.simd_backend is None:
+            self.assertEqual(xxhash._xxhash._SIMD_BACKENDS, ())
+            return
+        self.assertIsInstance(xxhash.simd_backend, str)
+        self.assertIn(xxhash.simd_backend, xxhash._xxhash._SIMD_BACKENDS)
+        self.assertEqual(xxhash._xxhash._SIMD_BACKENDS[-1], 'scalar')
+
+    @unittest.skipIf(xxhash.simd_backend is None, 'linked to libxxhash')
+    def test_backends_agree(self):
+        expected = None
+        for backend in xxhash._xxhash._SIMD_BACKENDS:
+            proc = _run(backend)
+            self.assertEqual(proc.returncode, 0, proc.stderr)
+            self.assertEqual(proc.stderr, '')
+            name, _, digests = proc.stdout.partition(', ')
+            self.assertEqual(name, '[%r' % backend)
+            if expected is None:
+                expected = digests
+            self.assertEqual(digests, expected, backend)
+
+    @unittest.skipIf(xxhash.simd_backend is None, 'linked to libxxhash')
+    def test_unsupported_backend(self):
+        proc = _run('no-such-unit')
+        self.assertEqual(proc.returncode, 0, proc.stderr)
+        self.assertIn('RuntimeWarning', proc.stderr)
+        self.assertTrue(proc.stdout.startswith(
+            '[%r' % xxhash._xxhash._SIMD_BACKENDS[0]), proc.stdout)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -71,6 +71,30 @@ class TestXXH(unittest.TestCase):
         self.assertEqual(a.intdigest(), b.intdigest())
         self.assertEqual(a.hexdigest(), b.hexdigest())
 
+    def test_xxh32_hasher(self):
+        for seed in (0, 1, 2**32-1):
+            h = xxhash.xxh32_hasher(seed)
+            self.assertEqual(h.seed, seed)
+            self.assertEqual(h.name, 'XXH32')
+            # Lengths around the XXH3 short-input and secret-based paths.
+            for n in (0, 1, 16, 128, 240, 241, 1024, 100000):
+                data = os.urandom(n)
+                self.assertEqual(h(data), xxhash.xxh32_intdigest(data, seed))
+                self.assertEqual(h.intdigest(data), xxhash.xxh32_intdigest(data, seed))
+                self.assertEqual(h.digest(data), xxhash.xxh32_digest(data, seed))
+                self.assertEqual(h.hexdigest(memoryview(data)), xxhash.xxh32_hexdigest(data, seed))
+        self.assertEqual(xxhash.xxh32_hasher(seed=2**32-1 + 1).seed, 0)
+        self.assertEqual(xxhash.xxh32_hasher()(b'a'), xxhash.xxh32_intdigest(b'a'))
+        h = xxhash.xxh32_hasher(1)
+        with self.assertRaises(TypeError):
+            h('a')
+        with self.assertRaises(TypeError):
+            h(b'a', 1)
+        with self.assertRaises(TypeError):
+            h(data=b'a')
+        with self.assertRaises(TypeError):
+            xxhash.BoundHasher()
+
     def test_xxh32_overflow(self):
         s = b'I want an unsigned 32-bit seed!'
         a = xxhash.xxh32(s, seed=0)
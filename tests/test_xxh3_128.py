@@ -114,6 +114,101 @@ class TestXXH(unittest.TestCase):
         self.assertEqual(a.intdigest(), b.intdigest())
         self.assertEqual(a.hexdigest(), b.hexdigest())
 
+    def test_xxh3_128_hasher(self):
+        for seed in (0, 1, 2**64-1):
+            h = xxhash.xxh3_128_hasher(seed)
+            self.assertEqual(h.seed, seed)
+            self.assertEqual(h.name, 'XXH3_128')
+            # Lengths around the XXH3 short-input and secret-based paths.
+            for n in (0, 1, 16, 128, 240, 241, 1024, 100000):
+                data = os.urandom(n)
+                self.assertEqual(h(data), xxhash.xxh3_128_intdigest(data, seed))
+                self.assertEqual(h.intdigest(data), xxhash.xxh3_128_intdigest(data, seed))
+                self.assertEqual(h.digest(data), xxhash.xxh3_128_digest(data, seed))
+                self.assertEqual(h.hexdigest(memoryview(data)), xxhash.xxh3_128_hexdigest(data, seed))
+        self.assertEqual(xxhash.xxh3_128_hasher(seed=2**64-1 + 1).seed, 0)
+        self.assertEqual(xxhash.xxh3_128_hasher()(b'a'), xxhash.xxh3_128_intdigest(b'a'))
+        h = xxhash.xxh3_128_hasher(1)
+        with self.assertRaises(TypeError):
+            h('a')
+        with self.assertRaises(TypeError):
+            h(b'a', 1)
+        with self.assertRaises(TypeError):
+            h(data=b'a')
+        with self.assertRaises(TypeError):
+            xxhash.BoundHasher()
+
+    def test_xxh3_128_secret(self):
+        secret = xxhash.xxh3_generate_secret(b'xxhash')
+        self.assertEqual(len(secret), xxhash.XXH3_SECRET_DEFAULT_SIZE)
+        self.assertEqual(xxhash.xxh3_128_intdigest(b'a', secret=secret), 64014667714243855767907796910875795922)
+        self.assertEqual(xxhash.xxh3_128_intdigest(b'a' * 1000, secret=secret), 61977024621688166872805074157217158248)
+        self.assertEqual(xxhash.xxh3_128(b'a', secret=secret).intdigest(), 64014667714243855767907796910875795922)
+        self.assertEqual(xxhash.xxh3_128(secret=bytearray(secret)).seed, 0)
+
+        for secret in (secret, xxhash.xxh3_generate_secret(),
+                       xxhash.xxh3_generate_secret(size=xxhash.XXH3_SECRET_SIZE_MIN)):
+            h = xxhash.xxh3_128_hasher(secret=secret)
+            for n in (0, 1, 16, 128, 240, 241, 1024, 100000):
+                data = os.urandom(n)
+                expected = xxhash.xxh3_128_intdigest(data, secret=secret)
+                self.assertNotEqual(expected, xxhash.xxh3_128_intdigest(data))
+                self.assertEqual(xxhash.xxh3_128_digest(data, secret=secret),
+                                 xxhash.xxh3_128(data, secret=secret).digest())
+                self.assertEqual(xxhash.xxh3_128_hexdigest(data, secret=memoryview(secret)),
+                                 xxhash.xxh3_128(data, secret=secret).hexdigest())
+                self.assertEqual(h(data), expected)
+
+                x = xxhash.xxh3_128(secret=secret)
+                x.update(data[:n // 2])
+                y = x.copy()
+                del x
+                y.update(data[n // 2:])
+                self.assertEqual(y.intdigest(), expected)
+                y.reset()
+                y.update(data)
+                self.assertEqual(y.intdigest(), expected)
+
+        x = xxhash.xxh3_128(b'a', secret=secret)
+        x.__init__(b'a')
+        self.assertEqual(x.intdigest(), xxhash.xxh3_128_intdigest(b'a'))
+        x.__init__(b'a', secret=secret)
+        self.assertEqual(x.intdigest(), xxhash.xxh3_128_intdigest(b'a', secret=secret))
+
+        with self.assertRaises(ValueError):
+            xxhash.xxh3_128_intdigest(b'a', 1, secret=secret)
+        with self.assertRaises(ValueError):
+            xxhash.xxh3_128(b'a', seed=1, secret=secret)
+        with self.assertRaises(ValueError):
+            xxhash.xxh3_128_hasher(1, secret=secret)
+        with self.assertRaises(ValueError):
+            xxhash.xxh3_128_digest(b'a', secret=secret[:xxhash.XXH3_SECRET_SIZE_MIN - 1])
+        with self.assertRaises(ValueError):
+            xxhash.xxh3_generate_secret(b'a', xxhash.XXH3_SECRET_SIZE_MIN - 1)
+        with self.assertRaises(TypeError):
+            xxhash.xxh3_128(secret='a' * 200)
+
+    def test_xxh3_128_intdigest_str(self):
+        # ASCII, Latin-1, BMP and astral storage, around the one-shot chunk.
+        for s in ('', 'a', 'xxhash', 'na\xefve caf\xe9', '\u65e5\u672c\u8a9e',
+                  '\U0001f600', 'k' * 100000, '\xe9' * 600, '\u65e5' * 341,
+                  '\u65e5' * 342, 'a\U0001f600' * 500):
+            for seed in (0, 1, 2**64-1):
+                self.assertEqual(xxhash.xxh3_128_intdigest_str(s, seed),
+                                 xxhash.xxh3_128_intdigest(s.encode('utf-8'), seed))
+        self.assertEqual(xxhash.xxh3_128_intdigest_str(data='a', seed=2**64),
+                         xxhash.xxh3_128_intdigest(b'a'))
+        for s in ('\ud800', 'a' * 2000 + '\udfff'):
+            with self.assertRaises(UnicodeEncodeError):
+                xxhash.xxh3_128_intdigest_str(s)
+        with self.assertRaises(TypeError):
+            xxhash.xxh3_128_intdigest_str(b'a')
+        with self.assertRaises(TypeError):
+            xxhash.xxh3_128_intdigest_str()
+        with self.assertRaises(TypeError):
+            xxhash.xxh3_128_intdigest_str('a', 0, 0)
+        self.assertIs(xxhash.xxh128_intdigest_str, xxhash.xxh3_128_intdigest_str)
+
     def test_xxh3_128_overflow(self):
         s = b'I want an unsigned 64-bit seed!'
         a = xxhash.xxh3_128(s, seed=0)
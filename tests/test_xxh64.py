@@ -1,4 +1,5 @@
 import os
+import sys
 import unittest
 import random
 import xxhash
@@ -70,6 +71,31 @@ class TestXXH(unittest.TestCase):
         self.assertEqual(a.intdigest(), b.intdigest())
         self.assertEqual(a.hexdigest(), b.hexdigest())
 
+    def test_xxh64_hasher(self):
+        for seed in (0, 1, 2**64-1):
+            h = xxhash.xxh64_hasher(seed)
+            self.assertEqual(h.seed, seed)
+            self.assertEqual(h.name, 'XXH64')
+            self.assertEqual(sys.getsizeof(h), sys.getsizeof(xxhash.xxh3_64_hasher()))
+            # Lengths around the XXH3 short-input and secret-based paths.
+            for n in (0, 1, 16, 128, 240, 241, 1024, 100000):
+                data = os.urandom(n)
+                self.assertEqual(h(data), xxhash.xxh64_intdigest(data, seed))
+                self.assertEqual(h.intdigest(data), xxhash.xxh64_intdigest(data, seed))
+                self.assertEqual(h.digest(data), xxhash.xxh64_digest(data, seed))
+                self.assertEqual(h.hexdigest(memoryview(data)), xxhash.xxh64_hexdigest(data, seed))
+        self.assertEqual(xxhash.xxh64_hasher(seed=2**64-1 + 1).seed, 0)
+        self.assertEqual(xxhash.xxh64_hasher()(b'a'), xxhash.xxh64_intdigest(b'a'))
+        h = xxhash.xxh64_hasher(1)
+        with self.assertRaises(TypeError):
+            h('a')
+        with self.assertRaises(TypeError):
+            h(b'a', 1)
+        with self.assertRaises(TypeError):
+            h(data=b'a')
+        with self.assertRaises(TypeError):
+            xxhash.BoundHasher()
+
     def test_xxh64_overflow(self):
         s = b'I want an unsigned 64-bit seed!'
         a = xxhash.xxh64(s, seed=0)
@@ -15,7 +15,52 @@ from ._xxhash import (
     xxh3_128_digest,
     xxh3_128_intdigest,
     xxh3_128_hexdigest,
+    xxh3_64_intdigest_str,
+    xxh3_128_intdigest_str,
+    xxh3_generate_secret,
+    xxh32_hasher,
+    xxh64_hasher,
+    xxh3_64_hasher,
+    xxh3_128_hasher,
+    BoundHasher,
+    xxh32_digest_many,
+    xxh32_intdigest_many,
+    xxh64_digest_many,
+    xxh64_intdigest_many,
+    xxh3_64_digest_many,
+    xxh3_64_intdigest_many,
+    xxh3_128_digest_many,
+    xxh3_128_intdigest_many,
+    xxh3_64_hash_strided,
+    xxh3_128_hash_strided,
+    xxh3_64_hash_offsets,
+    xxh3_128_hash_offsets,
+    xxh3_64_hash_columns,
+    xxh3_128_hash_columns,
+    hash_uint32_array,
+    hash_uint64_array,
+    hash_uint128_array,
+    file_digest,
+    file_block_digests,
+    copy_and_hash,
+    hash_tree,
+    verify_manifest,
+    hash_object,
+    minhash,
+    minhash_many,
+    jump_hash_many,
+    rendezvous_many,
+    DigestCache,
+    BloomFilter,
+    HyperLogLog,
+    CountMinSketch,
+    HashRing,
+    set_default_nthreads,
+    get_default_nthreads,
     XXHASH_VERSION,
+    XXH3_SECRET_SIZE_MIN,
+    XXH3_SECRET_DEFAULT_SIZE,
+    simd_backend,
 )
 
 from .version import VERSION
@@ -23,8 +68,15 @@ from .version import VERSION
 
 xxh128 = xxh3_128
 xxh128_hexdigest = xxh3_128_hexdigest
+xxh128_intdigest_str = xxh3_128_intdigest_str
 xxh128_intdigest = xxh3_128_intdigest
 xxh128_digest = xxh3_128_digest
+xxh128_hasher = xxh3_128_hasher
+xxh128_digest_many = xxh3_128_digest_many
+xxh128_intdigest_many = xxh3_128_intdigest_many
+xxh128_hash_strided = xxh3_128_hash_strided
+xxh128_hash_offsets = xxh3_128_hash_offsets
+xxh128_hash_columns = xxh3_128_hash_columns
 
 algorithms_available = set([
     "xxh32",
@@ -58,8 +110,60 @@ __all__ = [
     "xxh128_digest",
     "xxh128_intdigest",
     "xxh128_hexdigest",
+    "xxh3_64_intdigest_str",
+    "xxh3_128_intdigest_str",
+    "xxh128_intdigest_str",
+    "xxh3_generate_secret",
+    "xxh32_hasher",
+    "xxh64_hasher",
+    "xxh3_64_hasher",
+    "xxh3_128_hasher",
+    "xxh128_hasher",
+    "BoundHasher",
+    "xxh32_digest_many",
+    "xxh32_intdigest_many",
+    "xxh64_digest_many",
+    "xxh64_intdigest_many",
+    "xxh3_64_digest_many",
+    "xxh3_64_intdigest_many",
+    "xxh3_128_digest_many",
+    "xxh3_128_intdigest_many",
+    "xxh128_digest_many",
+    "xxh128_intdigest_many",
+    "xxh3_64_hash_strided",
+    "xxh3_128_hash_strided",
+    "xxh128_hash_strided",
+    "xxh3_64_hash_offsets",
+    "xxh3_128_hash_offsets",
+    "xxh128_hash_offsets",
+    "xxh3_64_hash_columns",
+    "xxh3_128_hash_columns",
+    "xxh128_hash_columns",
+    "hash_uint32_array",
+    "hash_uint64_array",
+    "hash_uint128_array",
+    "file_digest",
+    "file_block_digests",
+    "copy_and_hash",
+    "hash_tree",
+    "verify_manifest",
+    "hash_object",
+    "minhash",
+    "minhash_many",
+    "jump_hash_many",
+    "rendezvous_many",
+    "DigestCache",
+    "BloomFilter",
+    "HyperLogLog",
+    "CountMinSketch",
+    "HashRing",
+    "set_default_nthreads",
+    "get_default_nthreads",
     "VERSION",
     "XXHASH_VERSION",
+    "XXH3_SECRET_SIZE_MIN",
+    "XXH3_SECRET_DEFAULT_SIZE",
+    "simd_backend",
     "algorithms_available",
     "algorithms_guaranteed",
 ]
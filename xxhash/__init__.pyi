@@ -1,13 +1,26 @@
-from typing import Protocol, final
+from os import PathLike
+from types import TracebackType
+from typing import IO, Iterable, Literal, Protocol, Sequence, TypeVar, final, overload
 
 class _Buffer(Protocol):
     """Objects that support the buffer protocol (PEP 688)."""
     def __buffer__(self, flags: int, /) -> memoryview: ...
 
+class _HasFileno(Protocol):
+    def fileno(self) -> int: ...
+
 _DataType = _Buffer
+_OutT = TypeVar("_OutT", bound=_Buffer)
+_HasherT = TypeVar("_HasherT", bound=_Hasher)
+_FileType = int | str | bytes | PathLike[str] | PathLike[bytes]
+_KeysType = Sequence[_Buffer] | _Buffer
+_AlgorithmName = Literal["xxh32", "xxh64", "xxh3_64", "xxh3_128", "xxh128"]
 
 VERSION: str
 XXHASH_VERSION: str
+XXH3_SECRET_SIZE_MIN: int
+XXH3_SECRET_DEFAULT_SIZE: int
+simd_backend: str | None
 
 algorithms_available: set[str]
 algorithms_guaranteed: set[str]
@@ -33,8 +46,60 @@ __all__: list[str] = [
     "xxh128_digest",
     "xxh128_intdigest",
     "xxh128_hexdigest",
+    "xxh3_64_intdigest_str",
+    "xxh3_128_intdigest_str",
+    "xxh128_intdigest_str",
+    "xxh3_generate_secret",
+    "xxh32_hasher",
+    "xxh64_hasher",
+    "xxh3_64_hasher",
+    "xxh3_128_hasher",
+    "xxh128_hasher",
+    "BoundHasher",
+    "xxh32_digest_many",
+    "xxh32_intdigest_many",
+    "xxh64_digest_many",
+    "xxh64_intdigest_many",
+    "xxh3_64_digest_many",
+    "xxh3_64_intdigest_many",
+    "xxh3_128_digest_many",
+    "xxh3_128_intdigest_many",
+    "xxh128_digest_many",
+    "xxh128_intdigest_many",
+    "xxh3_64_hash_strided",
+    "xxh3_128_hash_strided",
+    "xxh128_hash_strided",
+    "xxh3_64_hash_offsets",
+    "xxh3_128_hash_offsets",
+    "xxh128_hash_offsets",
+    "xxh3_64_hash_columns",
+    "xxh3_128_hash_columns",
+    "xxh128_hash_columns",
+    "hash_uint32_array",
+    "hash_uint64_array",
+    "hash_uint128_array",
+    "file_digest",
+    "file_block_digests",
+    "copy_and_hash",
+    "hash_tree",
+    "verify_manifest",
+    "hash_object",
+    "minhash",
+    "minhash_many",
+    "jump_hash_many",
+    "rendezvous_many",
+    "DigestCache",
+    "BloomFilter",
+    "HyperLogLog",
+    "CountMinSketch",
+    "HashRing",
+    "set_default_nthreads",
+    "get_default_nthreads",
     "VERSION",
     "XXHASH_VERSION",
+    "XXH3_SECRET_SIZE_MIN",
+    "XXH3_SECRET_DEFAULT_SIZE",
+    "simd_backend",
     "algorithms_available",
     "algorithms_guaranteed",
 ]
@@ -65,29 +130,318 @@ class xxh32(_Hasher): ...
 class xxh64(_Hasher): ...
 
 @final
-class xxh3_64(_Hasher): ...
+class xxh3_64(_Hasher):
+    def __init__(self, data: _DataType = ..., seed: int = ..., *, secret: _DataType | None = ...) -> None: ...
 
 @final
-class xxh3_128(_Hasher): ...
+class xxh3_128(_Hasher):
+    def __init__(self, data: _DataType = ..., seed: int = ..., *, secret: _DataType | None = ...) -> None: ...
 
 xxh128 = xxh3_128
 
-def xxh32_digest(data: _DataType, seed: int = ...) -> bytes: ...
+@final
+class DigestCache:
+    def __init__(self, path: str | bytes | PathLike[str] | PathLike[bytes], capacity: int = ...) -> None: ...
+    def stats(self) -> dict[str, int | float]: ...
+    def clear(self) -> None: ...
+    def flush(self) -> None: ...
+    def close(self) -> None: ...
+    def __enter__(self) -> DigestCache: ...
+    def __exit__(self, exc_type: type[BaseException] | None, exc: BaseException | None, tb: TracebackType | None) -> None: ...
+    @property
+    def path(self) -> str | bytes | PathLike[str] | PathLike[bytes]: ...
+    @property
+    def capacity(self) -> int: ...
+    @property
+    def closed(self) -> bool: ...
+
+class BloomFilter:
+    def __init__(self, capacity: int, fp_rate: float = ..., seed: int = ...) -> None: ...
+    @classmethod
+    def frombytes(cls, data: _Buffer, /) -> BloomFilter: ...
+    @classmethod
+    def open(cls, path: str | bytes | PathLike[str] | PathLike[bytes], writable: bool = ...) -> BloomFilter: ...
+    def add(self, key: _Buffer, /) -> None: ...
+    def add_many(self, keys: _KeysType, offsets: _Buffer | None = ...) -> None: ...
+    @overload
+    def contains_many(self, keys: _KeysType, offsets: _Buffer | None = ..., *, out: None = ..., nthreads: int | None = ...) -> list[bool]: ...
+    @overload
+    def contains_many(self, keys: _KeysType, offsets: _Buffer | None = ..., *, out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+    def __contains__(self, key: _Buffer, /) -> bool: ...
+    def __buffer__(self, flags: int, /) -> memoryview: ...
+    def __bytes__(self) -> bytes: ...
+    def flush(self) -> None: ...
+    def close(self) -> None: ...
+    def __enter__(self) -> BloomFilter: ...
+    def __exit__(self, exc_type: type[BaseException] | None, exc: BaseException | None, tb: TracebackType | None) -> None: ...
+    @property
+    def capacity(self) -> int: ...
+    @property
+    def fp_rate(self) -> float: ...
+    @property
+    def seed(self) -> int: ...
+    @property
+    def num_bits(self) -> int: ...
+    @property
+    def num_hashes(self) -> int: ...
+    @property
+    def count(self) -> int: ...
+    @property
+    def readonly(self) -> bool: ...
+    @property
+    def closed(self) -> bool: ...
+    @property
+    def path(self) -> str | bytes | PathLike[str] | PathLike[bytes] | None: ...
+
+class HyperLogLog:
+    def __init__(self, precision: int = ..., seed: int = ...) -> None: ...
+    @classmethod
+    def frombytes(cls, data: _Buffer, /) -> HyperLogLog: ...
+    def add(self, key: _Buffer, /) -> None: ...
+    def add_many(self, keys: _KeysType, offsets: _Buffer | None = ..., *, nthreads: int | None = ...) -> None: ...
+    def merge(self, other: HyperLogLog, /) -> None: ...
+    def cardinality(self) -> float: ...
+    def __buffer__(self, flags: int, /) -> memoryview: ...
+    @property
+    def precision(self) -> int: ...
+    @property
+    def seed(self) -> int: ...
+
+class CountMinSketch:
+    def __init__(self, width: int, depth: int = ..., seed: int = ..., *, conservative: bool = ...) -> None: ...
+    @classmethod
+    def frombytes(cls, data: _Buffer, /) -> CountMinSketch: ...
+    def add(self, key: _Buffer, count: int = ...) -> None: ...
+    def add_many(self, keys: _KeysType, offsets: _Buffer | None = ..., *, weights: Sequence[int] | _Buffer | None = ...) -> None: ...
+    def estimate(self, key: _Buffer, /) -> int: ...
+    @overload
+    def estimate_many(self, keys: _KeysType, offsets: _Buffer | None = ..., *, out: None = ..., nthreads: int | None = ...) -> list[int]: ...
+    @overload
+    def estimate_many(self, keys: _KeysType, offsets: _Buffer | None = ..., *, out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+    def merge(self, other: CountMinSketch, /) -> None: ...
+    def __buffer__(self, flags: int, /) -> memoryview: ...
+    @property
+    def width(self) -> int: ...
+    @property
+    def depth(self) -> int: ...
+    @property
+    def seed(self) -> int: ...
+    @property
+    def conservative(self) -> bool: ...
+    @property
+    def total(self) -> int: ...
+
+class HashRing:
+    def __init__(self, nodes: _KeysType, vnodes: int = ..., seed: int = ...) -> None: ...
+    def lookup(self, key: _Buffer, /) -> int: ...
+    @overload
+    def lookup_many(self, keys: _KeysType, offsets: _Buffer | None = ..., *, out: None = ..., nthreads: int | None = ...) -> list[int]: ...
+    @overload
+    def lookup_many(self, keys: _KeysType, offsets: _Buffer | None = ..., *, out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+    @property
+    def num_nodes(self) -> int: ...
+    @property
+    def vnodes(self) -> int: ...
+    @property
+    def seed(self) -> int: ...
+
+@overload
+def xxh32_digest(data: _DataType, seed: int = ..., *, out: None = ...) -> bytes: ...
+@overload
+def xxh32_digest(data: _DataType, seed: int = ..., *, out: _OutT) -> _OutT: ...
 def xxh32_hexdigest(data: _DataType, seed: int = ...) -> str: ...
-def xxh32_intdigest(data: _DataType, seed: int = ...) -> int: ...
+@overload
+def xxh32_intdigest(data: _DataType, seed: int = ..., *, out: None = ...) -> int: ...
+@overload
+def xxh32_intdigest(data: _DataType, seed: int = ..., *, out: _OutT) -> _OutT: ...
 
-def xxh64_digest(data: _DataType, seed: int = ...) -> bytes: ...
+@overload
+def xxh64_digest(data: _DataType, seed: int = ..., *, out: None = ...) -> bytes: ...
+@overload
+def xxh64_digest(data: _DataType, seed: int = ..., *, out: _OutT) -> _OutT: ...
 def xxh64_hexdigest(data: _DataType, seed: int = ...) -> str: ...
-def xxh64_intdigest(data: _DataType, seed: int = ...) -> int: ...
+@overload
+def xxh64_intdigest(data: _DataType, seed: int = ..., *, out: None = ...) -> int: ...
+@overload
+def xxh64_intdigest(data: _DataType, seed: int = ..., *, out: _OutT) -> _OutT: ...
 
-def xxh3_64_digest(data: _DataType, seed: int = ...) -> bytes: ...
-def xxh3_64_hexdigest(data: _DataType, seed: int = ...) -> str: ...
-def xxh3_64_intdigest(data: _DataType, seed: int = ...) -> int: ...
+@overload
+def xxh3_64_digest(data: _DataType, seed: int = ..., *, secret: _DataType | None = ..., out: None = ...) -> bytes: ...
+@overload
+def xxh3_64_digest(data: _DataType, seed: int = ..., *, secret: _DataType | None = ..., out: _OutT) -> _OutT: ...
+def xxh3_64_hexdigest(data: _DataType, seed: int = ..., *, secret: _DataType | None = ...) -> str: ...
+@overload
+def xxh3_64_intdigest(data: _DataType, seed: int = ..., *, secret: _DataType | None = ..., out: None = ...) -> int: ...
+@overload
+def xxh3_64_intdigest(data: _DataType, seed: int = ..., *, secret: _DataType | None = ..., out: _OutT) -> _OutT: ...
 
-def xxh3_128_digest(data: _DataType, seed: int = ...) -> bytes: ...
-def xxh3_128_hexdigest(data: _DataType, seed: int = ...) -> str: ...
-def xxh3_128_intdigest(data: _DataType, seed: int = ...) -> int: ...
+@overload
+def xxh3_128_digest(data: _DataType, seed: int = ..., *, secret: _DataType | None = ..., out: None = ...) -> bytes: ...
+@overload
+def xxh3_128_digest(data: _DataType, seed: int = ..., *, secret: _DataType | None = ..., out: _OutT) -> _OutT: ...
+def xxh3_128_hexdigest(data: _DataType, seed: int = ..., *, secret: _DataType | None = ...) -> str: ...
+@overload
+def xxh3_128_intdigest(data: _DataType, seed: int = ..., *, secret: _DataType | None = ..., out: None = ...) -> int: ...
+@overload
+def xxh3_128_intdigest(data: _DataType, seed: int = ..., *, secret: _DataType | None = ..., out: _OutT) -> _OutT: ...
 
 xxh128_digest = xxh3_128_digest
 xxh128_hexdigest = xxh3_128_hexdigest
 xxh128_intdigest = xxh3_128_intdigest
+
+def xxh3_64_intdigest_str(data: str, seed: int = ...) -> int: ...
+def xxh3_128_intdigest_str(data: str, seed: int = ...) -> int: ...
+
+xxh128_intdigest_str = xxh3_128_intdigest_str
+
+def xxh3_generate_secret(material: _DataType | None = ..., size: int = ...) -> bytes: ...
+
+@final
+class BoundHasher:
+    def __call__(self, data: _DataType, /) -> int: ...
+    def digest(self, data: _DataType, /) -> bytes: ...
+    def hexdigest(self, data: _DataType, /) -> str: ...
+    def intdigest(self, data: _DataType, /) -> int: ...
+    @property
+    def name(self) -> str: ...
+    @property
+    def seed(self) -> int: ...
+    @property
+    def digest_size(self) -> int: ...
+
+def xxh32_hasher(seed: int = ...) -> BoundHasher: ...
+def xxh64_hasher(seed: int = ...) -> BoundHasher: ...
+def xxh3_64_hasher(seed: int = ..., *, secret: _DataType | None = ...) -> BoundHasher: ...
+def xxh3_128_hasher(seed: int = ..., *, secret: _DataType | None = ...) -> BoundHasher: ...
+
+xxh128_hasher = xxh3_128_hasher
+
+@overload
+def xxh32_digest_many(data: Iterable[_DataType], seed: int = ..., *, out: None = ..., nthreads: int | None = ...) -> list[bytes]: ...
+@overload
+def xxh32_digest_many(data: Iterable[_DataType], seed: int = ..., *, out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+@overload
+def xxh32_intdigest_many(data: Iterable[_DataType], seed: int = ..., *, out: None = ..., nthreads: int | None = ...) -> list[int]: ...
+@overload
+def xxh32_intdigest_many(data: Iterable[_DataType], seed: int = ..., *, out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+
+@overload
+def xxh64_digest_many(data: Iterable[_DataType], seed: int = ..., *, out: None = ..., nthreads: int | None = ...) -> list[bytes]: ...
+@overload
+def xxh64_digest_many(data: Iterable[_DataType], seed: int = ..., *, out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+@overload
+def xxh64_intdigest_many(data: Iterable[_DataType], seed: int = ..., *, out: None = ..., nthreads: int | None = ...) -> list[int]: ...
+@overload
+def xxh64_intdigest_many(data: Iterable[_DataType], seed: int = ..., *, out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+
+@overload
+def xxh3_64_digest_many(data: Iterable[_DataType], seed: int = ..., *, out: None = ..., nthreads: int | None = ...) -> list[bytes]: ...
+@overload
+def xxh3_64_digest_many(data: Iterable[_DataType], seed: int = ..., *, out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+@overload
+def xxh3_64_intdigest_many(data: Iterable[_DataType], seed: int = ..., *, out: None = ..., nthreads: int | None = ...) -> list[int]: ...
+@overload
+def xxh3_64_intdigest_many(data: Iterable[_DataType], seed: int = ..., *, out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+
+@overload
+def xxh3_128_digest_many(data: Iterable[_DataType], seed: int = ..., *, out: None = ..., nthreads: int | None = ...) -> list[bytes]: ...
+@overload
+def xxh3_128_digest_many(data: Iterable[_DataType], seed: int = ..., *, out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+@overload
+def xxh3_128_intdigest_many(data: Iterable[_DataType], seed: int = ..., *, out: None = ..., nthreads: int | None = ...) -> list[int]: ...
+@overload
+def xxh3_128_intdigest_many(data: Iterable[_DataType], seed: int = ..., *, out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+
+xxh128_digest_many = xxh3_128_digest_many
+xxh128_intdigest_many = xxh3_128_intdigest_many
+
+@overload
+def xxh3_64_hash_strided(data: _DataType, record_size: int, stride: int | None = ..., *, offset: int = ..., length: int | None = ..., seed: int = ..., out: None = ..., nthreads: int | None = ...) -> list[int]: ...
+@overload
+def xxh3_64_hash_strided(data: _DataType, record_size: int, stride: int | None = ..., *, offset: int = ..., length: int | None = ..., seed: int = ..., out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+@overload
+def xxh3_128_hash_strided(data: _DataType, record_size: int, stride: int | None = ..., *, offset: int = ..., length: int | None = ..., seed: int = ..., out: None = ..., nthreads: int | None = ...) -> list[int]: ...
+@overload
+def xxh3_128_hash_strided(data: _DataType, record_size: int, stride: int | None = ..., *, offset: int = ..., length: int | None = ..., seed: int = ..., out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+
+xxh128_hash_strided = xxh3_128_hash_strided
+
+@overload
+def xxh3_64_hash_offsets(data: _DataType, offsets: _Buffer, *, seed: int = ..., out: None = ..., nthreads: int | None = ...) -> list[int]: ...
+@overload
+def xxh3_64_hash_offsets(data: _DataType, offsets: _Buffer, *, seed: int = ..., out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+@overload
+def xxh3_128_hash_offsets(data: _DataType, offsets: _Buffer, *, seed: int = ..., out: None = ..., nthreads: int | None = ...) -> list[int]: ...
+@overload
+def xxh3_128_hash_offsets(data: _DataType, offsets: _Buffer, *, seed: int = ..., out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+
+xxh128_hash_offsets = xxh3_128_hash_offsets
+
+@overload
+def xxh3_64_hash_columns(columns: Sequence[_Buffer | tuple[_DataType, _Buffer]], seed: int = ..., *, out: None = ..., nthreads: int | None = ...) -> list[int]: ...
+@overload
+def xxh3_64_hash_columns(columns: Sequence[_Buffer | tuple[_DataType, _Buffer]], seed: int = ..., *, out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+@overload
+def xxh3_128_hash_columns(columns: Sequence[_Buffer | tuple[_DataType, _Buffer]], seed: int = ..., *, out: None = ..., nthreads: int | None = ...) -> list[int]: ...
+@overload
+def xxh3_128_hash_columns(columns: Sequence[_Buffer | tuple[_DataType, _Buffer]], seed: int = ..., *, out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+
+xxh128_hash_columns = xxh3_128_hash_columns
+
+@overload
+def hash_uint32_array(data: _Buffer, seed: int = ..., *, out: None = ..., nthreads: int | None = ...) -> list[int]: ...
+@overload
+def hash_uint32_array(data: _Buffer, seed: int = ..., *, out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+@overload
+def hash_uint64_array(data: _Buffer, seed: int = ..., *, out: None = ..., nthreads: int | None = ...) -> list[int]: ...
+@overload
+def hash_uint64_array(data: _Buffer, seed: int = ..., *, out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+@overload
+def hash_uint128_array(data: _Buffer, seed: int = ..., *, out: None = ..., nthreads: int | None = ...) -> list[int]: ...
+@overload
+def hash_uint128_array(data: _Buffer, seed: int = ..., *, out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+
+def set_default_nthreads(n: int, /) -> None: ...
+def get_default_nthreads() -> int: ...
+
+@overload
+def file_digest(file: _FileType, algorithm: type[_HasherT], *, seed: int = ..., mmap: bool = ..., buffer_size: int = ...) -> _HasherT: ...
+@overload
+def file_digest(file: _FileType, algorithm: _AlgorithmName, *, seed: int = ..., mmap: bool = ..., buffer_size: int = ...) -> _Hasher: ...
+
+@overload
+def file_block_digests(file: _FileType, algorithm: type[_Hasher] | _AlgorithmName, block_size: int | None = ..., *, ranges: Iterable[tuple[int, int]] | None = ..., seed: int = ..., mmap: bool = ..., out: None = ..., nthreads: int | None = ...) -> list[int]: ...
+@overload
+def file_block_digests(file: _FileType, algorithm: type[_Hasher] | _AlgorithmName, block_size: int | None = ..., *, ranges: Iterable[tuple[int, int]] | None = ..., seed: int = ..., mmap: bool = ..., out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+
+@overload
+def copy_and_hash(src: int | _HasFileno, dst: int | _HasFileno, algorithm: type[_HasherT], length: int | None = ..., *, seed: int = ..., buffer_size: int = ...) -> _HasherT: ...
+@overload
+def copy_and_hash(src: int | _HasFileno, dst: int | _HasFileno, algorithm: _AlgorithmName, length: int | None = ..., *, seed: int = ..., buffer_size: int = ...) -> _Hasher: ...
+
+@overload
+def hash_tree(root: str | PathLike[str], algorithm: type[_Hasher] | _AlgorithmName = ..., *, nthreads: int | None = ..., manifest: str | bytes | PathLike[str] | PathLike[bytes] | IO[bytes] | None = ..., format: Literal["gnu", "bsd"] = ..., follow_symlinks: bool = ..., cache: DigestCache | None = ...) -> dict[str, str]: ...
+@overload
+def hash_tree(root: bytes | PathLike[bytes], algorithm: type[_Hasher] | _AlgorithmName = ..., *, nthreads: int | None = ..., manifest: str | bytes | PathLike[str] | PathLike[bytes] | IO[bytes] | None = ..., format: Literal["gnu", "bsd"] = ..., follow_symlinks: bool = ..., cache: DigestCache | None = ...) -> dict[bytes, str]: ...
+
+def verify_manifest(manifest: str | bytes | PathLike[str] | PathLike[bytes] | IO[bytes], *, root: str | bytes | PathLike[str] | PathLike[bytes] | None = ..., nthreads: int | None = ..., cache: DigestCache | None = ...) -> dict[str, Literal["OK", "FAILED", "ERROR"]]: ...
+def hash_object(obj: object, algorithm: type[_Hasher] | _AlgorithmName = ..., seed: int = ..., *, unordered_dicts: bool = ...) -> int: ...
+
+_DocumentType = _Buffer | Sequence[_Buffer | str]
+
+@overload
+def minhash(data: _DocumentType, num_perm: int = ..., shingle: int = ..., seed: int = ..., *, out: None = ...) -> list[int]: ...
+@overload
+def minhash(data: _DocumentType, num_perm: int = ..., shingle: int = ..., seed: int = ..., *, out: _OutT) -> _OutT: ...
+@overload
+def minhash_many(documents: Sequence[_DocumentType] | _Buffer, num_perm: int = ..., shingle: int = ..., seed: int = ..., *, offsets: _Buffer | None = ..., out: None = ..., nthreads: int | None = ...) -> list[list[int]]: ...
+@overload
+def minhash_many(documents: Sequence[_DocumentType] | _Buffer, num_perm: int = ..., shingle: int = ..., seed: int = ..., *, offsets: _Buffer | None = ..., out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+@overload
+def jump_hash_many(keys: _KeysType, num_buckets: int, seed: int = ..., *, offsets: _Buffer | None = ..., out: None = ..., nthreads: int | None = ...) -> list[int]: ...
+@overload
+def jump_hash_many(keys: _KeysType, num_buckets: int, seed: int = ..., *, offsets: _Buffer | None = ..., out: _OutT, nthreads: int | None = ...) -> _OutT: ...
+@overload
+def rendezvous_many(keys: _KeysType, node_ids: _KeysType, weights: Sequence[float] | None = ..., seed: int = ..., *, offsets: _Buffer | None = ..., out: None = ..., nthreads: int | None = ...) -> list[int]: ...
+@overload
+def rendezvous_many(keys: _KeysType, node_ids: _KeysType, weights: Sequence[float] | None = ..., seed: int = ..., *, offsets: _Buffer | None = ..., out: _OutT, nthreads: int | None = ...) -> _OutT: ...